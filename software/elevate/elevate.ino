@@ -6,88 +6,198 @@
  * @author Jonathan Lee
  * Contact: jonlee27@seas.upenn.edu
  */
-#include <WiFi.h>
-#include <esp_now.h>
 #include "src/elevate_constants.h"
+#include "src/esp32_hal.h"
 #include "src/elevate_module.h"
 #include "src/button_panel.h"
 #include "src/elevate_system.h"
+#include "src/input_recorder.h"
+#include "src/control_task.h"
+#include "src/cycle_counter.h"
+#include "src/latency_stats.h"
+#include "src/minion_receiver.h"
+#include "src/pid_controller.h"
+#include "src/power_manager.h"
+#include "src/telemetry_buffer.h"
 
+// Set to 1 to report control task timing over serial
+#define BENCHMARK_CONTROL 0
+unsigned long const BENCHMARK_REPORT_MS = 10000;
+
+// Set to 1 to time the float and Q15.16 PID over serial at startup
+#define BENCHMARK_PID 0
+int const BENCHMARK_PID_ITERATIONS = 100000;
+
+// Set to 0 to stop streaming binary control telemetry over serial; the
+// benchmark reports use the port instead when either is on
+#define TELEMETRY 1
+#define STREAM_TELEMETRY (TELEMETRY && !BENCHMARK_CONTROL && !BENCHMARK_PID)
+unsigned long const TELEMETRY_BAUD_RATE = 921600;
+
+// Set to 1 to also stream radio frames and button levels on the telemetry
+// port, so elevate_replay can feed them back into ElevateSystem
+#define CAPTURE_INPUTS 0
+#define STREAM_INPUTS (CAPTURE_INPUTS && STREAM_TELEMETRY)
+
+// Set to 0 to keep the master awake while the desk is idle; the control
+// benchmark always keeps it awake
+#define LIGHT_SLEEP 1
+#define SLEEP_WHEN_IDLE (LIGHT_SLEEP && !BENCHMARK_CONTROL)
+unsigned long const IDLE_CHECK_MS = 100;
+
+Hal* const hal = esp32_hal();
+
+ButtonPanel button_panel = ButtonPanel(hal, ELEVATE_BOARD_.up_switch_pin, ELEVATE_BOARD_.down_switch_pin);
+
+typedef ElevateSystem<NUMBER_OF_MODULES_> Elevate;
+Elevate elevate(hal, ELEVATE_BOARD_, &button_panel);
+
+MinionReceiver receiver(hal, elevate.get_modules(), NUMBER_OF_MODULES_);
+
+ControlTask<Elevate> control_task(hal, &elevate, CONTROL_PERIOD_US_);
+
+TelemetryBuffer telemetry;
+
+#if STREAM_INPUTS
+InputRecorder input_recorder;
+#endif
+
+#if SLEEP_WHEN_IDLE
+PowerManager<Elevate> power_manager(hal, &elevate, &button_panel, &control_task, IDLE_SLEEP_DELAY_MS_);
+bool is_started = false;
+#endif
+
+#if BENCHMARK_CONTROL
 /**
- * Struct for messages from encoder minion
+ * Print control task timing over serial
  * 
- * id:                         minion ID
- * height:                     module height
- * lower_limit_switch_pressed: whether or not the lower limit switch is pressed
- * upper_limit_switch_pressed: whether or not the upper limit switch is pressed
+ * The statistics are read while the control task may be writing them, so a
+ * report can be off by the sample in flight.
  */
-struct MinionMessage {
-  unsigned int id;
-  int height;
-  bool lower_limit_switch_pressed;
-  bool upper_limit_switch_pressed;
-};
-MinionMessage message;
-
-ElevateModule module_0 = ElevateModule(
-  PWM_PIN_0,
-  PWM_CHANNEL_0,
-  DIRECTION_PIN_0
-);
-ElevateModule module_1 = ElevateModule(
-  PWM_PIN_1,
-  PWM_CHANNEL_1,
-  DIRECTION_PIN_1
-);
-ElevateModule module_2 = ElevateModule(
-  PWM_PIN_2,
-  PWM_CHANNEL_2,
-  DIRECTION_PIN_2
-);
-ElevateModule module_3 = ElevateModule(
-  PWM_PIN_3,
-  PWM_CHANNEL_3,
-  DIRECTION_PIN_3
-);
-
-int const NUMBER_OF_MODULES = 4;
-
-ElevateModule modules[NUMBER_OF_MODULES] = {
-  module_0,
-  module_1,
-  module_2,
-  module_3
-};
+void report_control_stats() {
+  LatencyStats const& execution = control_task.get_execution_stats();
+  LatencyStats const& jitter = control_task.get_jitter_stats();
+  float ticks_per_us = cycle_counter_ticks_per_us();
+  Serial.printf(
+    "control us: mean %.2f p99 %.2f max %.2f\n",
+    execution.get_mean() / ticks_per_us,
+    execution.get_percentile(99.0) / ticks_per_us,
+    execution.get_maximum() / ticks_per_us
+  );
+  Serial.printf(
+    "period jitter us: mean %.2f p99 %u max %u overruns %lu\n",
+    jitter.get_mean(),
+    jitter.get_percentile(99.0),
+    jitter.get_maximum(),
+    control_task.get_overruns()
+  );
+  for (int i = 0; i < LatencyStats::NUMBER_OF_BINS; i++) {
+    if (jitter.get_bin(i) == 0) continue;
+    Serial.printf("  <%u us: %u\n", (i + 1) * jitter.get_bin_width(), jitter.get_bin(i));
+  }
+  Serial.printf("  overflow: %u\n", jitter.get_overflow());
+}
+#endif
 
-ButtonPanel button_panel = ButtonPanel(UP_SWITCH_PIN_, DOWN_SWITCH_PIN_);
+#if BENCHMARK_PID
+/**
+ * Clock that moves one PID period on every read, so each benchmarked call
+ * runs a full sample
+ */
+class BenchmarkClock : public Clock {
+  public:
+    BenchmarkClock() : time_ms(0) {}
+    unsigned long millis() const { return time_ms += PID_RATE_MS_; }
+    unsigned long micros() const { return time_ms * 1000; }
 
-ElevateSystem elevate = ElevateSystem(modules, NUMBER_OF_MODULES, &button_panel);
+  private:
+    mutable unsigned long time_ms;
+};
 
-portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+/**
+ * Time one PID instantiation on the precomputed-coefficient path
+ * 
+ * @param name name to report
+ */
+template <typename T>
+void benchmark_pid(char const* name) {
+  BenchmarkClock clock;
+  PIDTuning tuning = {KP_, KI_ + 2.0f, KD_, KT_, DERIVATIVE_FILTER_MS_, OUTPUT_RATE_, MINIMUM_OUTPUT_, MAXIMUM_OUTPUT_};
+  PIDController<T> pid_controller = PIDController<T>(&clock, tuning, PID_RATE_MS_);
+  pid_controller.set_mode(ON);
+  volatile int sink = 0;
+  uint32_t start = read_cycle_counter();
+  for (int i = 0; i < BENCHMARK_PID_ITERATIONS; i++) {
+    sink = pid_controller.control((i % 1000) * 41, (i % 1000) * 40 + (i % 7) * 13, i % 300);
+  }
+  uint32_t cycles = read_cycle_counter() - start;
+  Serial.printf(
+    "%s: %.1f cycles, %.3f us per call\n",
+    name,
+    (float) cycles / BENCHMARK_PID_ITERATIONS,
+    (float) cycles / BENCHMARK_PID_ITERATIONS / cycle_counter_ticks_per_us()
+  );
+  (void) sink;
+}
+#endif
 
 /**
- * Callback when data is received from minion
+ * Callback when data is received from minion, only posts the sample for the
+ * control task to take
  */
 void receive_callback(const uint8_t* mac_address, const uint8_t* data, int len) {
-  portENTER_CRITICAL_ISR(&mux);
-  memcpy(&message, data, sizeof(message));
-  modules[message.id].update(
-    message.height,
-    message.lower_limit_switch_pressed,
-    message.upper_limit_switch_pressed
-  );
-  portEXIT_CRITICAL_ISR(&mux);
+#if STREAM_INPUTS
+  unsigned long receive_us = hal->clock->micros();
+#endif
+  receiver.receive(data, len);
+#if STREAM_INPUTS
+  input_recorder.record_radio_frame(receive_us, data, len);
+#endif
 }
 
 void setup() {
-  WiFi.mode(WIFI_STA);
-  WiFi.setSleep(false);
-  if (esp_now_init() != ESP_OK) return;
-  esp_now_register_recv_cb(receive_callback);
+#if BENCHMARK_CONTROL || BENCHMARK_PID
+  Serial.begin(115200);
+#elif STREAM_TELEMETRY
+  hal->serial->begin(TELEMETRY_BAUD_RATE);
+  elevate.set_telemetry(&telemetry);
+#endif
+#if STREAM_INPUTS
+  elevate.set_input_recorder(&input_recorder);
+#endif
+#if BENCHMARK_PID
+  benchmark_pid<float>("PID<float>");
+  benchmark_pid<Q16>("PID<Q16>");
+#endif
+  if (!hal->radio->begin()) return;
+  if (!hal->radio->add_peer(MINION_BROADCAST_ADDRESS, 0)) return;
+  hal->radio->set_receive_callback(receive_callback);
+  control_task.set_receiver(&receiver);
   elevate.setup();
+  control_task.start();
+#if SLEEP_WHEN_IDLE
+  is_started = true;
+#endif
 }
 
 void loop() {
-  elevate.update();
-  elevate.control();
+#if SLEEP_WHEN_IDLE
+  // Returns once a button wakes the master; the next pass resumes control
+  if (is_started && power_manager.update()) return;
+#endif
+#if BENCHMARK_CONTROL
+  delay(BENCHMARK_REPORT_MS);
+  report_control_stats();
+#elif STREAM_TELEMETRY
+  // loop() runs below the control task, so draining only uses idle time
+#if STREAM_INPUTS
+  input_recorder.drain(hal->serial);
+#endif
+  telemetry.drain(hal->serial);
+  vTaskDelay(1);
+#elif SLEEP_WHEN_IDLE
+  vTaskDelay(pdMS_TO_TICKS(IDLE_CHECK_MS));
+#else
+  vTaskDelay(portMAX_DELAY);
+#endif
 }
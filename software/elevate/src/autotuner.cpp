@@ -0,0 +1,241 @@
+/**
+ * @file autotuner.cpp
+ * 
+ * @brief relay-feedback PID autotune
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#include "autotuner.h"
+#include "elevate_constants.h"
+#include <math.h>
+
+int const Autotuner::RELAY_OUTPUT = AUTOTUNE_RELAY_OUTPUT_;
+long const Autotuner::HYSTERESIS = AUTOTUNE_HYSTERESIS_;
+long const Autotuner::LIFT = AUTOTUNE_LIFT_;
+int const Autotuner::WARMUP_CYCLES = AUTOTUNE_WARMUP_CYCLES_;
+int const Autotuner::CYCLES = AUTOTUNE_CYCLES_;
+unsigned long const Autotuner::TIMEOUT_MS = AUTOTUNE_TIMEOUT_MS_;
+unsigned long const Autotuner::PID_RATE_MS = PID_RATE_MS_;
+float const Autotuner::KP_RATIO = AUTOTUNE_KP_RATIO_;
+float const Autotuner::KI_RATIO = AUTOTUNE_KI_RATIO_;
+float const Autotuner::KD_RATIO = AUTOTUNE_KD_RATIO_;
+
+/**
+ * Autotuner constructor
+ * 
+ * @param hal               hardware abstraction layer
+ * @param modules           pointer to array of modules
+ * @param number_of_modules number of modules in system, at most 10
+ */
+Autotuner::Autotuner(Hal* hal, ElevateModule* modules, int number_of_modules) :
+HAL(hal),
+MODULES(modules),
+NUMBER_OF_MODULES((number_of_modules < MAXIMUM_MODULES) ? number_of_modules : MAXIMUM_MODULES) {
+  module = NUMBER_OF_MODULES;
+  tuned_modules = 0;
+  setpoint = 0;
+  is_relay_up = true;
+  start_time = 0;
+  previous_relay_time = 0;
+  cycle_start_time = 0;
+  cycles = 0;
+  peak = 0;
+  trough = 0;
+  amplitude_sum = 0.0f;
+  period_sum = 0.0f;
+  for (int i = 0; i < MAXIMUM_MODULES; i++) {
+    ultimate_gains[i] = 0.0f;
+    ultimate_periods[i] = 0.0f;
+  }
+}
+
+/**
+ * Give every module the gains stored for it, if any
+ */
+void Autotuner::load() {
+  if (!HAL->storage) return;
+  for (int i = 0; i < NUMBER_OF_MODULES; i++) {
+    char key[8];
+    get_key(i, key);
+    StoredGains gains;
+    if (HAL->storage->read(key, &gains, sizeof(gains)) && gains.version == GAINS_VERSION) {
+      MODULES[i].set_gains(gains.kp, gains.ki, gains.kd);
+    }
+  }
+}
+
+/**
+ * Start tuning from the first module, with every module stopped
+ */
+void Autotuner::start() {
+  for (int i = 0; i < NUMBER_OF_MODULES; i++) {
+    MODULES[i].hard_stop();
+  }
+  tuned_modules = 0;
+  module = 0;
+  start_module();
+}
+
+/**
+ * Abort tuning, keeping the gains of modules already tuned
+ */
+void Autotuner::stop() {
+  if (!is_running()) return;
+  MODULES[module].hard_stop();
+  module = NUMBER_OF_MODULES;
+}
+
+/**
+ * Run one control period of the experiment on the module under test: full
+ * relay output up while below the setpoint and down while above, with a
+ * small hysteresis band. The relay only switches once per PID period, so
+ * the sample-and-hold delay of the PID is part of the measured limit cycle.
+ * A module that does not oscillate within the timeout keeps its gains.
+ * 
+ * @return if tuning is over
+ */
+bool Autotuner::update() {
+  if (!is_running()) return true;
+  ElevateModule& current = MODULES[module];
+  unsigned long current_time = HAL->clock->millis();
+  if (current_time - start_time > TIMEOUT_MS || current.get_status() == MALFUNCTION) {
+    finish_module(false);
+    return !is_running();
+  }
+  if (current_time - previous_relay_time < PID_RATE_MS) return false;
+  previous_relay_time = current_time;
+
+  long height = current.get_height();
+  if (height > peak) peak = height;
+  if (height < trough) trough = height;
+  if (is_relay_up && height > setpoint + HYSTERESIS) {
+    is_relay_up = false;
+  } else if (!is_relay_up && height < setpoint - HYSTERESIS) {
+    is_relay_up = true;
+    if (cycles > WARMUP_CYCLES) {
+      amplitude_sum += (peak - trough) / 2.0f;
+      period_sum += (current_time - cycle_start_time) / 1000.0f;
+    }
+    cycles++;
+    cycle_start_time = current_time;
+    peak = height;
+    trough = height;
+    if (cycles > WARMUP_CYCLES + CYCLES) {
+      finish_module(true);
+      return !is_running();
+    }
+  }
+  current.drive(is_relay_up ? RELAY_OUTPUT : -RELAY_OUTPUT);
+  return false;
+}
+
+/**
+ * Get whether tuning is in progress
+ * 
+ * @return if a module is under test
+ */
+bool Autotuner::is_running() const {
+  return module < NUMBER_OF_MODULES;
+}
+
+/**
+ * Get how many modules the last run tuned
+ * 
+ * @return number of modules that oscillated and got new gains
+ */
+int Autotuner::get_tuned_modules() const {
+  return tuned_modules;
+}
+
+/**
+ * Get the ultimate gain measured for a module
+ * 
+ * @param module module index
+ * 
+ * @return ultimate gain in output per unit, 0 if never measured
+ */
+float Autotuner::get_ultimate_gain(int module) const {
+  return (module >= 0 && module < NUMBER_OF_MODULES) ? ultimate_gains[module] : 0.0f;
+}
+
+/**
+ * Get the ultimate period measured for a module
+ * 
+ * @param module module index
+ * 
+ * @return ultimate period in s, 0 if never measured
+ */
+float Autotuner::get_ultimate_period(int module) const {
+  return (module >= 0 && module < NUMBER_OF_MODULES) ? ultimate_periods[module] : 0.0f;
+}
+
+/**
+ * Set up the experiment on the current module, lifting it clear of the
+ * lower limit, or lowering it clear of the upper one
+ */
+void Autotuner::start_module() {
+  ElevateModule& current = MODULES[module];
+  long height = current.get_height();
+  setpoint = height + ((current.get_status() == UPPER_LIMITED) ? -LIFT : LIFT);
+  is_relay_up = setpoint > height;
+  start_time = HAL->clock->millis();
+  previous_relay_time = start_time - PID_RATE_MS;
+  cycle_start_time = start_time;
+  cycles = 0;
+  peak = height;
+  trough = height;
+  amplitude_sum = 0.0f;
+  period_sum = 0.0f;
+}
+
+/**
+ * Stop the current module, give it and store its new gains if the limit
+ * cycle was measured, and move on to the next module. The limit cycle
+ * amplitude a and period give the ultimate gain Ku = 4 d / (pi a) for relay
+ * output d and the ultimate period Tu, and the gains are ratios of them,
+ * stored per module so they survive a power cycle. The integral ratio
+ * defaults to zero: once a saturated leg sets the pace, a per-leg integral
+ * winds up against the leveling and raises the skew between legs.
+ * 
+ * @param is_measured if every cycle was measured
+ */
+void Autotuner::finish_module(bool is_measured) {
+  MODULES[module].hard_stop();
+  if (is_measured && amplitude_sum > 0.0f && period_sum > 0.0f) {
+    float amplitude = amplitude_sum / CYCLES;
+    float period = period_sum / CYCLES;
+    float ultimate_gain = 4.0f * RELAY_OUTPUT / ((float) M_PI * amplitude);
+    ultimate_gains[module] = ultimate_gain;
+    ultimate_periods[module] = period;
+
+    StoredGains gains;
+    gains.version = GAINS_VERSION;
+    gains.kp = KP_RATIO * ultimate_gain;
+    gains.ki = KI_RATIO * ultimate_gain / period;
+    gains.kd = KD_RATIO * ultimate_gain * period;
+    MODULES[module].set_gains(gains.kp, gains.ki, gains.kd);
+    if (HAL->storage) {
+      char key[8];
+      get_key(module, key);
+      HAL->storage->write(key, &gains, sizeof(gains));
+    }
+    tuned_modules++;
+  }
+  module++;
+  if (is_running()) start_module();
+}
+
+/**
+ * Get the storage key of a module's gains
+ * 
+ * @param module module index
+ * @param key    buffer of at least 5 characters for the key
+ */
+void Autotuner::get_key(int module, char* key) const {
+  key[0] = 'p';
+  key[1] = 'i';
+  key[2] = 'd';
+  key[3] = '0' + module;
+  key[4] = '\0';
+}
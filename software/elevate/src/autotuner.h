@@ -0,0 +1,80 @@
+/**
+ * @file autotuner.h
+ * 
+ * @brief header file for relay-feedback PID autotune
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#ifndef AUTOTUNER_H_
+#define AUTOTUNER_H_
+
+#include "elevate_module.h"
+#include "hal.h"
+#include <stdint.h>
+
+/**
+ * Struct for the gains of one module as kept in storage
+ * 
+ * version: layout version, records of another version are ignored
+ * kp:      proportional gain in output per unit of error
+ * ki:      integral gain in output per unit of error per s
+ * kd:      derivative gain in output s per unit of error
+ */
+struct StoredGains {
+  uint8_t version;
+  float kp;
+  float ki;
+  float kd;
+};
+
+class Autotuner {
+  public:
+    Autotuner(Hal* hal, ElevateModule* modules, int number_of_modules);
+    void load();
+    void start();
+    void stop();
+    bool update();
+    bool is_running() const;
+    int get_tuned_modules() const;
+    float get_ultimate_gain(int module) const;
+    float get_ultimate_period(int module) const;
+
+  private:
+    static uint8_t const GAINS_VERSION = 1;
+    static int const MAXIMUM_MODULES = 10;
+
+    static int const RELAY_OUTPUT;
+    static long const HYSTERESIS;
+    static long const LIFT;
+    static int const WARMUP_CYCLES;
+    static int const CYCLES;
+    static unsigned long const TIMEOUT_MS;
+    static unsigned long const PID_RATE_MS;
+    static float const KP_RATIO, KI_RATIO, KD_RATIO;
+
+    Hal* const HAL;
+    ElevateModule* const MODULES;
+    int const NUMBER_OF_MODULES;
+
+    int module;
+    int tuned_modules;
+    long setpoint;
+    bool is_relay_up;
+    unsigned long start_time;
+    unsigned long previous_relay_time;
+    unsigned long cycle_start_time;
+    int cycles;
+    long peak;
+    long trough;
+    float amplitude_sum;
+    float period_sum;
+    float ultimate_gains[MAXIMUM_MODULES];
+    float ultimate_periods[MAXIMUM_MODULES];
+
+    void start_module();
+    void finish_module(bool is_measured);
+    void get_key(int module, char* key) const;
+};
+
+#endif
@@ -8,24 +8,48 @@
  */
 #include "button_panel.h"
 #include "elevate_constants.h"
-#include "switch_utility.h"
-#include <Arduino.h>
+
+unsigned long const ButtonPanel::AUTOTUNE_CHORD_MS = AUTOTUNE_CHORD_MS_;
 
 /**
  * Button Panel constructor
  * 
+ * @param hal             hardware abstraction layer
  * @param up_switch_pin   up switch input pin
- * @param down_switch_pin down switch input pin
+ * @param down_switch_pin down switch input pin, in the GPIO bank of the up
+ *                        switch so both are read at once
  */
-ButtonPanel::ButtonPanel(uint8_t up_switch_pin, uint8_t down_switch_pin) :
-UP_SWITCH_PIN(up_switch_pin), DOWN_SWITCH_PIN(down_switch_pin) {}
+ButtonPanel::ButtonPanel(Hal* hal, uint8_t up_switch_pin, uint8_t down_switch_pin) :
+HAL(hal),
+UP_SWITCH_PIN(up_switch_pin),
+DOWN_SWITCH_PIN(down_switch_pin),
+switches(hal, USER_INPUT_DELAY_MS) {
+  switches.add_switch(UP_SWITCH_PIN);
+  switches.add_switch(DOWN_SWITCH_PIN);
+  were_both_pressed = false;
+  has_both_tapped = false;
+  both_press_time = 0;
+  both_release_time = 0;
+  is_chord_press = false;
+  is_chord_completed = false;
+  is_calibrate_held = false;
+  is_calibrate_hold_completed = false;
+}
 
 /**
  * Set up button panel
  */
-void ButtonPanel::setup() const {
-  pinMode(UP_SWITCH_PIN, INPUT);
-  pinMode(DOWN_SWITCH_PIN, INPUT);
+void ButtonPanel::setup() {
+  switches.setup();
+}
+
+/**
+ * Sample and debounce both switches and follow the gestures made with them,
+ * once per control step before any of them is read
+ */
+void ButtonPanel::update() {
+  switches.update();
+  update_gestures();
 }
 
 /**
@@ -34,16 +58,7 @@ void ButtonPanel::setup() const {
  * @return if up switch is pressed
  */
 bool ButtonPanel::up_switch_pressed() const {
-  static uint8_t switch_state = digitalRead(UP_SWITCH_PIN);
-  static uint8_t previous_state = digitalRead(UP_SWITCH_PIN);
-  static unsigned long previous_time = millis();
-  return switch_pressed(
-    UP_SWITCH_PIN,
-    USER_INPUT_DELAY_MS,
-    switch_state,
-    previous_state,
-    previous_time
-  );
+  return switches.is_pressed(UP_SWITCH_PIN);
 }
 
 /**
@@ -52,14 +67,126 @@ bool ButtonPanel::up_switch_pressed() const {
  * @return if down switch is pressed
  */
 bool ButtonPanel::down_switch_pressed() const {
-  static uint8_t switch_state = digitalRead(DOWN_SWITCH_PIN);
-  static uint8_t previous_state = digitalRead(DOWN_SWITCH_PIN);
-  static unsigned long previous_time = millis();
-  return switch_pressed(
-    DOWN_SWITCH_PIN,
-    USER_INPUT_DELAY_MS,
-    switch_state,
-    previous_state,
-    previous_time
-  );
+  return switches.is_pressed(DOWN_SWITCH_PIN);
+}
+
+/**
+ * Determine if up switch became pressed on the last update
+ * 
+ * @return if up switch was pressed
+ */
+bool ButtonPanel::up_switch_was_pressed() const {
+  return switches.was_pressed(UP_SWITCH_PIN);
+}
+
+/**
+ * Determine if down switch became pressed on the last update
+ * 
+ * @return if down switch was pressed
+ */
+bool ButtonPanel::down_switch_was_pressed() const {
+  return switches.was_pressed(DOWN_SWITCH_PIN);
+}
+
+/**
+ * Determine if up switch became released on the last update
+ * 
+ * @return if up switch was released
+ */
+bool ButtonPanel::up_switch_was_released() const {
+  return switches.was_released(UP_SWITCH_PIN);
+}
+
+/**
+ * Determine if down switch became released on the last update
+ * 
+ * @return if down switch was released
+ */
+bool ButtonPanel::down_switch_was_released() const {
+  return switches.was_released(DOWN_SWITCH_PIN);
+}
+
+/**
+ * Determine if either switch became pressed or released on the last update
+ * 
+ * @return if a switch changed
+ */
+bool ButtonPanel::has_changed() const {
+  return (switches.get_presses() | switches.get_releases()) != 0;
+}
+
+/**
+ * Determine if the autotune chord was completed on the last update: both
+ * switches tapped for less than AUTOTUNE_CHORD_MS, then pressed again within
+ * AUTOTUNE_CHORD_MS of the release
+ * 
+ * @return if the chord was completed
+ */
+bool ButtonPanel::autotune_chord_pressed() const {
+  return is_chord_completed;
+}
+
+/**
+ * Determine if both switches reached AUTOTUNE_CHORD_MS held on the last
+ * update, the press not being the end of a chord
+ * 
+ * @return if the calibrate hold was completed
+ */
+bool ButtonPanel::calibrate_hold_completed() const {
+  return is_calibrate_hold_completed;
+}
+
+/**
+ * Determine if both switches are held for calibration; until the hold is
+ * long enough the press may still turn out to be the start of a chord
+ * 
+ * @return if both switches have been held for AUTOTUNE_CHORD_MS
+ */
+bool ButtonPanel::calibrate_held() const {
+  return is_calibrate_held;
+}
+
+/**
+ * Read the raw switch pin levels, for input capture
+ * 
+ * @return up switch level in bit 0, down switch level in bit 1
+ */
+uint8_t ButtonPanel::read_levels() const {
+  return (uint8_t) (HAL->gpio->digital_read(UP_SWITCH_PIN) | (HAL->gpio->digital_read(DOWN_SWITCH_PIN) << 1));
+}
+
+/**
+ * Wake the next light sleep on a press of either switch
+ */
+void ButtonPanel::enable_wake() {
+  HAL->power->enable_pin_wake(UP_SWITCH_PIN, HAL_LOW);
+  HAL->power->enable_pin_wake(DOWN_SWITCH_PIN, HAL_LOW);
+}
+
+/**
+ * Tell a press of both switches held for calibration from a tap that may
+ * start the autotune chord, and find the press that completes the chord
+ */
+void ButtonPanel::update_gestures() {
+  bool are_both_pressed = up_switch_pressed() && down_switch_pressed();
+  unsigned long current_time = HAL->clock->millis();
+  is_chord_completed = false;
+  is_calibrate_hold_completed = false;
+  if (are_both_pressed && !were_both_pressed) {
+    is_chord_press = has_both_tapped && current_time - both_release_time <= AUTOTUNE_CHORD_MS;
+    is_chord_completed = is_chord_press;
+    has_both_tapped = false;
+    both_press_time = current_time;
+  } else if (are_both_pressed) {
+    if (!is_chord_press && !is_calibrate_held && current_time - both_press_time >= AUTOTUNE_CHORD_MS) {
+      is_calibrate_held = true;
+      is_calibrate_hold_completed = true;
+    }
+  } else if (were_both_pressed) {
+    has_both_tapped = !is_chord_press && !is_calibrate_held;
+    both_release_time = current_time;
+    is_chord_press = false;
+    is_calibrate_held = false;
+  }
+  were_both_pressed = are_both_pressed;
 }
@@ -9,18 +9,46 @@
 #ifndef BUTTON_PANEL_H_
 #define BUTTON_PANEL_H_
 
+#include "hal.h"
+#include "switch_debouncer.h"
 #include <stdint.h>
 
 class ButtonPanel {
   public:
-    ButtonPanel(uint8_t up_switch_pin, uint8_t down_switch_pin);
-    void setup() const;
+    ButtonPanel(Hal* hal, uint8_t up_switch_pin, uint8_t down_switch_pin);
+    void setup();
+    void update();
     bool up_switch_pressed() const;
     bool down_switch_pressed() const;
+    bool up_switch_was_pressed() const;
+    bool down_switch_was_pressed() const;
+    bool up_switch_was_released() const;
+    bool down_switch_was_released() const;
+    bool has_changed() const;
+    bool autotune_chord_pressed() const;
+    bool calibrate_hold_completed() const;
+    bool calibrate_held() const;
+    uint8_t read_levels() const;
+    void enable_wake();
 
   private:
+    static unsigned long const AUTOTUNE_CHORD_MS;
+
+    Hal* const HAL;
     uint8_t const UP_SWITCH_PIN;
     uint8_t const DOWN_SWITCH_PIN;
+
+    SwitchDebouncer switches;
+    bool were_both_pressed;
+    bool has_both_tapped;
+    unsigned long both_press_time;
+    unsigned long both_release_time;
+    bool is_chord_press;
+    bool is_chord_completed;
+    bool is_calibrate_held;
+    bool is_calibrate_hold_completed;
+
+    void update_gestures();
 };
 
 #endif
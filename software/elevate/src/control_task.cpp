@@ -0,0 +1,146 @@
+/**
+ * @file control_task.cpp
+ * 
+ * @brief fixed-rate elevate control task
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#include "control_task.h"
+#include "cycle_counter.h"
+
+/**
+ * Control Task constructor
+ * 
+ * @param hal       hardware abstraction layer
+ * @param system    system to control
+ * @param period_us control period in us
+ */
+template <typename T>
+ControlTask<T>::ControlTask(Hal* hal, T* system, unsigned long period_us) :
+HAL(hal),
+SYSTEM(system),
+PERIOD_US(period_us),
+execution_stats(cycle_counter_ticks_per_us()),
+jitter_stats(1) {
+  receiver = 0;
+  is_running = false;
+  has_previous_start = false;
+  previous_start_us = 0;
+  overruns = 0;
+}
+
+/**
+ * Start running the system at the control rate from the hal periodic timer,
+ * so the control period does not depend on what loop() does
+ * 
+ * @return if the task started
+ */
+template <typename T>
+bool ControlTask<T>::start() {
+  if (is_running) return true;
+  has_previous_start = false;
+  is_running = HAL->timer->start(PERIOD_US, tick, this);
+  return is_running;
+}
+
+/**
+ * Stop running the system
+ */
+template <typename T>
+void ControlTask<T>::stop() {
+  if (!is_running) return;
+  HAL->timer->stop();
+  is_running = false;
+}
+
+/**
+ * Set the minion receiver whose queued clock sync replies are sent after
+ * each control period, outside the timed section
+ * 
+ * @param receiver minion receiver, or null to send none
+ */
+template <typename T>
+void ControlTask<T>::set_receiver(MinionReceiver* receiver) {
+  this->receiver = receiver;
+}
+
+/**
+ * Get control period
+ * 
+ * @return control period in us
+ */
+template <typename T>
+unsigned long ControlTask<T>::get_period_us() const {
+  return PERIOD_US;
+}
+
+/**
+ * Get number of periods that started late by a full period or more
+ * 
+ * @return number of overruns
+ */
+template <typename T>
+unsigned long ControlTask<T>::get_overruns() const {
+  return overruns;
+}
+
+/**
+ * Get execution time statistics
+ * 
+ * @return execution time in cycle counter ticks
+ */
+template <typename T>
+LatencyStats const& ControlTask<T>::get_execution_stats() const {
+  return execution_stats;
+}
+
+/**
+ * Get start time jitter statistics
+ * 
+ * @return deviation of each period from nominal in us
+ */
+template <typename T>
+LatencyStats const& ControlTask<T>::get_jitter_stats() const {
+  return jitter_stats;
+}
+
+/**
+ * Timer callback
+ * 
+ * @param control_task control task to run
+ */
+template <typename T>
+void ControlTask<T>::tick(void* control_task) {
+  ((ControlTask<T>*) control_task)->run();
+}
+
+/**
+ * Run one control period, recording its execution time in cycle counter
+ * ticks and how far its start strayed from the nominal period in us
+ */
+template <typename T>
+void ControlTask<T>::run() {
+  unsigned long start_us = HAL->clock->micros();
+  if (has_previous_start) {
+    unsigned long period_us = start_us - previous_start_us;
+    unsigned long deviation_us = (period_us > PERIOD_US) ? period_us - PERIOD_US : PERIOD_US - period_us;
+    jitter_stats.record(deviation_us);
+    if (period_us >= 2 * PERIOD_US) overruns++;
+  }
+  has_previous_start = true;
+  previous_start_us = start_us;
+
+  uint32_t start = read_cycle_counter();
+  SYSTEM->update();
+  SYSTEM->control();
+  execution_stats.record(read_cycle_counter() - start);
+  if (receiver) receiver->send_sync_replies();
+}
+
+// The firmware is built for one board; host tools pick the module count at
+// run time and go through ElevateSystemBase
+template class ControlTask<ElevateSystem<NUMBER_OF_MODULES_> >;
+#ifndef ARDUINO
+template class ControlTask<ElevateSystemBase>;
+#endif
@@ -0,0 +1,52 @@
+/**
+ * @file control_task.h
+ * 
+ * @brief header file for fixed-rate elevate control task
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#ifndef CONTROL_TASK_H_
+#define CONTROL_TASK_H_
+
+#include "elevate_system.h"
+#include "hal.h"
+#include "latency_stats.h"
+#include "minion_receiver.h"
+
+/**
+ * Fixed-rate control task
+ * 
+ * @tparam T system type, the final ElevateSystem on the firmware so each
+ *           period calls it directly, or ElevateSystemBase on host tools
+ */
+template <typename T>
+class ControlTask {
+  public:
+    ControlTask(Hal* hal, T* system, unsigned long period_us);
+    bool start();
+    void stop();
+    void set_receiver(MinionReceiver* receiver);
+    unsigned long get_period_us() const;
+    unsigned long get_overruns() const;
+    LatencyStats const& get_execution_stats() const;
+    LatencyStats const& get_jitter_stats() const;
+
+  private:
+    Hal* const HAL;
+    T* const SYSTEM;
+    unsigned long const PERIOD_US;
+
+    MinionReceiver* receiver;
+    bool is_running;
+    bool has_previous_start;
+    unsigned long previous_start_us;
+    unsigned long overruns;
+    LatencyStats execution_stats;
+    LatencyStats jitter_stats;
+
+    static void tick(void* control_task);
+    void run();
+};
+
+#endif
@@ -0,0 +1,62 @@
+/**
+ * @file cycle_counter.h
+ * 
+ * @brief high resolution counter for timing code sections
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#ifndef CYCLE_COUNTER_H_
+#define CYCLE_COUNTER_H_
+
+#include <stdint.h>
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+
+/**
+ * Read the CPU cycle counter
+ * 
+ * @return counter ticks, wraps at 32 bits
+ */
+inline uint32_t read_cycle_counter() {
+  return ESP.getCycleCount();
+}
+
+/**
+ * Get the cycle counter rate
+ * 
+ * @return counter ticks per us
+ */
+inline uint32_t cycle_counter_ticks_per_us() {
+  return getCpuFrequencyMhz();
+}
+
+#else
+
+#include <time.h>
+
+/**
+ * Read the monotonic clock in ns, so one tick is one ns
+ * 
+ * @return counter ticks, wraps at 32 bits
+ */
+inline uint32_t read_cycle_counter() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint32_t) ((uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec);
+}
+
+/**
+ * Get the cycle counter rate
+ * 
+ * @return counter ticks per us
+ */
+inline uint32_t cycle_counter_ticks_per_us() {
+  return 1000;
+}
+
+#endif
+
+#endif
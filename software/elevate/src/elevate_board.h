@@ -0,0 +1,93 @@
+/**
+ * @file elevate_board.h
+ * 
+ * @brief compile-time description of the pins driving each module
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#ifndef ELEVATE_BOARD_H_
+#define ELEVATE_BOARD_H_
+
+#include <stdint.h>
+
+/**
+ * Struct for the pins driving one module
+ * 
+ * pwm_pin:       motor PWM pin
+ * pwm_channel:   PWM channel the pin is attached to
+ * direction_pin: motor direction pin
+ */
+struct ModulePins {
+  uint8_t pwm_pin;
+  uint8_t pwm_channel;
+  uint8_t direction_pin;
+};
+
+/**
+ * Struct for a master board
+ * 
+ * modules:         pins of each module
+ * up_switch_pin:   up button pin
+ * down_switch_pin: down button pin
+ */
+template <int NUMBER_OF_MODULES>
+struct ElevateBoard {
+  ModulePins modules[NUMBER_OF_MODULES];
+  uint8_t up_switch_pin;
+  uint8_t down_switch_pin;
+};
+
+/**
+ * Compile-time list of module indices, for expanding per-module
+ * initializers over a board
+ */
+template <int... INDICES>
+struct ModuleIndices {};
+
+template <int N, int... INDICES>
+struct MakeModuleIndices : MakeModuleIndices<N - 1, N - 1, INDICES...> {};
+
+template <int... INDICES>
+struct MakeModuleIndices<0, INDICES...> {
+  typedef ModuleIndices<INDICES...> Type;
+};
+
+template <int NUMBER_OF_MODULES, int... INDICES>
+constexpr ElevateBoard<NUMBER_OF_MODULES> make_board(
+    uint8_t const (&pwm_pins)[NUMBER_OF_MODULES],
+    uint8_t const (&direction_pins)[NUMBER_OF_MODULES],
+    uint8_t up_switch_pin,
+    uint8_t down_switch_pin,
+    ModuleIndices<INDICES...>) {
+  return {{{pwm_pins[INDICES], (uint8_t) INDICES, direction_pins[INDICES]}...}, up_switch_pin, down_switch_pin};
+}
+
+/**
+ * Build a board from its pin lists, module i on PWM channel i; the module
+ * count is the length of the lists, so adding a leg is only a matter of
+ * adding its pins
+ * 
+ * @param pwm_pins        motor PWM pin of each module
+ * @param direction_pins  motor direction pin of each module
+ * @param up_switch_pin   up button pin
+ * @param down_switch_pin down button pin
+ * 
+ * @return board
+ */
+template <int NUMBER_OF_MODULES>
+constexpr ElevateBoard<NUMBER_OF_MODULES> make_board(
+    uint8_t const (&pwm_pins)[NUMBER_OF_MODULES],
+    uint8_t const (&direction_pins)[NUMBER_OF_MODULES],
+    uint8_t up_switch_pin,
+    uint8_t down_switch_pin) {
+  return make_board(
+    pwm_pins,
+    direction_pins,
+    up_switch_pin,
+    down_switch_pin,
+    typename MakeModuleIndices<NUMBER_OF_MODULES>::Type()
+  );
+}
+
+#endif
@@ -9,45 +9,79 @@
 #ifndef ELEVATE_CONSTANTS_H_
 #define ELEVATE_CONSTANTS_H_
 
+#include "elevate_board.h"
+#include "hal.h"
 #include <stdint.h>
 
-// Pin constants
-#define PWM_PIN_0       15
-#define PWM_CHANNEL_0   0
-#define DIRECTION_PIN_0 13
-
-#define PWM_PIN_1       14
-#define PWM_CHANNEL_1   1
-#define DIRECTION_PIN_1 12
-
-#define PWM_PIN_2       39
-#define PWM_CHANNEL_2   2
-#define DIRECTION_PIN_2 41
-
-#define PWM_PIN_3       40
-#define PWM_CHANNEL_3   3
-#define DIRECTION_PIN_3 42
-
-#define UP_SWITCH_PIN_   36
-#define DOWN_SWITCH_PIN_ 37
+// Board constants, one entry per module; module i drives PWM channel i
+constexpr uint8_t PWM_PINS_[] = {15, 14, 39, 40};
+constexpr uint8_t DIRECTION_PINS_[] = {13, 12, 41, 42};
+constexpr uint8_t UP_SWITCH_PIN_ = 36;
+constexpr uint8_t DOWN_SWITCH_PIN_ = 37;
+static_assert(UP_SWITCH_PIN_ / HAL_PINS_PER_BANK == DOWN_SWITCH_PIN_ / HAL_PINS_PER_BANK, "button pins must share a GPIO bank");
+int const NUMBER_OF_MODULES_ = sizeof(PWM_PINS_);
+int const MAXIMUM_NUMBER_OF_MODULES_ = 8;
+constexpr ElevateBoard<NUMBER_OF_MODULES_> ELEVATE_BOARD_ = make_board(
+  PWM_PINS_,
+  DIRECTION_PINS_,
+  UP_SWITCH_PIN_,
+  DOWN_SWITCH_PIN_
+);
 
 // Switch constants
 unsigned long const USER_INPUT_DELAY_MS = 50;
+unsigned long const AUTOTUNE_CHORD_MS_ = 1000;
 
 // Elevate module constants
 uint32_t const MOTOR_FREQUENCY_ = 10000;
 uint8_t const MOTOR_RESOLUTION_BITS_ = 10;
 float const KP_ = 1.00;
 float const KI_ = 0.00;
-float const KD_ = 0.10;
+float const KD_ = 0.005;
+float const KT_ = 10.0;
+float const DERIVATIVE_FILTER_MS_ = 10.0;
+float const OUTPUT_RATE_ = 20000.0;
+float const KV_ = 0.10;
 unsigned long const PID_RATE_MS_ = 50;
 int const MINIMUM_OUTPUT_ = -(1 << MOTOR_RESOLUTION_BITS_) + 1;
 int const MAXIMUM_OUTPUT_ = (1 << MOTOR_RESOLUTION_BITS_) - 1;
 long const ERROR_THRESHOLD_ = 250;
 float const STOP_SETTLE_TIME = 2000;
+unsigned long const STALL_TIME_MS_ = 200;
+float const STALL_VELOCITY_ = 40.0;
+unsigned long const MAXIMUM_EXTRAPOLATION_US_ = 100000;
+
+// Cascaded control constants
+bool const CASCADED_CONTROL_ = false;
+float const KP_POSITION_ = 10.0;
+unsigned long const POSITION_RATE_MS_ = 10;
+int const MAXIMUM_VELOCITY_COMMAND_ = 8192;
+float const KP_VELOCITY_ = 0.10;
+float const KI_VELOCITY_ = 2.0;
+
+// Autotune constants
+int const AUTOTUNE_RELAY_OUTPUT_ = 800;
+long const AUTOTUNE_HYSTERESIS_ = 16;
+long const AUTOTUNE_LIFT_ = 2048;
+int const AUTOTUNE_WARMUP_CYCLES_ = 2;
+int const AUTOTUNE_CYCLES_ = 4;
+unsigned long const AUTOTUNE_TIMEOUT_MS_ = 10000;
+float const AUTOTUNE_KP_RATIO_ = 0.25;
+float const AUTOTUNE_KI_RATIO_ = 0.0;
+float const AUTOTUNE_KD_RATIO_ = 0.066;
 
 // Elevate system constants
 int const UNITS_PER_ROTATION = 1 << 12;
 float const ROTATIONS_PER_MS_ = 0.001;
+float const ROTATIONS_PER_S2_ = 4.0;
+float const ROTATIONS_PER_S3_ = 40.0;
+float const SYNC_GAIN_ = 2.0;
+long const SYNC_LAG_LIMIT_ = 1024;
+
+// Control task constants
+unsigned long const CONTROL_PERIOD_US_ = 2000;
+
+// Power constants
+unsigned long const IDLE_SLEEP_DELAY_MS_ = 10000;
 
 #endif
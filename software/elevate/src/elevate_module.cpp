@@ -8,36 +8,88 @@
  */
 #include "elevate_module.h"
 #include "elevate_constants.h"
-#include <Arduino.h>
+#include <math.h>
+#include <stdlib.h>
 
 uint32_t const ElevateModule::MOTOR_FREQUENCY = MOTOR_FREQUENCY_;
 uint8_t const ElevateModule::MOTOR_RESOLUTION_BITS = MOTOR_RESOLUTION_BITS_;
 
-float const ElevateModule::KP = KP_;
-float const ElevateModule::KI = KI_;
-float const ElevateModule::KD = KD_;
+PIDTuning const ElevateModule::PID_TUNING = {
+  KP_,
+  KI_,
+  KD_,
+  KT_,
+  DERIVATIVE_FILTER_MS_,
+  OUTPUT_RATE_,
+  MINIMUM_OUTPUT_,
+  MAXIMUM_OUTPUT_
+};
+PIDTuning const ElevateModule::POSITION_TUNING = {
+  KP_POSITION_,
+  0.0f,
+  0.0f,
+  0.0f,
+  0.0f,
+  0.0f,
+  -MAXIMUM_VELOCITY_COMMAND_,
+  MAXIMUM_VELOCITY_COMMAND_
+};
+PIDTuning const ElevateModule::VELOCITY_TUNING = {
+  KP_VELOCITY_,
+  KI_VELOCITY_,
+  0.0f,
+  KT_,
+  0.0f,
+  OUTPUT_RATE_,
+  MINIMUM_OUTPUT_,
+  MAXIMUM_OUTPUT_
+};
+float const ElevateModule::KV = KV_;
 unsigned long const ElevateModule::PID_RATE_MS = PID_RATE_MS_;
+unsigned long const ElevateModule::POSITION_RATE_MS = POSITION_RATE_MS_;
 int const ElevateModule::MINIMUM_OUTPUT = MINIMUM_OUTPUT_;
 int const ElevateModule::MAXIMUM_OUTPUT = MAXIMUM_OUTPUT_;
 long const ElevateModule::ERROR_THRESHOLD = ERROR_THRESHOLD_;
+unsigned long const ElevateModule::STALL_TIME_MS = STALL_TIME_MS_;
+float const ElevateModule::STALL_VELOCITY = STALL_VELOCITY_;
+unsigned long const ElevateModule::MAXIMUM_EXTRAPOLATION_US = MAXIMUM_EXTRAPOLATION_US_;
 
 /**
  * Elevate Module constructor
  * 
+ * @param hal                    hardware abstraction layer
  * @param pwm_pin                pwm pin
  * @param pwm_channel            pwm channel
  * @param direction_pin          direction pin
  */
-ElevateModule::ElevateModule(uint8_t pwm_pin, uint8_t pwm_channel, uint8_t direction_pin) :
+ElevateModule::ElevateModule(Hal* hal, uint8_t pwm_pin, uint8_t pwm_channel, uint8_t direction_pin) :
+HAL(hal),
 PWM_PIN(pwm_pin),
 PWM_CHANNEL(pwm_channel),
 DIRECTION_PIN(direction_pin),
-pid_controller(KP, KI, KD, PID_RATE_MS, MINIMUM_OUTPUT, MAXIMUM_OUTPUT) {
+pid_controller(hal->clock, PID_TUNING, PID_RATE_MS),
+position_controller(hal->clock, POSITION_TUNING, POSITION_RATE_MS),
+velocity_controller(hal->clock, VELOCITY_TUNING, POSITION_RATE_MS) {
+  is_cascaded = CASCADED_CONTROL_;
+  previous_velocity_control_us = 0;
+  timeline = {0, false, 0};
   is_setup = false;
   state = STOPPED;
   status = FINE;
   height = 0;
+  sample_receive_us = 0;
+  sample_timestamp_us = 0;
+  is_clock_synced = false;
+  maximum_extrapolation_us = MAXIMUM_EXTRAPOLATION_US;
+  error_threshold = ERROR_THRESHOLD;
+  control_height = 0;
+  velocity = 0.0f;
+  acceleration = 0.0f;
+  is_tracking = false;
+  tracked_velocity = 0.0f;
   height_offset = 0;
+  setpoint = 0;
+  output = 0;
   lower_limit_switch_pressed = false;
   upper_limit_switch_pressed = false;
 }
@@ -48,7 +100,8 @@ pid_controller(KP, KI, KD, PID_RATE_MS, MINIMUM_OUTPUT, MAXIMUM_OUTPUT) {
 void ElevateModule::setup() {
   if (!is_setup) {
     pwm_setup(PWM_CHANNEL, PWM_PIN);
-    pinMode(DIRECTION_PIN, OUTPUT);
+    HAL->gpio->pin_mode(DIRECTION_PIN, HAL_OUTPUT);
+    timeline.update_ms = HAL->clock->millis();
     is_setup = true;
   }
 }
@@ -91,34 +144,42 @@ void ElevateModule::update_status() {
  */
 void ElevateModule::hard_stop() {
   pid_controller.set_mode(OFF);
+  position_controller.set_mode(OFF);
+  velocity_controller.set_mode(OFF);
   set_speed(0);
   state = STOPPED;
+  timeline.is_stopping = false;
+  is_tracking = false;
 }
 
 /**
- * Command the module to smoothly stop
+ * Command the module to smoothly stop, once the system trajectory is at rest
+ * 
+ * The module is stopped when it is close enough, or when it has stalled short
+ * of the height and the controller cannot push it further. STOP_SETTLE_TIME
+ * only bounds how long a leg that keeps creeping is driven, timed from when
+ * this module started stopping.
  * 
  * @param height height to stop at
  */
 void ElevateModule::smooth_stop(long height) {
-  static bool first_call = true;
-  static unsigned long start_time = millis();
-  if (millis() - start_time > 1.05 * STOP_SETTLE_TIME) {
-    first_call = true;
-  }
-  if (first_call) {
-    first_call = false;
-    start_time = millis();
+  unsigned long current_time = HAL->clock->millis();
+  if (!timeline.is_stopping) {
+    timeline.is_stopping = true;
+    timeline.stop_start_ms = current_time;
   }
+  unsigned long stop_time = current_time - timeline.stop_start_ms;
 
   if (state == STOPPED) {
     hard_stop();
-  } else if (abs(height - (this->height - this->height_offset)) < ERROR_THRESHOLD) {
+  } else if (labs(height - get_height()) < error_threshold) {
+    hard_stop();
+  } else if (stop_time >= STALL_TIME_MS && fabsf(velocity) < STALL_VELOCITY) {
     hard_stop();
   } else {
-    if (millis() - start_time < STOP_SETTLE_TIME) {
+    if (stop_time < STOP_SETTLE_TIME) {
       state = STOPPING;
-      move(height);
+      track(height, 0.0f);
     } else {
       hard_stop();
     }
@@ -126,13 +187,85 @@ void ElevateModule::smooth_stop(long height) {
 }
 
 /**
- * Command the module to move
+ * Command the module to move, ending any smooth stop in progress
+ * 
+ * @param height   height to move to
+ * @param velocity trajectory velocity in units per s
+ */
+void ElevateModule::move(long height, float velocity) {
+  timeline.is_stopping = false;
+  track(height, velocity);
+}
+
+/**
+ * Drive the module toward a height, with the trajectory velocity fed forward
+ * so the PID only corrects what the motor model misses; the feedforward goes
+ * through the PID limits so anti-windup sees the output actually applied
  * 
- * @param height height to move to
+ * @param height   height to move to
+ * @param velocity trajectory velocity in units per s
  */
-void ElevateModule::move(long height) {
+void ElevateModule::track(long height, float velocity) {
+  is_tracking = true;
+  tracked_velocity = velocity;
+  if (is_cascaded) {
+    move_cascaded(height, velocity);
+    return;
+  }
+  setpoint = height;
   pid_controller.set_mode(ON);
-  set_speed(pid_controller.control(height, this->height - this->height_offset));
+  set_speed(pid_controller.control(height, get_height(), (int) lroundf(KV * velocity)));
+}
+
+/**
+ * Drive the module open loop, bypassing the PID
+ * 
+ * @param output signed output, clamped to the output limits
+ */
+void ElevateModule::drive(int output) {
+  pid_controller.set_mode(OFF);
+  position_controller.set_mode(OFF);
+  velocity_controller.set_mode(OFF);
+  if (output > MAXIMUM_OUTPUT) output = MAXIMUM_OUTPUT;
+  if (output < MINIMUM_OUTPUT) output = MINIMUM_OUTPUT;
+  set_speed(output);
+  timeline.is_stopping = false;
+  is_tracking = false;
+}
+
+/**
+ * Post a sample from the minion without blocking, safe to call from the
+ * radio callback while the control loop runs
+ * 
+ * @param sample new sample from encoder MCU
+ * 
+ * @return if no unread sample was overwritten; false if the control loop
+ *         fell behind
+ */
+bool ElevateModule::post_sample(ModuleSample const& sample) {
+  return mailbox.publish(sample);
+}
+
+/**
+ * Move every posted sample into the history, update module readings from
+ * the newest one, if there is one, and extrapolate the height to now
+ */
+void ElevateModule::take_sample() {
+  ModuleSample sample;
+  bool has_sample = false;
+  while (mailbox.consume(sample)) {
+    history.add(sample);
+    has_sample = true;
+  }
+  if (has_sample) {
+    sample_receive_us = sample.receive_us;
+    sample_timestamp_us = sample.timestamp_us;
+    is_clock_synced = sample.clock_synced;
+    velocity = sample.velocity;
+    acceleration = sample.acceleration;
+    update(sample.height, sample.lower_limit_switch_pressed, sample.upper_limit_switch_pressed);
+  }
+  control_height = extrapolate_height();
 }
 
 /**
@@ -146,19 +279,22 @@ void ElevateModule::update(
     long height,
     bool lower_limit_switch_pressed,
     bool upper_limit_switch_pressed) {
-  static unsigned long previous_time = millis();
-  unsigned long time_elapsed = millis() - previous_time;
+  unsigned long current_time = HAL->clock->millis();
+  unsigned long time_elapsed = current_time - timeline.update_ms;
   long height_difference = height - this->height;
 
   switch (state) {
     case STOPPED:
-      previous_time = millis();
+      timeline.update_ms = current_time;
       break;
     case STOPPING:
-      previous_time = millis();
+      timeline.update_ms = current_time;
       break;
     case CALIBRATE:
-      previous_time = millis();
+      timeline.update_ms = current_time;
+      break;
+    case AUTOTUNE:
+      timeline.update_ms = current_time;
       break;
     case MOVING_DOWN:
       if (time_elapsed > 1000) {
@@ -166,7 +302,7 @@ void ElevateModule::update(
           this->height_offset += (time_elapsed / 1000) * UNITS_PER_ROTATION;
         }
       }
-      previous_time = millis();
+      timeline.update_ms = current_time;
       break;
     case MOVING_UP:
       if (time_elapsed > 1000) {
@@ -174,15 +310,24 @@ void ElevateModule::update(
           this->height_offset -= (time_elapsed / 1000) * UNITS_PER_ROTATION;
         }
       }
-      previous_time = millis();
+      timeline.update_ms = current_time;
       break;
   }
 
   this->height = height;
+  this->control_height = height;
   this->lower_limit_switch_pressed = lower_limit_switch_pressed;
   this->upper_limit_switch_pressed = upper_limit_switch_pressed;
 }
 
+/**
+ * Restart update timing after the module went unsampled while idle, so the
+ * gap is not taken for rotations missed while moving
+ */
+void ElevateModule::resume() {
+  timeline.update_ms = HAL->clock->millis();
+}
+
 /**
  * Update the height offset
  */
@@ -190,6 +335,197 @@ void ElevateModule::update_offset() {
   height_offset = height;
 }
 
+/**
+ * Get time since the newest taken sample was measured, or since it arrived
+ * if the minion clock is not synced yet
+ * 
+ * @return sample age in us
+ */
+unsigned long ElevateModule::get_sample_age_us() const {
+  unsigned long now_us = HAL->clock->micros();
+  if (is_clock_synced) {
+    int32_t age_us = (int32_t) ((uint32_t) now_us - sample_timestamp_us);
+    return (age_us > 0) ? (unsigned long) age_us : 0;
+  }
+  return now_us - sample_receive_us;
+}
+
+/**
+ * Get module height extrapolated to the newest control instant
+ * 
+ * @return height in encoder units, before the height offset
+ */
+long ElevateModule::get_control_height() const {
+  return control_height;
+}
+
+/**
+ * Get module height the controller acts on, extrapolated to the newest
+ * control instant and relative to the calibrated offset
+ * 
+ * @return height in encoder units
+ */
+long ElevateModule::get_height() const {
+  return control_height - height_offset;
+}
+
+/**
+ * Get newest measured module height, before the offset and extrapolation
+ * 
+ * @return height in encoder units
+ */
+long ElevateModule::get_measured_height() const {
+  return height;
+}
+
+/**
+ * Get calibrated height offset
+ * 
+ * @return height offset in encoder units
+ */
+long ElevateModule::get_height_offset() const {
+  return height_offset;
+}
+
+/**
+ * Get height the module was last commanded to
+ * 
+ * @return setpoint in encoder units, relative to the offset
+ */
+long ElevateModule::get_setpoint() const {
+  return setpoint;
+}
+
+/**
+ * Get output applied to the motor
+ * 
+ * @return signed duty, positive up
+ */
+int ElevateModule::get_output() const {
+  return output;
+}
+
+/**
+ * Set how far ahead the height may be extrapolated from the newest sample
+ * 
+ * @param maximum_extrapolation_us extrapolation limit in us, 0 to control on
+ *                                 the newest sample as is
+ */
+void ElevateModule::set_maximum_extrapolation_us(unsigned long maximum_extrapolation_us) {
+  this->maximum_extrapolation_us = maximum_extrapolation_us;
+}
+
+/**
+ * Choose between one PID from position error to output and the cascade of
+ * a position loop commanding a velocity loop
+ * 
+ * @param is_cascaded if move() runs the cascade
+ */
+void ElevateModule::set_cascaded_control(bool is_cascaded) {
+  if (is_cascaded != this->is_cascaded) hard_stop();
+  this->is_cascaded = is_cascaded;
+}
+
+/**
+ * Give the position PID of this module its own gains
+ * 
+ * @param kp proportional gain in output per unit of error
+ * @param ki integral gain in output per unit of error per s
+ * @param kd derivative gain in output s per unit of error
+ */
+void ElevateModule::set_gains(float kp, float ki, float kd) {
+  PIDTuning tuning = pid_controller.get_tuning();
+  tuning.kp = kp;
+  tuning.ki = ki;
+  tuning.kd = kd;
+  pid_controller.set_tuning(tuning);
+}
+
+/**
+ * Change the sample time of the position PID
+ * 
+ * @param pid_rate_ms sample time in ms
+ */
+void ElevateModule::set_pid_rate(unsigned long pid_rate_ms) {
+  pid_controller.set_rate(pid_rate_ms);
+}
+
+/**
+ * Change how close to its stopping height a module has to be to stop
+ * 
+ * @param error_threshold largest error a module stops at in units
+ */
+void ElevateModule::set_error_threshold(long error_threshold) {
+  this->error_threshold = error_threshold;
+}
+
+/**
+ * Get the gains and limits of the position PID
+ * 
+ * @return position PID tuning
+ */
+PIDTuning const& ElevateModule::get_pid_tuning() const {
+  return pid_controller.get_tuning();
+}
+
+/**
+ * Get module velocity estimated by the minion as of the newest sample
+ * 
+ * @return velocity in encoder units per second
+ */
+float ElevateModule::get_velocity() const {
+  return velocity;
+}
+
+/**
+ * Get module acceleration estimated by the minion as of the newest sample
+ * 
+ * @return acceleration in encoder units per second squared
+ */
+float ElevateModule::get_acceleration() const {
+  return acceleration;
+}
+
+/**
+ * Get the recent samples of the module
+ * 
+ * @return sample history, newest first through get()
+ */
+SampleHistory const& ElevateModule::get_history() const {
+  return history;
+}
+
+/**
+ * Command the module to move through the cascade
+ * 
+ * The outer loop runs every POSITION_RATE_MS and turns position error into a
+ * velocity command on top of the trajectory velocity. The inner loop runs on
+ * every call against the minion velocity estimate, so a load change is
+ * caught as a velocity error within a sample instead of waiting for it to
+ * build up as position error. The first call after a pause counts as one
+ * outer period.
+ * 
+ * @param height              height to move to
+ * @param trajectory_velocity trajectory velocity in units per s
+ */
+void ElevateModule::move_cascaded(long height, float trajectory_velocity) {
+  unsigned long now_us = HAL->clock->micros();
+  float dt = (now_us - previous_velocity_control_us) / 1000000.0f;
+  if (dt > POSITION_RATE_MS / 1000.0f) dt = POSITION_RATE_MS / 1000.0f;
+  previous_velocity_control_us = now_us;
+
+  setpoint = height;
+  position_controller.set_mode(ON);
+  velocity_controller.set_mode(ON);
+  long velocity_command = position_controller.control(height, get_height(), (int) lroundf(trajectory_velocity));
+  set_speed(velocity_controller.control(
+    velocity_command,
+    lroundf(velocity),
+    (int) lroundf(KV * velocity_command),
+    dt
+  ));
+}
+
 /**
  * Set up the pwm pin of the module
  * 
@@ -197,9 +533,9 @@ void ElevateModule::update_offset() {
  * @param pin     pwm pin
  */
 void ElevateModule::pwm_setup(uint8_t channel, uint8_t pin) const {
-  ledcSetup(channel, MOTOR_FREQUENCY, MOTOR_RESOLUTION_BITS);
-  ledcAttachPin(pin, channel);
-  ledcWrite(channel, 0);
+  HAL->pwm->setup(channel, MOTOR_FREQUENCY, MOTOR_RESOLUTION_BITS);
+  HAL->pwm->attach_pin(pin, channel);
+  HAL->pwm->write(channel, 0);
 }
 
 /**
@@ -208,26 +544,51 @@ void ElevateModule::pwm_setup(uint8_t channel, uint8_t pin) const {
  * @param speed speed to set the module at
  */
 void ElevateModule::set_speed(int speed) {
+  output = speed;
   if (speed == 0) {
-    ledcWrite(PWM_CHANNEL, 0);
+    HAL->pwm->write(PWM_CHANNEL, 0);
     state = STOPPED;
   } else if (speed > 0) {
     if (status == UPPER_LIMITED) {
-      ledcWrite(PWM_CHANNEL, 0);
+      HAL->pwm->write(PWM_CHANNEL, 0);
+      output = 0;
       state = STOPPED;
     } else {
-      digitalWrite(DIRECTION_PIN, HIGH);
-      ledcWrite(PWM_CHANNEL, speed);
+      HAL->gpio->digital_write(DIRECTION_PIN, HAL_HIGH);
+      HAL->pwm->write(PWM_CHANNEL, speed);
       state = MOVING_UP;
     }
   } else {
     if (status == LOWER_LIMITED) {
-      ledcWrite(PWM_CHANNEL, 0);
+      HAL->pwm->write(PWM_CHANNEL, 0);
+      output = 0;
       state = STOPPED;
     } else {
-      digitalWrite(DIRECTION_PIN, LOW);
-      ledcWrite(PWM_CHANNEL, -speed);
+      HAL->gpio->digital_write(DIRECTION_PIN, HAL_LOW);
+      HAL->pwm->write(PWM_CHANNEL, -speed);
       state = MOVING_DOWN;
     }
   }
 }
+
+/**
+ * Extrapolate the newest sample to now
+ * 
+ * Legs whose samples arrive late or at different phases are compared at the
+ * same instant; the age is capped so a silent minion is not run away with.
+ * While tracking, the leg is taken to move at the mean of the minion
+ * velocity estimate, as old as the sample, and the trajectory velocity it is
+ * driven at now. Extrapolating a few tens of ms on the estimate alone feeds
+ * its noise back into the loop and skewed the legs more than the latency
+ * it corrected. The acceleration estimate is left out for the same reason.
+ * 
+ * @return extrapolated height in encoder units
+ */
+long ElevateModule::extrapolate_height() const {
+  if (history.get_count() == 0) return height;
+  unsigned long age_us = get_sample_age_us();
+  if (age_us > maximum_extrapolation_us) age_us = maximum_extrapolation_us;
+  float age_s = age_us * 1e-6f;
+  float mean_velocity = is_tracking ? 0.5f * (velocity + tracked_velocity) : velocity;
+  return height + lroundf(mean_velocity * age_s);
+}
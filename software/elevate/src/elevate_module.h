@@ -10,31 +10,86 @@
 #define ELEVATE_MODULE_H_
 
 #include "elevate_types.h"
+#include "hal.h"
 #include "pid_controller.h"
+#include "sample_history.h"
+#include "sample_mailbox.h"
 #include <stdint.h>
 
+// Set to 1 to run the module PID in Q15.16 fixed point instead of float
+#define FIXED_POINT_PID 0
+
+#if FIXED_POINT_PID
+typedef PIDController<Q16> ModulePIDController;
+#else
+typedef PIDController<float> ModulePIDController;
+#endif
+
+/**
+ * Struct for the times one module keeps on its own timeline
+ * 
+ * update_ms:     when readings were last updated in ms, for drift
+ *                compensation
+ * is_stopping:   if a smooth stop is in progress
+ * stop_start_ms: when the smooth stop in progress started in ms, for stop
+ *                settling
+ */
+struct ModuleTimeline {
+  unsigned long update_ms;
+  bool is_stopping;
+  unsigned long stop_start_ms;
+};
+
 class ElevateModule {
   public:
-    ElevateModule(uint8_t pwm_pin, uint8_t pwm_channel, uint8_t direction_pin);
+    ElevateModule(Hal* hal, uint8_t pwm_pin, uint8_t pwm_channel, uint8_t direction_pin);
     void setup();
     ElevateState get_state() const;
     ElevateStatus get_status() const;
     void update_status();
     void hard_stop();
     void smooth_stop(long height);
-    void move(long height);
+    void move(long height, float velocity);
+    void drive(int output);
+    bool post_sample(ModuleSample const& sample);
+    void take_sample();
     void update(long height, bool lower_limit_switch_pressed, bool upper_limit_switch_pressed);
     void update_offset();
+    void resume();
+    unsigned long get_sample_age_us() const;
+    long get_control_height() const;
+    long get_height() const;
+    long get_measured_height() const;
+    long get_height_offset() const;
+    long get_setpoint() const;
+    int get_output() const;
+    void set_maximum_extrapolation_us(unsigned long maximum_extrapolation_us);
+    void set_cascaded_control(bool is_cascaded);
+    void set_gains(float kp, float ki, float kd);
+    void set_pid_rate(unsigned long pid_rate_ms);
+    void set_error_threshold(long error_threshold);
+    PIDTuning const& get_pid_tuning() const;
+    float get_velocity() const;
+    float get_acceleration() const;
+    SampleHistory const& get_history() const;
 
   private:
     static uint32_t const MOTOR_FREQUENCY;
     static uint8_t const MOTOR_RESOLUTION_BITS;
 
-    static float const KP, KI, KD;
+    static PIDTuning const PID_TUNING;
+    static PIDTuning const POSITION_TUNING;
+    static PIDTuning const VELOCITY_TUNING;
+    static float const KV;
     static unsigned long const PID_RATE_MS;
+    static unsigned long const POSITION_RATE_MS;
     static int const MINIMUM_OUTPUT, MAXIMUM_OUTPUT;
     static long const ERROR_THRESHOLD;
+    static unsigned long const STALL_TIME_MS;
+    static float const STALL_VELOCITY;
+    static unsigned long const MAXIMUM_EXTRAPOLATION_US;
 
+    Hal* const HAL;
     uint8_t const PWM_PIN;
     uint8_t const PWM_CHANNEL;
     uint8_t const DIRECTION_PIN;
@@ -42,14 +97,36 @@ class ElevateModule {
     bool is_setup;
     ElevateState state;
     ElevateStatus status;
-    PIDController pid_controller;
-    volatile long height;
+    ModulePIDController pid_controller;
+    ModulePIDController position_controller;
+    ModulePIDController velocity_controller;
+    bool is_cascaded;
+    unsigned long previous_velocity_control_us;
+    ModuleTimeline timeline;
+    SampleMailbox mailbox;
+    SampleHistory history;
+    float velocity;
+    float acceleration;
+    bool is_tracking;
+    float tracked_velocity;
+    unsigned long sample_receive_us;
+    uint32_t sample_timestamp_us;
+    bool is_clock_synced;
+    unsigned long maximum_extrapolation_us;
+    long error_threshold;
+    long control_height;
+    long height;
     long height_offset;
-    volatile bool lower_limit_switch_pressed;
-    volatile bool upper_limit_switch_pressed;
+    long setpoint;
+    int output;
+    bool lower_limit_switch_pressed;
+    bool upper_limit_switch_pressed;
 
     void pwm_setup(uint8_t channel, uint8_t pin) const;
     void set_speed(int speed);
+    void track(long height, float velocity);
+    void move_cascaded(long height, float trajectory_velocity);
+    long extrapolate_height() const;
 };
 
 #endif
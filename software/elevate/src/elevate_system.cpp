@@ -8,72 +8,253 @@
  */
 #include "elevate_system.h"
 #include "elevate_constants.h"
-#include <Arduino.h>
+#include <math.h>
 
-float const ElevateSystem::ROTATIONS_PER_MS = ROTATIONS_PER_MS_;
+template <int NUMBER_OF_MODULES>
+float const ElevateSystem<NUMBER_OF_MODULES>::MAXIMUM_VELOCITY = UNITS_PER_ROTATION * ROTATIONS_PER_MS_ * 1e3;
+template <int NUMBER_OF_MODULES>
+float const ElevateSystem<NUMBER_OF_MODULES>::MAXIMUM_ACCELERATION = UNITS_PER_ROTATION * ROTATIONS_PER_S2_;
+template <int NUMBER_OF_MODULES>
+float const ElevateSystem<NUMBER_OF_MODULES>::MAXIMUM_JERK = UNITS_PER_ROTATION * ROTATIONS_PER_S3_;
+template <int NUMBER_OF_MODULES>
+float const ElevateSystem<NUMBER_OF_MODULES>::SYNC_GAIN = SYNC_GAIN_;
+template <int NUMBER_OF_MODULES>
+long const ElevateSystem<NUMBER_OF_MODULES>::SYNC_LAG_LIMIT = SYNC_LAG_LIMIT_;
 
 /**
  * Elevate System constructor
  * 
- * @param modules           pointer to array of modules
- * @param number_of_modules number of modules in system
- * @param button_panel      pointer to button panel
+ * @param hal          hardware abstraction layer
+ * @param board        pins of each module
+ * @param button_panel pointer to button panel
  */
-ElevateSystem::ElevateSystem(
-    ElevateModule* modules,
-    int number_of_modules,
+template <int NUMBER_OF_MODULES>
+ElevateSystem<NUMBER_OF_MODULES>::ElevateSystem(
+    Hal* hal,
+    ElevateBoard<NUMBER_OF_MODULES> const& board,
     ButtonPanel* button_panel) :
-    MODULES(modules),
-    NUMBER_OF_MODULES(number_of_modules),
-    BUTTON_PANEL(button_panel) {
+    ElevateSystem(hal, board, button_panel, typename MakeModuleIndices<NUMBER_OF_MODULES>::Type()) {}
+
+/**
+ * Elevate System constructor, builds one module per board entry in place,
+ * so the modules sit in one fixed array and every per-module loop has a
+ * compile-time trip count
+ * 
+ * @param hal          hardware abstraction layer
+ * @param board        pins of each module
+ * @param button_panel pointer to button panel
+ */
+template <int NUMBER_OF_MODULES>
+template <int... INDICES>
+ElevateSystem<NUMBER_OF_MODULES>::ElevateSystem(
+    Hal* hal,
+    ElevateBoard<NUMBER_OF_MODULES> const& board,
+    ButtonPanel* button_panel,
+    ModuleIndices<INDICES...>) :
+    HAL(hal),
+    BUTTON_PANEL(button_panel),
+    modules{ElevateModule(
+      hal,
+      board.modules[INDICES].pwm_pin,
+      board.modules[INDICES].pwm_channel,
+      board.modules[INDICES].direction_pin
+    )...},
+    trajectory(MAXIMUM_VELOCITY, MAXIMUM_ACCELERATION, MAXIMUM_JERK),
+    autotuner(hal, modules, NUMBER_OF_MODULES) {
   is_setup = false;
+  is_autotune_chord_held = false;
   state = STOPPED;
-  height = 0.0;
-  previous_move_time = micros();
+  status = FINE;
+  maximum_velocity = MAXIMUM_VELOCITY;
+  is_synchronized = true;
+  is_going_to_height = false;
+  target_height = 0;
+  previous_control_time = HAL->clock->micros();
+  telemetry = 0;
+  input_recorder = 0;
 }
 
 /**
  * Set up system
  */
-void ElevateSystem::setup() {
+template <int NUMBER_OF_MODULES>
+void ElevateSystem<NUMBER_OF_MODULES>::setup() {
   if (!is_setup) {
     BUTTON_PANEL->setup();
     for (int i = 0; i < NUMBER_OF_MODULES; i++) {
-      MODULES[i].setup();
+      modules[i].setup();
     }
+    autotuner.load();
+    enter_state();
+    events.post(STARTED);
+    previous_control_time = HAL->clock->micros();
+    if (input_recorder) input_recorder->record_setup(previous_control_time, BUTTON_PANEL->read_levels());
     is_setup = true;
   }
 }
 
 /**
- * Update the state and status of the system
+ * Update the status of the system and handle any input that changed
  */
-void ElevateSystem::update() {
+template <int NUMBER_OF_MODULES>
+void ElevateSystem<NUMBER_OF_MODULES>::update() {
+  if (input_recorder) input_recorder->record_control_step(HAL->clock->micros(), BUTTON_PANEL->read_levels());
+  BUTTON_PANEL->update();
+  take_module_samples();
   update_module_status();
-  update_system_state();
+  post_input_events();
+  dispatch_events();
 }
 
 /**
- * Control the system based on its state
+ * Control the system based on its state, then handle a finished motion
  */
-void ElevateSystem::control() {
+template <int NUMBER_OF_MODULES>
+void ElevateSystem<NUMBER_OF_MODULES>::control() {
+  unsigned long current_time = HAL->clock->micros();
+  float dt = (current_time - previous_control_time) * 1e-6f;
+  previous_control_time = current_time;
+
   switch (state) {
     case CALIBRATE:
-      calibrate();
+      calibrate(dt);
       break;
     case STOPPED:
-      hard_stop();
       break;
     case STOPPING:
-      smooth_stop();
+      smooth_stop(dt);
       break;
     case MOVING_UP:
-      move_up();
+      move_up(dt);
       break;
     case MOVING_DOWN:
-      move_down();
+      move_down(dt);
+      break;
+    case AUTOTUNE:
+      autotune();
       break;
   }
+  record_telemetry(current_time);
+  dispatch_events();
+}
+
+/**
+ * Determine if the system is stopped with no event left to handle, so only
+ * new input can move it
+ * 
+ * @return if the system is idle
+ */
+template <int NUMBER_OF_MODULES>
+bool ElevateSystem<NUMBER_OF_MODULES>::is_idle() const {
+  return state == STOPPED && events.is_empty();
+}
+
+/**
+ * Restart control timing after control was paused while idle, so the first
+ * control step does not integrate the pause
+ */
+template <int NUMBER_OF_MODULES>
+void ElevateSystem<NUMBER_OF_MODULES>::resume() {
+  for (int i = 0; i < NUMBER_OF_MODULES; i++) {
+    modules[i].resume();
+  }
+  previous_control_time = HAL->clock->micros();
+}
+
+/**
+ * Travel to a height and stop there, unless a button is pressed first; call
+ * from the context that runs update()
+ * 
+ * @param height height to travel to
+ */
+template <int NUMBER_OF_MODULES>
+void ElevateSystem<NUMBER_OF_MODULES>::go_to_height(long height) {
+  is_going_to_height = true;
+  target_height = height;
+  events.post(HEIGHT_REQUESTED);
+}
+
+/**
+ * Turn leg synchronization on or off, on by default
+ * 
+ * @param is_enabled whether legs are corrected against each other
+ */
+template <int NUMBER_OF_MODULES>
+void ElevateSystem<NUMBER_OF_MODULES>::set_synchronization(bool is_enabled) {
+  is_synchronized = is_enabled;
+  if (!is_enabled) trajectory.set_velocity_limit(maximum_velocity);
+}
+
+/**
+ * Change the travel speed
+ * 
+ * @param maximum_velocity largest trajectory velocity in units per s
+ */
+template <int NUMBER_OF_MODULES>
+void ElevateSystem<NUMBER_OF_MODULES>::set_maximum_velocity(float maximum_velocity) {
+  this->maximum_velocity = maximum_velocity;
+  trajectory.set_velocity_limit(maximum_velocity);
+}
+
+/**
+ * Record every module into a telemetry buffer after each control step
+ * 
+ * @param telemetry buffer to record into, or null to stop recording
+ */
+template <int NUMBER_OF_MODULES>
+void ElevateSystem<NUMBER_OF_MODULES>::set_telemetry(TelemetryBuffer* telemetry) {
+  this->telemetry = telemetry;
+}
+
+/**
+ * Record setup, every control step and the button levels it reads, for
+ * replay; radio frames are recorded by whoever hands them to the receiver
+ * 
+ * @param input_recorder recorder to record into, or null to stop recording
+ */
+template <int NUMBER_OF_MODULES>
+void ElevateSystem<NUMBER_OF_MODULES>::set_input_recorder(InputRecorder* input_recorder) {
+  this->input_recorder = input_recorder;
+}
+
+/**
+ * Get the trajectory the legs follow
+ * 
+ * @return trajectory generator
+ */
+template <int NUMBER_OF_MODULES>
+TrajectoryGenerator const& ElevateSystem<NUMBER_OF_MODULES>::get_trajectory() const {
+  return trajectory;
+}
+
+/**
+ * Get the per-leg autotune
+ * 
+ * @return autotuner
+ */
+template <int NUMBER_OF_MODULES>
+Autotuner const& ElevateSystem<NUMBER_OF_MODULES>::get_autotuner() const {
+  return autotuner;
+}
+
+/**
+ * Get the number of modules
+ * 
+ * @return number of modules
+ */
+template <int NUMBER_OF_MODULES>
+int ElevateSystem<NUMBER_OF_MODULES>::get_number_of_modules() const {
+  return NUMBER_OF_MODULES;
+}
+
+/**
+ * Get the modules, in board order, to hand to the minion receiver
+ * 
+ * @return pointer to array of modules
+ */
+template <int NUMBER_OF_MODULES>
+ElevateModule* ElevateSystem<NUMBER_OF_MODULES>::get_modules() {
+  return modules;
 }
 
 /**
@@ -81,7 +262,8 @@ void ElevateSystem::control() {
  * 
  * @return system status
  */
-ElevateStatus ElevateSystem::get_status() const {
+template <int NUMBER_OF_MODULES>
+ElevateStatus ElevateSystem<NUMBER_OF_MODULES>::get_status() const {
   if (is_module_status(MALFUNCTION)) {
     return MALFUNCTION;
   }
@@ -101,70 +283,190 @@ ElevateStatus ElevateSystem::get_status() const {
  * 
  * @return if the system modules have a given status
  */
-bool ElevateSystem::is_module_status(ElevateStatus status) const {
+template <int NUMBER_OF_MODULES>
+bool ElevateSystem<NUMBER_OF_MODULES>::is_module_status(ElevateStatus status) const {
   for (int i = 0; i < NUMBER_OF_MODULES; i++) {
-    if (MODULES[i].get_status() == status) return true;
+    if (modules[i].get_status() == status) return true;
   }
   return false;
 }
 
 /**
- * Set the state of the system
+ * Set the state of the system, running the transition actions if it changes.
+ * Leaving and entering a state run its actions once, so a stopped system
+ * stops its motors on entry and then does no control work until the next
+ * event
  * 
  * @param state given state
  */
-void ElevateSystem::set_state(ElevateState state) {
+template <int NUMBER_OF_MODULES>
+void ElevateSystem<NUMBER_OF_MODULES>::set_state(ElevateState state) {
   ElevateState current_state = this->state;
-  ElevateStatus current_status = get_status();
+  ElevateState next_state = state;
   switch (state) {
     case CALIBRATE:
-      this->state = state;
-      if (current_state != CALIBRATE) previous_move_time = micros();
       break;
     case STOPPED:
-      this->state = state;
       break;
     case STOPPING:
-      this->state = (current_state == STOPPED) ? STOPPED : STOPPING;
+      if (current_state == STOPPED) next_state = STOPPED;
       break;
     case MOVING_UP:
-      if (current_status == MALFUNCTION || current_status == UPPER_LIMITED) {
-        this->state = STOPPED;
-      } else {
-        this->state = MOVING_UP;
-      }
-      if (current_state != MOVING_UP) previous_move_time = micros();
+      if (status == MALFUNCTION || status == UPPER_LIMITED) next_state = STOPPED;
       break;
     case MOVING_DOWN:
-      if (current_status == MALFUNCTION || current_status == LOWER_LIMITED) {
-        this->state = STOPPED;
-      } else {
-        this->state = MOVING_DOWN;
-      }
-      if (current_state != MOVING_DOWN) previous_move_time = micros();
+      if (status == MALFUNCTION || status == LOWER_LIMITED) next_state = STOPPED;
       break;
+    case AUTOTUNE:
+      if (status == MALFUNCTION) next_state = STOPPED;
+      break;
+  }
+  if (next_state == current_state) return;
+  exit_state();
+  this->state = next_state;
+  enter_state();
+}
+
+/**
+ * Run the actions for leaving the current state
+ */
+template <int NUMBER_OF_MODULES>
+void ElevateSystem<NUMBER_OF_MODULES>::exit_state() {
+  if (state == AUTOTUNE) {
+    autotuner.stop();
+    finish_autotune();
+  }
+}
+
+/**
+ * Run the actions for entering the current state
+ */
+template <int NUMBER_OF_MODULES>
+void ElevateSystem<NUMBER_OF_MODULES>::enter_state() {
+  if (state == STOPPED) {
+    hard_stop();
+  } else if (state == AUTOTUNE) {
+    autotuner.start();
+  }
+}
+
+/**
+ * Take the newest minion sample of all modules in the system
+ */
+template <int NUMBER_OF_MODULES>
+void ElevateSystem<NUMBER_OF_MODULES>::take_module_samples() {
+  for (int i = 0; i < NUMBER_OF_MODULES; i++) {
+    modules[i].take_sample();
   }
 }
 
 /**
  * Update the status of all modules in the system
  */
-void ElevateSystem::update_module_status() {
+template <int NUMBER_OF_MODULES>
+void ElevateSystem<NUMBER_OF_MODULES>::update_module_status() {
   for (int i = 0; i < NUMBER_OF_MODULES; i++) {
-    MODULES[i].update_status();
+    modules[i].update_status();
+  }
+}
+
+/**
+ * Post an event for every button edge, the autotune chord taking the place
+ * of the edges that completed it, for both buttons held long enough to
+ * calibrate and for a change of system status
+ */
+template <int NUMBER_OF_MODULES>
+void ElevateSystem<NUMBER_OF_MODULES>::post_input_events() {
+  if (BUTTON_PANEL->has_changed()) {
+    if (BUTTON_PANEL->autotune_chord_pressed()) {
+      events.post(AUTOTUNE_CHORD);
+    } else {
+      if (BUTTON_PANEL->up_switch_was_pressed()) events.post(UP_PRESSED);
+      if (BUTTON_PANEL->up_switch_was_released()) events.post(UP_RELEASED);
+      if (BUTTON_PANEL->down_switch_was_pressed()) events.post(DOWN_PRESSED);
+      if (BUTTON_PANEL->down_switch_was_released()) events.post(DOWN_RELEASED);
+    }
+  }
+  if (BUTTON_PANEL->calibrate_hold_completed()) events.post(CALIBRATE_HELD);
+
+  ElevateStatus current_status = get_status();
+  if (current_status != status) {
+    status = current_status;
+    events.post(STATUS_CHANGED);
   }
 }
 
 /**
- * Update the state of the system based on button panel input
+ * Handle every pending event in the order it was posted
+ * 
+ * The system state only changes on events. update() turns debounced button
+ * edges and limit switch readings that change the system status into
+ * events, control() posts one when a motion finishes, and both call this
+ * before they return.
  */
-void ElevateSystem::update_system_state() {
-  if (BUTTON_PANEL->up_switch_pressed() && BUTTON_PANEL->down_switch_pressed()) {
+template <int NUMBER_OF_MODULES>
+void ElevateSystem<NUMBER_OF_MODULES>::dispatch_events() {
+  ElevateEvent event;
+  while (events.take(event)) {
+    handle_event(event);
+  }
+}
+
+/**
+ * Move the state machine on an event
+ * 
+ * The autotune chord starts tuning, or starts it over. Tuning carries on
+ * while the chord is still held and is aborted by any later press. A
+ * finished calibration or smooth stop stops; anything else settles on the
+ * state the current input asks for.
+ * 
+ * @param event event to handle
+ */
+template <int NUMBER_OF_MODULES>
+void ElevateSystem<NUMBER_OF_MODULES>::handle_event(ElevateEvent event) {
+  if (event == AUTOTUNE_CHORD) {
+    is_going_to_height = false;
+    is_autotune_chord_held = true;
+    if (state == AUTOTUNE) set_state(STOPPED);
+    set_state(AUTOTUNE);
+    return;
+  }
+  if (state == AUTOTUNE) {
+    if (event != AUTOTUNE_DONE) {
+      bool is_pressed = BUTTON_PANEL->up_switch_pressed() || BUTTON_PANEL->down_switch_pressed();
+      if (is_autotune_chord_held) is_autotune_chord_held = is_pressed;
+      if (is_autotune_chord_held || !is_pressed) return;
+    }
+    set_state(STOPPED);
+  }
+  if (event == CALIBRATED || (event == SETTLED && state == STOPPING)) {
+    set_state(STOPPED);
+    return;
+  }
+  update_system_state();
+}
+
+/**
+ * Set the state of the system the button panel and travel request ask for;
+ * both buttons stop the desk until they have been held long enough to
+ * calibrate, so a tap starting the autotune chord never drives it down
+ */
+template <int NUMBER_OF_MODULES>
+void ElevateSystem<NUMBER_OF_MODULES>::update_system_state() {
+  if (BUTTON_PANEL->up_switch_pressed() || BUTTON_PANEL->down_switch_pressed()) {
+    is_going_to_height = false;
+  }
+
+  if (BUTTON_PANEL->calibrate_held()) {
     set_state(CALIBRATE);
+  } else if (BUTTON_PANEL->up_switch_pressed() && BUTTON_PANEL->down_switch_pressed()) {
+    set_state(STOPPING);
   } else if (BUTTON_PANEL->up_switch_pressed()) {
     set_state(MOVING_UP);
   } else if (BUTTON_PANEL->down_switch_pressed()) {
     set_state(MOVING_DOWN);
+  } else if (is_going_to_height) {
+    set_state(target_height >= trajectory.get_position() ? MOVING_UP : MOVING_DOWN);
   } else {
     set_state(STOPPING);
   }
@@ -172,75 +474,208 @@ void ElevateSystem::update_system_state() {
 
 /**
  * Calibrate the system
+ * 
+ * @param dt time since the last control in s
  */
-void ElevateSystem::calibrate() {
+template <int NUMBER_OF_MODULES>
+void ElevateSystem<NUMBER_OF_MODULES>::calibrate(float dt) {
+  trajectory.set_velocity_limit(maximum_velocity);
+  trajectory.set_velocity_target(-maximum_velocity);
+  trajectory.update(dt);
   bool is_level = true;
   for (int i = 0; i < NUMBER_OF_MODULES; i++) {
-    if (MODULES[i].get_status() == LOWER_LIMITED) {
-      MODULES[i].hard_stop();
-      MODULES[i].update_offset();
+    if (modules[i].get_status() == LOWER_LIMITED) {
+      modules[i].hard_stop();
+      modules[i].update_offset();
     } else {
       is_level = false;
-      unsigned long current_time = micros();
-      height -= UNITS_PER_ROTATION * ROTATIONS_PER_MS * (current_time - previous_move_time) * 1e-3;
-      previous_move_time = current_time;
-      MODULES[i].move((long) height);
+      modules[i].move(lroundf(trajectory.get_position()), trajectory.get_velocity());
     }
   }
 
   if (is_level) {
-    height = 0.0;
-    set_state(STOPPED);
+    trajectory.reset(0.0f);
+    events.post(CALIBRATED);
+  }
+}
+
+/**
+ * Run the autotune experiment until every leg is done
+ */
+template <int NUMBER_OF_MODULES>
+void ElevateSystem<NUMBER_OF_MODULES>::autotune() {
+  if (autotuner.update()) events.post(AUTOTUNE_DONE);
+}
+
+/**
+ * Stop after autotune with the trajectory at rest on the mean leg height, so
+ * the next move starts where the legs were left
+ */
+template <int NUMBER_OF_MODULES>
+void ElevateSystem<NUMBER_OF_MODULES>::finish_autotune() {
+  long mean_height = 0;
+  for (int i = 0; i < NUMBER_OF_MODULES; i++) {
+    modules[i].hard_stop();
+    mean_height += modules[i].get_height();
   }
+  trajectory.reset(mean_height / NUMBER_OF_MODULES);
 }
 
 /**
- * Force stop the system
+ * Force stop the system, leaving the trajectory at rest where it was
  */
-void ElevateSystem::hard_stop() {
+template <int NUMBER_OF_MODULES>
+void ElevateSystem<NUMBER_OF_MODULES>::hard_stop() {
   for (int i = 0; i < NUMBER_OF_MODULES; i++) {
-    MODULES[i].hard_stop();
+    modules[i].hard_stop();
   }
+  if (!trajectory.is_at_rest()) trajectory.reset(trajectory.get_position());
 }
 
 /**
- * Command the system to smoothly stop
+ * Command the system to smoothly stop: brake the trajectory, then let each
+ * module settle on where it came to rest
+ * 
+ * @param dt time since the last control in s
  */
-void ElevateSystem::smooth_stop() {
+template <int NUMBER_OF_MODULES>
+void ElevateSystem<NUMBER_OF_MODULES>::smooth_stop(float dt) {
+  trajectory.set_velocity_target(0.0f);
+  trajectory.update(dt);
+  if (!trajectory.is_at_rest()) {
+    move();
+    return;
+  }
+
   for (int i = 0; i < NUMBER_OF_MODULES; i++) {
-    MODULES[i].smooth_stop((long) height);
+    modules[i].smooth_stop(lroundf(trajectory.get_position()));
   }
   for (int i = 0; i < NUMBER_OF_MODULES; i++) {
-    if (MODULES[i].get_state() != STOPPED) return;
+    if (modules[i].get_state() != STOPPED) return;
+  }
+  events.post(SETTLED);
+}
+
+/**
+ * Record the setpoint, measurement, output, state and status of every module
+ * 
+ * @param time_us clock at the control step in us
+ */
+template <int NUMBER_OF_MODULES>
+void ElevateSystem<NUMBER_OF_MODULES>::record_telemetry(unsigned long time_us) {
+  if (!telemetry) return;
+  TelemetryRecord record;
+  record.timestamp_us = time_us;
+  for (int i = 0; i < NUMBER_OF_MODULES; i++) {
+    ElevateModule const& module = modules[i];
+    record.setpoint = module.get_setpoint();
+    record.height = module.get_measured_height();
+    record.height_offset = module.get_height_offset();
+    record.output = (int16_t) module.get_output();
+    record.module = (uint8_t) i;
+    record.state = (uint8_t) module.get_state();
+    record.status = (uint8_t) module.get_status();
+    telemetry->record(record);
   }
-  state = STOPPED;
 }
 
 /**
- * Command the system to move
+ * Slow the trajectory so the leg furthest behind it keeps up: full speed up
+ * to half of SYNC_LAG_LIMIT of lag, then linearly down to a halt at the
+ * limit, so a heavily loaded leg sets the pace instead of falling behind
+ * 
+ * @param direction 1 when travelling up, -1 when travelling down
  */
-void ElevateSystem::move() {
+template <int NUMBER_OF_MODULES>
+void ElevateSystem<NUMBER_OF_MODULES>::synchronize_velocity(float direction) {
+  if (!is_synchronized) return;
+  float reference = trajectory.get_position();
+  float lag = 0.0f;
   for (int i = 0; i < NUMBER_OF_MODULES; i++) {
-    MODULES[i].move((long) height);
+    float module_lag = direction * (reference - modules[i].get_height());
+    if (module_lag > lag) lag = module_lag;
   }
+  float scale = 2.0f * (1.0f - lag / SYNC_LAG_LIMIT);
+  if (scale > 1.0f) scale = 1.0f;
+  trajectory.set_velocity_limit(maximum_velocity * scale);
 }
 
 /**
- * Command the system to move up
+ * Command the system to follow the jerk-limited trajectory, so the legs only
+ * settle on the last few units once it is at rest. Each module is corrected
+ * by its deviation from the mean module height, pulling the laggards up and
+ * holding the leaders back.
  */
-void ElevateSystem::move_up() {
-  unsigned long current_time = micros();
-  height += UNITS_PER_ROTATION * ROTATIONS_PER_MS * (current_time - previous_move_time) * 1e-3;
-  previous_move_time = current_time;
+template <int NUMBER_OF_MODULES>
+void ElevateSystem<NUMBER_OF_MODULES>::move() {
+  long height = lroundf(trajectory.get_position());
+  long mean_height = 0;
+  if (is_synchronized) {
+    for (int i = 0; i < NUMBER_OF_MODULES; i++) {
+      mean_height += modules[i].get_height();
+    }
+    mean_height /= NUMBER_OF_MODULES;
+  }
+
+  for (int i = 0; i < NUMBER_OF_MODULES; i++) {
+    long correction = is_synchronized ? lroundf(SYNC_GAIN * (mean_height - modules[i].get_height())) : 0;
+    modules[i].move(height + correction, trajectory.get_velocity());
+  }
+}
+
+/**
+ * Command the system to move up, or to the target height
+ * 
+ * @param dt time since the last control in s
+ */
+template <int NUMBER_OF_MODULES>
+void ElevateSystem<NUMBER_OF_MODULES>::move_up(float dt) {
+  if (is_going_to_height) {
+    trajectory.set_position_target(target_height);
+  } else {
+    trajectory.set_velocity_target(maximum_velocity);
+  }
+  synchronize_velocity(1.0f);
+  trajectory.update(dt);
+  if (is_going_to_height && trajectory.is_at_target()) {
+    is_going_to_height = false;
+    events.post(HEIGHT_REACHED);
+  }
   move();
 }
 
 /**
- * Command the system to move down
+ * Command the system to move down, or to the target height
+ * 
+ * @param dt time since the last control in s
  */
-void ElevateSystem::move_down() {
-  unsigned long current_time = micros();
-  height -= UNITS_PER_ROTATION * ROTATIONS_PER_MS * (current_time - previous_move_time) * 1e-3;
-  previous_move_time = current_time;
+template <int NUMBER_OF_MODULES>
+void ElevateSystem<NUMBER_OF_MODULES>::move_down(float dt) {
+  if (is_going_to_height) {
+    trajectory.set_position_target(target_height);
+  } else {
+    trajectory.set_velocity_target(-maximum_velocity);
+  }
+  synchronize_velocity(-1.0f);
+  trajectory.update(dt);
+  if (is_going_to_height && trajectory.is_at_target()) {
+    is_going_to_height = false;
+    events.post(HEIGHT_REACHED);
+  }
   move();
 }
+
+// The firmware is built for one board; host tools pick the module count at
+// run time, up to MAXIMUM_NUMBER_OF_MODULES_
+#ifdef ARDUINO
+template class ElevateSystem<NUMBER_OF_MODULES_>;
+#else
+template class ElevateSystem<1>;
+template class ElevateSystem<2>;
+template class ElevateSystem<3>;
+template class ElevateSystem<4>;
+template class ElevateSystem<5>;
+template class ElevateSystem<6>;
+template class ElevateSystem<7>;
+template class ElevateSystem<8>;
+#endif
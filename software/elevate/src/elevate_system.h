@@ -9,40 +9,119 @@
 #ifndef ELEVATE_SYSTEM_H_
 #define ELEVATE_SYSTEM_H_
 
+#include "autotuner.h"
 #include "elevate_types.h"
 #include "elevate_module.h"
 #include "button_panel.h"
+#include "elevate_board.h"
+#include "elevate_constants.h"
+#include "event_queue.h"
+#include "hal.h"
+#include "input_recorder.h"
+#include "telemetry_buffer.h"
+#include "trajectory_generator.h"
 
-class ElevateSystem {
+/**
+ * Interface to an elevate system of any module count, for code that runs or
+ * inspects a system without being built for one board
+ */
+class ElevateSystemBase {
   public:
-    ElevateSystem(ElevateModule* modules, int number_of_modules, ButtonPanel* button_panel);
+    virtual ~ElevateSystemBase() {}
+    virtual void setup() = 0;
+    virtual void update() = 0;
+    virtual void control() = 0;
+    virtual bool is_idle() const = 0;
+    virtual void resume() = 0;
+    virtual void go_to_height(long height) = 0;
+    virtual void set_synchronization(bool is_enabled) = 0;
+    virtual void set_maximum_velocity(float maximum_velocity) = 0;
+    virtual void set_telemetry(TelemetryBuffer* telemetry) = 0;
+    virtual void set_input_recorder(InputRecorder* input_recorder) = 0;
+    virtual TrajectoryGenerator const& get_trajectory() const = 0;
+    virtual Autotuner const& get_autotuner() const = 0;
+    virtual int get_number_of_modules() const = 0;
+    virtual ElevateModule* get_modules() = 0;
+};
+
+template <int NUMBER_OF_MODULES>
+class ElevateSystem final : public ElevateSystemBase {
+  public:
+    ElevateSystem(Hal* hal, ElevateBoard<NUMBER_OF_MODULES> const& board, ButtonPanel* button_panel);
     void setup();
     void update();
     void control();
+    bool is_idle() const;
+    void resume();
+    void go_to_height(long height);
+    void set_synchronization(bool is_enabled);
+    void set_maximum_velocity(float maximum_velocity);
+    void set_telemetry(TelemetryBuffer* telemetry);
+    void set_input_recorder(InputRecorder* input_recorder);
+    TrajectoryGenerator const& get_trajectory() const;
+    Autotuner const& get_autotuner() const;
+    int get_number_of_modules() const;
+    ElevateModule* get_modules();
 
   private:
-    static float const ROTATIONS_PER_MS;
+    static_assert(NUMBER_OF_MODULES >= 1 && NUMBER_OF_MODULES <= MAXIMUM_NUMBER_OF_MODULES_, "unsupported number of modules");
+
+    static float const MAXIMUM_VELOCITY;
+    static float const MAXIMUM_ACCELERATION;
+    static float const MAXIMUM_JERK;
+    static float const SYNC_GAIN;
+    static long const SYNC_LAG_LIMIT;
 
-    ElevateModule* const MODULES;
-    int const NUMBER_OF_MODULES;
+    Hal* const HAL;
     ButtonPanel* const BUTTON_PANEL;
 
+    ElevateModule modules[NUMBER_OF_MODULES];
     bool is_setup;
     ElevateState state;
-    float height;
-    unsigned long previous_move_time;
+    ElevateStatus status;
+    EventQueue events;
+    float maximum_velocity;
+    TrajectoryGenerator trajectory;
+    Autotuner autotuner;
+    bool is_autotune_chord_held;
+    bool is_synchronized;
+    bool is_going_to_height;
+    long target_height;
+    unsigned long previous_control_time;
+    TelemetryBuffer* telemetry;
+    InputRecorder* input_recorder;
+
+    template <int... INDICES>
+    ElevateSystem(
+      Hal* hal,
+      ElevateBoard<NUMBER_OF_MODULES> const& board,
+      ButtonPanel* button_panel,
+      ModuleIndices<INDICES...>
+    );
+    ElevateSystem(ElevateSystem const&) = delete;
+    ElevateSystem& operator=(ElevateSystem const&) = delete;
 
     ElevateStatus get_status() const;
     bool is_module_status(ElevateStatus status) const;
     void set_state(ElevateState state);
+    void exit_state();
+    void enter_state();
+    void take_module_samples();
     void update_module_status();
+    void post_input_events();
+    void dispatch_events();
+    void handle_event(ElevateEvent event);
     void update_system_state();
-    void calibrate();
+    void calibrate(float dt);
+    void record_telemetry(unsigned long time_us);
+    void autotune();
+    void finish_autotune();
     void hard_stop();
-    void smooth_stop();
+    void smooth_stop(float dt);
+    void synchronize_velocity(float direction);
     void move();
-    void move_up();
-    void move_down();
+    void move_up(float dt);
+    void move_down(float dt);
 };
 
 #endif
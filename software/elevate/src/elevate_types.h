@@ -32,13 +32,48 @@ enum ElevateStatus {
  * STOPPING:    preparing to stop
  * MOVING_UP:   moving upwards
  * MOVING_DOWN: moving downwards
+ * AUTOTUNE:    measuring each leg to tune its PID gains
  */
 enum ElevateState {
   CALIBRATE,
   STOPPED,
   STOPPING,
   MOVING_UP,
-  MOVING_DOWN
+  MOVING_DOWN,
+  AUTOTUNE
+};
+
+/**
+ * Elevate Event
+ * 
+ * STARTED:          system set up, inputs not yet looked at
+ * UP_PRESSED:       up button pressed
+ * UP_RELEASED:      up button released
+ * DOWN_PRESSED:     down button pressed
+ * DOWN_RELEASED:    down button released
+ * AUTOTUNE_CHORD:   autotune chord completed
+ * CALIBRATE_HELD:   both buttons held long enough to calibrate
+ * STATUS_CHANGED:   a limit switch reading changed the system status
+ * HEIGHT_REQUESTED: travel to a height requested
+ * HEIGHT_REACHED:   trajectory arrived at the requested height
+ * CALIBRATED:       every leg reached its lower limit
+ * SETTLED:          every leg came to rest after a smooth stop
+ * AUTOTUNE_DONE:    every leg tuned or given up on
+ */
+enum ElevateEvent {
+  STARTED,
+  UP_PRESSED,
+  UP_RELEASED,
+  DOWN_PRESSED,
+  DOWN_RELEASED,
+  AUTOTUNE_CHORD,
+  CALIBRATE_HELD,
+  STATUS_CHANGED,
+  HEIGHT_REQUESTED,
+  HEIGHT_REACHED,
+  CALIBRATED,
+  SETTLED,
+  AUTOTUNE_DONE
 };
 
 #endif
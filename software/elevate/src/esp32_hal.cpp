@@ -0,0 +1,508 @@
+/**
+ * @file esp32_hal.cpp
+ * 
+ * @brief ESP32 hardware abstraction layer backend
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#ifdef ARDUINO
+
+#include "esp32_hal.h"
+#include <Arduino.h>
+#include <Preferences.h>
+#include <WiFi.h>
+#include <Wire.h>
+#include <driver/gpio.h>
+#include <esp_now.h>
+#include <esp_sleep.h>
+#include <esp_timer.h>
+#include <soc/gpio_reg.h>
+#include <string.h>
+
+/**
+ * Get milliseconds since boot
+ * 
+ * @return milliseconds since boot
+ */
+unsigned long Esp32Clock::millis() const {
+  return ::millis();
+}
+
+/**
+ * Get microseconds since boot
+ * 
+ * @return microseconds since boot
+ */
+unsigned long Esp32Clock::micros() const {
+  return ::micros();
+}
+
+/**
+ * Set the mode of a pin
+ * 
+ * @param pin  pin number
+ * @param mode pin mode
+ */
+void Esp32Gpio::pin_mode(uint8_t pin, HalPinMode mode) {
+  pinMode(pin, (mode == HAL_OUTPUT) ? OUTPUT : INPUT);
+}
+
+/**
+ * Read a digital pin
+ * 
+ * @param pin pin number
+ * 
+ * @return pin level
+ */
+uint8_t Esp32Gpio::digital_read(uint8_t pin) const {
+  return (digitalRead(pin) == HIGH) ? HAL_HIGH : HAL_LOW;
+}
+
+/**
+ * Write a digital pin
+ * 
+ * @param pin   pin number
+ * @param value pin level
+ */
+void Esp32Gpio::digital_write(uint8_t pin, uint8_t value) {
+  digitalWrite(pin, (value == HAL_HIGH) ? HIGH : LOW);
+}
+
+/**
+ * Read the levels of a bank of pins in one input register read
+ * 
+ * @param bank bank number, pins HAL_PINS_PER_BANK * bank and up
+ * 
+ * @return pin levels, pin n in bit n % HAL_PINS_PER_BANK
+ */
+uint32_t Esp32Gpio::read_bank(uint8_t bank) const {
+  return (bank == 0) ? REG_READ(GPIO_IN_REG) : REG_READ(GPIO_IN1_REG);
+}
+
+/**
+ * Set up a pwm channel
+ * 
+ * @param channel         pwm channel
+ * @param frequency       pwm frequency in Hz
+ * @param resolution_bits duty resolution in bits
+ */
+void Esp32Pwm::setup(uint8_t channel, uint32_t frequency, uint8_t resolution_bits) {
+  ledcSetup(channel, frequency, resolution_bits);
+}
+
+/**
+ * Attach a pin to a pwm channel
+ * 
+ * @param pin     pwm pin
+ * @param channel pwm channel
+ */
+void Esp32Pwm::attach_pin(uint8_t pin, uint8_t channel) {
+  ledcAttachPin(pin, channel);
+}
+
+/**
+ * Write a pwm duty
+ * 
+ * @param channel pwm channel
+ * @param duty    duty in channel resolution
+ */
+void Esp32Pwm::write(uint8_t channel, uint32_t duty) {
+  ledcWrite(channel, duty);
+}
+
+/**
+ * Start ESP-NOW in station mode
+ * 
+ * @return if ESP-NOW started
+ */
+bool Esp32Radio::begin() {
+  WiFi.mode(WIFI_STA);
+  WiFi.setSleep(false);
+  return esp_now_init() == ESP_OK;
+}
+
+/**
+ * Add an ESP-NOW peer
+ * 
+ * @param mac_address peer address
+ * @param channel     Wi-Fi channel
+ * 
+ * @return if peer was added
+ */
+bool Esp32Radio::add_peer(const uint8_t* mac_address, uint8_t channel) {
+  esp_now_peer_info_t peer;
+  memset(&peer, 0, sizeof(peer));
+  memcpy(peer.peer_addr, mac_address, ESP_NOW_ETH_ALEN);
+  peer.channel = channel;
+  peer.encrypt = false;
+  return esp_now_add_peer(&peer) == ESP_OK;
+}
+
+/**
+ * Register callback for received frames
+ * 
+ * @param callback receive callback
+ */
+void Esp32Radio::set_receive_callback(ReceiveCallback callback) {
+  esp_now_register_recv_cb(callback);
+}
+
+/**
+ * Send a frame
+ * 
+ * @param mac_address peer address
+ * @param data        frame payload
+ * @param len         payload length in bytes
+ * 
+ * @return if frame was queued
+ */
+bool Esp32Radio::send(const uint8_t* mac_address, const uint8_t* data, size_t len) {
+  return esp_now_send(mac_address, data, len) == ESP_OK;
+}
+
+/**
+ * ESP32 I2c constructor
+ * 
+ * @param core     core to pin the transfer task to
+ * @param priority FreeRTOS priority of the transfer task
+ */
+Esp32I2c::Esp32I2c(int core, int priority) : CORE(core), PRIORITY(priority) {
+  queue = 0;
+  task = 0;
+}
+
+/**
+ * Start the I2C bus and the task that runs asynchronous reads
+ * 
+ * @param sda_pin   data pin
+ * @param scl_pin   clock pin
+ * @param frequency bus frequency in Hz
+ * 
+ * @return if bus started
+ */
+bool Esp32I2c::begin(int sda_pin, int scl_pin, uint32_t frequency) {
+  if (!Wire.begin(sda_pin, scl_pin, frequency)) return false;
+  if (!queue) {
+    QueueHandle_t queue_handle = xQueueCreate(QUEUE_LENGTH, sizeof(Request));
+    if (!queue_handle) return false;
+    queue = queue_handle;
+  }
+  if (!task) {
+    TaskHandle_t task_handle;
+    if (xTaskCreatePinnedToCore(task_main, "i2c", 2048, this, PRIORITY, &task_handle, CORE) != pdPASS) {
+      return false;
+    }
+    task = task_handle;
+  }
+  return true;
+}
+
+/**
+ * Read consecutive registers from a device in one transaction with a
+ * repeated start
+ * 
+ * The calling task sleeps on the driver interrupt while bytes move.
+ * 
+ * @param device_address   device address
+ * @param register_address first register to read
+ * @param data             buffer for register contents
+ * @param len              number of bytes to read
+ * @param timeout_ms       time to wait for data in ms
+ * 
+ * @return if all bytes were read
+ */
+bool Esp32I2c::read(
+    uint8_t device_address,
+    uint8_t register_address,
+    uint8_t* data,
+    size_t len,
+    unsigned long timeout_ms) {
+  Wire.setTimeOut((uint16_t) timeout_ms);
+  Wire.beginTransmission(device_address);
+  Wire.write(register_address);
+  if (Wire.endTransmission(false) != 0) return false;
+  if (Wire.requestFrom(device_address, (uint8_t) len) != len) return false;
+  for (size_t i = 0; i < len; i++) {
+    data[i] = Wire.read();
+  }
+  return true;
+}
+
+/**
+ * Queue a read of consecutive registers and return at once
+ * 
+ * The callback runs on the transfer task; data must stay valid until then.
+ * 
+ * @param device_address   device address
+ * @param register_address first register to read
+ * @param data             buffer for register contents
+ * @param len              number of bytes to read
+ * @param timeout_ms       time to wait for data in ms
+ * @param callback         called when the read finishes or fails
+ * @param context          pointer passed to the callback
+ * 
+ * @return if the read was queued
+ */
+bool Esp32I2c::read_async(
+    uint8_t device_address,
+    uint8_t register_address,
+    uint8_t* data,
+    size_t len,
+    unsigned long timeout_ms,
+    I2cCallback callback,
+    void* context) {
+  if (!queue) return false;
+  Request request = {device_address, register_address, data, len, timeout_ms, callback, context};
+  return xQueueSend((QueueHandle_t) queue, &request, 0) == pdTRUE;
+}
+
+/**
+ * Transfer task, runs queued reads one at a time
+ * 
+ * @param i2c bus that owns the task
+ */
+void Esp32I2c::task_main(void* i2c) {
+  Esp32I2c* self = (Esp32I2c*) i2c;
+  Request request;
+  for (;;) {
+    if (xQueueReceive((QueueHandle_t) self->queue, &request, portMAX_DELAY) != pdTRUE) continue;
+    bool success = self->read(
+      request.device_address,
+      request.register_address,
+      request.data,
+      request.len,
+      request.timeout_ms
+    );
+    request.callback(request.context, success);
+  }
+}
+
+/**
+ * ESP32 Periodic Timer constructor
+ * 
+ * @param core     core to pin the tick task to
+ * @param priority FreeRTOS priority of the tick task
+ */
+Esp32PeriodicTimer::Esp32PeriodicTimer(int core, int priority) : CORE(core), PRIORITY(priority) {
+  callback = 0;
+  context = 0;
+  task = 0;
+  timer = 0;
+}
+
+/**
+ * Start calling back at a fixed rate from a task pinned to its own core
+ * 
+ * @param period_us tick period in us
+ * @param callback  tick callback
+ * @param context   pointer passed to the callback
+ * 
+ * @return if the timer started
+ */
+bool Esp32PeriodicTimer::start(unsigned long period_us, TickCallback callback, void* context) {
+  if (task) return false;
+  this->callback = callback;
+  this->context = context;
+
+  TaskHandle_t task_handle;
+  if (xTaskCreatePinnedToCore(task_main, "control", 4096, this, PRIORITY, &task_handle, CORE) != pdPASS) {
+    return false;
+  }
+  task = task_handle;
+
+  esp_timer_create_args_t timer_arguments = {};
+  timer_arguments.callback = timer_callback;
+  timer_arguments.arg = this;
+  timer_arguments.dispatch_method = ESP_TIMER_TASK;
+  timer_arguments.name = "control";
+  esp_timer_handle_t timer_handle;
+  if (esp_timer_create(&timer_arguments, &timer_handle) != ESP_OK) {
+    stop();
+    return false;
+  }
+  timer = timer_handle;
+  if (esp_timer_start_periodic(timer_handle, period_us) != ESP_OK) {
+    stop();
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Stop the timer and its task
+ */
+void Esp32PeriodicTimer::stop() {
+  if (timer) {
+    esp_timer_stop((esp_timer_handle_t) timer);
+    esp_timer_delete((esp_timer_handle_t) timer);
+    timer = 0;
+  }
+  if (task) {
+    vTaskDelete((TaskHandle_t) task);
+    task = 0;
+  }
+}
+
+/**
+ * Tick task, runs the callback once per timer notification
+ * 
+ * @param periodic_timer timer that owns the task
+ */
+void Esp32PeriodicTimer::task_main(void* periodic_timer) {
+  Esp32PeriodicTimer* self = (Esp32PeriodicTimer*) periodic_timer;
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    self->callback(self->context);
+  }
+}
+
+/**
+ * Timer callback, wakes the tick task
+ * 
+ * @param periodic_timer timer that owns the task
+ */
+void Esp32PeriodicTimer::timer_callback(void* periodic_timer) {
+  Esp32PeriodicTimer* self = (Esp32PeriodicTimer*) periodic_timer;
+  xTaskNotifyGive((TaskHandle_t) self->task);
+}
+
+char const* const Esp32Storage::NAMESPACE = "elevate";
+
+/**
+ * Read a value from non-volatile storage
+ * 
+ * @param key  key, at most 15 characters
+ * @param data buffer for the value
+ * @param len  value length in bytes
+ * 
+ * @return if a value of exactly len bytes was stored under the key
+ */
+bool Esp32Storage::read(const char* key, void* data, size_t len) {
+  Preferences preferences;
+  if (!preferences.begin(NAMESPACE, true)) return false;
+  bool is_read = preferences.getBytesLength(key) == len && preferences.getBytes(key, data, len) == len;
+  preferences.end();
+  return is_read;
+}
+
+/**
+ * Write a value to non-volatile storage
+ * 
+ * @param key  key, at most 15 characters
+ * @param data value
+ * @param len  value length in bytes
+ * 
+ * @return if the value was written
+ */
+bool Esp32Storage::write(const char* key, const void* data, size_t len) {
+  Preferences preferences;
+  if (!preferences.begin(NAMESPACE, false)) return false;
+  bool is_written = preferences.putBytes(key, data, len) == len;
+  preferences.end();
+  return is_written;
+}
+
+size_t const Esp32SerialPort::TX_BUFFER_SIZE = 4096;
+
+/**
+ * Start the USB serial port, with a transmit buffer large enough that a
+ * burst of telemetry does not wait on the UART
+ * 
+ * @param baud_rate baud rate
+ * 
+ * @return if the port started
+ */
+bool Esp32SerialPort::begin(unsigned long baud_rate) {
+  Serial.setTxBufferSize(TX_BUFFER_SIZE);
+  Serial.begin(baud_rate);
+  return true;
+}
+
+/**
+ * Get how many bytes can be written without blocking
+ * 
+ * @return free space in the transmit buffer in bytes
+ */
+size_t Esp32SerialPort::available_for_write() {
+  return Serial.availableForWrite();
+}
+
+/**
+ * Write bytes to the serial port
+ * 
+ * @param data bytes to write
+ * @param len  number of bytes
+ * 
+ * @return number of bytes written
+ */
+size_t Esp32SerialPort::write(const uint8_t* data, size_t len) {
+  return Serial.write(data, len);
+}
+
+/**
+ * Esp32 Power constructor
+ */
+Esp32Power::Esp32Power() {
+  number_of_wake_pins = 0;
+}
+
+/**
+ * Wake the next light sleep when a pin reaches a level
+ * 
+ * @param pin   input pin
+ * @param level level that wakes, HAL_LOW or HAL_HIGH
+ */
+void Esp32Power::enable_pin_wake(uint8_t pin, uint8_t level) {
+  if (number_of_wake_pins >= MAXIMUM_WAKE_PINS) return;
+  gpio_wakeup_enable((gpio_num_t) pin, level == HAL_HIGH ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL);
+  esp_sleep_enable_gpio_wakeup();
+  wake_pins[number_of_wake_pins++] = pin;
+}
+
+/**
+ * Wake the next light sleep after a time
+ * 
+ * @param sleep_us longest sleep in us
+ */
+void Esp32Power::enable_timer_wake(unsigned long sleep_us) {
+  esp_sleep_enable_timer_wakeup(sleep_us);
+}
+
+/**
+ * Light sleep until an enabled wake source fires, then clear every wake
+ * source; the radio is off and timers are held while asleep, and micros()
+ * keeps counting
+ */
+void Esp32Power::light_sleep() {
+  esp_light_sleep_start();
+  esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_ALL);
+  for (int i = 0; i < number_of_wake_pins; i++) {
+    gpio_wakeup_disable((gpio_num_t) wake_pins[i]);
+  }
+  number_of_wake_pins = 0;
+}
+
+/**
+ * Get the ESP32 hardware abstraction layer
+ * 
+ * The periodic timer and the I2C transfer task run on core 1 above the
+ * Arduino loop task, leaving Wi-Fi and ESP-NOW on core 0.
+ * 
+ * @return pointer to ESP32 hal
+ */
+Hal* esp32_hal() {
+  static Esp32Clock clock;
+  static Esp32Gpio gpio;
+  static Esp32Pwm pwm;
+  static Esp32Radio radio;
+  static Esp32I2c i2c(1, configMAX_PRIORITIES - 3);
+  static Esp32PeriodicTimer timer(1, configMAX_PRIORITIES - 2);
+  static Esp32Storage storage;
+  static Esp32SerialPort serial;
+  static Esp32Power power;
+  static Hal hal = {&clock, &gpio, &pwm, &radio, &i2c, &timer, &storage, &serial, &power};
+  return &hal;
+}
+
+#endif
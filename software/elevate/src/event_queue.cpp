@@ -0,0 +1,71 @@
+/**
+ * @file event_queue.cpp
+ * 
+ * @brief elevate system event queue
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#include "event_queue.h"
+
+/**
+ * Event Queue constructor; events are posted and taken from the context
+ * that runs the system, so the ring needs no synchronization
+ */
+EventQueue::EventQueue() {
+  head = 0;
+  tail = 0;
+  dropped = 0;
+}
+
+/**
+ * Post an event behind every pending one. A control step posts at most a
+ * handful of events and takes them all before the next, so a full queue
+ * means events are not being taken; the event is then refused and counted
+ * 
+ * @param event event to post
+ * 
+ * @return if the event was queued
+ */
+bool EventQueue::post(ElevateEvent event) {
+  uint8_t next_head = (head + 1) % CAPACITY;
+  if (next_head == tail) {
+    dropped++;
+    return false;
+  }
+  events[head] = event;
+  head = next_head;
+  return true;
+}
+
+/**
+ * Take the oldest pending event
+ * 
+ * @param event taken event
+ * 
+ * @return if there was an event to take
+ */
+bool EventQueue::take(ElevateEvent& event) {
+  if (tail == head) return false;
+  event = events[tail];
+  tail = (tail + 1) % CAPACITY;
+  return true;
+}
+
+/**
+ * Determine if no event is pending
+ * 
+ * @return if the queue is empty
+ */
+bool EventQueue::is_empty() const {
+  return tail == head;
+}
+
+/**
+ * Get number of events refused because the queue was full
+ * 
+ * @return number of dropped events
+ */
+uint32_t EventQueue::get_dropped() const {
+  return dropped;
+}
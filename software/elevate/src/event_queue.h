@@ -0,0 +1,32 @@
+/**
+ * @file event_queue.h
+ * 
+ * @brief header file for elevate system event queue
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#ifndef EVENT_QUEUE_H_
+#define EVENT_QUEUE_H_
+
+#include "elevate_types.h"
+#include <stdint.h>
+
+class EventQueue {
+  public:
+    EventQueue();
+    bool post(ElevateEvent event);
+    bool take(ElevateEvent& event);
+    bool is_empty() const;
+    uint32_t get_dropped() const;
+
+  private:
+    static uint8_t const CAPACITY = 16;
+
+    ElevateEvent events[CAPACITY];
+    uint8_t head;
+    uint8_t tail;
+    uint32_t dropped;
+};
+
+#endif
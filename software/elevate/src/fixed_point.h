@@ -0,0 +1,209 @@
+/**
+ * @file fixed_point.h
+ * 
+ * @brief signed Q-format fixed point number
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#ifndef FIXED_POINT_H_
+#define FIXED_POINT_H_
+
+#include <stdint.h>
+
+/**
+ * Fixed point number stored as a 32 bit integer scaled by 2^FRACTIONAL_BITS.
+ * Products are formed in 64 bits and rounded back, and every result
+ * saturates instead of wrapping, so a controller driven far off its
+ * setpoint still pushes in the right direction.
+ * 
+ * @tparam FRACTIONAL_BITS number of fractional bits
+ */
+template <int FRACTIONAL_BITS>
+class FixedPoint {
+  public:
+    /**
+     * Fixed Point constructor, zero
+     */
+    FixedPoint() : raw(0) {}
+
+    /**
+     * Fixed Point constructor from an integer
+     * 
+     * @param value integer value, saturated to the representable range
+     */
+    explicit FixedPoint(long value) : raw(saturate((int64_t) value * ONE)) {}
+
+    /**
+     * Fixed Point constructor from a float, rounded to the nearest step
+     * 
+     * @param value value, saturated to the representable range
+     */
+    explicit FixedPoint(float value) {
+      float scaled = value * ONE;
+      if (scaled >= (float) INT32_MAX) {
+        raw = INT32_MAX;
+      } else if (scaled <= (float) INT32_MIN) {
+        raw = INT32_MIN;
+      } else {
+        raw = (int32_t) (scaled < 0.0f ? scaled - 0.5f : scaled + 0.5f);
+      }
+    }
+
+    /**
+     * Get the value rounded to the nearest integer, halves away from zero
+     * 
+     * @return integer value
+     */
+    long to_long() const {
+      int32_t half = ONE / 2;
+      return (raw < 0) ? -(long) (((int64_t) -raw + half) >> FRACTIONAL_BITS) :
+        (long) (((int64_t) raw + half) >> FRACTIONAL_BITS);
+    }
+
+    /**
+     * Get the value as a float
+     * 
+     * @return value
+     */
+    float to_float() const {
+      return (float) raw / ONE;
+    }
+
+    /**
+     * Add, saturating
+     * 
+     * @param other addend
+     * 
+     * @return sum
+     */
+    FixedPoint operator+(FixedPoint other) const {
+      return from_raw(saturate((int64_t) raw + other.raw));
+    }
+
+    /**
+     * Subtract, saturating
+     * 
+     * @param other subtrahend
+     * 
+     * @return difference
+     */
+    FixedPoint operator-(FixedPoint other) const {
+      return from_raw(saturate((int64_t) raw - other.raw));
+    }
+
+    /**
+     * Negate, saturating
+     * 
+     * @return negated value
+     */
+    FixedPoint operator-() const {
+      return from_raw(saturate(-(int64_t) raw));
+    }
+
+    /**
+     * Multiply in 64 bits, rounding and saturating
+     * 
+     * @param other factor
+     * 
+     * @return product
+     */
+    FixedPoint operator*(FixedPoint other) const {
+      int64_t product = (int64_t) raw * other.raw;
+      return from_raw(saturate((product + (ONE / 2)) >> FRACTIONAL_BITS));
+    }
+
+    /**
+     * Add in place, saturating
+     * 
+     * @param other addend
+     * 
+     * @return this value
+     */
+    FixedPoint& operator+=(FixedPoint other) {
+      return *this = *this + other;
+    }
+
+    /**
+     * Compare
+     * 
+     * @param other value to compare to
+     * 
+     * @return if this value is smaller
+     */
+    bool operator<(FixedPoint other) const {
+      return raw < other.raw;
+    }
+
+    /**
+     * Compare
+     * 
+     * @param other value to compare to
+     * 
+     * @return if this value is larger
+     */
+    bool operator>(FixedPoint other) const {
+      return raw > other.raw;
+    }
+
+  private:
+    static int32_t const ONE = (int32_t) 1 << FRACTIONAL_BITS;
+
+    int32_t raw;
+
+    /**
+     * Build a value from its scaled representation
+     * 
+     * @param raw value times 2^FRACTIONAL_BITS
+     * 
+     * @return value
+     */
+    static FixedPoint from_raw(int32_t raw) {
+      FixedPoint value;
+      value.raw = raw;
+      return value;
+    }
+
+    /**
+     * Clamp a wide intermediate to the 32 bit range
+     * 
+     * @param value scaled value
+     * 
+     * @return saturated scaled value
+     */
+    static int32_t saturate(int64_t value) {
+      if (value > INT32_MAX) return INT32_MAX;
+      if (value < INT32_MIN) return INT32_MIN;
+      return (int32_t) value;
+    }
+};
+
+/**
+ * Q15.16, steps of 1/65536 and a range of +-32768
+ */
+typedef FixedPoint<16> Q16;
+
+/**
+ * Round a float to the nearest integer
+ * 
+ * @param value value
+ * 
+ * @return integer value
+ */
+inline long to_long(float value) {
+  return (long) (value < 0.0f ? value - 0.5f : value + 0.5f);
+}
+
+/**
+ * Round a fixed point number to the nearest integer
+ * 
+ * @param value value
+ * 
+ * @return integer value
+ */
+template <int FRACTIONAL_BITS>
+inline long to_long(FixedPoint<FRACTIONAL_BITS> value) {
+  return value.to_long();
+}
+
+#endif
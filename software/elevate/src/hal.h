@@ -0,0 +1,164 @@
+/**
+ * @file hal.h
+ * 
+ * @brief hardware abstraction layer for elevate
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#ifndef HAL_H_
+#define HAL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+uint8_t const HAL_LOW = 0;
+uint8_t const HAL_HIGH = 1;
+int const HAL_PINS_PER_BANK = 32;
+
+/**
+ * Pin Mode
+ * 
+ * HAL_INPUT:  digital input
+ * HAL_OUTPUT: digital output
+ */
+enum HalPinMode {
+  HAL_INPUT,
+  HAL_OUTPUT
+};
+
+/**
+ * Callback for received radio frames
+ * 
+ * mac_address: sender address
+ * data:        frame payload
+ * len:         payload length in bytes
+ */
+typedef void (*ReceiveCallback)(const uint8_t* mac_address, const uint8_t* data, int len);
+
+/**
+ * Callback for finished asynchronous I2C reads
+ * 
+ * context: pointer given when the read was started
+ * success: whether every byte was read
+ */
+typedef void (*I2cCallback)(void* context, bool success);
+
+/**
+ * Callback for periodic timer ticks
+ * 
+ * context: pointer given when the timer was started
+ */
+typedef void (*TickCallback)(void* context);
+
+class Clock {
+  public:
+    virtual ~Clock() {}
+    virtual unsigned long millis() const = 0;
+    virtual unsigned long micros() const = 0;
+};
+
+class Gpio {
+  public:
+    virtual ~Gpio() {}
+    virtual void pin_mode(uint8_t pin, HalPinMode mode) = 0;
+    virtual uint8_t digital_read(uint8_t pin) const = 0;
+    virtual void digital_write(uint8_t pin, uint8_t value) = 0;
+    virtual uint32_t read_bank(uint8_t bank) const = 0;
+};
+
+class Pwm {
+  public:
+    virtual ~Pwm() {}
+    virtual void setup(uint8_t channel, uint32_t frequency, uint8_t resolution_bits) = 0;
+    virtual void attach_pin(uint8_t pin, uint8_t channel) = 0;
+    virtual void write(uint8_t channel, uint32_t duty) = 0;
+};
+
+class Radio {
+  public:
+    virtual ~Radio() {}
+    virtual bool begin() = 0;
+    virtual bool add_peer(const uint8_t* mac_address, uint8_t channel) = 0;
+    virtual void set_receive_callback(ReceiveCallback callback) = 0;
+    virtual bool send(const uint8_t* mac_address, const uint8_t* data, size_t len) = 0;
+};
+
+class I2c {
+  public:
+    virtual ~I2c() {}
+    virtual bool begin(int sda_pin, int scl_pin, uint32_t frequency) = 0;
+    virtual bool read(
+      uint8_t device_address,
+      uint8_t register_address,
+      uint8_t* data,
+      size_t len,
+      unsigned long timeout_ms
+    ) = 0;
+    virtual bool read_async(
+      uint8_t device_address,
+      uint8_t register_address,
+      uint8_t* data,
+      size_t len,
+      unsigned long timeout_ms,
+      I2cCallback callback,
+      void* context
+    ) = 0;
+};
+
+class PeriodicTimer {
+  public:
+    virtual ~PeriodicTimer() {}
+    virtual bool start(unsigned long period_us, TickCallback callback, void* context) = 0;
+    virtual void stop() = 0;
+};
+
+class Storage {
+  public:
+    virtual ~Storage() {}
+    virtual bool read(const char* key, void* data, size_t len) = 0;
+    virtual bool write(const char* key, const void* data, size_t len) = 0;
+};
+
+class SerialPort {
+  public:
+    virtual ~SerialPort() {}
+    virtual bool begin(unsigned long baud_rate) = 0;
+    virtual size_t available_for_write() = 0;
+    virtual size_t write(const uint8_t* data, size_t len) = 0;
+};
+
+class Power {
+  public:
+    virtual ~Power() {}
+    virtual void enable_pin_wake(uint8_t pin, uint8_t level) = 0;
+    virtual void enable_timer_wake(unsigned long sleep_us) = 0;
+    virtual void light_sleep() = 0;
+};
+
+/**
+ * Struct bundling the hardware backends injected into elevate classes
+ * 
+ * clock:   time source
+ * gpio:    digital pins
+ * pwm:     motor pwm channels
+ * radio:   minion link
+ * i2c:     sensor bus
+ * timer:   fixed-rate tick source for control
+ * storage: non-volatile key-value store, survives power cycles
+ * serial:  byte stream to a host, for telemetry
+ * power:   light sleep, for idling between bursts of activity
+ */
+struct Hal {
+  Clock* clock;
+  Gpio* gpio;
+  Pwm* pwm;
+  Radio* radio;
+  I2c* i2c;
+  PeriodicTimer* timer;
+  Storage* storage;
+  SerialPort* serial;
+  Power* power;
+};
+
+#endif
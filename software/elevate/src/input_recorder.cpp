@@ -0,0 +1,211 @@
+/**
+ * @file input_recorder.cpp
+ * 
+ * @brief master input capture, for deterministic replay
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#include "input_recorder.h"
+#include <string.h>
+
+/**
+ * Encode an input as a capture frame, little-endian, 12 + payload length
+ * bytes:
+ * 
+ *   0  uint8   sync byte INPUT_SYNC
+ *   1  uint8   capture format version
+ *   2  uint8   input type
+ *   3  uint8   payload length
+ *   4  uint16  sequence number, increments by one per input of the same
+ *              source, dropped inputs included
+ *   6  uint32  master clock when the input was taken in us
+ *   10         payload: button levels for setup and control steps, the
+ *              raw frame for radio frames
+ *   ...uint16  CRC-16/CCITT-FALSE over every byte before it
+ * 
+ * @param event  input to encode
+ * @param buffer destination
+ * @param size   destination size in bytes
+ * 
+ * @return frame length in bytes, 0 if it does not fit
+ */
+size_t encode_input_frame(InputEvent const& event, uint8_t* buffer, size_t size) {
+  size_t len = INPUT_HEADER_SIZE + event.len + 2;
+  if (event.len > INPUT_MAXIMUM_PAYLOAD || size < len) return 0;
+  buffer[0] = INPUT_SYNC;
+  buffer[1] = INPUT_VERSION;
+  buffer[2] = event.type;
+  buffer[3] = event.len;
+  buffer[4] = (uint8_t) event.sequence;
+  buffer[5] = (uint8_t) (event.sequence >> 8);
+  buffer[6] = (uint8_t) event.timestamp_us;
+  buffer[7] = (uint8_t) (event.timestamp_us >> 8);
+  buffer[8] = (uint8_t) (event.timestamp_us >> 16);
+  buffer[9] = (uint8_t) (event.timestamp_us >> 24);
+  memcpy(buffer + INPUT_HEADER_SIZE, event.data, event.len);
+  uint16_t crc = minion_crc16(buffer, len - 2);
+  buffer[len - 2] = (uint8_t) crc;
+  buffer[len - 1] = (uint8_t) (crc >> 8);
+  return len;
+}
+
+/**
+ * Decode a capture frame
+ * 
+ * @param buffer frame bytes
+ * @param len    number of bytes available
+ * @param event  decoded input, untouched unless the frame is valid
+ * 
+ * @return frame length in bytes if the bytes start with a whole frame of
+ *         this version with a matching checksum, otherwise 0
+ */
+size_t decode_input_frame(const uint8_t* buffer, size_t len, InputEvent& event) {
+  if (len < INPUT_HEADER_SIZE + 2) return 0;
+  if (buffer[0] != INPUT_SYNC || buffer[1] != INPUT_VERSION) return 0;
+  size_t payload_len = buffer[3];
+  size_t frame_len = INPUT_HEADER_SIZE + payload_len + 2;
+  if (payload_len > INPUT_MAXIMUM_PAYLOAD || len < frame_len) return 0;
+  uint16_t crc = (uint16_t) (buffer[frame_len - 2] | (buffer[frame_len - 1] << 8));
+  if (crc != minion_crc16(buffer, frame_len - 2)) return 0;
+  event.type = buffer[2];
+  event.len = (uint8_t) payload_len;
+  event.sequence = (uint16_t) (buffer[4] | (buffer[5] << 8));
+  event.timestamp_us = (uint32_t) buffer[6] |
+    ((uint32_t) buffer[7] << 8) |
+    ((uint32_t) buffer[8] << 16) |
+    ((uint32_t) buffer[9] << 24);
+  memcpy(event.data, buffer + INPUT_HEADER_SIZE, payload_len);
+  return frame_len;
+}
+
+/**
+ * Input Recorder constructor, starts empty. Radio frames and control steps,
+ * plus the time of setup, are everything the master control stack reacts
+ * to, so recording them is enough to feed the same inputs back into
+ * ElevateSystem later. Radio frames arrive on the radio task and control
+ * steps run on the control task, so each source has its own lock-free ring.
+ */
+InputRecorder::InputRecorder() : dropped(0) {
+  control_ring.head = 0;
+  control_ring.tail = 0;
+  control_ring.sequence = 0;
+  radio_ring.head = 0;
+  radio_ring.tail = 0;
+  radio_ring.sequence = 0;
+}
+
+/**
+ * Record system setup, called only by the control side
+ * 
+ * @param timestamp_us  master clock at setup in us
+ * @param button_levels button pin levels
+ * 
+ * @return if the input was queued; false if the buffer is full
+ */
+bool InputRecorder::record_setup(uint32_t timestamp_us, uint8_t button_levels) {
+  return record(control_ring, timestamp_us, INPUT_SETUP, &button_levels, 1);
+}
+
+/**
+ * Record the start of a control step, called only by the control side
+ * 
+ * @param timestamp_us  master clock at the control step in us
+ * @param button_levels button pin levels the step reads
+ * 
+ * @return if the input was queued; false if the buffer is full
+ */
+bool InputRecorder::record_control_step(uint32_t timestamp_us, uint8_t button_levels) {
+  return record(control_ring, timestamp_us, INPUT_CONTROL_STEP, &button_levels, 1);
+}
+
+/**
+ * Record a radio frame given to the minion receiver, called only by the
+ * radio side
+ * 
+ * @param timestamp_us master clock the receiver saw in us
+ * @param data         frame payload
+ * @param len          payload length in bytes
+ * 
+ * @return if the input was queued; false if the buffer is full or the frame
+ *         is too long to be a minion frame
+ */
+bool InputRecorder::record_radio_frame(uint32_t timestamp_us, const uint8_t* data, int len) {
+  if (len < 0 || (size_t) len > INPUT_MAXIMUM_PAYLOAD) return false;
+  return record(radio_ring, timestamp_us, INPUT_RADIO_FRAME, data, (size_t) len);
+}
+
+/**
+ * Write queued inputs to a serial port as capture frames, oldest first with
+ * radio frames first on a tie, as many as fit without blocking, called only
+ * by the consumer
+ * 
+ * @param serial serial port to write to
+ * 
+ * @return number of frames written
+ */
+size_t InputRecorder::drain(SerialPort* serial) {
+  size_t frames = 0;
+  uint8_t frame[INPUT_MAXIMUM_FRAME_SIZE];
+  while (true) {
+    uint32_t control_tail = control_ring.tail.load(std::memory_order_relaxed);
+    uint32_t radio_tail = radio_ring.tail.load(std::memory_order_relaxed);
+    bool has_control = control_tail != control_ring.head.load(std::memory_order_acquire);
+    bool has_radio = radio_tail != radio_ring.head.load(std::memory_order_acquire);
+    if (!has_control && !has_radio) break;
+
+    Ring* ring = has_radio ? &radio_ring : &control_ring;
+    if (has_control && has_radio) {
+      uint32_t control_time = control_ring.events[control_tail % CAPACITY].timestamp_us;
+      uint32_t radio_time = radio_ring.events[radio_tail % CAPACITY].timestamp_us;
+      if ((int32_t) (control_time - radio_time) < 0) ring = &control_ring;
+    }
+    uint32_t tail = (ring == &control_ring) ? control_tail : radio_tail;
+    InputEvent const& event = ring->events[tail % CAPACITY];
+    if (serial->available_for_write() < INPUT_HEADER_SIZE + event.len + 2) break;
+    size_t len = encode_input_frame(event, frame, sizeof(frame));
+    ring->tail.store(tail + 1, std::memory_order_release);
+    serial->write(frame, len);
+    frames++;
+  }
+  return frames;
+}
+
+/**
+ * Get how many inputs were refused because the buffer was full; their
+ * sequence numbers are still used up, so the replay can tell the capture is
+ * incomplete
+ * 
+ * @return number of dropped inputs
+ */
+uint32_t InputRecorder::get_dropped() const {
+  return dropped.load(std::memory_order_relaxed);
+}
+
+/**
+ * Queue one input, called only by the ring's producer
+ * 
+ * @param ring         ring of the input's source
+ * @param timestamp_us master clock in us
+ * @param type         input type
+ * @param data         payload
+ * @param len          payload length in bytes
+ * 
+ * @return if the input was queued; false if the ring is full
+ */
+bool InputRecorder::record(Ring& ring, uint32_t timestamp_us, uint8_t type, const uint8_t* data, size_t len) {
+  uint16_t current_sequence = ring.sequence++;
+  uint32_t current = ring.head.load(std::memory_order_relaxed);
+  if (current - ring.tail.load(std::memory_order_acquire) >= CAPACITY) {
+    dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  InputEvent& slot = ring.events[current % CAPACITY];
+  slot.timestamp_us = timestamp_us;
+  slot.sequence = current_sequence;
+  slot.type = type;
+  slot.len = (uint8_t) len;
+  memcpy(slot.data, data, len);
+  ring.head.store(current + 1, std::memory_order_release);
+  return true;
+}
@@ -0,0 +1,93 @@
+/**
+ * @file input_recorder.h
+ * 
+ * @brief header file for master input capture, for deterministic replay
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#ifndef INPUT_RECORDER_H_
+#define INPUT_RECORDER_H_
+
+#include "hal.h"
+#include "minion_protocol.h"
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+uint8_t const INPUT_SYNC = 0x5a;
+uint8_t const INPUT_VERSION = 1;
+size_t const INPUT_HEADER_SIZE = 10;
+size_t const INPUT_MAXIMUM_PAYLOAD = MINION_MAXIMUM_BATCH_FRAME_SIZE;
+size_t const INPUT_MAXIMUM_FRAME_SIZE = INPUT_HEADER_SIZE + INPUT_MAXIMUM_PAYLOAD + 2;
+
+/**
+ * Input Type
+ * 
+ * INPUT_SETUP:        ElevateSystem::setup() ran
+ * INPUT_CONTROL_STEP: ElevateSystem::update() and control() ran
+ * INPUT_RADIO_FRAME:  a radio frame reached the minion receiver
+ */
+enum InputType {
+  INPUT_SETUP = 1,
+  INPUT_CONTROL_STEP = 2,
+  INPUT_RADIO_FRAME = 3
+};
+
+/**
+ * Struct for one master input
+ * 
+ * timestamp_us: master clock when the input was taken in us
+ * sequence:     sequence number, set by the recorder
+ * type:         input type
+ * len:          payload length in bytes
+ * data:         payload, button levels with the up switch pin level in bit
+ *               0 and the down switch pin level in bit 1 for setup and
+ *               control steps, the raw frame for radio frames
+ */
+struct InputEvent {
+  uint32_t timestamp_us;
+  uint16_t sequence;
+  uint8_t type;
+  uint8_t len;
+  uint8_t data[INPUT_MAXIMUM_PAYLOAD];
+};
+
+size_t encode_input_frame(InputEvent const& event, uint8_t* buffer, size_t size);
+size_t decode_input_frame(const uint8_t* buffer, size_t len, InputEvent& event);
+
+class InputRecorder {
+  public:
+    InputRecorder();
+    bool record_setup(uint32_t timestamp_us, uint8_t button_levels);
+    bool record_control_step(uint32_t timestamp_us, uint8_t button_levels);
+    bool record_radio_frame(uint32_t timestamp_us, const uint8_t* data, int len);
+    size_t drain(SerialPort* serial);
+    uint32_t get_dropped() const;
+
+  private:
+    static uint32_t const CAPACITY = 32;
+
+    /**
+     * Struct for a single-producer, single-consumer ring of inputs
+     * 
+     * events:   queued inputs
+     * head:     inputs ever queued
+     * tail:     inputs ever taken
+     * sequence: sequence number of the next input
+     */
+    struct Ring {
+      InputEvent events[CAPACITY];
+      std::atomic<uint32_t> head;
+      std::atomic<uint32_t> tail;
+      uint16_t sequence;
+    };
+
+    Ring control_ring;
+    Ring radio_ring;
+    std::atomic<uint32_t> dropped;
+
+    bool record(Ring& ring, uint32_t timestamp_us, uint8_t type, const uint8_t* data, size_t len);
+};
+
+#endif
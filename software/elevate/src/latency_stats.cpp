@@ -0,0 +1,165 @@
+/**
+ * @file latency_stats.cpp
+ * 
+ * @brief allocation-free latency statistics
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#include "latency_stats.h"
+#include <math.h>
+
+/**
+ * Latency Stats constructor
+ * 
+ * @param bin_width histogram bin width in counter ticks
+ */
+LatencyStats::LatencyStats(uint32_t bin_width) {
+  set_bin_width(bin_width);
+}
+
+/**
+ * Clear all recorded latencies
+ */
+void LatencyStats::reset() {
+  count = 0;
+  minimum = UINT32_MAX;
+  maximum = 0;
+  sum = 0;
+  sum_of_squares = 0.0;
+  for (int i = 0; i < NUMBER_OF_BINS; i++) {
+    bins[i] = 0;
+  }
+  overflow = 0;
+}
+
+/**
+ * Change the histogram bin width, clearing all recorded latencies
+ * 
+ * @param bin_width histogram bin width in counter ticks
+ */
+void LatencyStats::set_bin_width(uint32_t bin_width) {
+  this->bin_width = (bin_width > 0) ? bin_width : 1;
+  reset();
+}
+
+/**
+ * Record one latency
+ * 
+ * @param latency latency in counter ticks
+ */
+void LatencyStats::record(uint32_t latency) {
+  count++;
+  if (latency < minimum) minimum = latency;
+  if (latency > maximum) maximum = latency;
+  sum += latency;
+  sum_of_squares += (double) latency * latency;
+  uint32_t bin = latency / bin_width;
+  if (bin < (uint32_t) NUMBER_OF_BINS) {
+    bins[bin]++;
+  } else {
+    overflow++;
+  }
+}
+
+/**
+ * Get number of recorded latencies
+ * 
+ * @return number of latencies
+ */
+uint32_t LatencyStats::get_count() const {
+  return count;
+}
+
+/**
+ * Get minimum latency
+ * 
+ * @return minimum latency in counter ticks
+ */
+uint32_t LatencyStats::get_minimum() const {
+  return (count > 0) ? minimum : 0;
+}
+
+/**
+ * Get maximum latency
+ * 
+ * @return maximum latency in counter ticks
+ */
+uint32_t LatencyStats::get_maximum() const {
+  return maximum;
+}
+
+/**
+ * Get mean latency
+ * 
+ * @return mean latency in counter ticks
+ */
+float LatencyStats::get_mean() const {
+  if (count == 0) return 0.0;
+  return (float) ((double) sum / count);
+}
+
+/**
+ * Get standard deviation of latency, used as the jitter figure
+ * 
+ * @return standard deviation in counter ticks
+ */
+float LatencyStats::get_standard_deviation() const {
+  if (count < 2) return 0.0;
+  double mean = (double) sum / count;
+  double variance = sum_of_squares / count - mean * mean;
+  return (variance > 0.0) ? (float) sqrt(variance) : 0.0;
+}
+
+/**
+ * Get a latency percentile
+ * 
+ * @param percentile percentile, 0-100
+ * 
+ * @return upper edge of the bin holding the percentile in counter ticks,
+ *         or the maximum if it falls past the last bin
+ */
+uint32_t LatencyStats::get_percentile(float percentile) const {
+  if (count == 0) return 0;
+  uint32_t target = (uint32_t) ceil(count * percentile / 100.0);
+  if (target == 0) target = 1;
+  uint32_t seen = 0;
+  for (int i = 0; i < NUMBER_OF_BINS; i++) {
+    seen += bins[i];
+    if (seen >= target) {
+      uint32_t edge = (i + 1) * bin_width;
+      return (edge < maximum) ? edge : maximum;
+    }
+  }
+  return maximum;
+}
+
+/**
+ * Get histogram bin width
+ * 
+ * @return bin width in counter ticks
+ */
+uint32_t LatencyStats::get_bin_width() const {
+  return bin_width;
+}
+
+/**
+ * Get histogram bin count
+ * 
+ * @param bin bin index
+ * 
+ * @return number of latencies in the bin
+ */
+uint32_t LatencyStats::get_bin(int bin) const {
+  if (bin < 0 || bin >= NUMBER_OF_BINS) return 0;
+  return bins[bin];
+}
+
+/**
+ * Get number of latencies past the last bin
+ * 
+ * @return number of latencies
+ */
+uint32_t LatencyStats::get_overflow() const {
+  return overflow;
+}
@@ -0,0 +1,43 @@
+/**
+ * @file latency_stats.h
+ * 
+ * @brief header file for allocation-free latency statistics
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#ifndef LATENCY_STATS_H_
+#define LATENCY_STATS_H_
+
+#include <stdint.h>
+
+class LatencyStats {
+  public:
+    static int const NUMBER_OF_BINS = 64;
+
+    LatencyStats(uint32_t bin_width);
+    void reset();
+    void set_bin_width(uint32_t bin_width);
+    void record(uint32_t latency);
+    uint32_t get_count() const;
+    uint32_t get_minimum() const;
+    uint32_t get_maximum() const;
+    float get_mean() const;
+    float get_standard_deviation() const;
+    uint32_t get_percentile(float percentile) const;
+    uint32_t get_bin_width() const;
+    uint32_t get_bin(int bin) const;
+    uint32_t get_overflow() const;
+
+  private:
+    uint32_t bin_width;
+    uint32_t count;
+    uint32_t minimum;
+    uint32_t maximum;
+    uint64_t sum;
+    double sum_of_squares;
+    uint32_t bins[NUMBER_OF_BINS];
+    uint32_t overflow;
+};
+
+#endif
@@ -0,0 +1,795 @@
+/**
+ * @file linux_hal.cpp
+ * 
+ * @brief Linux hardware abstraction layer backend
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#ifndef ARDUINO
+
+#include "linux_hal.h"
+#include <chrono>
+#include <string.h>
+#include <time.h>
+
+/**
+ * Read the monotonic clock
+ * 
+ * @return monotonic time in us
+ */
+static unsigned long long monotonic_micros() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (unsigned long long) now.tv_sec * 1000000ULL + now.tv_nsec / 1000;
+}
+
+/**
+ * Linux Clock constructor
+ */
+LinuxClock::LinuxClock() {
+  start_us = monotonic_micros();
+}
+
+/**
+ * Get milliseconds since construction
+ * 
+ * @return milliseconds since construction
+ */
+unsigned long LinuxClock::millis() const {
+  return (unsigned long) ((monotonic_micros() - start_us) / 1000);
+}
+
+/**
+ * Get microseconds since construction
+ * 
+ * @return microseconds since construction
+ */
+unsigned long LinuxClock::micros() const {
+  return (unsigned long) (monotonic_micros() - start_us);
+}
+
+/**
+ * Virtual Clock constructor
+ */
+VirtualClock::VirtualClock() {
+  time_us = 0;
+}
+
+/**
+ * Get virtual milliseconds
+ * 
+ * @return virtual milliseconds
+ */
+unsigned long VirtualClock::millis() const {
+  return (unsigned long) (time_us / 1000);
+}
+
+/**
+ * Get virtual microseconds
+ * 
+ * @return virtual microseconds
+ */
+unsigned long VirtualClock::micros() const {
+  return (unsigned long) time_us;
+}
+
+/**
+ * Set virtual time
+ * 
+ * @param time_us virtual time in us
+ */
+void VirtualClock::set_micros(unsigned long long time_us) {
+  this->time_us = time_us;
+}
+
+/**
+ * Advance virtual time
+ * 
+ * @param time_us time to advance in us
+ */
+void VirtualClock::advance_micros(unsigned long long time_us) {
+  this->time_us += time_us;
+}
+
+/**
+ * Linux Gpio constructor, inputs idle high as with pull-ups
+ */
+LinuxGpio::LinuxGpio() {
+  for (int i = 0; i < NUMBER_OF_PINS; i++) {
+    levels[i] = HAL_HIGH;
+    modes[i] = HAL_INPUT;
+  }
+  for (int i = 0; i < NUMBER_OF_BANKS; i++) {
+    bank_levels[i] = 0xffffffff;
+  }
+}
+
+/**
+ * Set the mode of a pin
+ * 
+ * @param pin  pin number
+ * @param mode pin mode
+ */
+void LinuxGpio::pin_mode(uint8_t pin, HalPinMode mode) {
+  modes[pin] = mode;
+}
+
+/**
+ * Read a digital pin
+ * 
+ * @param pin pin number
+ * 
+ * @return pin level
+ */
+uint8_t LinuxGpio::digital_read(uint8_t pin) const {
+  return levels[pin];
+}
+
+/**
+ * Write a digital pin
+ * 
+ * @param pin   pin number
+ * @param value pin level
+ */
+void LinuxGpio::digital_write(uint8_t pin, uint8_t value) {
+  set_level(pin, value);
+}
+
+/**
+ * Read the levels of a bank of pins at once
+ * 
+ * @param bank bank number, pins HAL_PINS_PER_BANK * bank and up
+ * 
+ * @return pin levels, pin n in bit n % HAL_PINS_PER_BANK
+ */
+uint32_t LinuxGpio::read_bank(uint8_t bank) const {
+  return (bank < NUMBER_OF_BANKS) ? bank_levels[bank] : 0;
+}
+
+/**
+ * Drive an input pin from outside
+ * 
+ * @param pin   pin number
+ * @param value pin level
+ */
+void LinuxGpio::set_input(uint8_t pin, uint8_t value) {
+  set_level(pin, value);
+}
+
+/**
+ * Get the mode of a pin
+ * 
+ * @param pin pin number
+ * 
+ * @return pin mode
+ */
+HalPinMode LinuxGpio::get_mode(uint8_t pin) const {
+  return modes[pin];
+}
+
+/**
+ * Set the level of a pin, keeping its bank in step for read_bank()
+ * 
+ * @param pin   pin number
+ * @param value pin level
+ */
+void LinuxGpio::set_level(uint8_t pin, uint8_t value) {
+  levels[pin] = value;
+  uint32_t bit = (uint32_t) 1 << (pin % HAL_PINS_PER_BANK);
+  if (value == HAL_HIGH) {
+    bank_levels[pin / HAL_PINS_PER_BANK] |= bit;
+  } else {
+    bank_levels[pin / HAL_PINS_PER_BANK] &= ~bit;
+  }
+}
+
+/**
+ * Linux Pwm constructor
+ */
+LinuxPwm::LinuxPwm() {
+  for (int i = 0; i < NUMBER_OF_CHANNELS; i++) {
+    frequencies[i] = 0;
+    resolution_bits[i] = 0;
+    duties[i] = 0;
+  }
+}
+
+/**
+ * Set up a pwm channel
+ * 
+ * @param channel         pwm channel
+ * @param frequency       pwm frequency in Hz
+ * @param resolution_bits duty resolution in bits
+ */
+void LinuxPwm::setup(uint8_t channel, uint32_t frequency, uint8_t resolution_bits) {
+  if (channel >= NUMBER_OF_CHANNELS) return;
+  frequencies[channel] = frequency;
+  this->resolution_bits[channel] = resolution_bits;
+}
+
+/**
+ * Attach a pin to a pwm channel
+ * 
+ * @param pin     pwm pin
+ * @param channel pwm channel
+ */
+void LinuxPwm::attach_pin(uint8_t pin, uint8_t channel) {}
+
+/**
+ * Write a pwm duty
+ * 
+ * @param channel pwm channel
+ * @param duty    duty in channel resolution
+ */
+void LinuxPwm::write(uint8_t channel, uint32_t duty) {
+  if (channel >= NUMBER_OF_CHANNELS) return;
+  duties[channel] = duty;
+}
+
+/**
+ * Get the duty of a pwm channel
+ * 
+ * @param channel pwm channel
+ * 
+ * @return duty in channel resolution
+ */
+uint32_t LinuxPwm::get_duty(uint8_t channel) const {
+  if (channel >= NUMBER_OF_CHANNELS) return 0;
+  return duties[channel];
+}
+
+/**
+ * Get the resolution of a pwm channel
+ * 
+ * @param channel pwm channel
+ * 
+ * @return duty resolution in bits
+ */
+uint8_t LinuxPwm::get_resolution_bits(uint8_t channel) const {
+  if (channel >= NUMBER_OF_CHANNELS) return 0;
+  return resolution_bits[channel];
+}
+
+/**
+ * Linux Radio constructor
+ */
+LinuxRadio::LinuxRadio() {
+  is_started = false;
+  callback = 0;
+}
+
+/**
+ * Start the radio
+ * 
+ * @return if radio started
+ */
+bool LinuxRadio::begin() {
+  is_started = true;
+  return true;
+}
+
+/**
+ * Add a peer
+ * 
+ * @param mac_address peer address
+ * @param channel     Wi-Fi channel
+ * 
+ * @return if peer was added
+ */
+bool LinuxRadio::add_peer(const uint8_t* mac_address, uint8_t channel) {
+  return is_started;
+}
+
+/**
+ * Register callback for received frames
+ * 
+ * @param callback receive callback
+ */
+void LinuxRadio::set_receive_callback(ReceiveCallback callback) {
+  this->callback = callback;
+}
+
+/**
+ * Record a sent frame
+ * 
+ * @param mac_address peer address
+ * @param data        frame payload
+ * @param len         payload length in bytes
+ * 
+ * @return if frame was recorded
+ */
+bool LinuxRadio::send(const uint8_t* mac_address, const uint8_t* data, size_t len) {
+  if (!is_started) return false;
+  sent.push_back(std::vector<uint8_t>(data, data + len));
+  return true;
+}
+
+/**
+ * Deliver a frame to the receive callback
+ * 
+ * @param mac_address sender address
+ * @param data        frame payload
+ * @param len         payload length in bytes
+ */
+void LinuxRadio::receive(const uint8_t* mac_address, const uint8_t* data, int len) {
+  if (is_started && callback) callback(mac_address, data, len);
+}
+
+/**
+ * Get frames sent since last clear
+ * 
+ * @return sent frames
+ */
+std::vector<std::vector<uint8_t> > const& LinuxRadio::get_sent() const {
+  return sent;
+}
+
+/**
+ * Clear recorded frames
+ */
+void LinuxRadio::clear_sent() {
+  sent.clear();
+}
+
+/**
+ * Linux I2c constructor
+ */
+LinuxI2c::LinuxI2c() {
+  is_started = false;
+  frequency = 0;
+  for (int i = 0; i < NUMBER_OF_ADDRESSES; i++) {
+    devices[i] = 0;
+  }
+  deferred = false;
+  failures_remaining = 0;
+  is_pending = false;
+  pending_device_address = 0;
+  pending_register_address = 0;
+  pending_data = 0;
+  pending_len = 0;
+  pending_callback = 0;
+  pending_context = 0;
+}
+
+/**
+ * Start the I2C bus
+ * 
+ * @param sda_pin   data pin
+ * @param scl_pin   clock pin
+ * @param frequency bus frequency in Hz
+ * 
+ * @return if bus started
+ */
+bool LinuxI2c::begin(int sda_pin, int scl_pin, uint32_t frequency) {
+  this->frequency = frequency;
+  is_started = true;
+  return true;
+}
+
+/**
+ * Read consecutive registers from an attached device
+ * 
+ * @param device_address   device address
+ * @param register_address first register to read
+ * @param data             buffer for register contents
+ * @param len              number of bytes to read
+ * @param timeout_ms       time to wait for data in ms
+ * 
+ * @return if all bytes were read
+ */
+bool LinuxI2c::read(
+    uint8_t device_address,
+    uint8_t register_address,
+    uint8_t* data,
+    size_t len,
+    unsigned long timeout_ms) {
+  if (!is_started || device_address >= NUMBER_OF_ADDRESSES) return false;
+  if (failures_remaining > 0) {
+    failures_remaining--;
+    return false;
+  }
+  I2cDevice* device = devices[device_address];
+  if (!device) return false;
+  return device->read(register_address, data, len);
+}
+
+/**
+ * Start a read of consecutive registers, finished at once or, if deferred,
+ * by complete_transfer()
+ * 
+ * @param device_address   device address
+ * @param register_address first register to read
+ * @param data             buffer for register contents
+ * @param len              number of bytes to read
+ * @param timeout_ms       time to wait for data in ms
+ * @param callback         called when the read finishes or fails
+ * @param context          pointer passed to the callback
+ * 
+ * @return if the read was started; false if the bus is stopped or busy
+ */
+bool LinuxI2c::read_async(
+    uint8_t device_address,
+    uint8_t register_address,
+    uint8_t* data,
+    size_t len,
+    unsigned long timeout_ms,
+    I2cCallback callback,
+    void* context) {
+  if (!is_started || is_pending) return false;
+  is_pending = true;
+  pending_device_address = device_address;
+  pending_register_address = register_address;
+  pending_data = data;
+  pending_len = len;
+  pending_callback = callback;
+  pending_context = context;
+  if (!deferred) complete_transfer();
+  return true;
+}
+
+/**
+ * Attach a simulated device to the bus
+ * 
+ * @param device_address device address
+ * @param device         simulated device
+ */
+void LinuxI2c::attach(uint8_t device_address, I2cDevice* device) {
+  if (device_address < NUMBER_OF_ADDRESSES) devices[device_address] = device;
+}
+
+/**
+ * Get the bus frequency
+ * 
+ * @return bus frequency in Hz
+ */
+uint32_t LinuxI2c::get_frequency() const {
+  return frequency;
+}
+
+/**
+ * Choose whether asynchronous reads wait for complete_transfer()
+ * 
+ * @param deferred whether reads stay in flight until completed by hand
+ */
+void LinuxI2c::set_deferred(bool deferred) {
+  this->deferred = deferred;
+}
+
+/**
+ * Finish the read in flight and run its callback
+ * 
+ * @return if a read was in flight
+ */
+bool LinuxI2c::complete_transfer() {
+  if (!is_pending) return false;
+  bool success = read(pending_device_address, pending_register_address, pending_data, pending_len, 0);
+  is_pending = false;
+  pending_callback(pending_context, success);
+  return true;
+}
+
+/**
+ * Check if an asynchronous read is in flight
+ * 
+ * @return if a read is in flight
+ */
+bool LinuxI2c::is_transfer_pending() const {
+  return is_pending;
+}
+
+/**
+ * Make the next reads fail as a bus error would
+ * 
+ * @param count number of reads to fail
+ */
+void LinuxI2c::fail_transfers(int count) {
+  failures_remaining = count;
+}
+
+/**
+ * Linux Periodic Timer constructor
+ * 
+ * @param simulated_tick whether ticks come from tick() instead of real time
+ */
+LinuxPeriodicTimer::LinuxPeriodicTimer(bool simulated_tick) : SIMULATED_TICK(simulated_tick) {
+  is_running = false;
+  period_us = 0;
+  callback = 0;
+  context = 0;
+  requested_ticks = 0;
+  completed_ticks = 0;
+}
+
+/**
+ * Linux Periodic Timer destructor
+ */
+LinuxPeriodicTimer::~LinuxPeriodicTimer() {
+  stop();
+}
+
+/**
+ * Start calling back at a fixed rate from a dedicated thread
+ * 
+ * @param period_us tick period in us
+ * @param callback  tick callback
+ * @param context   pointer passed to the callback
+ * 
+ * @return if the timer started
+ */
+bool LinuxPeriodicTimer::start(unsigned long period_us, TickCallback callback, void* context) {
+  if (is_running || period_us == 0) return false;
+  this->period_us = period_us;
+  this->callback = callback;
+  this->context = context;
+  requested_ticks = 0;
+  completed_ticks = 0;
+  is_running = true;
+  thread = std::thread(&LinuxPeriodicTimer::thread_main, this);
+  return true;
+}
+
+/**
+ * Stop the timer and join its thread
+ */
+void LinuxPeriodicTimer::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!is_running) return;
+    is_running = false;
+  }
+  condition.notify_all();
+  thread.join();
+}
+
+/**
+ * Run one simulated tick on the timer thread and wait for it to finish
+ */
+void LinuxPeriodicTimer::tick() {
+  if (!SIMULATED_TICK) return;
+  std::unique_lock<std::mutex> lock(mutex);
+  if (!is_running) return;
+  unsigned long long tick = ++requested_ticks;
+  condition.notify_all();
+  condition.wait(lock, [this, tick] { return completed_ticks >= tick || !is_running; });
+}
+
+/**
+ * Timer thread, runs the callback on real time deadlines or simulated ticks
+ */
+void LinuxPeriodicTimer::thread_main() {
+  std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now();
+  std::unique_lock<std::mutex> lock(mutex);
+  while (is_running) {
+    if (SIMULATED_TICK) {
+      condition.wait(lock, [this] { return requested_ticks > completed_ticks || !is_running; });
+      if (!is_running) break;
+    } else {
+      deadline += std::chrono::microseconds(period_us);
+      if (condition.wait_until(lock, deadline, [this] { return !is_running; })) break;
+    }
+    lock.unlock();
+    callback(context);
+    lock.lock();
+    if (SIMULATED_TICK) {
+      completed_ticks++;
+      condition.notify_all();
+    }
+  }
+}
+
+/**
+ * Read a value from storage
+ * 
+ * @param key  key
+ * @param data buffer for the value
+ * @param len  value length in bytes
+ * 
+ * @return if a value of exactly len bytes was stored under the key
+ */
+bool LinuxStorage::read(const char* key, void* data, size_t len) {
+  std::map<std::string, std::vector<uint8_t> >::const_iterator value = values.find(key);
+  if (value == values.end() || value->second.size() != len) return false;
+  memcpy(data, value->second.data(), len);
+  return true;
+}
+
+/**
+ * Write a value to storage
+ * 
+ * @param key  key
+ * @param data value
+ * @param len  value length in bytes
+ * 
+ * @return if the value was written
+ */
+bool LinuxStorage::write(const char* key, const void* data, size_t len) {
+  const uint8_t* bytes = (const uint8_t*) data;
+  values[key] = std::vector<uint8_t>(bytes, bytes + len);
+  return true;
+}
+
+/**
+ * Forget every stored value, like erasing flash
+ */
+void LinuxStorage::clear() {
+  values.clear();
+}
+
+/**
+ * Linux Serial Port constructor, keeps written bytes in memory
+ */
+LinuxSerialPort::LinuxSerialPort() {
+  output = 0;
+}
+
+/**
+ * Start the serial port, the baud rate has no effect
+ * 
+ * @param baud_rate baud rate
+ * 
+ * @return true
+ */
+bool LinuxSerialPort::begin(unsigned long baud_rate) {
+  return true;
+}
+
+/**
+ * Get how many bytes can be written without blocking, which is any number
+ * 
+ * @return free space in bytes
+ */
+size_t LinuxSerialPort::available_for_write() {
+  return SIZE_MAX;
+}
+
+/**
+ * Write bytes to the output file, or keep them in memory without one
+ * 
+ * @param data bytes to write
+ * @param len  number of bytes
+ * 
+ * @return number of bytes written
+ */
+size_t LinuxSerialPort::write(const uint8_t* data, size_t len) {
+  if (output) return fwrite(data, 1, len, output);
+  written.insert(written.end(), data, data + len);
+  return len;
+}
+
+/**
+ * Send written bytes to a file instead of memory
+ * 
+ * @param output open file, or null to keep bytes in memory
+ */
+void LinuxSerialPort::set_output(FILE* output) {
+  this->output = output;
+}
+
+/**
+ * Get the bytes written while there was no output file
+ * 
+ * @return written bytes, oldest first
+ */
+std::vector<uint8_t> const& LinuxSerialPort::get_written() const {
+  return written;
+}
+
+/**
+ * Forget the bytes kept in memory
+ */
+void LinuxSerialPort::clear() {
+  written.clear();
+}
+
+/**
+ * Linux Power constructor
+ * 
+ * @param clock clock that times sleeps
+ * @param gpio  pins that can wake a sleep
+ */
+LinuxPower::LinuxPower(Clock const* clock, Gpio const* gpio) : CLOCK(clock), GPIO(gpio) {
+  number_of_wake_pins = 0;
+  is_timer_wake = false;
+  wake_after_us = 0;
+  awake_per_wake_us = 0;
+  is_sleeping = false;
+  sleep_start_us = 0;
+  asleep_us = 0;
+  sleeps = 0;
+}
+
+/**
+ * Wake the next light sleep when a pin reaches a level
+ * 
+ * @param pin   input pin
+ * @param level level that wakes, HAL_LOW or HAL_HIGH
+ */
+void LinuxPower::enable_pin_wake(uint8_t pin, uint8_t level) {
+  if (number_of_wake_pins >= MAXIMUM_WAKE_PINS) return;
+  wake_pins[number_of_wake_pins] = pin;
+  wake_levels[number_of_wake_pins] = level;
+  number_of_wake_pins++;
+}
+
+/**
+ * Wake the next light sleep after a time
+ * 
+ * @param sleep_us longest sleep in us
+ */
+void LinuxPower::enable_timer_wake(unsigned long sleep_us) {
+  is_timer_wake = true;
+  wake_after_us = sleep_us;
+}
+
+/**
+ * Start a light sleep; unlike on the ESP32 this returns at once, and the
+ * host stops running the device until update() finds a wake source fired
+ */
+void LinuxPower::light_sleep() {
+  is_sleeping = true;
+  sleep_start_us = CLOCK->micros() + awake_per_wake_us;
+  sleeps++;
+}
+
+/**
+ * Wake if an enabled wake source has fired, clearing every wake source, as
+ * often as the host wants wake sources checked
+ * 
+ * @return if the device is awake
+ */
+bool LinuxPower::update() {
+  if (!is_sleeping) return true;
+  long slept_us = (long) (CLOCK->micros() - sleep_start_us);
+  bool is_woken = is_timer_wake && slept_us >= (long) wake_after_us;
+  for (int i = 0; i < number_of_wake_pins && !is_woken; i++) {
+    is_woken = GPIO->digital_read(wake_pins[i]) == wake_levels[i];
+  }
+  if (!is_woken) return false;
+  if (slept_us > 0) asleep_us += slept_us;
+  number_of_wake_pins = 0;
+  is_timer_wake = false;
+  is_sleeping = false;
+  return true;
+}
+
+/**
+ * Charge every wake a time awake that the host runs in no time, waking up
+ * and working before the next light_sleep(); each sleep starts that much
+ * later
+ * 
+ * @param awake_us time awake per wake in us
+ */
+void LinuxPower::set_awake_per_wake(unsigned long awake_us) {
+  awake_per_wake_us = awake_us;
+}
+
+/**
+ * Determine if the device is in light sleep
+ * 
+ * @return if the device is asleep
+ */
+bool LinuxPower::is_asleep() const {
+  return is_sleeping;
+}
+
+/**
+ * Get total time spent in light sleep, including a sleep still going on
+ * 
+ * @return time asleep in us
+ */
+unsigned long LinuxPower::get_asleep_us() const {
+  long slept_us = is_sleeping ? (long) (CLOCK->micros() - sleep_start_us) : 0;
+  return (slept_us > 0) ? asleep_us + slept_us : asleep_us;
+}
+
+/**
+ * Get number of light sleeps started
+ * 
+ * @return number of sleeps
+ */
+unsigned long LinuxPower::get_sleeps() const {
+  return sleeps;
+}
+
+#endif
@@ -0,0 +1,170 @@
+/**
+ * @file minion_receiver.cpp
+ * 
+ * @brief master side minion frame receiver
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#include "minion_receiver.h"
+
+/**
+ * Minion Receiver constructor
+ * 
+ * @param hal               hardware abstraction layer
+ * @param modules           pointer to array of modules, indexed by minion ID
+ * @param number_of_modules number of modules in system
+ */
+MinionReceiver::MinionReceiver(Hal* hal, ElevateModule* modules, int number_of_modules) :
+HAL(hal),
+MODULES(modules),
+NUMBER_OF_MODULES(number_of_modules < MAXIMUM_NUMBER_OF_MODULES ? number_of_modules : MAXIMUM_NUMBER_OF_MODULES) {
+  for (int i = 0; i < MAXIMUM_NUMBER_OF_MODULES; i++) {
+    link_stats[i].received = 0;
+    link_stats[i].samples = 0;
+    link_stats[i].lost = 0;
+    link_stats[i].stale = 0;
+    link_stats[i].dropped = 0;
+    link_stats[i].sync_replies = 0;
+    link_stats[i].last_sequence = 0;
+    link_stats[i].last_timestamp_us = 0;
+    link_stats[i].last_receive_us = 0;
+    has_queued_reply[i].store(false, std::memory_order_relaxed);
+  }
+  rejected = 0;
+}
+
+/**
+ * Receive one frame from a minion, called from the radio callback. Sequence
+ * numbers count lost frames and drop stale ones, and every sample of a batch
+ * is posted to its module in order without blocking the control task.
+ * 
+ * @param data frame
+ * @param len  frame length in bytes
+ * 
+ * @return receive status
+ */
+MinionMessageStatus MinionReceiver::receive(const uint8_t* data, int len) {
+  unsigned long receive_us = HAL->clock->micros();
+  MinionMessageType type;
+  MinionMessageStatus status = (len > 0) ?
+    peek_minion_message_type(data, (size_t) len, type) :
+    MINION_MESSAGE_TOO_SHORT;
+  if (status == MINION_MESSAGE_OK && type == MINION_SYNC_REQUEST) {
+    return queue_sync_reply(data, (size_t) len, receive_us);
+  }
+
+  MinionBatch batch;
+  if (status == MINION_MESSAGE_OK) {
+    status = decode_minion_batch(data, (size_t) len, batch);
+  }
+  if (status == MINION_MESSAGE_OK && batch.id >= NUMBER_OF_MODULES) {
+    status = MINION_MESSAGE_BAD_ID;
+  }
+  if (status != MINION_MESSAGE_OK) {
+    rejected++;
+    return status;
+  }
+
+  MinionLinkStats& link = link_stats[batch.id];
+  if (link.received > 0) {
+    uint16_t gap = (uint16_t) (batch.sequence - link.last_sequence);
+    if (gap == 0 || gap >= 0x8000) {
+      link.stale++;
+      return MINION_MESSAGE_STALE;
+    }
+    link.lost += gap - 1;
+  }
+  link.received++;
+  link.samples += batch.count;
+  link.last_sequence = batch.sequence;
+  link.last_timestamp_us = batch.samples[batch.count - 1].timestamp_us;
+  link.last_receive_us = receive_us;
+
+  ElevateModule& module = MODULES[batch.id];
+  for (uint8_t i = 0; i < batch.count; i++) {
+    MinionSample const& minion_sample = batch.samples[i];
+    ModuleSample sample;
+    sample.height = minion_sample.height;
+    sample.lower_limit_switch_pressed = (minion_sample.status & MINION_LOWER_LIMIT_BIT) != 0;
+    sample.upper_limit_switch_pressed = (minion_sample.status & MINION_UPPER_LIMIT_BIT) != 0;
+    sample.encoder_stale = (minion_sample.status & MINION_ENCODER_STALE_BIT) != 0;
+    sample.velocity = minion_sample.velocity;
+    sample.acceleration = minion_sample.acceleration * MINION_ACCELERATION_SCALE;
+    sample.clock_synced = (minion_sample.status & MINION_CLOCK_SYNCED_BIT) != 0;
+    sample.timestamp_us = minion_sample.timestamp_us;
+    sample.receive_us = receive_us;
+    if (!module.post_sample(sample)) link.dropped++;
+  }
+  return MINION_MESSAGE_OK;
+}
+
+/**
+ * Queue the reply to a clock sync request from a minion. The reply is not
+ * sent here because the radio callback must not send; a request that
+ * arrives while the previous reply to its minion is still queued is dropped,
+ * and the minion asks again on its next sync.
+ * 
+ * @param data       request frame
+ * @param len        request frame length in bytes
+ * @param receive_us master clock when the request arrived in us
+ * 
+ * @return receive status
+ */
+MinionMessageStatus MinionReceiver::queue_sync_reply(const uint8_t* data, size_t len, unsigned long receive_us) {
+  MinionSyncRequest request;
+  MinionMessageStatus status = decode_minion_sync_request(data, len, request);
+  if (status == MINION_MESSAGE_OK && request.id >= NUMBER_OF_MODULES) {
+    status = MINION_MESSAGE_BAD_ID;
+  }
+  if (status != MINION_MESSAGE_OK) {
+    rejected++;
+    return status;
+  }
+
+  if (has_queued_reply[request.id].load(std::memory_order_acquire)) return MINION_MESSAGE_OK;
+  MinionSyncReply& reply = queued_replies[request.id];
+  reply.id = request.id;
+  reply.minion_send_us = request.minion_send_us;
+  reply.master_receive_us = (uint32_t) receive_us;
+  has_queued_reply[request.id].store(true, std::memory_order_release);
+  return MINION_MESSAGE_OK;
+}
+
+/**
+ * Send every queued clock sync reply, stamped with the master send time,
+ * called from the control task rather than the radio callback
+ */
+void MinionReceiver::send_sync_replies() {
+  for (int i = 0; i < NUMBER_OF_MODULES; i++) {
+    if (!has_queued_reply[i].load(std::memory_order_acquire)) continue;
+    MinionSyncReply reply = queued_replies[i];
+    has_queued_reply[i].store(false, std::memory_order_release);
+    reply.master_send_us = (uint32_t) HAL->clock->micros();
+    uint8_t frame[MINION_SYNC_REPLY_FRAME_SIZE];
+    size_t frame_len = encode_minion_sync_reply(reply, frame, sizeof(frame));
+    if (HAL->radio->send(MINION_BROADCAST_ADDRESS, frame, frame_len)) {
+      link_stats[i].sync_replies++;
+    }
+  }
+}
+
+/**
+ * Get link statistics of one minion
+ * 
+ * @param module minion ID
+ * 
+ * @return link statistics
+ */
+MinionLinkStats const& MinionReceiver::get_link_stats(int module) const {
+  return link_stats[module];
+}
+
+/**
+ * Get number of frames rejected before reaching a module
+ * 
+ * @return number of rejected frames
+ */
+uint32_t MinionReceiver::get_rejected() const {
+  return rejected;
+}
@@ -0,0 +1,66 @@
+/**
+ * @file minion_receiver.h
+ * 
+ * @brief header file for master side minion frame receiver
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#ifndef MINION_RECEIVER_H_
+#define MINION_RECEIVER_H_
+
+#include "elevate_module.h"
+#include "hal.h"
+#include "minion_protocol.h"
+#include <atomic>
+#include <stdint.h>
+
+/**
+ * Struct for link statistics of one minion
+ * 
+ * received:          accepted frames
+ * samples:           samples in accepted frames
+ * lost:              frames skipped in the sequence
+ * stale:             repeated or out-of-order frames dropped
+ * dropped:           unread samples overwritten in a module that fell behind
+ * sync_replies:      clock sync requests answered
+ * last_sequence:     sequence number of the newest accepted frame
+ * last_timestamp_us: minion timestamp of the newest accepted sample in us
+ * last_receive_us:   master clock when the newest frame arrived in us
+ */
+struct MinionLinkStats {
+  uint32_t received;
+  uint32_t samples;
+  uint32_t lost;
+  uint32_t stale;
+  uint32_t dropped;
+  uint32_t sync_replies;
+  uint16_t last_sequence;
+  uint32_t last_timestamp_us;
+  unsigned long last_receive_us;
+};
+
+class MinionReceiver {
+  public:
+    MinionReceiver(Hal* hal, ElevateModule* modules, int number_of_modules);
+    MinionMessageStatus receive(const uint8_t* data, int len);
+    void send_sync_replies();
+    MinionLinkStats const& get_link_stats(int module) const;
+    uint32_t get_rejected() const;
+
+  private:
+    static int const MAXIMUM_NUMBER_OF_MODULES = 16;
+
+    Hal* const HAL;
+    ElevateModule* const MODULES;
+    int const NUMBER_OF_MODULES;
+
+    MinionLinkStats link_stats[MAXIMUM_NUMBER_OF_MODULES];
+    uint32_t rejected;
+    MinionSyncReply queued_replies[MAXIMUM_NUMBER_OF_MODULES];
+    std::atomic<bool> has_queued_reply[MAXIMUM_NUMBER_OF_MODULES];
+
+    MinionMessageStatus queue_sync_reply(const uint8_t* data, size_t len, unsigned long receive_us);
+};
+
+#endif
@@ -7,36 +7,42 @@
  * Contact: jonlee27@seas.upenn.edu
  */
 #include "pid_controller.h"
-#include <Arduino.h>
+
+/**
+ * Clamp a value to a range
+ * 
+ * @param value   value to clamp
+ * @param minimum lower bound
+ * @param maximum upper bound
+ * 
+ * @return clamped value
+ */
+template <typename T>
+static T clamp(T value, T minimum, T maximum) {
+  if (value > maximum) return maximum;
+  if (value < minimum) return minimum;
+  return value;
+}
 
 /**
  * PID Controller constructor
  * 
- * @param kp             proportional coefficient
- * @param ki             integral coefficient
- * @param kd             derivative coefficient
- * @param pid_rate_ms    sample time in ms
- * @param minimum_output minimum output value
- * @param maximum_output maximum output value
+ * @param clock       time source
+ * @param tuning      gains and output limits
+ * @param pid_rate_ms sample time in ms
  */
-PIDController::PIDController(
-    float kp,
-    float ki,
-    float kd,
-    unsigned long pid_rate_ms,
-    int minimum_output,
-    int maximum_output) :
-    KP(kp),
-    KI(ki),
-    KD(kd),
-    PID_RATE_MS(pid_rate_ms),
-    MINIMUM_OUTPUT(minimum_output),
-    MAXIMUM_OUTPUT(maximum_output) {
+template <typename T>
+PIDController<T>::PIDController(Clock* clock, PIDTuning const& tuning, unsigned long pid_rate_ms) :
+CLOCK(clock) {
+  this->pid_rate_ms = pid_rate_ms;
+  set_tuning(tuning);
   mode = OFF;
-  previous_time = millis();
-  integral_term = 0.0;
+  is_primed = false;
+  previous_time = CLOCK->millis();
+  integral_term = T();
+  derivative_term = T();
   previous_input = 0;
-  previous_output = 0;
+  previous_output = T();
 }
 
 /**
@@ -44,7 +50,8 @@ PIDController::PIDController(
  * 
  * @param mode mode to set PID controller to
  */
-void PIDController::set_mode(Mode mode) {
+template <typename T>
+void PIDController<T>::set_mode(Mode mode) {
   if (mode == ON && this->mode == OFF) {
     start();
   }
@@ -52,46 +59,160 @@ void PIDController::set_mode(Mode mode) {
 }
 
 /**
- * Use PID controller to calculate output
+ * Change gains and limits, taking effect from the next sample
  * 
- * @param setpoint setpoint value
- * @param input    input value
+ * @param tuning gains and output limits
+ */
+template <typename T>
+void PIDController<T>::set_tuning(PIDTuning const& tuning) {
+  this->tuning = tuning;
+  minimum_output = T((long) tuning.minimum_output);
+  maximum_output = T((long) tuning.maximum_output);
+  fixed_rate = get_coefficients(tuning, pid_rate_ms / 1000.0f);
+}
+
+/**
+ * Change the sample time of the clocked control, taking effect from the next
+ * sample
+ * 
+ * @param pid_rate_ms sample time in ms
+ */
+template <typename T>
+void PIDController<T>::set_rate(unsigned long pid_rate_ms) {
+  this->pid_rate_ms = pid_rate_ms;
+  fixed_rate = get_coefficients(tuning, pid_rate_ms / 1000.0f);
+}
+
+/**
+ * Get gains and limits
+ * 
+ * @return tuning in use
+ */
+template <typename T>
+PIDTuning const& PIDController<T>::get_tuning() const {
+  return tuning;
+}
+
+/**
+ * Use PID controller to calculate output, sampling once per PID rate with
+ * the precomputed coefficients and holding the output in between
+ * 
+ * @param setpoint    setpoint value
+ * @param input       input value
+ * @param feedforward output added ahead of the limits
  * 
  * @return output of PID controller
  */
-int PIDController::control(long setpoint, long input) {
-  if (mode == OFF) return previous_output;
-
-  unsigned long current_time = millis();
-  if ((current_time - previous_time) >= PID_RATE_MS) {
-    long error = setpoint - input;
-    integral_term += KI * error;
-    if (integral_term > MAXIMUM_OUTPUT) {
-      integral_term = MAXIMUM_OUTPUT;
-    } else if (integral_term < MINIMUM_OUTPUT) {
-      integral_term < MINIMUM_OUTPUT;
-    }
-    long input_derivative = input - previous_input;
-
-    int output = (int) (KP * error + integral_term - KD * input_derivative);
-    if (output > MAXIMUM_OUTPUT) {
-      output = MAXIMUM_OUTPUT;
-    } else if (output < MINIMUM_OUTPUT) {
-      output = MINIMUM_OUTPUT;
-    }
+template <typename T>
+int PIDController<T>::control(long setpoint, long input, int feedforward) {
+  if (mode == OFF) return (int) to_long(previous_output);
 
+  unsigned long current_time = CLOCK->millis();
+  if ((current_time - previous_time) >= pid_rate_ms) {
     previous_time = current_time;
+    return step(setpoint, input, feedforward, fixed_rate);
+  }
+
+  return (int) to_long(previous_output);
+}
+
+/**
+ * Use PID controller to calculate output for a sample time chosen by the
+ * caller, working the coefficients out on every call
+ * 
+ * @param setpoint    setpoint value
+ * @param input       input value
+ * @param feedforward output added ahead of the limits
+ * @param dt          time since the last sample in s
+ * 
+ * @return output of PID controller
+ */
+template <typename T>
+int PIDController<T>::control(long setpoint, long input, int feedforward, float dt) {
+  if (mode == OFF || dt <= 0.0f) return (int) to_long(previous_output);
+  return step(setpoint, input, feedforward, get_coefficients(tuning, dt));
+}
+
+/**
+ * Convert the continuous tuning to per-sample coefficients, worked out once
+ * per sample time so a sample costs a handful of multiply-adds in T
+ * 
+ * The derivative filter is discretized with a backward difference. With no
+ * integral action there is nothing to unwind, so back-calculation is off.
+ * 
+ * @param tuning gains and output limits
+ * @param dt     sample time in s
+ * 
+ * @return coefficients for the sample time
+ */
+template <typename T>
+typename PIDController<T>::Coefficients PIDController<T>::get_coefficients(PIDTuning const& tuning, float dt) {
+  float filter_time = tuning.derivative_filter_ms / 1000.0f;
+  float output_step = (tuning.output_rate > 0.0f) ?
+    tuning.output_rate * dt :
+    (float) tuning.maximum_output - tuning.minimum_output;
+
+  Coefficients coefficients;
+  coefficients.kp = T(tuning.kp);
+  coefficients.ki = T(tuning.ki * dt);
+  coefficients.kt = T((tuning.ki == 0.0f) ? 0.0f : tuning.kt * dt);
+  coefficients.derivative_decay = T(filter_time / (filter_time + dt));
+  coefficients.derivative_gain = T(tuning.kd / (filter_time + dt));
+  coefficients.output_step = T(output_step);
+  return coefficients;
+}
+
+/**
+ * Run one sample of the controller. The derivative acts on the input so
+ * setpoint steps do not kick the output, and is low-pass filtered so encoder
+ * quantization does not reach the motor as noise. The integral is wound back
+ * by the difference between the limited and unlimited output, so it never
+ * charges up while the motor is saturated.
+ * 
+ * @param setpoint     setpoint value
+ * @param input        input value
+ * @param feedforward  output added ahead of the limits
+ * @param coefficients per-sample coefficients
+ * 
+ * @return output of PID controller
+ */
+template <typename T>
+int PIDController<T>::step(long setpoint, long input, int feedforward, Coefficients const& coefficients) {
+  if (!is_primed) {
     previous_input = input;
-    previous_output = output;
-    return output;
+    is_primed = true;
   }
-  
-  return previous_output;
+  T error = T(setpoint - input);
+  T input_change = T(input - previous_input);
+  derivative_term = coefficients.derivative_decay * derivative_term - coefficients.derivative_gain * input_change;
+
+  T unlimited_output = coefficients.kp * error + integral_term + derivative_term + T((long) feedforward);
+  T output = clamp(
+    unlimited_output,
+    previous_output - coefficients.output_step,
+    previous_output + coefficients.output_step
+  );
+  output = clamp(output, minimum_output, maximum_output);
+
+  integral_term += coefficients.ki * error + coefficients.kt * (output - unlimited_output);
+  integral_term = clamp(integral_term, minimum_output, maximum_output);
+
+  previous_input = input;
+  previous_output = output;
+  return (int) to_long(output);
 }
 
 /**
- * Start PID controller when turned ON
+ * Start PID controller when turned ON, from rest
  */
-void PIDController::start() {
-  integral_term = 0.0;
+template <typename T>
+void PIDController<T>::start() {
+  is_primed = false;
+  integral_term = T();
+  derivative_term = T();
+  previous_output = T();
 }
+
+// Pick the faster one for the target with elevate_bench or BENCHMARK_PID
+template class PIDController<float>;
+template class PIDController<Q16>;
@@ -9,6 +9,9 @@
 #ifndef PID_CONTROLLER_H_
 #define PID_CONTROLLER_H_
 
+#include "fixed_point.h"
+#include "hal.h"
+
 /**
  * Mode for PID controller
  * 
@@ -20,30 +23,84 @@ enum Mode {
   OFF
 };
 
+/**
+ * PID controller tuning, gains in continuous time so they hold at any
+ * sample time
+ * 
+ * kp:                   proportional gain in output per unit of error
+ * ki:                   integral gain in output per unit of error per s
+ * kd:                   derivative gain in output s per unit of error
+ * kt:                   back-calculation gain per s, how fast the integral
+ *                       unwinds while the output is limited
+ * derivative_filter_ms: time constant of the low-pass on the derivative in
+ *                       ms, 0 for none
+ * output_rate:          largest change of output per s, 0 for no limit
+ * minimum_output:       minimum output value
+ * maximum_output:       maximum output value
+ */
+struct PIDTuning {
+  float kp;
+  float ki;
+  float kd;
+  float kt;
+  float derivative_filter_ms;
+  float output_rate;
+  int minimum_output;
+  int maximum_output;
+};
+
+/**
+ * PID controller in float or Q-format fixed point
+ * 
+ * @tparam T number type for the per-sample math, float or FixedPoint
+ */
+template <typename T>
 class PIDController {
   public:
-    PIDController(
-      float kp,
-      float ki,
-      float kd,
-      unsigned long pid_rate_ms,
-      int minimum_output,
-      int maximum_output
-    );
+    PIDController(Clock* clock, PIDTuning const& tuning, unsigned long pid_rate_ms);
     void set_mode(Mode mode);
-    int control(long setpoint, long input);
+    void set_tuning(PIDTuning const& tuning);
+    void set_rate(unsigned long pid_rate_ms);
+    PIDTuning const& get_tuning() const;
+    int control(long setpoint, long input, int feedforward);
+    int control(long setpoint, long input, int feedforward, float dt);
 
   private:
-    float const KP, KI, KD;
-    unsigned long const PID_RATE_MS;
-    int const MINIMUM_OUTPUT, MAXIMUM_OUTPUT;
-    
+    /**
+     * Per-sample coefficients for one sample time
+     * 
+     * kp:               proportional gain
+     * ki:               integral gain times sample time
+     * kt:               back-calculation gain times sample time
+     * derivative_decay: share of the filtered derivative kept each sample
+     * derivative_gain:  gain on the input change each sample
+     * output_step:      largest change of output each sample
+     */
+    struct Coefficients {
+      T kp;
+      T ki;
+      T kt;
+      T derivative_decay;
+      T derivative_gain;
+      T output_step;
+    };
+
+    Clock* const CLOCK;
+
+    unsigned long pid_rate_ms;
+    PIDTuning tuning;
+    T minimum_output, maximum_output;
+    Coefficients fixed_rate;
     Mode mode;
+    bool is_primed;
     unsigned long previous_time;
-    float integral_term;
+    T integral_term;
+    T derivative_term;
     long previous_input;
-    int previous_output;
-    
+    T previous_output;
+
+    static Coefficients get_coefficients(PIDTuning const& tuning, float dt);
+    int step(long setpoint, long input, int feedforward, Coefficients const& coefficients);
     void start();
 };
 
@@ -0,0 +1,104 @@
+/**
+ * @file power_manager.cpp
+ * 
+ * @brief master light sleep while idle
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#include "power_manager.h"
+
+/**
+ * Power Manager constructor
+ * 
+ * @param hal           hardware abstraction layer
+ * @param system        system to watch for idle
+ * @param button_panel  buttons that wake the master
+ * @param control_task  task to stop while asleep
+ * @param idle_delay_ms how long the system has to be idle before sleeping
+ *                      in ms
+ */
+template <typename T>
+PowerManager<T>::PowerManager(
+    Hal* hal,
+    T* system,
+    ButtonPanel* button_panel,
+    ControlTask<T>* control_task,
+    unsigned long idle_delay_ms) :
+HAL(hal),
+SYSTEM(system),
+BUTTON_PANEL(button_panel),
+CONTROL_TASK(control_task),
+IDLE_DELAY_MS(idle_delay_ms) {
+  is_sleeping = false;
+  idle_start_time = HAL->clock->millis();
+  sleeps = 0;
+}
+
+/**
+ * Resume after a light sleep, or go to sleep if idle for long enough; call
+ * from loop()
+ * 
+ * Once the system has been idle with both buttons up for IDLE_DELAY_MS, the
+ * control task is stopped and the master light sleeps until either button
+ * pulls its pin low. The next call restarts the system timing, so the sleep
+ * is not taken for time spent moving, and the control task, which debounces
+ * the press as usual, so the press that woke the master is the one that
+ * moves the desk. The minions are not told; they notice the legs moving on
+ * their own. On the ESP32 light_sleep() returns once the master wakes; on
+ * Linux it returns at once, and the host holds off the next call until a
+ * wake source has fired.
+ * 
+ * @return if the master went to sleep
+ */
+template <typename T>
+bool PowerManager<T>::update() {
+  unsigned long current_time = HAL->clock->millis();
+  if (is_sleeping) {
+    is_sleeping = false;
+    idle_start_time = current_time;
+    SYSTEM->resume();
+    CONTROL_TASK->start();
+    return false;
+  }
+
+  bool is_pressed = BUTTON_PANEL->up_switch_pressed() || BUTTON_PANEL->down_switch_pressed();
+  if (!SYSTEM->is_idle() || is_pressed) {
+    idle_start_time = current_time;
+    return false;
+  }
+  if (current_time - idle_start_time < IDLE_DELAY_MS) return false;
+
+  CONTROL_TASK->stop();
+  BUTTON_PANEL->enable_wake();
+  is_sleeping = true;
+  sleeps++;
+  HAL->power->light_sleep();
+  return true;
+}
+
+/**
+ * Determine if the master is asleep, or woke and has not resumed yet
+ * 
+ * @return if the master is asleep
+ */
+template <typename T>
+bool PowerManager<T>::is_asleep() const {
+  return is_sleeping;
+}
+
+/**
+ * Get number of light sleeps
+ * 
+ * @return number of sleeps
+ */
+template <typename T>
+unsigned long PowerManager<T>::get_sleeps() const {
+  return sleeps;
+}
+
+// Instantiated for the same system types as ControlTask
+template class PowerManager<ElevateSystem<NUMBER_OF_MODULES_> >;
+#ifndef ARDUINO
+template class PowerManager<ElevateSystemBase>;
+#endif
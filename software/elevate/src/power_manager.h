@@ -0,0 +1,48 @@
+/**
+ * @file power_manager.h
+ * 
+ * @brief header file for master light sleep while idle
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#ifndef POWER_MANAGER_H_
+#define POWER_MANAGER_H_
+
+#include "button_panel.h"
+#include "control_task.h"
+#include "elevate_system.h"
+#include "hal.h"
+
+/**
+ * Master light sleep while idle
+ * 
+ * @tparam T system type, as for ControlTask
+ */
+template <typename T>
+class PowerManager {
+  public:
+    PowerManager(
+      Hal* hal,
+      T* system,
+      ButtonPanel* button_panel,
+      ControlTask<T>* control_task,
+      unsigned long idle_delay_ms
+    );
+    bool update();
+    bool is_asleep() const;
+    unsigned long get_sleeps() const;
+
+  private:
+    Hal* const HAL;
+    T* const SYSTEM;
+    ButtonPanel* const BUTTON_PANEL;
+    ControlTask<T>* const CONTROL_TASK;
+    unsigned long const IDLE_DELAY_MS;
+
+    bool is_sleeping;
+    unsigned long idle_start_time;
+    unsigned long sleeps;
+};
+
+#endif
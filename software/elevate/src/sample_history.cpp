@@ -0,0 +1,63 @@
+/**
+ * @file sample_history.cpp
+ * 
+ * @brief per-module minion sample history
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#include "sample_history.h"
+
+/**
+ * Sample History constructor, starts empty. The history holds the most
+ * recent samples of one module in minion time order, so the control loop
+ * sees motion between radio frames instead of only the newest height.
+ */
+SampleHistory::SampleHistory() {
+  newest = CAPACITY - 1;
+  count = 0;
+}
+
+/**
+ * Forget every sample
+ */
+void SampleHistory::clear() {
+  newest = CAPACITY - 1;
+  count = 0;
+}
+
+/**
+ * Add the newest sample, a sample older than the newest one means the
+ * minion restarted and clears the history first
+ * 
+ * @param sample newest sample
+ */
+void SampleHistory::add(ModuleSample const& sample) {
+  if (count > 0 && (int32_t) (sample.timestamp_us - samples[newest].timestamp_us) < 0) {
+    clear();
+  }
+  newest = (newest + 1) % CAPACITY;
+  samples[newest] = sample;
+  if (count < CAPACITY) count++;
+}
+
+/**
+ * Get number of samples held
+ * 
+ * @return number of samples
+ */
+int SampleHistory::get_count() const {
+  return count;
+}
+
+/**
+ * Get a held sample
+ * 
+ * @param age 0 for the newest sample, up to get_count() - 1 for the oldest
+ * 
+ * @return sample
+ */
+ModuleSample const& SampleHistory::get(int age) const {
+  return samples[(newest - age + CAPACITY) % CAPACITY];
+}
+
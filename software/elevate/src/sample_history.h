@@ -0,0 +1,31 @@
+/**
+ * @file sample_history.h
+ * 
+ * @brief header file for per-module minion sample history
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#ifndef SAMPLE_HISTORY_H_
+#define SAMPLE_HISTORY_H_
+
+#include "sample_mailbox.h"
+#include <stdint.h>
+
+class SampleHistory {
+  public:
+    SampleHistory();
+    void clear();
+    void add(ModuleSample const& sample);
+    int get_count() const;
+    ModuleSample const& get(int age) const;
+
+  private:
+    static int const CAPACITY = 32;
+
+    ModuleSample samples[CAPACITY];
+    int newest;
+    int count;
+};
+
+#endif
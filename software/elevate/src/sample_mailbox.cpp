@@ -0,0 +1,73 @@
+/**
+ * @file sample_mailbox.cpp
+ * 
+ * @brief lock-free minion sample mailbox
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#include "sample_mailbox.h"
+
+/**
+ * Sample Mailbox constructor, starts empty. The radio callback is the only
+ * producer and the control loop the only consumer, and neither waits for
+ * the other.
+ */
+SampleMailbox::SampleMailbox() : head(0), tail(0) {}
+
+/**
+ * Sample Mailbox copy constructor, only valid before the mailbox is shared
+ * 
+ * @param other mailbox to copy
+ */
+SampleMailbox::SampleMailbox(SampleMailbox const& other) :
+head(other.head.load(std::memory_order_relaxed)),
+tail(other.tail.load(std::memory_order_relaxed)) {
+  for (uint32_t i = 0; i < CAPACITY; i++) {
+    samples[i] = other.samples[i];
+  }
+}
+
+/**
+ * Publish a new sample, called only by the producer. A full mailbox drops
+ * its oldest sample to make room, so the newest always gets through. The
+ * release fence orders the previous head store before the slot is rewritten,
+ * which lets the consumer tell when a slot it copied was overwritten.
+ * 
+ * @param sample newest sample
+ * 
+ * @return if no unread sample was overwritten
+ */
+bool SampleMailbox::publish(ModuleSample const& sample) {
+  uint32_t current = head.load(std::memory_order_relaxed);
+  bool is_full = current - tail.load(std::memory_order_relaxed) >= CAPACITY;
+  std::atomic_thread_fence(std::memory_order_release);
+  samples[current % CAPACITY] = sample;
+  head.store(current + 1, std::memory_order_release);
+  return !is_full;
+}
+
+/**
+ * Take the oldest queued sample, called only by the consumer. If the
+ * producer has lapped the consumer, skip to the oldest sample still in the
+ * ring. The copy is retried if the producer reached its slot meanwhile.
+ * 
+ * @param sample oldest sample, untouched if there is none
+ * 
+ * @return if a sample was taken
+ */
+bool SampleMailbox::consume(ModuleSample& sample) {
+  uint32_t current = tail.load(std::memory_order_relaxed);
+  ModuleSample copy;
+  while (true) {
+    uint32_t newest = head.load(std::memory_order_acquire);
+    if (current == newest) return false;
+    if (newest - current >= CAPACITY) current = newest - CAPACITY + 1;
+    copy = samples[current % CAPACITY];
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (head.load(std::memory_order_relaxed) - current < CAPACITY) break;
+  }
+  sample = copy;
+  tail.store(current + 1, std::memory_order_relaxed);
+  return true;
+}
@@ -0,0 +1,57 @@
+/**
+ * @file sample_mailbox.h
+ * 
+ * @brief header file for lock-free minion sample mailbox
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#ifndef SAMPLE_MAILBOX_H_
+#define SAMPLE_MAILBOX_H_
+
+#include <atomic>
+#include <stdint.h>
+
+/**
+ * Struct for one minion sample
+ * 
+ * height:                     module height
+ * lower_limit_switch_pressed: whether or not the lower limit switch is pressed
+ * upper_limit_switch_pressed: whether or not the upper limit switch is pressed
+ * encoder_stale:              whether the minion had no fresh encoder reading
+ * velocity:                   minion velocity estimate in units per second
+ * acceleration:               minion acceleration estimate in units per
+ *                             second squared
+ * clock_synced:               whether timestamp_us is on the master clock
+ * timestamp_us:               clock when the sample was taken in us, master
+ *                             clock once the minion is synced
+ * receive_us:                 master clock when the sample arrived in us
+ */
+struct ModuleSample {
+  long height;
+  bool lower_limit_switch_pressed;
+  bool upper_limit_switch_pressed;
+  bool encoder_stale;
+  float velocity;
+  float acceleration;
+  bool clock_synced;
+  uint32_t timestamp_us;
+  unsigned long receive_us;
+};
+
+class SampleMailbox {
+  public:
+    SampleMailbox();
+    SampleMailbox(SampleMailbox const& other);
+    bool publish(ModuleSample const& sample);
+    bool consume(ModuleSample& sample);
+
+  private:
+    static uint32_t const CAPACITY = 32;
+
+    ModuleSample samples[CAPACITY];
+    std::atomic<uint32_t> head;
+    std::atomic<uint32_t> tail;
+};
+
+#endif
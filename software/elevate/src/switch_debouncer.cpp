@@ -0,0 +1,163 @@
+/**
+ * @file switch_debouncer.cpp
+ * 
+ * @brief debouncing a bank of switches in parallel
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#include "switch_debouncer.h"
+
+/**
+ * Switch Debouncer constructor
+ * 
+ * @param hal      hardware abstraction layer
+ * @param delay_ms how long a level has to hold to count in ms, sampled in
+ *                 STABLE_SAMPLES ticks
+ */
+SwitchDebouncer::SwitchDebouncer(Hal* hal, unsigned long delay_ms) :
+HAL(hal),
+TICK_US(delay_ms * 1000 / STABLE_SAMPLES) {
+  bank = -1;
+  mask = 0;
+  previous_tick_us = 0;
+  pressed = 0;
+  count_low = 0;
+  count_high = 0;
+  presses = 0;
+  releases = 0;
+}
+
+/**
+ * Add a switch, before setup; every switch has to be in the bank of the
+ * first one
+ * 
+ * @param pin switch input pin
+ * 
+ * @return if the switch was added
+ */
+bool SwitchDebouncer::add_switch(uint8_t pin) {
+  int pin_bank = pin / HAL_PINS_PER_BANK;
+  if (bank >= 0 && pin_bank != bank) return false;
+  bank = pin_bank;
+  mask |= pin_bit(pin);
+  return true;
+}
+
+/**
+ * Set up the switch pins and start from their current levels
+ */
+void SwitchDebouncer::setup() {
+  if (bank < 0) return;
+  for (int i = 0; i < HAL_PINS_PER_BANK; i++) {
+    if (mask & ((uint32_t) 1 << i)) HAL->gpio->pin_mode((uint8_t) (bank * HAL_PINS_PER_BANK + i), HAL_INPUT);
+  }
+  pressed = ~HAL->gpio->read_bank((uint8_t) bank) & mask;
+  count_low = 0;
+  count_high = 0;
+  presses = 0;
+  releases = 0;
+  previous_tick_us = HAL->clock->micros();
+}
+
+/**
+ * Sample every switch if a tick is due; call at least once per tick. Edges
+ * are only reported until the next call
+ * 
+ * Every switch sits in one GPIO bank, so a tick is one register read however
+ * many switches there are. Each switch keeps a two bit count of consecutive
+ * ticks its level has disagreed with its debounced state, bit-sliced across
+ * two words as a vertical counter, so every switch is counted at once. A
+ * switch changes state on the STABLE_SAMPLES-th disagreeing tick in a row,
+ * and any agreeing tick clears its count.
+ */
+void SwitchDebouncer::update() {
+  presses = 0;
+  releases = 0;
+  unsigned long current_us = HAL->clock->micros();
+  unsigned long elapsed_us = current_us - previous_tick_us;
+  if (bank < 0 || elapsed_us < TICK_US) return;
+  // Stay on the tick grid unless a whole tick was missed
+  previous_tick_us = (elapsed_us < 2 * TICK_US) ? previous_tick_us + TICK_US : current_us;
+
+  uint32_t sample = ~HAL->gpio->read_bank((uint8_t) bank) & mask;
+  uint32_t delta = sample ^ pressed;
+  count_high = (count_high ^ count_low) & delta;
+  count_low = ~count_low & delta;
+  uint32_t toggle = delta & ~(count_low | count_high);
+  pressed ^= toggle;
+  presses = toggle & pressed;
+  releases = toggle & ~pressed;
+}
+
+/**
+ * Determine if a switch is pressed; switches are active low, so a switch
+ * reads pressed when its pin is low
+ * 
+ * @param pin switch input pin
+ * 
+ * @return if the switch is pressed
+ */
+bool SwitchDebouncer::is_pressed(uint8_t pin) const {
+  return (pressed & pin_bit(pin)) != 0;
+}
+
+/**
+ * Determine if a switch became pressed on the last update
+ * 
+ * @param pin switch input pin
+ * 
+ * @return if the switch was pressed
+ */
+bool SwitchDebouncer::was_pressed(uint8_t pin) const {
+  return (presses & pin_bit(pin)) != 0;
+}
+
+/**
+ * Determine if a switch became released on the last update
+ * 
+ * @param pin switch input pin
+ * 
+ * @return if the switch was released
+ */
+bool SwitchDebouncer::was_released(uint8_t pin) const {
+  return (releases & pin_bit(pin)) != 0;
+}
+
+/**
+ * Get every pressed switch
+ * 
+ * @return pressed switches, pin n in bit n % HAL_PINS_PER_BANK
+ */
+uint32_t SwitchDebouncer::get_pressed() const {
+  return pressed;
+}
+
+/**
+ * Get every switch that became pressed on the last update
+ * 
+ * @return press edges, pin n in bit n % HAL_PINS_PER_BANK
+ */
+uint32_t SwitchDebouncer::get_presses() const {
+  return presses;
+}
+
+/**
+ * Get every switch that became released on the last update
+ * 
+ * @return release edges, pin n in bit n % HAL_PINS_PER_BANK
+ */
+uint32_t SwitchDebouncer::get_releases() const {
+  return releases;
+}
+
+/**
+ * Get the bit of a pin within its bank
+ * 
+ * @param pin pin number
+ * 
+ * @return pin bit
+ */
+uint32_t SwitchDebouncer::pin_bit(uint8_t pin) {
+  return (uint32_t) 1 << (pin % HAL_PINS_PER_BANK);
+}
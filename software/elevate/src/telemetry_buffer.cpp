@@ -0,0 +1,195 @@
+/**
+ * @file telemetry_buffer.cpp
+ * 
+ * @brief lock-free control telemetry ring buffer
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#include "telemetry_buffer.h"
+#include "minion_protocol.h"
+
+/**
+ * Write a little-endian 16 bit value
+ * 
+ * @param buffer destination
+ * @param value  value to write
+ */
+static void write_u16(uint8_t* buffer, uint16_t value) {
+  buffer[0] = (uint8_t) value;
+  buffer[1] = (uint8_t) (value >> 8);
+}
+
+/**
+ * Write a little-endian 32 bit value
+ * 
+ * @param buffer destination
+ * @param value  value to write
+ */
+static void write_u32(uint8_t* buffer, uint32_t value) {
+  buffer[0] = (uint8_t) value;
+  buffer[1] = (uint8_t) (value >> 8);
+  buffer[2] = (uint8_t) (value >> 16);
+  buffer[3] = (uint8_t) (value >> 24);
+}
+
+/**
+ * Read a little-endian 16 bit value
+ * 
+ * @param buffer source
+ * 
+ * @return value read
+ */
+static uint16_t read_u16(const uint8_t* buffer) {
+  return (uint16_t) (buffer[0] | (buffer[1] << 8));
+}
+
+/**
+ * Read a little-endian 32 bit value
+ * 
+ * @param buffer source
+ * 
+ * @return value read
+ */
+static uint32_t read_u32(const uint8_t* buffer) {
+  return (uint32_t) buffer[0] |
+    ((uint32_t) buffer[1] << 8) |
+    ((uint32_t) buffer[2] << 16) |
+    ((uint32_t) buffer[3] << 24);
+}
+
+/**
+ * Encode a record as a trace frame, little-endian, 26 bytes:
+ * 
+ *   0  uint8   sync byte TELEMETRY_SYNC
+ *   1  uint8   trace format version
+ *   2  uint16  sequence number, increments by one per record, dropped
+ *              records included
+ *   4  uint32  master clock at the control step in us
+ *   8  uint8   module index
+ *   9  uint8   module state in the low nibble, module status in the high
+ *   10 int32   setpoint
+ *   14 int32   measured height
+ *   18 int32   height offset
+ *   22 int16   PID output
+ *   24 uint16  CRC-16/CCITT-FALSE over bytes 0-23
+ * 
+ * @param record record to encode
+ * @param buffer destination of at least TELEMETRY_FRAME_SIZE bytes
+ */
+void encode_telemetry_frame(TelemetryRecord const& record, uint8_t* buffer) {
+  buffer[0] = TELEMETRY_SYNC;
+  buffer[1] = TELEMETRY_VERSION;
+  write_u16(buffer + 2, record.sequence);
+  write_u32(buffer + 4, record.timestamp_us);
+  buffer[8] = record.module;
+  buffer[9] = (uint8_t) ((record.state & 0x0f) | (record.status << 4));
+  write_u32(buffer + 10, (uint32_t) record.setpoint);
+  write_u32(buffer + 14, (uint32_t) record.height);
+  write_u32(buffer + 18, (uint32_t) record.height_offset);
+  write_u16(buffer + 22, (uint16_t) record.output);
+  write_u16(buffer + 24, minion_crc16(buffer, TELEMETRY_FRAME_SIZE - 2));
+}
+
+/**
+ * Decode a trace frame
+ * 
+ * @param buffer frame bytes
+ * @param len    number of bytes available
+ * @param record decoded record, untouched unless the frame is valid
+ * 
+ * @return if the bytes start with a whole frame of this version with a
+ *         matching checksum
+ */
+bool decode_telemetry_frame(const uint8_t* buffer, size_t len, TelemetryRecord& record) {
+  if (len < TELEMETRY_FRAME_SIZE) return false;
+  if (buffer[0] != TELEMETRY_SYNC || buffer[1] != TELEMETRY_VERSION) return false;
+  if (read_u16(buffer + 24) != minion_crc16(buffer, TELEMETRY_FRAME_SIZE - 2)) return false;
+  record.sequence = read_u16(buffer + 2);
+  record.timestamp_us = read_u32(buffer + 4);
+  record.module = buffer[8];
+  record.state = buffer[9] & 0x0f;
+  record.status = buffer[9] >> 4;
+  record.setpoint = (int32_t) read_u32(buffer + 10);
+  record.height = (int32_t) read_u32(buffer + 14);
+  record.height_offset = (int32_t) read_u32(buffer + 18);
+  record.output = (int16_t) read_u16(buffer + 22);
+  return true;
+}
+
+/**
+ * Telemetry Buffer constructor, starts empty. The control task is the only
+ * producer and a low-priority task draining to the serial port the only
+ * consumer. Records are kept unencoded so recording is a copy and two atomic
+ * accesses; the consumer does the encoding.
+ */
+TelemetryBuffer::TelemetryBuffer() : head(0), tail(0), dropped(0) {
+  sequence = 0;
+}
+
+/**
+ * Record one module at one control step, called only by the producer
+ * 
+ * @param record record to keep; its sequence number is assigned here
+ * 
+ * @return if the record was queued; false if the buffer is full, in which
+ *         case its sequence number is still used up so a gap shows on the
+ *         host
+ */
+bool TelemetryBuffer::record(TelemetryRecord const& record) {
+  uint16_t current_sequence = sequence++;
+  uint32_t current = head.load(std::memory_order_relaxed);
+  if (current - tail.load(std::memory_order_acquire) >= CAPACITY) {
+    dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    return false;
+  }
+  TelemetryRecord& slot = records[current % CAPACITY];
+  slot = record;
+  slot.sequence = current_sequence;
+  head.store(current + 1, std::memory_order_release);
+  return true;
+}
+
+/**
+ * Take the oldest record, called only by the consumer
+ * 
+ * @param record oldest record, untouched if there is none
+ * 
+ * @return if a record was taken
+ */
+bool TelemetryBuffer::take(TelemetryRecord& record) {
+  uint32_t current = tail.load(std::memory_order_relaxed);
+  if (current == head.load(std::memory_order_acquire)) return false;
+  record = records[current % CAPACITY];
+  tail.store(current + 1, std::memory_order_release);
+  return true;
+}
+
+/**
+ * Write queued records to a serial port as trace frames, as many as fit
+ * without blocking, called only by the consumer
+ * 
+ * @param serial serial port to write to
+ * 
+ * @return number of frames written
+ */
+size_t TelemetryBuffer::drain(SerialPort* serial) {
+  size_t frames = 0;
+  uint8_t frame[TELEMETRY_FRAME_SIZE];
+  TelemetryRecord record;
+  while (serial->available_for_write() >= TELEMETRY_FRAME_SIZE && take(record)) {
+    encode_telemetry_frame(record, frame);
+    serial->write(frame, TELEMETRY_FRAME_SIZE);
+    frames++;
+  }
+  return frames;
+}
+
+/**
+ * Get how many records were refused because the buffer was full
+ * 
+ * @return number of dropped records
+ */
+uint32_t TelemetryBuffer::get_dropped() const {
+  return dropped.load(std::memory_order_relaxed);
+}
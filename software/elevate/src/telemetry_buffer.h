@@ -0,0 +1,67 @@
+/**
+ * @file telemetry_buffer.h
+ * 
+ * @brief header file for lock-free control telemetry ring buffer
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#ifndef TELEMETRY_BUFFER_H_
+#define TELEMETRY_BUFFER_H_
+
+#include "hal.h"
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+uint8_t const TELEMETRY_SYNC = 0xa5;
+uint8_t const TELEMETRY_VERSION = 1;
+size_t const TELEMETRY_FRAME_SIZE = 26;
+
+/**
+ * Struct for one module at one control step
+ * 
+ * timestamp_us:  master clock at the control step in us
+ * setpoint:      height the module was last commanded to
+ * height:        newest measured module height, before the offset
+ * height_offset: calibrated height offset
+ * output:        PID output applied to the motor
+ * sequence:      sequence number, set by the buffer
+ * module:        module index
+ * state:         module state
+ * status:        module status
+ */
+struct TelemetryRecord {
+  uint32_t timestamp_us;
+  int32_t setpoint;
+  int32_t height;
+  int32_t height_offset;
+  int16_t output;
+  uint16_t sequence;
+  uint8_t module;
+  uint8_t state;
+  uint8_t status;
+};
+
+void encode_telemetry_frame(TelemetryRecord const& record, uint8_t* buffer);
+bool decode_telemetry_frame(const uint8_t* buffer, size_t len, TelemetryRecord& record);
+
+class TelemetryBuffer {
+  public:
+    TelemetryBuffer();
+    bool record(TelemetryRecord const& record);
+    bool take(TelemetryRecord& record);
+    size_t drain(SerialPort* serial);
+    uint32_t get_dropped() const;
+
+  private:
+    static uint32_t const CAPACITY = 512;
+
+    TelemetryRecord records[CAPACITY];
+    std::atomic<uint32_t> head;
+    std::atomic<uint32_t> tail;
+    std::atomic<uint32_t> dropped;
+    uint16_t sequence;
+};
+
+#endif
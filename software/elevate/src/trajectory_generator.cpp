@@ -0,0 +1,225 @@
+/**
+ * @file trajectory_generator.cpp
+ * 
+ * @brief jerk-limited trajectory generator
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#include "trajectory_generator.h"
+#include <math.h>
+
+/**
+ * Trajectory Generator constructor
+ * 
+ * @param maximum_velocity     velocity limit in units per s
+ * @param maximum_acceleration acceleration limit in units per s^2
+ * @param maximum_jerk         jerk limit in units per s^3
+ */
+TrajectoryGenerator::TrajectoryGenerator(float maximum_velocity, float maximum_acceleration, float maximum_jerk) :
+MAXIMUM_VELOCITY(maximum_velocity),
+MAXIMUM_ACCELERATION(maximum_acceleration),
+MAXIMUM_JERK(maximum_jerk) {
+  velocity_limit = maximum_velocity;
+  reset(0.0f);
+}
+
+/**
+ * Put the trajectory at rest at a position
+ * 
+ * @param position position in units
+ */
+void TrajectoryGenerator::reset(float position) {
+  target = VELOCITY_TARGET;
+  target_velocity = 0.0f;
+  target_position = position;
+  is_braking = false;
+  this->position = position;
+  velocity = 0.0f;
+  acceleration = 0.0f;
+}
+
+/**
+ * Start, cruise or stop at a velocity
+ * 
+ * @param velocity velocity in units per s, clamped to the velocity limit
+ */
+void TrajectoryGenerator::set_velocity_target(float velocity) {
+  target = VELOCITY_TARGET;
+  target_velocity = velocity;
+  is_braking = false;
+}
+
+/**
+ * Go to a position and stop there
+ * 
+ * @param position position in units
+ */
+void TrajectoryGenerator::set_position_target(float position) {
+  if (target != POSITION_TARGET || position != target_position) is_braking = false;
+  target = POSITION_TARGET;
+  target_position = position;
+}
+
+/**
+ * Lower the cruise velocity below the maximum, for both kinds of target
+ * 
+ * @param velocity velocity limit in units per s, clamped to 0 and the
+ *                 maximum velocity
+ */
+void TrajectoryGenerator::set_velocity_limit(float velocity) {
+  if (velocity > MAXIMUM_VELOCITY) velocity = MAXIMUM_VELOCITY;
+  if (velocity < 0.0f) velocity = 0.0f;
+  velocity_limit = velocity;
+}
+
+/**
+ * Advance the trajectory by one control period, so a button can be pressed
+ * or released at any instant. Velocity targets ramp acceleration in and out
+ * at the jerk limit, giving S-shaped velocity profiles at start, stop and
+ * reversal. Position targets brake once the jerk-limited stopping distance
+ * reaches the distance left.
+ * 
+ * @param dt time since the last update in s
+ */
+void TrajectoryGenerator::update(float dt) {
+  if (dt <= 0.0f) return;
+
+  float velocity_target = target_velocity;
+  if (velocity_target > velocity_limit) velocity_target = velocity_limit;
+  if (velocity_target < -velocity_limit) velocity_target = -velocity_limit;
+  if (target == POSITION_TARGET) {
+    float remaining = target_position - position;
+    if (is_at_rest()) {
+      is_braking = false;
+      if (fabsf(remaining) <= MAXIMUM_VELOCITY * dt) {
+        position = target_position;
+        return;
+      }
+    } else if (!is_braking) {
+      is_braking = remaining * velocity <= 0.0f ||
+        fabsf(get_stopping_distance()) + fabsf(velocity) * dt >= fabsf(remaining);
+    }
+    velocity_target = is_braking ? 0.0f : (remaining > 0.0f ? velocity_limit : -velocity_limit);
+  }
+
+  if (fabsf(velocity_target - velocity) <= 0.5f * MAXIMUM_JERK * dt * dt &&
+      fabsf(acceleration) <= MAXIMUM_JERK * dt) {
+    velocity = velocity_target;
+    acceleration = 0.0f;
+    position += velocity * dt;
+    return;
+  }
+
+  float jerk = track_velocity(velocity_target, dt);
+  position += (velocity + (acceleration / 2.0f + jerk * dt / 6.0f) * dt) * dt;
+  velocity += (acceleration + jerk * dt / 2.0f) * dt;
+  acceleration += jerk * dt;
+  if (acceleration > MAXIMUM_ACCELERATION) acceleration = MAXIMUM_ACCELERATION;
+  if (acceleration < -MAXIMUM_ACCELERATION) acceleration = -MAXIMUM_ACCELERATION;
+}
+
+/**
+ * Get position setpoint
+ * 
+ * @return position in units
+ */
+float TrajectoryGenerator::get_position() const {
+  return position;
+}
+
+/**
+ * Get velocity setpoint
+ * 
+ * @return velocity in units per s
+ */
+float TrajectoryGenerator::get_velocity() const {
+  return velocity;
+}
+
+/**
+ * Get acceleration setpoint
+ * 
+ * @return acceleration in units per s^2
+ */
+float TrajectoryGenerator::get_acceleration() const {
+  return acceleration;
+}
+
+/**
+ * Get whether the trajectory is standing still
+ * 
+ * @return if velocity and acceleration are both zero
+ */
+bool TrajectoryGenerator::is_at_rest() const {
+  return velocity == 0.0f && acceleration == 0.0f;
+}
+
+/**
+ * Get whether a position target has been reached
+ * 
+ * @return if at rest on the position target
+ */
+bool TrajectoryGenerator::is_at_target() const {
+  return target == POSITION_TARGET && is_at_rest() && position == target_position;
+}
+
+/**
+ * Choose the jerk for one period of tracking a velocity
+ * 
+ * Once bringing the acceleration to zero at the jerk limit would carry the
+ * velocity past the target, the acceleration is ramped out with the jerk
+ * that lands exactly on the target instead.
+ * 
+ * @param velocity_target velocity to reach in units per s
+ * @param dt              period in s
+ * 
+ * @return jerk in units per s^3
+ */
+float TrajectoryGenerator::track_velocity(float velocity_target, float dt) const {
+  float velocity_error = velocity_target - velocity;
+  float ramp_out_velocity = acceleration * fabsf(acceleration) / (2.0f * MAXIMUM_JERK);
+
+  if (acceleration != 0.0f &&
+      (acceleration > 0.0f) == (velocity_error > 0.0f) &&
+      fabsf(ramp_out_velocity) >= fabsf(velocity_error)) {
+    float jerk = -acceleration * fabsf(acceleration) / (2.0f * velocity_error);
+    if (fabsf(jerk * dt) > fabsf(acceleration)) jerk = -acceleration / dt;
+    return jerk;
+  }
+
+  float acceleration_target = (velocity_error > ramp_out_velocity) ? MAXIMUM_ACCELERATION : -MAXIMUM_ACCELERATION;
+  float jerk = (acceleration_target - acceleration) / dt;
+  if (jerk > MAXIMUM_JERK) jerk = MAXIMUM_JERK;
+  if (jerk < -MAXIMUM_JERK) jerk = -MAXIMUM_JERK;
+  return jerk;
+}
+
+/**
+ * Get the distance covered if braking to a stop starts now
+ * 
+ * Acceleration towards the direction of travel is first ramped out, then
+ * the velocity left is removed with a symmetric S-curve, which covers half
+ * the velocity times its duration.
+ * 
+ * @return signed distance in units
+ */
+float TrajectoryGenerator::get_stopping_distance() const {
+  float direction = (velocity < 0.0f) ? -1.0f : 1.0f;
+  float speed = direction * velocity;
+  float forward_acceleration = direction * acceleration;
+  float distance = 0.0f;
+
+  if (forward_acceleration > 0.0f) {
+    float ramp_time = forward_acceleration / MAXIMUM_JERK;
+    distance += (speed + (forward_acceleration / 2.0f - MAXIMUM_JERK * ramp_time / 6.0f) * ramp_time) * ramp_time;
+    speed += forward_acceleration * ramp_time / 2.0f;
+  }
+
+  if (speed * MAXIMUM_JERK >= MAXIMUM_ACCELERATION * MAXIMUM_ACCELERATION) {
+    distance += speed * (speed / MAXIMUM_ACCELERATION + MAXIMUM_ACCELERATION / MAXIMUM_JERK) / 2.0f;
+  } else {
+    distance += speed * sqrtf(speed / MAXIMUM_JERK);
+  }
+  return direction * distance;
+}
@@ -0,0 +1,55 @@
+/**
+ * @file trajectory_generator.h
+ * 
+ * @brief header file for jerk-limited trajectory generator
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#ifndef TRAJECTORY_GENERATOR_H_
+#define TRAJECTORY_GENERATOR_H_
+
+/**
+ * Trajectory Target
+ * 
+ * VELOCITY_TARGET: reach and hold a velocity, 0 to stop
+ * POSITION_TARGET: come to rest at a position
+ */
+enum TrajectoryTarget {
+  VELOCITY_TARGET,
+  POSITION_TARGET
+};
+
+class TrajectoryGenerator {
+  public:
+    TrajectoryGenerator(float maximum_velocity, float maximum_acceleration, float maximum_jerk);
+    void reset(float position);
+    void set_velocity_target(float velocity);
+    void set_position_target(float position);
+    void set_velocity_limit(float velocity);
+    void update(float dt);
+    float get_position() const;
+    float get_velocity() const;
+    float get_acceleration() const;
+    bool is_at_rest() const;
+    bool is_at_target() const;
+
+  private:
+    float const MAXIMUM_VELOCITY;
+    float const MAXIMUM_ACCELERATION;
+    float const MAXIMUM_JERK;
+
+    float velocity_limit;
+    TrajectoryTarget target;
+    float target_velocity;
+    float target_position;
+    bool is_braking;
+    float position;
+    float velocity;
+    float acceleration;
+
+    float track_velocity(float velocity_target, float dt) const;
+    float get_stopping_distance() const;
+};
+
+#endif
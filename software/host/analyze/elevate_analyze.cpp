@@ -0,0 +1,755 @@
+/**
+ * @file elevate_analyze.cpp
+ * 
+ * @brief streaming analyzer for binary control telemetry traces
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#include "elevate_constants.h"
+#include "elevate_types.h"
+#include "input_recorder.h"
+#include "telemetry_buffer.h"
+#include <algorithm>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+static int const MAXIMUM_MODULES = 16;
+static uint64_t const MOTION_END_US = 250000;
+static size_t const RELEASE_BYTES = 64 << 20;
+static size_t const PLOT_BUCKETS = 1024;
+static int const MAXIMUM_MOTIONS_SHOWN = 20;
+static char const* const RISER_COLORS[] = {
+  "#1f77b4", "#ff7f0e", "#2ca02c", "#d62728", "#9467bd", "#8c564b", "#e377c2", "#7f7f7f"
+};
+static char const* const TARGET_COLOR = "#7da7d9";
+
+/**
+ * Struct for what is known of one module at a control step
+ * 
+ * is_valid: if a record for the module has been read
+ * setpoint: commanded height relative to the offset in units
+ * position: measured height relative to the offset in units
+ * state:    module state
+ */
+struct ModuleState {
+  bool is_valid = false;
+  double setpoint = 0.0;
+  double position = 0.0;
+  uint8_t state = STOPPED;
+};
+
+/**
+ * Struct for one module over a motion
+ * 
+ * start:          position when the motion started in units
+ * target:         setpoint when the motion ended in units
+ * final_position: position when the motion ended in units
+ * rise_s:         time from 10 to 90% of the step in s, negative if the
+ *                 step was never covered
+ * overshoot:      furthest past the target in the direction of travel in
+ *                 units
+ * settle_s:       time from the start until the module stayed within the
+ *                 settling band in s
+ */
+struct ModuleMotion {
+  double start;
+  double target;
+  double final_position;
+  double rise_s;
+  double overshoot;
+  double settle_s;
+};
+
+/**
+ * Struct for running totals of one metric over every motion
+ * 
+ * sum:     sum over motions
+ * maximum: largest over motions
+ * count:   motions with the metric
+ */
+struct Total {
+  double sum = 0.0;
+  double maximum = 0.0;
+  unsigned long count = 0;
+
+  void add(double value) {
+    sum += value;
+    maximum = std::max(maximum, value);
+    count++;
+  }
+
+  double mean() const {
+    return count ? sum / count : 0.0;
+  }
+};
+
+/**
+ * Memory-mapped trace read front to back, handing pages behind the read
+ * position back to the kernel so resident memory stays flat however long the
+ * soak test ran. Input capture frames sharing the stream are passed over,
+ * other bytes that do not start a valid frame are skipped one at a time
+ * until the stream lines up again, and sequence gaps are counted as records
+ * the master dropped.
+ */
+class TraceReader {
+  public:
+    TraceReader() : fd(-1), data(0), size(0), position(0), released(0) {}
+
+    ~TraceReader() {
+      if (data) munmap((void*) data, size);
+      if (fd >= 0) close(fd);
+    }
+
+    /**
+     * Map a trace file
+     * 
+     * @param path trace path
+     * 
+     * @return if the file was mapped
+     */
+    bool open(char const* path) {
+      fd = ::open(path, O_RDONLY);
+      if (fd < 0) return false;
+      struct stat status;
+      if (fstat(fd, &status) != 0) return false;
+      size = (size_t) status.st_size;
+      if (size == 0) return true;
+      void* mapped = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (mapped == MAP_FAILED) return false;
+      data = (const uint8_t*) mapped;
+      madvise(mapped, size, MADV_SEQUENTIAL);
+      return true;
+    }
+
+    /**
+     * Read the next valid frame, skipping bytes that do not start one
+     * 
+     * @param record decoded record
+     * 
+     * @return if a frame was read; false at the end of the file
+     */
+    bool next(TelemetryRecord& record) {
+      while (position + TELEMETRY_FRAME_SIZE <= size) {
+        release();
+        if (data[position] == TELEMETRY_SYNC &&
+            decode_telemetry_frame(data + position, size - position, record)) {
+          position += TELEMETRY_FRAME_SIZE;
+          frames++;
+          if (frames > 1) missing += (uint16_t) (record.sequence - next_sequence);
+          next_sequence = (uint16_t) (record.sequence + 1);
+          return true;
+        }
+        InputEvent event;
+        size_t input_len = (data[position] == INPUT_SYNC) ? decode_input_frame(data + position, size - position, event) : 0;
+        if (input_len > 0) {
+          position += input_len;
+          continue;
+        }
+        position++;
+        skipped_bytes++;
+      }
+      skipped_bytes += size - position;
+      position = size;
+      return false;
+    }
+
+    uint64_t get_size() const { return size; }
+    uint64_t frames = 0;
+    uint64_t missing = 0;
+    uint64_t skipped_bytes = 0;
+
+  private:
+    int fd;
+    const uint8_t* data;
+    size_t size;
+    size_t position;
+    size_t released;
+    uint16_t next_sequence = 0;
+
+    /**
+     * Hand pages well behind the read position back to the kernel
+     */
+    void release() {
+      if (position - released < 2 * RELEASE_BYTES) return;
+      madvise((void*) (data + released), RELEASE_BYTES, MADV_DONTNEED);
+      released += RELEASE_BYTES;
+    }
+};
+
+/**
+ * Min/max envelope of several series over time, at most PLOT_BUCKETS wide;
+ * when a sample lands past the last bucket, neighbouring buckets are merged
+ * and the bucket width doubles
+ */
+class Envelope {
+  public:
+    Envelope(int number_of_series, double start_s, double bucket_s) :
+    NUMBER_OF_SERIES(number_of_series),
+    start_s(start_s),
+    bucket_s(bucket_s),
+    minimum(PLOT_BUCKETS * number_of_series, INFINITY),
+    maximum(PLOT_BUCKETS * number_of_series, -INFINITY) {}
+
+    /**
+     * Add one sample of one series
+     * 
+     * @param time_s time in s
+     * @param series series index
+     * @param value  value
+     */
+    void add(double time_s, int series, double value) {
+      if (time_s < start_s) return;
+      size_t bucket = (size_t) ((time_s - start_s) / bucket_s);
+      while (bucket >= PLOT_BUCKETS) {
+        merge();
+        bucket /= 2;
+      }
+      size_t index = bucket * NUMBER_OF_SERIES + series;
+      minimum[index] = std::min(minimum[index], value);
+      maximum[index] = std::max(maximum[index], value);
+    }
+
+    int const NUMBER_OF_SERIES;
+    double start_s;
+    double bucket_s;
+    std::vector<double> minimum;
+    std::vector<double> maximum;
+
+  private:
+    /**
+     * Merge neighbouring buckets, doubling the bucket width
+     */
+    void merge() {
+      for (size_t i = 0; i < PLOT_BUCKETS; i++) {
+        for (int j = 0; j < NUMBER_OF_SERIES; j++) {
+          size_t to = i * NUMBER_OF_SERIES + j;
+          size_t from = 2 * i * NUMBER_OF_SERIES + j;
+          if (2 * i + 1 < PLOT_BUCKETS) {
+            minimum[to] = std::min(minimum[from], minimum[from + NUMBER_OF_SERIES]);
+            maximum[to] = std::max(maximum[from], maximum[from + NUMBER_OF_SERIES]);
+          } else {
+            minimum[to] = INFINITY;
+            maximum[to] = -INFINITY;
+          }
+        }
+      }
+      bucket_s *= 2.0;
+    }
+};
+
+/**
+ * Pick round tick spacing for an axis
+ * 
+ * @param span axis span
+ * 
+ * @return tick spacing of 1, 2, 2.5 or 5 times a power of ten
+ */
+static double tick_step(double span) {
+  double raw = span / 6.0;
+  double magnitude = pow(10.0, floor(log10(raw)));
+  double const STEPS[] = {1.0, 2.0, 2.5, 5.0, 10.0};
+  for (double step : STEPS) {
+    if (step * magnitude >= raw) return step * magnitude;
+  }
+  return 10.0 * magnitude;
+}
+
+/**
+ * Write a line plot as SVG in the style of control_plots
+ * 
+ * @param path     output path
+ * @param title    plot title
+ * @param y_label  y axis label
+ * @param envelope plotted data
+ * @param end_s    end of the time axis in s
+ * @param names    series names, none for no legend
+ * @param colors   series colors
+ * 
+ * @return if the file was written
+ */
+static bool write_plot(
+    std::string const& path,
+    char const* title,
+    char const* y_label,
+    Envelope const& envelope,
+    double end_s,
+    std::vector<std::string> const& names,
+    std::vector<std::string> const& colors) {
+  double const WIDTH = 800.0, HEIGHT = 450.0;
+  double const LEFT = 90.0, RIGHT = 20.0, TOP = 45.0, BOTTOM = 60.0;
+  double plot_width = WIDTH - LEFT - RIGHT;
+  double plot_height = HEIGHT - TOP - BOTTOM;
+
+  double y_minimum = INFINITY, y_maximum = -INFINITY;
+  for (size_t i = 0; i < envelope.minimum.size(); i++) {
+    if (envelope.minimum[i] > envelope.maximum[i]) continue;
+    y_minimum = std::min(y_minimum, envelope.minimum[i]);
+    y_maximum = std::max(y_maximum, envelope.maximum[i]);
+  }
+  if (y_minimum > y_maximum) y_minimum = y_maximum = 0.0;
+  double padding = std::max((y_maximum - y_minimum) * 0.05, 1e-6);
+  y_minimum -= padding;
+  y_maximum += padding;
+
+  double span_s = std::max(end_s - envelope.start_s, 1e-3);
+  double time_scale = 1.0;
+  char const* time_unit = "s";
+  if (span_s > 7200.0) {
+    time_scale = 3600.0;
+    time_unit = "h";
+  } else if (span_s > 600.0) {
+    time_scale = 60.0;
+    time_unit = "min";
+  }
+  auto x = [&](double time_s) { return LEFT + (time_s - envelope.start_s) / span_s * plot_width; };
+  auto y = [&](double value) { return TOP + (y_maximum - value) / (y_maximum - y_minimum) * plot_height; };
+
+  FILE* file = fopen(path.c_str(), "w");
+  if (!file) {
+    fprintf(stderr, "cannot open %s\n", path.c_str());
+    return false;
+  }
+  fprintf(file, "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%.0f\" height=\"%.0f\" font-family=\"Lato, Helvetica, sans-serif\">\n", WIDTH, HEIGHT);
+  fprintf(file, "<rect width=\"100%%\" height=\"100%%\" fill=\"white\"/>\n");
+  fprintf(file, "<text x=\"%.1f\" y=\"30\" font-size=\"24\" text-anchor=\"middle\">%s</text>\n", LEFT + plot_width / 2, title);
+
+  double x_step = tick_step(span_s / time_scale);
+  for (double tick = 0.0; tick <= span_s / time_scale + 1e-9; tick += x_step) {
+    double position = x(envelope.start_s + tick * time_scale);
+    fprintf(file, "<line x1=\"%.1f\" y1=\"%.1f\" x2=\"%.1f\" y2=\"%.1f\" stroke=\"#b0b0b0\" stroke-width=\"0.8\"/>\n", position, TOP, position, TOP + plot_height);
+    fprintf(file, "<text x=\"%.1f\" y=\"%.1f\" font-size=\"12\" text-anchor=\"middle\">%g</text>\n", position, TOP + plot_height + 16, tick);
+  }
+  double y_step = tick_step(y_maximum - y_minimum);
+  for (double tick = ceil(y_minimum / y_step) * y_step; tick <= y_maximum; tick += y_step) {
+    double position = y(tick);
+    fprintf(file, "<line x1=\"%.1f\" y1=\"%.1f\" x2=\"%.1f\" y2=\"%.1f\" stroke=\"#b0b0b0\" stroke-width=\"0.8\"/>\n", LEFT, position, LEFT + plot_width, position);
+    fprintf(file, "<text x=\"%.1f\" y=\"%.1f\" font-size=\"12\" text-anchor=\"end\">%g</text>\n", LEFT - 6, position + 4, fabs(tick) < y_step * 1e-6 ? 0.0 : tick);
+  }
+  fprintf(file, "<text x=\"%.1f\" y=\"%.1f\" font-size=\"16\" text-anchor=\"middle\">Time (%s)</text>\n", LEFT + plot_width / 2, HEIGHT - 15, time_unit);
+  fprintf(file, "<text transform=\"translate(22 %.1f) rotate(-90)\" font-size=\"16\" text-anchor=\"middle\">%s</text>\n", TOP + plot_height / 2, y_label);
+
+  for (int series = 0; series < envelope.NUMBER_OF_SERIES; series++) {
+    fprintf(file, "<polyline fill=\"none\" stroke=\"%s\" stroke-width=\"1\" points=\"", colors[series].c_str());
+    double previous = NAN;
+    for (size_t bucket = 0; bucket < PLOT_BUCKETS; bucket++) {
+      size_t index = bucket * envelope.NUMBER_OF_SERIES + series;
+      double low = envelope.minimum[index], high = envelope.maximum[index];
+      if (low > high) continue;
+      double time_s = envelope.start_s + (bucket + 0.5) * envelope.bucket_s;
+      if (time_s > end_s) time_s = end_s;
+      bool is_rising = isnan(previous) || fabs(previous - low) <= fabs(previous - high);
+      fprintf(file, "%.1f,%.1f ", x(time_s), y(is_rising ? low : high));
+      if (high > low) fprintf(file, "%.1f,%.1f ", x(time_s), y(is_rising ? high : low));
+      previous = is_rising ? high : low;
+    }
+    fprintf(file, "\"/>\n");
+  }
+  fprintf(file, "<rect x=\"%.1f\" y=\"%.1f\" width=\"%.1f\" height=\"%.1f\" fill=\"none\" stroke=\"black\"/>\n", LEFT, TOP, plot_width, plot_height);
+
+  if (!names.empty()) {
+    // Put the legend in the corner the data crosses least
+    double legend_width = 150.0, legend_height = 20.0 * names.size() + 8;
+    double legend_x = LEFT + 8, legend_y = TOP + 8;
+    size_t fewest = SIZE_MAX;
+    for (int corner = 0; corner < 4; corner++) {
+      double corner_x = (corner & 1) ? LEFT + plot_width - legend_width - 8 : LEFT + 8;
+      double corner_y = (corner & 2) ? TOP + plot_height - legend_height - 8 : TOP + 8;
+      size_t crossings = 0;
+      for (size_t bucket = 0; bucket < PLOT_BUCKETS; bucket++) {
+        double position = x(envelope.start_s + (bucket + 0.5) * envelope.bucket_s);
+        if (position < corner_x || position > corner_x + legend_width) continue;
+        for (int series = 0; series < envelope.NUMBER_OF_SERIES; series++) {
+          size_t index = bucket * envelope.NUMBER_OF_SERIES + series;
+          if (envelope.minimum[index] > envelope.maximum[index]) continue;
+          double top = y(envelope.maximum[index]), bottom = y(envelope.minimum[index]);
+          if (bottom >= corner_y && top <= corner_y + legend_height) crossings++;
+        }
+      }
+      if (crossings < fewest) {
+        fewest = crossings;
+        legend_x = corner_x;
+        legend_y = corner_y;
+      }
+    }
+    fprintf(file, "<rect x=\"%.1f\" y=\"%.1f\" width=\"%.1f\" height=\"%.1f\" fill=\"white\" fill-opacity=\"0.8\" stroke=\"#cccccc\" rx=\"3\"/>\n", legend_x, legend_y, legend_width, legend_height);
+    for (size_t i = 0; i < names.size(); i++) {
+      double row = legend_y + 16 + 20.0 * i;
+      fprintf(file, "<line x1=\"%.1f\" y1=\"%.1f\" x2=\"%.1f\" y2=\"%.1f\" stroke=\"%s\" stroke-width=\"1.5\"/>\n", legend_x + 8, row - 4, legend_x + 38, row - 4, colors[i].c_str());
+      fprintf(file, "<text x=\"%.1f\" y=\"%.1f\" font-size=\"13\">%s</text>\n", legend_x + 46, row, names[i].c_str());
+    }
+  }
+  fprintf(file, "</svg>\n");
+  fclose(file);
+  return true;
+}
+
+/**
+ * Segments control steps into motions and measures each one. Records
+ * sharing a timestamp form one control step. A motion starts when any
+ * module moves and ends once every module has stayed stopped for
+ * MOTION_END_US. Per motion and module it measures rise time (10 to 90% of
+ * the step), overshoot past the final setpoint, settling time into a band
+ * of the larger of 2% of the step and ERROR_THRESHOLD_, and steady-state
+ * error; the skew is the spread of leg heights. Only the motion in progress
+ * is kept, and each motion goes to csv as soon as it ends.
+ */
+class MotionAnalyzer {
+  public:
+    MotionAnalyzer(double mm_per_unit, FILE* csv) : MM_PER_UNIT(mm_per_unit), CSV(csv) {
+      is_moving = false;
+      start_us = 0;
+      last_active_us = 0;
+      number_of_modules = 0;
+      motions = 0;
+      if (CSV) {
+        fprintf(CSV, "motion,start_s,duration_s,direction,travel_mm,rise_s,overshoot_mm,settle_s,steady_state_error_mm,max_skew_mm,rms_skew_mm\n");
+      }
+    }
+
+    /**
+     * Add one control step
+     * 
+     * @param time_us           time since the trace started in us
+     * @param modules           module states
+     * @param number_of_modules number of modules
+     */
+    void add_step(uint64_t time_us, ModuleState const* modules, int number_of_modules) {
+      bool is_active = false;
+      for (int i = 0; i < number_of_modules; i++) {
+        uint8_t state = modules[i].state;
+        if (state == MOVING_UP || state == MOVING_DOWN || state == STOPPING) is_active = true;
+      }
+      if (!is_moving && !is_active) return;
+      if (!is_moving) {
+        is_moving = true;
+        start_us = time_us;
+        this->number_of_modules = number_of_modules;
+        times_us.clear();
+        positions.clear();
+        setpoints.clear();
+      }
+      if (is_active) last_active_us = time_us;
+      times_us.push_back(time_us);
+      for (int i = 0; i < this->number_of_modules; i++) {
+        positions.push_back(modules[i].position);
+        setpoints.push_back(modules[i].setpoint);
+      }
+      if (time_us - last_active_us >= MOTION_END_US) finish();
+    }
+
+    /**
+     * Measure the motion in progress, if any, and forget it
+     */
+    void finish() {
+      if (!is_moving) return;
+      is_moving = false;
+      size_t steps = times_us.size();
+      int n = number_of_modules;
+
+      double rise_s = 0.0, overshoot = 0.0, settle_s = 0.0, steady_state_error = 0.0, travel = 0.0;
+      bool has_rise = false;
+      for (int i = 0; i < n; i++) {
+        ModuleMotion motion = measure(i);
+        travel += (motion.target - motion.start) / n;
+        if (motion.rise_s >= 0.0) {
+          rise_s = std::max(rise_s, motion.rise_s);
+          has_rise = true;
+        }
+        overshoot = std::max(overshoot, motion.overshoot);
+        settle_s = std::max(settle_s, motion.settle_s);
+        steady_state_error = std::max(steady_state_error, fabs(motion.target - motion.final_position));
+      }
+      double max_skew = 0.0, sum_squares = 0.0;
+      for (size_t step = 0; step < steps; step++) {
+        double low = INFINITY, high = -INFINITY;
+        for (int i = 0; i < n; i++) {
+          low = std::min(low, positions[step * n + i]);
+          high = std::max(high, positions[step * n + i]);
+        }
+        max_skew = std::max(max_skew, high - low);
+        sum_squares += (high - low) * (high - low);
+      }
+      double rms_skew = steps ? sqrt(sum_squares / steps) : 0.0;
+      double duration_s = (times_us.back() - start_us) * 1e-6;
+
+      motions++;
+      if (has_rise) rise_totals.add(rise_s);
+      overshoot_totals.add(overshoot * MM_PER_UNIT);
+      settle_totals.add(settle_s);
+      steady_state_totals.add(steady_state_error * MM_PER_UNIT);
+      skew_totals.add(max_skew * MM_PER_UNIT);
+      if (CSV) {
+        fprintf(
+          CSV,
+          "%lu,%.3f,%.3f,%s,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+          motions,
+          start_us * 1e-6,
+          duration_s,
+          travel >= 0.0 ? "up" : "down",
+          fabs(travel) * MM_PER_UNIT,
+          has_rise ? rise_s : -1.0,
+          overshoot * MM_PER_UNIT,
+          settle_s,
+          steady_state_error * MM_PER_UNIT,
+          max_skew * MM_PER_UNIT,
+          rms_skew * MM_PER_UNIT
+        );
+      }
+      if (motions <= (unsigned long) MAXIMUM_MOTIONS_SHOWN) {
+        printf(
+          "%6lu %9.3f %7.2f %5s %8.2f %7.3f %9.3f %8.3f %8.3f %8.3f\n",
+          motions,
+          start_us * 1e-6,
+          duration_s,
+          travel >= 0.0 ? "up" : "down",
+          fabs(travel) * MM_PER_UNIT,
+          has_rise ? rise_s : -1.0,
+          overshoot * MM_PER_UNIT,
+          settle_s,
+          steady_state_error * MM_PER_UNIT,
+          max_skew * MM_PER_UNIT
+        );
+      }
+    }
+
+    double const MM_PER_UNIT;
+    unsigned long motions;
+    Total rise_totals;
+    Total overshoot_totals;
+    Total settle_totals;
+    Total steady_state_totals;
+    Total skew_totals;
+
+  private:
+    FILE* const CSV;
+
+    bool is_moving;
+    uint64_t start_us;
+    uint64_t last_active_us;
+    int number_of_modules;
+    std::vector<uint64_t> times_us;
+    std::vector<double> positions;
+    std::vector<double> setpoints;
+
+    /**
+     * Measure one module over the motion in progress
+     * 
+     * @param module module index
+     * 
+     * @return module measurements
+     */
+    ModuleMotion measure(int module) const {
+      size_t steps = times_us.size();
+      int n = number_of_modules;
+      ModuleMotion motion;
+      motion.start = positions[module];
+      motion.target = setpoints[(steps - 1) * n + module];
+      motion.final_position = positions[(steps - 1) * n + module];
+      double step = motion.target - motion.start;
+      double direction = (step > 0.0) ? 1.0 : -1.0;
+      double band = std::max(0.02 * fabs(step), (double) ERROR_THRESHOLD_);
+
+      uint64_t rise_start_us = 0, rise_end_us = 0, last_outside_us = start_us;
+      bool has_rise_start = false, has_rise_end = false;
+      motion.overshoot = 0.0;
+      for (size_t i = 0; i < steps; i++) {
+        double position = positions[i * n + module];
+        double progress = direction * (position - motion.start);
+        if (!has_rise_start && progress >= 0.1 * fabs(step)) {
+          has_rise_start = true;
+          rise_start_us = times_us[i];
+        }
+        if (!has_rise_end && progress >= 0.9 * fabs(step)) {
+          has_rise_end = true;
+          rise_end_us = times_us[i];
+        }
+        motion.overshoot = std::max(motion.overshoot, direction * (position - motion.target));
+        if (fabs(position - motion.target) > band) last_outside_us = times_us[i];
+      }
+      bool is_step = fabs(step) >= band;
+      motion.rise_s = (is_step && has_rise_start && has_rise_end) ? (rise_end_us - rise_start_us) * 1e-6 : -1.0;
+      motion.settle_s = (last_outside_us - start_us) * 1e-6;
+      return motion;
+    }
+};
+
+/**
+ * Parse a pair of comma separated numbers
+ * 
+ * @param text   pair text
+ * @param first  first number
+ * @param second second number
+ * 
+ * @return if two numbers were parsed
+ */
+static bool parse_pair(char const* text, double& first, double& second) {
+  char* end = 0;
+  first = strtod(text, &end);
+  if (*end != ',') return false;
+  second = strtod(end + 1, &end);
+  return *end == '\0';
+}
+
+/**
+ * Analyze a trace captured from the master or written by elevate_sim
+ * --trace, optionally plotting trajectory_comparison (target path and leg
+ * heights), riser_error (setpoint minus height per leg) and riser_balance
+ * (largest height difference between legs)
+ */
+int main(int argc, char** argv) {
+  char const* trace_path = 0;
+  char const* csv_path = 0;
+  char const* plots_path = 0;
+  double window_start_s = 0.0;
+  double window_end_s = INFINITY;
+  double lead_mm = 8.0;
+  bool is_metric = false;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--csv") && i + 1 < argc) {
+      csv_path = argv[++i];
+    } else if (!strcmp(argv[i], "--plots") && i + 1 < argc) {
+      plots_path = argv[++i];
+    } else if (!strcmp(argv[i], "--window") && i + 1 < argc && parse_pair(argv[i + 1], window_start_s, window_end_s)) {
+      i++;
+    } else if (!strcmp(argv[i], "--lead") && i + 1 < argc) {
+      lead_mm = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--mm")) {
+      is_metric = true;
+    } else if (argv[i][0] != '-' && !trace_path) {
+      trace_path = argv[i];
+    } else {
+      trace_path = 0;
+      break;
+    }
+  }
+  if (!trace_path) {
+    fprintf(stderr, "usage: %s trace [--csv path] [--plots dir] [--window from,to] [--lead mm] [--mm]\n", argv[0]);
+    return 2;
+  }
+
+  TraceReader reader;
+  if (!reader.open(trace_path)) {
+    fprintf(stderr, "cannot read %s\n", trace_path);
+    return 1;
+  }
+  FILE* csv = csv_path ? fopen(csv_path, "w") : 0;
+  if (csv_path && !csv) {
+    fprintf(stderr, "cannot open %s\n", csv_path);
+    return 1;
+  }
+
+  double mm_per_unit = lead_mm / UNITS_PER_ROTATION;
+  double plot_per_unit = is_metric ? mm_per_unit : mm_per_unit / 25.4;
+  MotionAnalyzer analyzer(mm_per_unit, csv);
+  printf("%6s %9s %7s %5s %8s %7s %9s %8s %8s %8s\n",
+    "motion", "start s", "dur s", "dir", "travel", "rise s", "overshoot", "settle s", "ss error", "skew mm");
+
+  ModuleState modules[MAXIMUM_MODULES];
+  int number_of_modules = 0;
+  bool has_step = false;
+  uint32_t step_timestamp_us = 0;
+  uint64_t time_us = 0;
+  std::vector<Envelope> envelopes;
+
+  // Flush the step gathered so far to the analyzer and the plots
+  auto flush_step = [&]() {
+    if (!has_step) return;
+    for (int i = 0; i < number_of_modules; i++) {
+      if (!modules[i].is_valid) return;
+    }
+    analyzer.add_step(time_us, modules, number_of_modules);
+    if (!plots_path) return;
+    double time_s = time_us * 1e-6;
+    if (time_s < window_start_s || time_s > window_end_s) return;
+    if (envelopes.empty()) {
+      envelopes.push_back(Envelope(number_of_modules + 1, window_start_s, 1e-3));
+      envelopes.push_back(Envelope(number_of_modules, window_start_s, 1e-3));
+      envelopes.push_back(Envelope(1, window_start_s, 1e-3));
+    }
+    double target = 0.0, low = INFINITY, high = -INFINITY;
+    for (int i = 0; i < number_of_modules; i++) {
+      target += modules[i].setpoint / number_of_modules;
+      low = std::min(low, modules[i].position);
+      high = std::max(high, modules[i].position);
+      envelopes[0].add(time_s, i + 1, modules[i].position * plot_per_unit);
+      envelopes[1].add(time_s, i, (modules[i].setpoint - modules[i].position) * plot_per_unit);
+    }
+    envelopes[0].add(time_s, 0, target * plot_per_unit);
+    envelopes[2].add(time_s, 0, (high - low) * plot_per_unit);
+  };
+
+  TelemetryRecord record;
+  while (reader.next(record)) {
+    if (record.module >= MAXIMUM_MODULES) continue;
+    if (!has_step || record.timestamp_us != step_timestamp_us) {
+      flush_step();
+      if (has_step) time_us += (uint32_t) (record.timestamp_us - step_timestamp_us);
+      has_step = true;
+      step_timestamp_us = record.timestamp_us;
+    }
+    ModuleState& module = modules[record.module];
+    module.is_valid = true;
+    module.setpoint = record.setpoint;
+    module.position = record.height - record.height_offset;
+    module.state = record.state;
+    number_of_modules = std::max(number_of_modules, record.module + 1);
+  }
+  flush_step();
+  analyzer.finish();
+  if (csv) fclose(csv);
+
+  if (analyzer.motions > (unsigned long) MAXIMUM_MOTIONS_SHOWN) {
+    printf("... %lu more motions%s%s\n", analyzer.motions - MAXIMUM_MOTIONS_SHOWN, csv_path ? " in " : "", csv_path ? csv_path : "");
+  }
+  printf(
+    "trace: %.1f MB, %llu frames, %llu records dropped, %llu bytes skipped, %d modules, %.1f s\n",
+    reader.get_size() / 1e6,
+    (unsigned long long) reader.frames,
+    (unsigned long long) reader.missing,
+    (unsigned long long) reader.skipped_bytes,
+    number_of_modules,
+    time_us * 1e-6
+  );
+  printf("motions: %lu\n", analyzer.motions);
+  printf("rise time: mean %.3f s, max %.3f s\n", analyzer.rise_totals.mean(), analyzer.rise_totals.maximum);
+  printf("overshoot: mean %.3f mm, max %.3f mm\n", analyzer.overshoot_totals.mean(), analyzer.overshoot_totals.maximum);
+  printf("settling time: mean %.3f s, max %.3f s\n", analyzer.settle_totals.mean(), analyzer.settle_totals.maximum);
+  printf("steady-state error: mean %.3f mm, max %.3f mm\n", analyzer.steady_state_totals.mean(), analyzer.steady_state_totals.maximum);
+  printf("max skew: mean %.3f mm, max %.3f mm\n", analyzer.skew_totals.mean(), analyzer.skew_totals.maximum);
+
+  if (plots_path && !envelopes.empty()) {
+    double end_s = std::min(window_end_s, time_us * 1e-6);
+    char const* unit = is_metric ? "mm" : "in.";
+    std::string directory = plots_path;
+    std::vector<std::string> risers, colors;
+    for (int i = 0; i < number_of_modules; i++) {
+      risers.push_back("Riser " + std::to_string(i + 1));
+      colors.push_back(RISER_COLORS[i % 8]);
+    }
+    std::vector<std::string> trajectory_names = risers, trajectory_colors = colors;
+    trajectory_names.insert(trajectory_names.begin(), "Target Path");
+    trajectory_colors.insert(trajectory_colors.begin(), TARGET_COLOR);
+
+    bool is_written =
+      write_plot(directory + "/trajectory_comparison.svg", "Riser Height vs. Time",
+        (std::string("Riser Height (") + unit + ")").c_str(), envelopes[0], end_s, trajectory_names, trajectory_colors) &&
+      write_plot(directory + "/riser_error.svg", "Riser Height Error vs. Time",
+        (std::string("Riser Height Error (") + unit + ")").c_str(), envelopes[1], end_s, risers, colors) &&
+      write_plot(directory + "/riser_balance.svg", "Max Absolute Error Between Risers vs. Time",
+        (std::string("Max Absolute Error Between Risers (") + unit + ")").c_str(), envelopes[2], end_s,
+        std::vector<std::string>(), std::vector<std::string>(1, TARGET_COLOR));
+    if (!is_written) return 1;
+    printf("plots: %s/{trajectory_comparison,riser_error,riser_balance}.svg\n", plots_path);
+  }
+  return 0;
+}
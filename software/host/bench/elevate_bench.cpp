@@ -0,0 +1,453 @@
+/**
+ * @file elevate_bench.cpp
+ * 
+ * @brief control loop cycle-time and jitter benchmarks
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#include "as5600_model.h"
+#include "button_panel.h"
+#include "control_task.h"
+#include "cycle_counter.h"
+#include "desk_simulator.h"
+#include "elevate_constants.h"
+#include "elevate_minion.h"
+#include "elevate_module.h"
+#include "elevate_system.h"
+#include "latency_stats.h"
+#include "linux_hal.h"
+#include "minion_protocol.h"
+#include "minion_receiver.h"
+#include "pid_controller.h"
+#include "telemetry_buffer.h"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+static uint32_t const WARMUP_BIN_WIDTH = 1000;
+
+/**
+ * Time a benchmark body, warming up and sizing the histogram first
+ * 
+ * @param stats      latency recorder
+ * @param iterations number of timed iterations
+ * @param body       code under test, called with the iteration index
+ */
+template <typename Body>
+static void measure(LatencyStats& stats, int iterations, Body body) {
+  stats.set_bin_width(WARMUP_BIN_WIDTH);
+  for (int i = 0; i < iterations / 10 + 1; i++) {
+    uint32_t start = read_cycle_counter();
+    body(i);
+    stats.record(read_cycle_counter() - start);
+  }
+  stats.set_bin_width(2 * stats.get_percentile(99.0) / LatencyStats::NUMBER_OF_BINS + 1);
+  for (int i = 0; i < iterations; i++) {
+    uint32_t start = read_cycle_counter();
+    body(i);
+    stats.record(read_cycle_counter() - start);
+  }
+}
+
+/**
+ * Print one row of the results table
+ * 
+ * @param name  benchmark name
+ * @param stats latency recorder
+ */
+static void print_row(char const* name, LatencyStats const& stats) {
+  float ticks_per_ns = cycle_counter_ticks_per_us() / 1000.0;
+  printf(
+    "%-28s %9u %10.1f %10.1f %10.1f %10.1f\n",
+    name,
+    stats.get_count(),
+    stats.get_mean() / ticks_per_ns,
+    stats.get_percentile(99.0) / ticks_per_ns,
+    stats.get_maximum() / ticks_per_ns,
+    stats.get_standard_deviation() / ticks_per_ns
+  );
+}
+
+/**
+ * Print the jitter histogram of a benchmark
+ * 
+ * @param name  benchmark name
+ * @param stats latency recorder
+ */
+static void print_histogram(char const* name, LatencyStats const& stats) {
+  float ticks_per_ns = cycle_counter_ticks_per_us() / 1000.0;
+  uint32_t largest = stats.get_overflow();
+  for (int i = 0; i < LatencyStats::NUMBER_OF_BINS; i++) {
+    if (stats.get_bin(i) > largest) largest = stats.get_bin(i);
+  }
+  printf("\n%s\n", name);
+  for (int i = 0; i < LatencyStats::NUMBER_OF_BINS; i++) {
+    uint32_t bin = stats.get_bin(i);
+    if (bin == 0) continue;
+    printf("  < %8.1f ns %9u ", (i + 1) * stats.get_bin_width() / ticks_per_ns, bin);
+    for (uint32_t j = 0; j < 50 * bin / largest; j++) putchar('#');
+    putchar('\n');
+  }
+  printf("  overflow    %9u\n", stats.get_overflow());
+}
+
+/**
+ * Time the master loop() against the simulator, alternating up, stop and down
+ * 
+ * @param stats        latency recorder
+ * @param iterations   number of timed loops
+ * @param is_recording if every loop records telemetry
+ */
+static void bench_master_loop(LatencyStats& stats, int iterations, bool is_recording) {
+  DeskParameters parameters;
+  parameters.record_telemetry = is_recording;
+  DeskSimulator simulator = DeskSimulator(parameters);
+  simulator.setup();
+  simulator.run_for(1000000);
+  stats.set_bin_width(WARMUP_BIN_WIDTH);
+  simulator.set_loop_stats(&stats);
+  simulator.press_up(true);
+  simulator.run_for(2000000);
+  stats.set_bin_width(2 * stats.get_percentile(99.0) / LatencyStats::NUMBER_OF_BINS + 1);
+
+  int phase = 0;
+  while ((int) stats.get_count() < iterations) {
+    simulator.press_up(phase % 4 == 0);
+    simulator.press_down(phase % 4 == 2);
+    simulator.run_for(5000000);
+    simulator.get_serial().clear();
+    phase++;
+  }
+  simulator.set_loop_stats(0);
+}
+
+/**
+ * Time the master loop() without telemetry
+ * 
+ * @param stats      latency recorder
+ * @param iterations number of timed loops
+ */
+static void bench_master_loop(LatencyStats& stats, int iterations) {
+  bench_master_loop(stats, iterations, false);
+}
+
+/**
+ * Time the master loop() recording telemetry every loop
+ * 
+ * @param stats      latency recorder
+ * @param iterations number of timed loops
+ */
+static void bench_master_loop_telemetry(LatencyStats& stats, int iterations) {
+  bench_master_loop(stats, iterations, true);
+}
+
+/**
+ * Time recording one telemetry record, taking records back out in between
+ * so the buffer never fills
+ * 
+ * @param stats      latency recorder
+ * @param iterations number of timed records
+ */
+static void bench_telemetry_record(LatencyStats& stats, int iterations) {
+  TelemetryBuffer telemetry;
+  TelemetryRecord record = {};
+  measure(stats, iterations, [&](int i) {
+    record.timestamp_us = (uint32_t) i;
+    record.height = i;
+    telemetry.record(record);
+    if (i % 64 == 63) {
+      TelemetryRecord taken;
+      while (telemetry.take(taken)) {}
+    }
+  });
+}
+
+/**
+ * Time draining one telemetry record to a serial port as a trace frame
+ * 
+ * @param stats      latency recorder
+ * @param iterations number of timed frames
+ */
+static void bench_telemetry_drain(LatencyStats& stats, int iterations) {
+  TelemetryBuffer telemetry;
+  LinuxSerialPort serial;
+  TelemetryRecord record = {};
+  measure(stats, iterations, [&](int i) {
+    record.height = i;
+    telemetry.record(record);
+    telemetry.drain(&serial);
+    if (i % 1024 == 1023) serial.clear();
+  });
+}
+
+/**
+ * Time one PIDController instantiation with the sample time elapsed on every
+ * call, through the precomputed coefficients or with them worked out per call
+ * 
+ * @param stats         latency recorder
+ * @param iterations    number of timed calls
+ * @param is_fixed_rate if the clocked, precomputed-coefficient path is timed
+ */
+template <typename T>
+static void bench_pid(LatencyStats& stats, int iterations, bool is_fixed_rate) {
+  VirtualClock clock;
+  PIDTuning tuning = {
+    KP_,
+    KI_ + 2.0f,
+    KD_,
+    KT_,
+    DERIVATIVE_FILTER_MS_,
+    OUTPUT_RATE_,
+    MINIMUM_OUTPUT_,
+    MAXIMUM_OUTPUT_
+  };
+  PIDController<T> pid_controller = PIDController<T>(&clock, tuning, PID_RATE_MS_);
+  pid_controller.set_mode(ON);
+  float dt = PID_RATE_MS_ / 1000.0f;
+  volatile int sink = 0;
+  measure(stats, iterations, [&](int i) {
+    long setpoint = (i % 1000) * 41;
+    long input = (i % 1000) * 40 + (i % 7) * 13;
+    if (is_fixed_rate) {
+      clock.advance_micros(PID_RATE_MS_ * 1000);
+      sink = pid_controller.control(setpoint, input, i % 300);
+    } else {
+      sink = pid_controller.control(setpoint, input, i % 300, dt);
+    }
+  });
+  (void) sink;
+}
+
+/**
+ * Time the float PID through the precomputed coefficients
+ * 
+ * @param stats      latency recorder
+ * @param iterations number of timed calls
+ */
+static void bench_pid_float(LatencyStats& stats, int iterations) {
+  bench_pid<float>(stats, iterations, true);
+}
+
+/**
+ * Time the Q15.16 PID through the precomputed coefficients
+ * 
+ * @param stats      latency recorder
+ * @param iterations number of timed calls
+ */
+static void bench_pid_fixed(LatencyStats& stats, int iterations) {
+  bench_pid<Q16>(stats, iterations, true);
+}
+
+/**
+ * Time the float PID working its coefficients out per call
+ * 
+ * @param stats      latency recorder
+ * @param iterations number of timed calls
+ */
+static void bench_pid_float_any_rate(LatencyStats& stats, int iterations) {
+  bench_pid<float>(stats, iterations, false);
+}
+
+/**
+ * Time the Q15.16 PID working its coefficients out per call
+ * 
+ * @param stats      latency recorder
+ * @param iterations number of timed calls
+ */
+static void bench_pid_fixed_any_rate(LatencyStats& stats, int iterations) {
+  bench_pid<Q16>(stats, iterations, false);
+}
+
+/**
+ * Time ElevateModule::update while the module is moving
+ * 
+ * @param stats      latency recorder
+ * @param iterations number of timed calls
+ */
+static void bench_module_update(LatencyStats& stats, int iterations) {
+  VirtualClock clock;
+  LinuxGpio gpio;
+  LinuxPwm pwm;
+  LinuxRadio radio;
+  Hal hal = {&clock, &gpio, &pwm, &radio, 0, 0};
+  ModulePins const& pins = ELEVATE_BOARD_.modules[0];
+  ElevateModule module = ElevateModule(&hal, pins.pwm_pin, pins.pwm_channel, pins.direction_pin);
+  module.setup();
+  module.move(1 << 30, 0.0f);
+  measure(stats, iterations, [&](int i) {
+    clock.advance_micros(20000);
+    module.update(i * 80L, false, false);
+  });
+}
+
+/**
+ * Time ElevateMinion::update_height against a spinning simulated encoder
+ * 
+ * @param stats      latency recorder
+ * @param iterations number of timed calls
+ */
+static void bench_update_height(LatencyStats& stats, int iterations) {
+  VirtualClock clock;
+  LinuxGpio gpio;
+  LinuxI2c i2c;
+  As5600Model encoder;
+  i2c.attach(0x36, &encoder);
+  Hal hal = {&clock, &gpio, 0, 0, &i2c, 0};
+  ElevateMinion minion = ElevateMinion(&hal, 0, 1);
+  minion.setup();
+  volatile long sink = 0;
+  measure(stats, iterations, [&](int i) {
+    encoder.set_raw_angle((i * 37) % 4096);
+    sink = minion.update_height();
+  });
+  (void) sink;
+}
+
+/**
+ * Time one batched minion frame from encoding through MinionReceiver::receive
+ * to ElevateModule::take_sample
+ * 
+ * @param stats      latency recorder
+ * @param iterations number of timed calls
+ */
+static void bench_batch_round_trip(LatencyStats& stats, int iterations) {
+  VirtualClock clock;
+  LinuxGpio gpio;
+  LinuxPwm pwm;
+  Hal hal = {&clock, &gpio, &pwm, 0, 0, 0};
+  ModulePins const& pins = ELEVATE_BOARD_.modules[0];
+  ElevateModule module = ElevateModule(&hal, pins.pwm_pin, pins.pwm_channel, pins.direction_pin);
+  module.setup();
+  MinionReceiver receiver = MinionReceiver(&hal, &module, 1);
+  MinionBatch batch;
+  batch.id = 0;
+  batch.sequence = 0;
+  batch.count = 0;
+  uint8_t frame[MINION_MAXIMUM_BATCH_FRAME_SIZE];
+  measure(stats, iterations, [&](int i) {
+    batch.sequence++;
+    batch.count = 0;
+    for (int j = 0; j < 10; j++) {
+      MinionSample sample = {(uint32_t) (i * 20000 + j * 2000), i * 400 + j * 40, 20000, 0, 0};
+      add_minion_sample(batch, sample);
+    }
+    size_t len = encode_minion_batch(batch, frame, sizeof(frame));
+    receiver.receive(frame, (int) len);
+    module.take_sample();
+  });
+}
+
+/**
+ * Run ControlTask in real time and report its period jitter
+ * 
+ * @param duration_ms how long to run the task in ms
+ */
+static void bench_control_task(unsigned long duration_ms) {
+  LinuxClock clock;
+  LinuxGpio gpio;
+  LinuxPwm pwm;
+  LinuxRadio radio;
+  LinuxPeriodicTimer timer = LinuxPeriodicTimer(false);
+  Hal hal = {&clock, &gpio, &pwm, &radio, 0, &timer};
+  ButtonPanel button_panel = ButtonPanel(&hal, UP_SWITCH_PIN_, DOWN_SWITCH_PIN_);
+  ElevateSystem<NUMBER_OF_MODULES_> system(&hal, ELEVATE_BOARD_, &button_panel);
+  system.setup();
+  ControlTask<ElevateSystem<NUMBER_OF_MODULES_> > control_task(&hal, &system, CONTROL_PERIOD_US_);
+  control_task.start();
+  std::this_thread::sleep_for(std::chrono::milliseconds(duration_ms));
+  control_task.stop();
+
+  LatencyStats const& jitter = control_task.get_jitter_stats();
+  printf(
+    "\ncontrol task at %lu us, real time on Linux: %u periods, jitter mean %.1f us p99 %u us max %u us, %lu overruns\n",
+    control_task.get_period_us(),
+    jitter.get_count(),
+    jitter.get_mean(),
+    jitter.get_percentile(99.0),
+    jitter.get_maximum(),
+    control_task.get_overruns()
+  );
+}
+
+/**
+ * Time the master loop(), the PID controllers, the module and minion
+ * updates, a minion frame round trip and telemetry on the Linux hal, then
+ * run ControlTask in real time and report how far each period start strays
+ * from nominal
+ */
+int main(int argc, char** argv) {
+  int iterations = 200000;
+  bool histogram = false;
+  unsigned long control_task_ms = 1000;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--iterations") && i + 1 < argc) {
+      iterations = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--histogram")) {
+      histogram = true;
+    } else if (!strcmp(argv[i], "--control-task-ms") && i + 1 < argc) {
+      control_task_ms = strtoul(argv[++i], 0, 10);
+    } else {
+      fprintf(stderr, "usage: %s [--iterations N] [--histogram] [--control-task-ms N]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  LatencyStats overhead = LatencyStats(1);
+  measure(overhead, iterations, [](int) {});
+
+  struct Benchmark {
+    char const* name;
+    void (*run)(LatencyStats&, int);
+    LatencyStats stats;
+  } benchmarks[] = {
+    {"master loop()", bench_master_loop, LatencyStats(1)},
+    {"master loop() + telemetry", bench_master_loop_telemetry, LatencyStats(1)},
+    {"PID<float> fixed rate", bench_pid_float, LatencyStats(1)},
+    {"PID<Q16> fixed rate", bench_pid_fixed, LatencyStats(1)},
+    {"PID<float> any rate", bench_pid_float_any_rate, LatencyStats(1)},
+    {"PID<Q16> any rate", bench_pid_fixed_any_rate, LatencyStats(1)},
+    {"ElevateModule::update", bench_module_update, LatencyStats(1)},
+    {"ElevateMinion::update_height", bench_update_height, LatencyStats(1)},
+    {"10-sample batch round trip", bench_batch_round_trip, LatencyStats(1)},
+    {"TelemetryBuffer::record", bench_telemetry_record, LatencyStats(1)},
+    {"telemetry frame drain", bench_telemetry_drain, LatencyStats(1)},
+  };
+
+  printf("%-28s %9s %10s %10s %10s %10s\n", "benchmark", "samples", "mean ns", "p99 ns", "max ns", "jitter ns");
+  print_row("timer overhead", overhead);
+  for (Benchmark& benchmark : benchmarks) {
+    benchmark.run(benchmark.stats, iterations);
+    print_row(benchmark.name, benchmark.stats);
+  }
+
+  float ticks_per_us = cycle_counter_ticks_per_us();
+  LatencyStats const& loop_stats = benchmarks[0].stats;
+  printf(
+    "\nloop headroom: p99 %.2f us is %.3f%% of the %lu ms PID period and %.3f%% of a 1 kHz period\n",
+    loop_stats.get_percentile(99.0) / ticks_per_us,
+    loop_stats.get_percentile(99.0) / ticks_per_us / (PID_RATE_MS_ * 10.0),
+    PID_RATE_MS_,
+    loop_stats.get_percentile(99.0) / ticks_per_us / 10.0
+  );
+
+  LatencyStats const& telemetry_stats = benchmarks[1].stats;
+  printf(
+    "telemetry overhead: %.1f ns mean per loop, %.1f%% of loop(), %.4f%% of the %lu us control period\n",
+    (telemetry_stats.get_mean() - loop_stats.get_mean()) / ticks_per_us * 1000.0,
+    100.0 * (telemetry_stats.get_mean() - loop_stats.get_mean()) / loop_stats.get_mean(),
+    (telemetry_stats.get_mean() - loop_stats.get_mean()) / ticks_per_us / CONTROL_PERIOD_US_ * 100.0,
+    CONTROL_PERIOD_US_
+  );
+
+  if (control_task_ms > 0) bench_control_task(control_task_ms);
+
+  if (histogram) {
+    for (Benchmark& benchmark : benchmarks) {
+      print_histogram(benchmark.name, benchmark.stats);
+    }
+  }
+  return 0;
+}
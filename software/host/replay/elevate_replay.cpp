@@ -0,0 +1,219 @@
+/**
+ * @file elevate_replay.cpp
+ * 
+ * @brief command line driver for deterministic replay of a master capture
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#include "replay_engine.h"
+#include "cycle_counter.h"
+#include <chrono>
+#include <deque>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+/**
+ * Struct for the comparison of replayed telemetry against the capture
+ * 
+ * compared:            pairs of records compared
+ * differing:           pairs whose control fields differ
+ * first_difference_us: master time of the first differing record in us
+ * first_module:        module of the first differing record
+ */
+struct Comparison {
+  unsigned long compared = 0;
+  unsigned long differing = 0;
+  uint32_t first_difference_us = 0;
+  int first_module = -1;
+};
+
+/**
+ * Check if two telemetry records show the same control step; the timestamp
+ * is left out, as on hardware it is read once control() has started
+ * 
+ * @param a first record
+ * @param b second record
+ * 
+ * @return if module, state, status, setpoint, height and output match
+ */
+static bool is_same_step(TelemetryRecord const& a, TelemetryRecord const& b) {
+  return a.module == b.module &&
+    a.state == b.state &&
+    a.status == b.status &&
+    a.setpoint == b.setpoint &&
+    a.height == b.height &&
+    a.height_offset == b.height_offset &&
+    a.output == b.output;
+}
+
+/**
+ * Compare queued replayed and captured records in sequence order; records
+ * only one side has, because the captured master dropped them, are skipped
+ * 
+ * @param replayed   replayed records, oldest first
+ * @param captured   captured records, oldest first
+ * @param comparison running comparison
+ */
+static void compare(
+    std::deque<TelemetryRecord>& replayed,
+    std::deque<TelemetryRecord>& captured,
+    Comparison& comparison) {
+  while (!replayed.empty() && !captured.empty()) {
+    int16_t lead = (int16_t) (captured.front().sequence - replayed.front().sequence);
+    if (lead > 0) {
+      replayed.pop_front();
+      continue;
+    }
+    if (lead < 0) {
+      captured.pop_front();
+      continue;
+    }
+    comparison.compared++;
+    if (!is_same_step(replayed.front(), captured.front())) {
+      if (comparison.differing == 0) {
+        comparison.first_difference_us = captured.front().timestamp_us;
+        comparison.first_module = captured.front().module;
+      }
+      comparison.differing++;
+    }
+    replayed.pop_front();
+    captured.pop_front();
+  }
+}
+
+/**
+ * Replay a capture, from the desk with CAPTURE_INPUTS set or from
+ * elevate_sim --trace path --capture, as fast as possible or at --speed
+ * times the original timing. The options describe the captured master and
+ * must match it for an exact replay. The replayed telemetry is checked
+ * against the capture record by record, and its digest, FNV-1a over every
+ * replayed frame, lets two builds of the controller be compared on
+ * identical inputs.
+ */
+int main(int argc, char** argv) {
+  char const* capture_path = 0;
+  char const* trace_path = 0;
+  double speed = 0.0;
+  ReplayParameters parameters;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--speed") && i + 1 < argc) {
+      speed = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--modules") && i + 1 < argc) {
+      parameters.number_of_modules = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--trace") && i + 1 < argc) {
+      trace_path = argv[++i];
+    } else if (!strcmp(argv[i], "--no-extrapolation")) {
+      parameters.extrapolate_height = false;
+    } else if (!strcmp(argv[i], "--no-synchronization")) {
+      parameters.synchronize_legs = false;
+    } else if (!strcmp(argv[i], "--cascade")) {
+      parameters.cascaded_control = true;
+    } else if (argv[i][0] != '-' && !capture_path) {
+      capture_path = argv[i];
+    } else {
+      capture_path = 0;
+      break;
+    }
+  }
+  if (!capture_path || parameters.number_of_modules < 1 || parameters.number_of_modules > MAXIMUM_NUMBER_OF_MODULES_) {
+    fprintf(stderr, "usage: %s capture [--speed x] [--modules N] [--trace path] [--no-extrapolation] [--no-synchronization] [--cascade]\n", argv[0]);
+    return 2;
+  }
+
+  CaptureReader reader;
+  if (!reader.open(capture_path)) {
+    fprintf(stderr, "cannot open %s\n", capture_path);
+    return 1;
+  }
+  FILE* trace = trace_path ? fopen(trace_path, "wb") : 0;
+  if (trace_path && !trace) {
+    fprintf(stderr, "cannot open %s\n", trace_path);
+    return 1;
+  }
+
+  ReplayEngine engine(parameters);
+  LatencyStats loop_stats(250);
+  engine.set_loop_stats(&loop_stats);
+
+  std::deque<TelemetryRecord> replayed;
+  std::deque<TelemetryRecord> captured;
+  Comparison comparison;
+  uint64_t digest = 0xcbf29ce484222325ULL;
+  unsigned long replayed_records = 0;
+  unsigned long setups = 0;
+  bool has_start = false;
+  unsigned long long start_us = 0;
+  auto wall_start = std::chrono::steady_clock::now();
+
+  InputEvent event;
+  TelemetryRecord record;
+  CaptureItem item;
+  while ((item = reader.next(event, record)) != CAPTURE_END) {
+    if (item == CAPTURE_TELEMETRY) {
+      captured.push_back(record);
+      compare(replayed, captured, comparison);
+      continue;
+    }
+    engine.apply(event);
+    if (event.type == INPUT_SETUP) setups++;
+    if (!has_start) {
+      has_start = true;
+      start_us = engine.get_time_us();
+    }
+    if (speed > 0.0) {
+      double elapsed_s = (engine.get_time_us() - start_us) * 1e-6 / speed;
+      std::this_thread::sleep_until(wall_start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(elapsed_s)));
+    }
+    while (engine.get_telemetry().take(record)) {
+      uint8_t frame[TELEMETRY_FRAME_SIZE];
+      encode_telemetry_frame(record, frame);
+      for (size_t i = 0; i < TELEMETRY_FRAME_SIZE; i++) {
+        digest = (digest ^ frame[i]) * 0x100000001b3ULL;
+      }
+      if (trace) fwrite(frame, 1, TELEMETRY_FRAME_SIZE, trace);
+      replayed.push_back(record);
+      replayed_records++;
+    }
+    compare(replayed, captured, comparison);
+  }
+  if (trace) fclose(trace);
+
+  double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+  double replayed_s = (engine.get_time_us() - start_us) * 1e-6;
+  printf(
+    "capture: %.1f MB, %lu setups, %lu control steps, %lu radio frames, %lu inputs lost, %llu bytes skipped\n",
+    reader.get_bytes() / 1e6,
+    setups,
+    engine.get_control_steps(),
+    engine.get_radio_frames(),
+    reader.get_lost_inputs(),
+    reader.get_skipped_bytes()
+  );
+  printf("replayed: %.1f s in %.3f s wall (%.0fx real time)\n", replayed_s, wall_s, wall_s > 0.0 ? replayed_s / wall_s : 0.0);
+  printf(
+    "control loop us: mean %.2f p99 %.2f max %.2f\n",
+    loop_stats.get_mean() / cycle_counter_ticks_per_us(),
+    (float) loop_stats.get_percentile(99.0) / cycle_counter_ticks_per_us(),
+    (float) loop_stats.get_maximum() / cycle_counter_ticks_per_us()
+  );
+  printf("telemetry: %lu records, digest %016llx\n", replayed_records, (unsigned long long) digest);
+  if (comparison.compared == 0) {
+    printf("capture has no telemetry to compare against\n");
+  } else if (comparison.differing == 0) {
+    printf("matches capture: %lu of %lu records identical\n", comparison.compared, comparison.compared);
+  } else {
+    printf(
+      "differs from capture: %lu of %lu records, first at %.6f s on module %d\n",
+      comparison.differing,
+      comparison.compared,
+      comparison.first_difference_us * 1e-6,
+      comparison.first_module
+    );
+  }
+  if (reader.get_lost_inputs() > 0) printf("capture is missing inputs, the replay cannot be exact\n");
+  return comparison.differing > 0 ? 1 : 0;
+}
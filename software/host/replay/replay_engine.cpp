@@ -0,0 +1,320 @@
+/**
+ * @file replay_engine.cpp
+ * 
+ * @brief deterministic replay of captured master inputs
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#include "replay_engine.h"
+#include "cycle_counter.h"
+#include <string.h>
+
+/**
+ * Capture Reader constructor
+ */
+CaptureReader::CaptureReader() : buffer(BUFFER_SIZE) {
+  file = 0;
+  start = 0;
+  end = 0;
+  is_end_of_file = false;
+  bytes = 0;
+  skipped_bytes = 0;
+  lost_inputs = 0;
+  has_control_sequence = false;
+  has_radio_sequence = false;
+  next_control_sequence = 0;
+  next_radio_sequence = 0;
+}
+
+/**
+ * Capture Reader destructor
+ */
+CaptureReader::~CaptureReader() {
+  if (file) fclose(file);
+}
+
+/**
+ * Open a capture, a serial stream of input capture and telemetry frames
+ * 
+ * @param path capture path
+ * 
+ * @return if the file was opened
+ */
+bool CaptureReader::open(char const* path) {
+  file = fopen(path, "rb");
+  return file != 0;
+}
+
+/**
+ * Read the next frame, skipping bytes that do not start one
+ * 
+ * @param event  decoded input, set for CAPTURE_INPUT
+ * @param record decoded telemetry, set for CAPTURE_TELEMETRY
+ * 
+ * @return kind of frame read
+ */
+CaptureItem CaptureReader::next(InputEvent& event, TelemetryRecord& record) {
+  while (fill(INPUT_MAXIMUM_FRAME_SIZE) > 0) {
+    const uint8_t* data = buffer.data() + start;
+    size_t available = end - start;
+    if (data[0] == INPUT_SYNC) {
+      size_t len = decode_input_frame(data, available, event);
+      if (len > 0) {
+        start += len;
+        count_lost(event);
+        return CAPTURE_INPUT;
+      }
+    } else if (data[0] == TELEMETRY_SYNC && decode_telemetry_frame(data, available, record)) {
+      start += TELEMETRY_FRAME_SIZE;
+      return CAPTURE_TELEMETRY;
+    }
+    start++;
+    skipped_bytes++;
+  }
+  return CAPTURE_END;
+}
+
+/**
+ * Get how many bytes have been read from the capture
+ * 
+ * @return bytes read
+ */
+unsigned long long CaptureReader::get_bytes() const {
+  return bytes;
+}
+
+/**
+ * Get how many bytes did not start a valid frame
+ * 
+ * @return skipped bytes
+ */
+unsigned long long CaptureReader::get_skipped_bytes() const {
+  return skipped_bytes;
+}
+
+/**
+ * Get how many inputs the captured master dropped, from sequence gaps
+ * 
+ * @return lost inputs
+ */
+unsigned long CaptureReader::get_lost_inputs() const {
+  return lost_inputs;
+}
+
+/**
+ * Read ahead until len bytes are buffered or the file ends
+ * 
+ * @param len bytes wanted
+ * 
+ * @return bytes buffered
+ */
+size_t CaptureReader::fill(size_t len) {
+  if (end - start >= len || is_end_of_file || !file) return end - start;
+  memmove(buffer.data(), buffer.data() + start, end - start);
+  end -= start;
+  start = 0;
+  size_t read = fread(buffer.data() + end, 1, buffer.size() - end, file);
+  if (read == 0) is_end_of_file = true;
+  end += read;
+  bytes += read;
+  return end - start;
+}
+
+/**
+ * Count inputs missing before this one, per source
+ * 
+ * @param event input just read
+ */
+void CaptureReader::count_lost(InputEvent const& event) {
+  bool is_radio = event.type == INPUT_RADIO_FRAME;
+  bool& has_sequence = is_radio ? has_radio_sequence : has_control_sequence;
+  uint16_t& next_sequence = is_radio ? next_radio_sequence : next_control_sequence;
+  if (has_sequence) lost_inputs += (uint16_t) (event.sequence - next_sequence);
+  has_sequence = true;
+  next_sequence = (uint16_t) (event.sequence + 1);
+}
+
+/**
+ * Replay Engine constructor, builds the master as the sketch does on the
+ * Linux hal. Minion physics are not simulated; the legs are only what the
+ * captured frames say they were.
+ * 
+ * @param parameters replay configuration
+ */
+ReplayEngine::ReplayEngine(ReplayParameters const& parameters) : PARAMETERS(parameters) {
+  hal = {&clock, &gpio, &pwm, &radio, 0, 0, &storage, &serial};
+  loop_stats = 0;
+  is_setup = false;
+  has_time = false;
+  previous_timestamp_us = 0;
+  control_steps = 0;
+  radio_frames = 0;
+
+  int number_of_modules = PARAMETERS.number_of_modules;
+  button_panel.reset(new ButtonPanel(&hal, UP_SWITCH_PIN_, DOWN_SWITCH_PIN_));
+  system.reset(create_sim_system(&hal, number_of_modules, button_panel.get()));
+  ElevateModule* modules = system->get_modules();
+  for (int i = 0; i < number_of_modules; i++) {
+    if (!PARAMETERS.extrapolate_height) modules[i].set_maximum_extrapolation_us(0);
+    modules[i].set_cascaded_control(PARAMETERS.cascaded_control);
+  }
+  receiver.reset(new MinionReceiver(&hal, modules, number_of_modules));
+  system->set_synchronization(PARAMETERS.synchronize_legs);
+  system->set_telemetry(&telemetry);
+  radio.begin();
+}
+
+/**
+ * Apply one captured input at its time; a capture that starts after setup
+ * sets the system up at its first control step. The clock does not move
+ * during a step, so a simulator capture replays exactly; on hardware each
+ * step replays at the time update() started, so dt can differ from the
+ * original by the few us the step took.
+ * 
+ * @param event captured input
+ */
+void ReplayEngine::apply(InputEvent const& event) {
+  set_time(event.timestamp_us);
+  switch (event.type) {
+    case INPUT_SETUP:
+      set_button_levels(event.data[0]);
+      system->setup();
+      is_setup = true;
+      break;
+    case INPUT_CONTROL_STEP: {
+      set_button_levels(event.data[0]);
+      if (!is_setup) {
+        system->setup();
+        is_setup = true;
+      }
+      uint32_t start = loop_stats ? read_cycle_counter() : 0;
+      system->update();
+      system->control();
+      if (loop_stats) loop_stats->record(read_cycle_counter() - start);
+      receiver->send_sync_replies();
+      radio.clear_sent();
+      control_steps++;
+      break;
+    }
+    case INPUT_RADIO_FRAME:
+      receiver->receive(event.data, event.len);
+      radio_frames++;
+      break;
+  }
+}
+
+/**
+ * Get replayed master time, the 32 bit captured clock unwrapped
+ * 
+ * @return master time in us
+ */
+unsigned long long ReplayEngine::get_time_us() const {
+  return clock.micros();
+}
+
+/**
+ * Get number of control steps replayed
+ * 
+ * @return control steps
+ */
+unsigned long ReplayEngine::get_control_steps() const {
+  return control_steps;
+}
+
+/**
+ * Get number of radio frames replayed
+ * 
+ * @return radio frames
+ */
+unsigned long ReplayEngine::get_radio_frames() const {
+  return radio_frames;
+}
+
+/**
+ * Get a replayed module
+ * 
+ * @param module module index
+ * 
+ * @return elevate module
+ */
+ElevateModule& ReplayEngine::get_module(int module) {
+  return system->get_modules()[module];
+}
+
+/**
+ * Get the replayed system
+ * 
+ * @return elevate system
+ */
+ElevateSystemBase& ReplayEngine::get_system() {
+  return *system;
+}
+
+/**
+ * Get the replayed minion receiver
+ * 
+ * @return minion receiver
+ */
+MinionReceiver& ReplayEngine::get_receiver() {
+  return *receiver;
+}
+
+/**
+ * Get the buffer the replayed system records telemetry into; take records
+ * from it or it fills up
+ * 
+ * @return telemetry buffer
+ */
+TelemetryBuffer& ReplayEngine::get_telemetry() {
+  return telemetry;
+}
+
+/**
+ * Get the replayed master storage, fill it before the setup input to give
+ * the legs their stored gains
+ * 
+ * @return master storage
+ */
+LinuxStorage& ReplayEngine::get_storage() {
+  return storage;
+}
+
+/**
+ * Time every replayed control step into a latency recorder
+ * 
+ * @param loop_stats latency recorder, or null to stop timing
+ */
+void ReplayEngine::set_loop_stats(LatencyStats* loop_stats) {
+  this->loop_stats = loop_stats;
+}
+
+/**
+ * Move the virtual clock to a captured timestamp, unwrapping the 32 bit
+ * master clock; an input stamped a little before the previous one, as a
+ * radio frame racing a control step can be, keeps the clock where it is
+ * 
+ * @param timestamp_us captured master clock in us
+ */
+void ReplayEngine::set_time(uint32_t timestamp_us) {
+  if (!has_time) {
+    clock.set_micros(timestamp_us);
+    has_time = true;
+    previous_timestamp_us = timestamp_us;
+    return;
+  }
+  int32_t elapsed_us = (int32_t) (timestamp_us - previous_timestamp_us);
+  if (elapsed_us <= 0) return;
+  clock.advance_micros(elapsed_us);
+  previous_timestamp_us = timestamp_us;
+}
+
+/**
+ * Drive the button pins to captured levels
+ * 
+ * @param button_levels up switch level in bit 0, down switch level in bit 1
+ */
+void ReplayEngine::set_button_levels(uint8_t button_levels) {
+  gpio.set_input(UP_SWITCH_PIN_, button_levels & 0x01);
+  gpio.set_input(DOWN_SWITCH_PIN_, (button_levels >> 1) & 0x01);
+}
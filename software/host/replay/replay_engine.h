@@ -0,0 +1,130 @@
+/**
+ * @file replay_engine.h
+ * 
+ * @brief header file for deterministic replay of captured master inputs
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#ifndef REPLAY_ENGINE_H_
+#define REPLAY_ENGINE_H_
+
+#include "button_panel.h"
+#include "elevate_constants.h"
+#include "elevate_module.h"
+#include "elevate_system.h"
+#include "input_recorder.h"
+#include "latency_stats.h"
+#include "linux_hal.h"
+#include "minion_receiver.h"
+#include "sim_board.h"
+#include "telemetry_buffer.h"
+#include <memory>
+#include <stdio.h>
+#include <vector>
+
+/**
+ * Struct for replay configuration, which has to match the captured master
+ * for the replay to be exact
+ * 
+ * number_of_modules:  number of modules in the master, up to
+ *                     MAXIMUM_NUMBER_OF_MODULES_
+ * extrapolate_height: let the master extrapolate leg heights to the
+ *                     control instant
+ * synchronize_legs:   let the master correct legs against each other
+ * cascaded_control:   drive each leg through the position/velocity cascade
+ *                     instead of one position PID
+ */
+struct ReplayParameters {
+  int number_of_modules = 4;
+  bool extrapolate_height = true;
+  bool synchronize_legs = true;
+  bool cascaded_control = CASCADED_CONTROL_;
+};
+
+/**
+ * Capture Item
+ * 
+ * CAPTURE_END:       no frames left
+ * CAPTURE_INPUT:     input capture frame
+ * CAPTURE_TELEMETRY: telemetry frame the captured master sent
+ */
+enum CaptureItem {
+  CAPTURE_END,
+  CAPTURE_INPUT,
+  CAPTURE_TELEMETRY
+};
+
+class CaptureReader {
+  public:
+    CaptureReader();
+    ~CaptureReader();
+    bool open(char const* path);
+    CaptureItem next(InputEvent& event, TelemetryRecord& record);
+    unsigned long long get_bytes() const;
+    unsigned long long get_skipped_bytes() const;
+    unsigned long get_lost_inputs() const;
+
+  private:
+    static size_t const BUFFER_SIZE = 1 << 16;
+
+    FILE* file;
+    std::vector<uint8_t> buffer;
+    size_t start;
+    size_t end;
+    bool is_end_of_file;
+    unsigned long long bytes;
+    unsigned long long skipped_bytes;
+    unsigned long lost_inputs;
+    bool has_control_sequence;
+    bool has_radio_sequence;
+    uint16_t next_control_sequence;
+    uint16_t next_radio_sequence;
+
+    size_t fill(size_t len);
+    void count_lost(InputEvent const& event);
+};
+
+class ReplayEngine {
+  public:
+    explicit ReplayEngine(ReplayParameters const& parameters);
+    void apply(InputEvent const& event);
+    unsigned long long get_time_us() const;
+    unsigned long get_control_steps() const;
+    unsigned long get_radio_frames() const;
+    ElevateModule& get_module(int module);
+    ElevateSystemBase& get_system();
+    MinionReceiver& get_receiver();
+    TelemetryBuffer& get_telemetry();
+    LinuxStorage& get_storage();
+    void set_loop_stats(LatencyStats* loop_stats);
+
+  private:
+    ReplayParameters const PARAMETERS;
+
+    VirtualClock clock;
+    LinuxGpio gpio;
+    LinuxPwm pwm;
+    LinuxRadio radio;
+    LinuxStorage storage;
+    LinuxSerialPort serial;
+    Hal hal;
+
+    std::unique_ptr<MinionReceiver> receiver;
+    std::unique_ptr<ButtonPanel> button_panel;
+    std::unique_ptr<ElevateSystemBase> system;
+    TelemetryBuffer telemetry;
+
+    LatencyStats* loop_stats;
+
+    bool is_setup;
+    bool has_time;
+    uint32_t previous_timestamp_us;
+    unsigned long control_steps;
+    unsigned long radio_frames;
+
+    void set_time(uint32_t timestamp_us);
+    void set_button_levels(uint8_t button_levels);
+};
+
+#endif
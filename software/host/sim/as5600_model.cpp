@@ -0,0 +1,63 @@
+/**
+ * @file as5600_model.cpp
+ * 
+ * @brief simulated AS5600 magnetic encoder
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#include "as5600_model.h"
+#include <string.h>
+
+/**
+ * AS5600 Model constructor, magnet detected at nominal strength
+ */
+As5600Model::As5600Model() {
+  memset(registers, 0, sizeof(registers));
+  registers[STATUS_ADDRESS] = 0x20;
+  read_count = 0;
+}
+
+/**
+ * Read consecutive registers
+ * 
+ * @param register_address first register to read
+ * @param data             buffer for register contents
+ * @param len              number of bytes to read
+ * 
+ * @return if all registers exist
+ */
+bool As5600Model::read(uint8_t register_address, uint8_t* data, size_t len) {
+  if (register_address + len > NUMBER_OF_REGISTERS) return false;
+  memcpy(data, registers + register_address, len);
+  read_count++;
+  return true;
+}
+
+/**
+ * Set the raw angle registers
+ * 
+ * @param raw_angle raw angle, 0-4095
+ */
+void As5600Model::set_raw_angle(int raw_angle) {
+  registers[RAW_ANGLE_ADDRESS] = (uint8_t) ((raw_angle >> 8) & 0x0f);
+  registers[RAW_ANGLE_ADDRESS + 1] = (uint8_t) (raw_angle & 0xff);
+}
+
+/**
+ * Set the status register
+ * 
+ * @param status status register contents
+ */
+void As5600Model::set_status(uint8_t status) {
+  registers[STATUS_ADDRESS] = status;
+}
+
+/**
+ * Get number of bus reads served
+ * 
+ * @return number of reads
+ */
+unsigned long As5600Model::get_read_count() const {
+  return read_count;
+}
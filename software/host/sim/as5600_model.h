@@ -0,0 +1,32 @@
+/**
+ * @file as5600_model.h
+ * 
+ * @brief header file for simulated AS5600 magnetic encoder
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#ifndef AS5600_MODEL_H_
+#define AS5600_MODEL_H_
+
+#include "linux_hal.h"
+#include <stdint.h>
+
+class As5600Model : public I2cDevice {
+  public:
+    As5600Model();
+    bool read(uint8_t register_address, uint8_t* data, size_t len);
+    void set_raw_angle(int raw_angle);
+    void set_status(uint8_t status);
+    unsigned long get_read_count() const;
+
+  private:
+    static uint8_t const STATUS_ADDRESS = 0x0b;
+    static uint8_t const RAW_ANGLE_ADDRESS = 0x0c;
+    static uint8_t const NUMBER_OF_REGISTERS = 0x20;
+
+    uint8_t registers[NUMBER_OF_REGISTERS];
+    unsigned long read_count;
+};
+
+#endif
@@ -0,0 +1,596 @@
+/**
+ * @file desk_simulator.cpp
+ * 
+ * @brief faster-than-real-time desk simulator
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#include "desk_simulator.h"
+#include "cycle_counter.h"
+#include "elevate_constants.h"
+#include <math.h>
+#include <string.h>
+
+/**
+ * Leg constructor
+ * 
+ * @param physics    physical parameters shared by every leg
+ * @param parameters parameters for this leg
+ */
+DeskSimulator::Leg::Leg(LegPhysics const& physics, LegParameters const& parameters) :
+model(physics, parameters),
+timer(true),
+power(&clock, &gpio) {
+  clock_offset_us = parameters.clock_offset_us;
+  clock_drift_ppm = parameters.clock_drift_ppm;
+  pwm_channel = 0;
+  direction_pin = 0;
+  next_sample_us = 0;
+  next_transmit_us = 0;
+  next_sync_us = 0;
+}
+
+/**
+ * Desk Simulator constructor
+ * 
+ * @param parameters simulator configuration
+ */
+DeskSimulator::DeskSimulator(DeskParameters const& parameters) :
+PARAMETERS(parameters),
+timer(true),
+power(&clock, &gpio),
+radio_random(2023) {
+  hal = {&clock, &gpio, &pwm, &radio, 0, &timer, &storage, &serial, &power};
+  loop_stats = 0;
+  telemetry_frames = 0;
+  input_frames = 0;
+  is_setup = false;
+  next_master_us = 0;
+
+  int number_of_legs = (int) PARAMETERS.legs.size();
+  button_panel.reset(new ButtonPanel(&hal, UP_SWITCH_PIN_, DOWN_SWITCH_PIN_));
+  system.reset(create_sim_system(&hal, number_of_legs, button_panel.get()));
+  ElevateModule* modules = system->get_modules();
+  for (int i = 0; i < number_of_legs; i++) {
+    std::unique_ptr<Leg> leg(new Leg(PARAMETERS.physics, PARAMETERS.legs[i]));
+    leg->i2c.attach(ENCODER_ADDRESS, &leg->encoder);
+    leg->hal = {&leg->clock, &leg->gpio, 0, 0, &leg->i2c, PARAMETERS.light_sleep ? &leg->timer : 0, 0, 0, &leg->power};
+    sync_leg_clock(*leg);
+    leg->clock_sync.reset(new ClockSync(&leg->hal, (uint8_t) i));
+    leg->minion.reset(new ElevateMinion(&leg->hal, LOWER_LIMIT_SWITCH_PIN, UPPER_LIMIT_SWITCH_PIN));
+    leg->sampler.reset(new MinionSampler(
+      &leg->hal,
+      leg->minion.get(),
+      PARAMETERS.minion_sync_period_us > 0 ? leg->clock_sync.get() : 0,
+      PARAMETERS.minion_period_us,
+      PARAMETERS.minion_decimation
+    ));
+    if (PARAMETERS.light_sleep) {
+      leg->power.set_awake_per_wake(PARAMETERS.minion_poll_awake_us);
+      leg->power_manager.reset(new MinionPowerManager(
+        &leg->hal,
+        leg->minion.get(),
+        leg->sampler.get(),
+        PARAMETERS.minion_sync_period_us > 0 ? leg->clock_sync.get() : 0,
+        PARAMETERS.minion_idle_delay_ms,
+        PARAMETERS.minion_wake_poll_us,
+        PARAMETERS.minion_wake_distance
+      ));
+    }
+    leg->pwm_channel = (uint8_t) i;
+    leg->direction_pin = (uint8_t) (SIM_DIRECTION_PIN_ + i);
+    leg->next_sample_us = 0;
+    leg->next_transmit_us = (unsigned long long) PARAMETERS.minion_transmit_period_us * (i + 1) / number_of_legs;
+    if (!PARAMETERS.extrapolate_height) modules[i].set_maximum_extrapolation_us(0);
+    modules[i].set_cascaded_control(PARAMETERS.cascaded_control);
+    legs.push_back(std::move(leg));
+  }
+  link_free_us.assign(2 * number_of_legs, 0);
+  receiver.reset(new MinionReceiver(&hal, modules, number_of_legs));
+  system->set_synchronization(PARAMETERS.synchronize_legs);
+  if (PARAMETERS.record_telemetry) system->set_telemetry(&telemetry);
+  if (PARAMETERS.record_inputs) system->set_input_recorder(&input_recorder);
+  if (PARAMETERS.use_control_task || PARAMETERS.light_sleep) {
+    control_task.reset(new ControlTask<ElevateSystemBase>(&hal, system.get(), PARAMETERS.master_period_us));
+    control_task->set_receiver(receiver.get());
+  }
+  if (PARAMETERS.light_sleep) {
+    power_manager.reset(new PowerManager<ElevateSystemBase>(
+      &hal,
+      system.get(),
+      button_panel.get(),
+      control_task.get(),
+      PARAMETERS.master_idle_delay_ms
+    ));
+  }
+}
+
+/**
+ * Desk Simulator destructor
+ */
+DeskSimulator::~DeskSimulator() {
+  if (control_task) control_task->stop();
+}
+
+/**
+ * Set up minions and master
+ */
+void DeskSimulator::setup() {
+  if (!is_setup) {
+    radio.begin();
+    for (size_t i = 0; i < legs.size(); i++) {
+      sync_leg_inputs(*legs[i]);
+      legs[i]->minion->setup();
+      if (legs[i]->power_manager) legs[i]->sampler->start();
+    }
+    system->setup();
+    if (control_task) control_task->start();
+    is_setup = true;
+  }
+}
+
+/**
+ * Hold or release the up button
+ * 
+ * @param pressed whether the button is held
+ */
+void DeskSimulator::press_up(bool pressed) {
+  gpio.set_input(UP_SWITCH_PIN_, pressed ? HAL_LOW : HAL_HIGH);
+}
+
+/**
+ * Hold or release the down button
+ * 
+ * @param pressed whether the button is held
+ */
+void DeskSimulator::press_down(bool pressed) {
+  gpio.set_input(DOWN_SWITCH_PIN_, pressed ? HAL_LOW : HAL_HIGH);
+}
+
+/**
+ * Advance the simulation by one physics step, running every minion sample,
+ * transmission and sync request and every master period that falls due on
+ * the shared virtual timeline. A sleeping master or minion runs nothing
+ * until one of its wake sources fires: the master checks every master
+ * period, a minion every physics step.
+ */
+void DeskSimulator::step() {
+  setup();
+  double dt = PARAMETERS.physics_step_us * 1e-6;
+  for (size_t i = 0; i < legs.size(); i++) {
+    Leg& leg = *legs[i];
+    leg.model.step(get_leg_duty((int) i), get_leg_direction_up((int) i), dt);
+    sync_leg_inputs(leg);
+  }
+  clock.advance_micros(PARAMETERS.physics_step_us);
+
+  unsigned long long now = clock.micros();
+  for (size_t i = 0; i < legs.size(); i++) {
+    Leg& leg = *legs[i];
+    sync_leg_clock(leg);
+    if (leg.power_manager && !wake_leg(leg)) continue;
+    while (leg.next_sample_us <= now) {
+      if (leg.power_manager) {
+        leg.timer.tick();
+      } else {
+        leg.sampler->sample();
+      }
+      leg.next_sample_us += PARAMETERS.minion_period_us;
+    }
+    while (leg.next_transmit_us <= now) {
+      if (leg.power_manager && leg.power_manager->update()) break;
+      transmit_leg((int) i);
+      leg.next_transmit_us += PARAMETERS.minion_transmit_period_us;
+    }
+    while (PARAMETERS.minion_sync_period_us > 0 && leg.next_sync_us <= now && !leg.power.is_asleep()) {
+      uint8_t request[MINION_SYNC_REQUEST_FRAME_SIZE];
+      size_t len = leg.clock_sync->encode_request(request, sizeof(request));
+      send_frame((int) i, MASTER, request, len);
+      leg.next_sync_us += PARAMETERS.minion_sync_period_us;
+    }
+  }
+  deliver_frames();
+  while (next_master_us <= now) {
+    if (power_manager) {
+      if (!power.update()) {
+        next_master_us += PARAMETERS.master_period_us;
+        continue;
+      }
+      // Woken, loop() restarts the control task before its first tick
+      if (power_manager->is_asleep()) power_manager->update();
+    }
+    uint32_t start = loop_stats ? read_cycle_counter() : 0;
+    if (control_task) {
+      timer.tick();
+    } else {
+      system->update();
+      system->control();
+    }
+    if (loop_stats) loop_stats->record(read_cycle_counter() - start);
+    if (!control_task) receiver->send_sync_replies();
+    broadcast_replies();
+    if (PARAMETERS.record_inputs) input_frames += input_recorder.drain(&serial);
+    if (PARAMETERS.record_telemetry) telemetry_frames += telemetry.drain(&serial);
+    if (power_manager) power_manager->update();
+    next_master_us += PARAMETERS.master_period_us;
+  }
+}
+
+/**
+ * Advance the simulation by a duration
+ * 
+ * @param duration_us duration in us
+ */
+void DeskSimulator::run_for(unsigned long long duration_us) {
+  unsigned long long end_us = clock.micros() + duration_us;
+  while (clock.micros() < end_us) {
+    step();
+  }
+}
+
+/**
+ * Get simulated time
+ * 
+ * @return simulated time in us
+ */
+unsigned long long DeskSimulator::get_time_us() const {
+  return clock.micros();
+}
+
+/**
+ * Get number of simulated legs
+ * 
+ * @return number of legs
+ */
+int DeskSimulator::get_number_of_legs() const {
+  return (int) legs.size();
+}
+
+/**
+ * Get a leg model
+ * 
+ * @param leg leg index
+ * 
+ * @return leg model
+ */
+LegModel& DeskSimulator::get_leg(int leg) {
+  return legs[leg]->model;
+}
+
+/**
+ * Get the motor duty the master commands for a leg
+ * 
+ * @param leg leg index
+ * 
+ * @return motor duty, 0-1
+ */
+double DeskSimulator::get_leg_duty(int leg) const {
+  uint8_t channel = legs[leg]->pwm_channel;
+  double full_scale = (double) ((1u << pwm.get_resolution_bits(channel)) - 1);
+  if (full_scale <= 0.0) return 0.0;
+  double duty = pwm.get_duty(channel) / full_scale;
+  return duty > 1.0 ? 1.0 : duty;
+}
+
+/**
+ * Get the direction the master commands for a leg
+ * 
+ * @param leg leg index
+ * 
+ * @return whether the leg is commanded upwards
+ */
+bool DeskSimulator::get_leg_direction_up(int leg) const {
+  return gpio.digital_read(legs[leg]->direction_pin) == HAL_HIGH;
+}
+
+/**
+ * Get the spread between the highest and lowest leg
+ * 
+ * @return leg skew in m
+ */
+double DeskSimulator::get_skew() const {
+  double minimum = legs[0]->model.get_height();
+  double maximum = minimum;
+  for (size_t i = 1; i < legs.size(); i++) {
+    double height = legs[i]->model.get_height();
+    if (height < minimum) minimum = height;
+    if (height > maximum) maximum = height;
+  }
+  return maximum - minimum;
+}
+
+/**
+ * Get the master module driving a leg
+ * 
+ * @param leg leg index
+ * 
+ * @return elevate module
+ */
+ElevateModule& DeskSimulator::get_module(int leg) {
+  return system->get_modules()[leg];
+}
+
+/**
+ * Get the master system
+ * 
+ * @return elevate system
+ */
+ElevateSystemBase& DeskSimulator::get_system() {
+  return *system;
+}
+
+/**
+ * Get the master power manager
+ * 
+ * @return power manager, or null without light sleep
+ */
+PowerManager<ElevateSystemBase> const* DeskSimulator::get_power_manager() const {
+  return power_manager.get();
+}
+
+/**
+ * Get the master light sleep backend
+ * 
+ * @return master power backend
+ */
+LinuxPower const& DeskSimulator::get_master_power() const {
+  return power;
+}
+
+/**
+ * Get the power manager of a minion
+ * 
+ * @param leg leg index
+ * 
+ * @return minion power manager, or null without light sleep
+ */
+MinionPowerManager const* DeskSimulator::get_minion_power_manager(int leg) const {
+  return legs[leg]->power_manager.get();
+}
+
+/**
+ * Get the light sleep backend of a minion
+ * 
+ * @param leg leg index
+ * 
+ * @return minion power backend
+ */
+LinuxPower const& DeskSimulator::get_leg_power(int leg) const {
+  return legs[leg]->power;
+}
+
+/**
+ * Get the minion of a leg
+ * 
+ * @param leg leg index
+ * 
+ * @return minion
+ */
+ElevateMinion const& DeskSimulator::get_minion(int leg) const {
+  return *legs[leg]->minion;
+}
+
+/**
+ * Get the clock of a minion, offset and drifting from the master clock
+ * 
+ * @param leg leg index
+ * 
+ * @return minion clock
+ */
+Clock const& DeskSimulator::get_leg_clock(int leg) const {
+  return legs[leg]->clock;
+}
+
+/**
+ * Get the master minion receiver
+ * 
+ * @return minion receiver
+ */
+MinionReceiver& DeskSimulator::get_receiver() {
+  return *receiver;
+}
+
+/**
+ * Get the clock sync of a minion
+ * 
+ * @param leg leg index
+ * 
+ * @return clock sync
+ */
+ClockSync const& DeskSimulator::get_clock_sync(int leg) const {
+  return *legs[leg]->clock_sync;
+}
+
+/**
+ * Get the master hardware abstraction layer
+ * 
+ * @return master hal
+ */
+Hal* DeskSimulator::get_master_hal() {
+  return &hal;
+}
+
+/**
+ * Get the master non-volatile storage, copy another simulator's into it
+ * before setup() to simulate a power cycle
+ * 
+ * @return master storage
+ */
+LinuxStorage& DeskSimulator::get_storage() {
+  return storage;
+}
+
+/**
+ * Get the master serial port, which receives telemetry when it is recorded
+ * 
+ * @return master serial port
+ */
+LinuxSerialPort& DeskSimulator::get_serial() {
+  return serial;
+}
+
+/**
+ * Get the master telemetry buffer
+ * 
+ * @return telemetry buffer
+ */
+TelemetryBuffer const& DeskSimulator::get_telemetry() const {
+  return telemetry;
+}
+
+/**
+ * Get the master input recorder
+ * 
+ * @return input recorder
+ */
+InputRecorder const& DeskSimulator::get_input_recorder() const {
+  return input_recorder;
+}
+
+/**
+ * Get how many telemetry frames went to the master serial port
+ * 
+ * @return number of telemetry frames
+ */
+unsigned long long DeskSimulator::get_telemetry_frames() const {
+  return telemetry_frames;
+}
+
+/**
+ * Get how many input capture frames went to the master serial port
+ * 
+ * @return number of capture frames
+ */
+unsigned long long DeskSimulator::get_input_frames() const {
+  return input_frames;
+}
+
+/**
+ * Time every master loop() into a latency recorder
+ * 
+ * @param loop_stats latency recorder, or null to stop timing
+ */
+void DeskSimulator::set_loop_stats(LatencyStats* loop_stats) {
+  this->loop_stats = loop_stats;
+}
+
+/**
+ * Copy leg physics onto its encoder and limit switch pins
+ * 
+ * @param leg simulated leg
+ */
+void DeskSimulator::sync_leg_inputs(Leg& leg) {
+  leg.encoder.set_raw_angle(leg.model.get_raw_angle());
+  leg.gpio.set_input(LOWER_LIMIT_SWITCH_PIN, leg.model.lower_limit_switch_pressed() ? HAL_LOW : HAL_HIGH);
+  leg.gpio.set_input(UPPER_LIMIT_SWITCH_PIN, leg.model.upper_limit_switch_pressed() ? HAL_LOW : HAL_HIGH);
+}
+
+/**
+ * Set a minion clock from the master clock with its offset and drift, so
+ * clock sync has a real offset to find
+ * 
+ * @param leg simulated leg
+ */
+void DeskSimulator::sync_leg_clock(Leg& leg) {
+  double master_us = (double) clock.micros();
+  leg.clock.set_micros((unsigned long long) (leg.clock_offset_us + llround(master_us * (1.0 + leg.clock_drift_ppm * 1e-6))));
+}
+
+/**
+ * Check a sleeping minion's wake sources and run the poll it wakes for, as
+ * its loop() does between light sleeps, restarting its schedules once it
+ * samples at full rate again
+ * 
+ * @param leg simulated leg
+ * 
+ * @return if the minion is awake and sampling
+ */
+bool DeskSimulator::wake_leg(Leg& leg) {
+  if (!leg.power.update()) return false;
+  if (leg.power_manager->is_sampling()) return true;
+  if (leg.power_manager->update()) return false;
+  unsigned long long now = clock.micros();
+  leg.next_sample_us = now + PARAMETERS.minion_period_us;
+  leg.next_transmit_us = now;
+  leg.next_sync_us = now;
+  return true;
+}
+
+/**
+ * Send every queued minion sample to the master, as the minion loop() does
+ * 
+ * @param leg leg index
+ */
+void DeskSimulator::transmit_leg(int leg) {
+  uint8_t frame[MINION_MAXIMUM_BATCH_FRAME_SIZE];
+  size_t len;
+  while ((len = legs[leg]->sampler->encode_frame((uint8_t) leg, frame, sizeof(frame))) > 0) {
+    send_frame(leg, MASTER, frame, len);
+  }
+}
+
+/**
+ * Put a frame in the air with the configured latency, never ahead of an
+ * earlier frame on the same link; a frame longer than any in the protocol
+ * is dropped
+ * 
+ * @param source      leg index, or MASTER
+ * @param destination leg index, or MASTER
+ * @param data        frame payload
+ * @param len         payload length in bytes
+ */
+void DeskSimulator::send_frame(int source, int destination, const uint8_t* data, size_t len) {
+  if (len > sizeof(Frame::data)) return;
+  unsigned long long latency_us = PARAMETERS.radio_latency_us;
+  if (PARAMETERS.radio_jitter_us > 0) {
+    latency_us += std::uniform_int_distribution<unsigned long>(0, PARAMETERS.radio_jitter_us)(radio_random);
+  }
+  unsigned long long& free_us = (source == MASTER) ?
+    link_free_us[legs.size() + destination] :
+    link_free_us[source];
+  unsigned long long deliver_us = clock.micros() + latency_us;
+  if (deliver_us < free_us) deliver_us = free_us;
+  free_us = deliver_us;
+
+  std::multimap<unsigned long long, Frame>::iterator in_flight = frames_in_flight.emplace(deliver_us, Frame());
+  Frame& frame = in_flight->second;
+  frame.destination = destination;
+  frame.len = len;
+  memcpy(frame.data, data, len);
+}
+
+/**
+ * Hand every frame whose latency has passed to the master receive_callback
+ * or the minion sync receive callback
+ */
+void DeskSimulator::deliver_frames() {
+  unsigned long long now = clock.micros();
+  while (!frames_in_flight.empty() && frames_in_flight.begin()->first <= now) {
+    Frame const& frame = frames_in_flight.begin()->second;
+    if (frame.destination == MASTER) {
+      if (power.is_asleep()) {
+        frames_in_flight.erase(frames_in_flight.begin());
+        continue;
+      }
+      receiver->receive(frame.data, (int) frame.len);
+      if (PARAMETERS.record_inputs) input_recorder.record_radio_frame(clock.micros(), frame.data, (int) frame.len);
+    } else if (!legs[frame.destination]->power.is_asleep()) {
+      legs[frame.destination]->clock_sync->receive(frame.data, (int) frame.len);
+    }
+    frames_in_flight.erase(frames_in_flight.begin());
+  }
+}
+
+/**
+ * Put every frame the master sent since the last call in the air to each leg
+ */
+void DeskSimulator::broadcast_replies() {
+  std::vector<std::vector<uint8_t> > const& replies = radio.get_sent();
+  for (size_t i = 0; i < replies.size(); i++) {
+    for (size_t j = 0; j < legs.size(); j++) {
+      send_frame(MASTER, (int) j, replies[i].data(), replies[i].size());
+    }
+  }
+  radio.clear_sent();
+}
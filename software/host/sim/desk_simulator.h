@@ -0,0 +1,220 @@
+/**
+ * @file desk_simulator.h
+ * 
+ * @brief header file for faster-than-real-time desk simulator
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#ifndef DESK_SIMULATOR_H_
+#define DESK_SIMULATOR_H_
+
+#include "as5600_model.h"
+#include "button_panel.h"
+#include "clock_sync.h"
+#include "control_task.h"
+#include "elevate_constants.h"
+#include "elevate_minion.h"
+#include "elevate_module.h"
+#include "elevate_system.h"
+#include "input_recorder.h"
+#include "latency_stats.h"
+#include "leg_model.h"
+#include "linux_hal.h"
+#include "minion_power_manager.h"
+#include "minion_receiver.h"
+#include "minion_sampler.h"
+#include "power_manager.h"
+#include "sim_board.h"
+#include "telemetry_buffer.h"
+#include <map>
+#include <memory>
+#include <random>
+#include <vector>
+
+/**
+ * Struct for desk simulator configuration
+ * 
+ * physics:                   physical parameters shared by every leg
+ * legs:                      per-leg parameters, one entry per leg, up to
+ *                            MAXIMUM_NUMBER_OF_MODULES_ legs
+ * physics_step_us:           physics integration step in us
+ * master_period_us:          period of the master loop() in us
+ * minion_period_us:          period between minion encoder reads in us
+ * minion_decimation:         encoder reads per sample sent to the master
+ * minion_transmit_period_us: period between minion transmissions in us
+ * minion_sync_period_us:     period between minion clock sync requests in
+ *                            us, 0 to leave samples on the minion clock
+ * radio_latency_us:          fixed delay of every radio frame in us
+ * radio_jitter_us:           extra delay of each radio frame, uniform up to
+ *                            this many us; frames on one link stay in order
+ * extrapolate_height:        let the master extrapolate leg heights to the
+ *                            control instant
+ * synchronize_legs:          let the master correct legs against each other
+ * cascaded_control:          drive each leg through the position/velocity
+ *                            cascade instead of one position PID
+ * use_control_task:          run the master through ControlTask on a
+ *                            simulated-tick timer thread instead of calling
+ *                            loop() inline
+ * record_telemetry:          record master control telemetry and drain it
+ *                            to the master serial port after every loop()
+ * record_inputs:             record master inputs for replay and drain them
+ *                            to the master serial port after every loop()
+ * light_sleep:               let the master and minions light sleep while
+ *                            idle; runs the master through ControlTask and
+ *                            each minion sampler on a simulated-tick timer
+ * master_idle_delay_ms:      master idle time before sleeping in ms
+ * minion_idle_delay_ms:      minion still time before sleeping in ms
+ * minion_wake_poll_us:       minion light sleep between encoder polls in us
+ * minion_wake_distance:      leg motion that wakes a minion in encoder units
+ * minion_poll_awake_us:      time a minion is awake per encoder poll in us,
+ *                            about 500 us to wake from light sleep and
+ *                            135 us to read the encoder over 400 kHz I2C
+ */
+struct DeskParameters {
+  LegPhysics physics;
+  std::vector<LegParameters> legs = std::vector<LegParameters>(4);
+  unsigned long physics_step_us = 1000;
+  unsigned long master_period_us = 1000;
+  unsigned long minion_period_us = 1000;
+  uint8_t minion_decimation = 2;
+  unsigned long minion_transmit_period_us = 20000;
+  unsigned long minion_sync_period_us = 500000;
+  unsigned long radio_latency_us = 0;
+  unsigned long radio_jitter_us = 0;
+  bool extrapolate_height = true;
+  bool synchronize_legs = true;
+  bool cascaded_control = CASCADED_CONTROL_;
+  bool use_control_task = false;
+  bool record_telemetry = false;
+  bool record_inputs = false;
+  bool light_sleep = false;
+  unsigned long master_idle_delay_ms = IDLE_SLEEP_DELAY_MS_;
+  unsigned long minion_idle_delay_ms = 5000;
+  unsigned long minion_wake_poll_us = 25000;
+  long minion_wake_distance = 16;
+  unsigned long minion_poll_awake_us = 640;
+};
+
+class DeskSimulator {
+  public:
+    explicit DeskSimulator(DeskParameters const& parameters);
+    ~DeskSimulator();
+    void setup();
+    void press_up(bool pressed);
+    void press_down(bool pressed);
+    void step();
+    void run_for(unsigned long long duration_us);
+    unsigned long long get_time_us() const;
+    int get_number_of_legs() const;
+    LegModel& get_leg(int leg);
+    double get_leg_duty(int leg) const;
+    bool get_leg_direction_up(int leg) const;
+    double get_skew() const;
+    ElevateModule& get_module(int leg);
+    ElevateSystemBase& get_system();
+    PowerManager<ElevateSystemBase> const* get_power_manager() const;
+    LinuxPower const& get_master_power() const;
+    MinionPowerManager const* get_minion_power_manager(int leg) const;
+    LinuxPower const& get_leg_power(int leg) const;
+    ElevateMinion const& get_minion(int leg) const;
+    Clock const& get_leg_clock(int leg) const;
+    MinionReceiver& get_receiver();
+    ClockSync const& get_clock_sync(int leg) const;
+    Hal* get_master_hal();
+    LinuxStorage& get_storage();
+    LinuxSerialPort& get_serial();
+    TelemetryBuffer const& get_telemetry() const;
+    InputRecorder const& get_input_recorder() const;
+    unsigned long long get_telemetry_frames() const;
+    unsigned long long get_input_frames() const;
+    void set_loop_stats(LatencyStats* loop_stats);
+
+  private:
+    static uint8_t const LOWER_LIMIT_SWITCH_PIN = 0;
+    static uint8_t const UPPER_LIMIT_SWITCH_PIN = 1;
+    static uint8_t const ENCODER_ADDRESS = 0x36;
+    static int const MASTER = -1;
+
+    /**
+     * Struct for one simulated leg and its minion
+     */
+    struct Leg {
+      LegModel model;
+      As5600Model encoder;
+      VirtualClock clock;
+      LinuxGpio gpio;
+      LinuxI2c i2c;
+      LinuxPeriodicTimer timer;
+      LinuxPower power;
+      Hal hal;
+      std::unique_ptr<ClockSync> clock_sync;
+      std::unique_ptr<ElevateMinion> minion;
+      std::unique_ptr<MinionSampler> sampler;
+      std::unique_ptr<MinionPowerManager> power_manager;
+      long long clock_offset_us;
+      double clock_drift_ppm;
+      uint8_t pwm_channel;
+      uint8_t direction_pin;
+      unsigned long long next_sample_us;
+      unsigned long long next_transmit_us;
+      unsigned long long next_sync_us;
+
+      Leg(LegPhysics const& physics, LegParameters const& parameters);
+    };
+
+    /**
+     * Struct for one radio frame in the air
+     * 
+     * destination: leg index, or MASTER
+     * len:         payload length in bytes
+     * data:        frame payload
+     */
+    struct Frame {
+      int destination;
+      size_t len;
+      uint8_t data[MINION_MAXIMUM_BATCH_FRAME_SIZE];
+    };
+
+    DeskParameters const PARAMETERS;
+
+    VirtualClock clock;
+    LinuxGpio gpio;
+    LinuxPwm pwm;
+    LinuxRadio radio;
+    LinuxPeriodicTimer timer;
+    LinuxStorage storage;
+    LinuxSerialPort serial;
+    LinuxPower power;
+    Hal hal;
+
+    std::vector<std::unique_ptr<Leg> > legs;
+    std::unique_ptr<MinionReceiver> receiver;
+    std::unique_ptr<ButtonPanel> button_panel;
+    std::unique_ptr<ElevateSystemBase> system;
+    std::unique_ptr<ControlTask<ElevateSystemBase> > control_task;
+    std::unique_ptr<PowerManager<ElevateSystemBase> > power_manager;
+    TelemetryBuffer telemetry;
+    InputRecorder input_recorder;
+    unsigned long long telemetry_frames;
+    unsigned long long input_frames;
+
+    std::multimap<unsigned long long, Frame> frames_in_flight;
+    std::vector<unsigned long long> link_free_us;
+    std::mt19937 radio_random;
+
+    LatencyStats* loop_stats;
+
+    bool is_setup;
+    unsigned long long next_master_us;
+
+    void sync_leg_inputs(Leg& leg);
+    void sync_leg_clock(Leg& leg);
+    bool wake_leg(Leg& leg);
+    void transmit_leg(int leg);
+    void send_frame(int source, int destination, const uint8_t* data, size_t len);
+    void deliver_frames();
+    void broadcast_replies();
+};
+
+#endif
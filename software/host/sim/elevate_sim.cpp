@@ -0,0 +1,612 @@
+/**
+ * @file elevate_sim.cpp
+ * 
+ * @brief command line driver for the desk simulator
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#include "desk_simulator.h"
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+/**
+ * Parse a comma separated list of numbers
+ * 
+ * @param text list text
+ * 
+ * @return parsed values
+ */
+static std::vector<double> parse_list(char const* text) {
+  std::vector<double> values;
+  char* end = 0;
+  while (*text) {
+    values.push_back(strtod(text, &end));
+    if (*end != ',') break;
+    text = end + 1;
+  }
+  return values;
+}
+
+/**
+ * Write one row of leg heights
+ * 
+ * @param csv       output file, may be null
+ * @param simulator desk simulator
+ */
+static void write_row(FILE* csv, DeskSimulator& simulator) {
+  if (!csv) return;
+  fprintf(csv, "%.3f", simulator.get_time_us() * 1e-6);
+  for (int i = 0; i < simulator.get_number_of_legs(); i++) {
+    fprintf(csv, ",%.3f", simulator.get_leg(i).get_height() * 1e3);
+  }
+  fprintf(csv, "\n");
+}
+
+/**
+ * Struct for leg skew over a run
+ * 
+ * maximum:            maximum skew in m
+ * travel_sum_squares: sum of squared skew over steps with a leg moving in m^2
+ * travel_steps:       steps with a leg moving
+ */
+struct SkewStats {
+  double maximum = 0.0;
+  double travel_sum_squares = 0.0;
+  unsigned long long travel_steps = 0;
+};
+
+/**
+ * Get the RMS leg skew over steps with a leg moving
+ * 
+ * @param skew_stats leg skew statistics
+ * 
+ * @return RMS skew in m, 0 if no leg moved
+ */
+static double get_travel_rms(SkewStats const& skew_stats) {
+  return skew_stats.travel_steps ? sqrt(skew_stats.travel_sum_squares / skew_stats.travel_steps) : 0.0;
+}
+
+/**
+ * Check whether any leg is moving
+ * 
+ * @param simulator desk simulator
+ * 
+ * @return if a leg moves faster than 1 mm/s
+ */
+static bool is_travelling(DeskSimulator& simulator) {
+  for (int i = 0; i < simulator.get_number_of_legs(); i++) {
+    if (fabs(simulator.get_leg(i).get_velocity()) > 1e-3) return true;
+  }
+  return false;
+}
+
+/**
+ * Run the simulator while sampling heights to csv and tracking skew
+ * 
+ * @param simulator   desk simulator
+ * @param duration_us duration in us
+ * @param csv         output file, may be null
+ * @param skew_stats  running leg skew statistics
+ */
+static void run(DeskSimulator& simulator, unsigned long long duration_us, FILE* csv, SkewStats& skew_stats) {
+  unsigned long long const ROW_PERIOD_US = 50000;
+  unsigned long long end_us = simulator.get_time_us() + duration_us;
+  unsigned long long next_row_us = simulator.get_time_us();
+  while (simulator.get_time_us() < end_us) {
+    simulator.step();
+    double skew = simulator.get_skew();
+    if (skew > skew_stats.maximum) skew_stats.maximum = skew;
+    if (is_travelling(simulator)) {
+      skew_stats.travel_sum_squares += skew * skew;
+      skew_stats.travel_steps++;
+    }
+    if (simulator.get_time_us() >= next_row_us) {
+      write_row(csv, simulator);
+      next_row_us += ROW_PERIOD_US;
+    }
+  }
+}
+
+/**
+ * Travel up for 20 s and let the desk come to rest
+ * 
+ * @param simulator  desk simulator
+ * @param csv        output file, may be null
+ * @param skew_stats running leg skew statistics
+ */
+static void run_balance(DeskSimulator& simulator, FILE* csv, SkewStats& skew_stats) {
+  run(simulator, 1000000, csv, skew_stats);
+  simulator.press_up(true);
+  run(simulator, 20000000, csv, skew_stats);
+  simulator.press_up(false);
+  run(simulator, 5000000, csv, skew_stats);
+}
+
+/**
+ * Replay a day of desk usage: a sit/stand move every 20-40 minutes
+ * 
+ * @param simulator  desk simulator
+ * @param csv        output file, may be null
+ * @param skew_stats running leg skew statistics
+ */
+static void run_day(DeskSimulator& simulator, FILE* csv, SkewStats& skew_stats) {
+  unsigned long long const DAY_US = 24ULL * 3600 * 1000000;
+  std::mt19937 random(2023);
+  std::uniform_int_distribution<int> idle_s(20 * 60, 40 * 60);
+  std::uniform_int_distribution<int> move_s(5, 20);
+  bool up = true;
+  int moves = 0;
+  while (simulator.get_time_us() < DAY_US) {
+    run(simulator, idle_s(random) * 1000000ULL, csv, skew_stats);
+    if (up) simulator.press_up(true); else simulator.press_down(true);
+    run(simulator, move_s(random) * 1000000ULL, csv, skew_stats);
+    simulator.press_up(false);
+    simulator.press_down(false);
+    up = !up;
+    moves++;
+  }
+  printf("moves: %d\n", moves);
+}
+
+/**
+ * Travel up while someone leans on the last leg for 5 s mid-travel
+ * 
+ * @param simulator  desk simulator
+ * @param load_kg    normal load of the last leg in kg
+ * @param csv        output file, may be null
+ * @param skew_stats running leg skew statistics
+ */
+static void run_load(DeskSimulator& simulator, double load_kg, FILE* csv, SkewStats& skew_stats) {
+  double const LEANING_LOAD_KG = 60.0;
+  LegModel& leg = simulator.get_leg(simulator.get_number_of_legs() - 1);
+  run(simulator, 1000000, csv, skew_stats);
+  simulator.press_up(true);
+  run(simulator, 4000000, csv, skew_stats);
+  leg.set_load(load_kg + LEANING_LOAD_KG);
+  run(simulator, 5000000, csv, skew_stats);
+  leg.set_load(load_kg);
+  run(simulator, 5000000, csv, skew_stats);
+  simulator.press_up(false);
+  run(simulator, 5000000, csv, skew_stats);
+}
+
+/**
+ * Enter autotune with the button chord, checking the desk stays put until
+ * the chord completes, wait for every leg to be tuned and print what was
+ * measured, check the gains come back after a power cycle, then run balance
+ * on this simulator and on an untuned copy and print the skew the copy
+ * reached
+ * 
+ * @param simulator  desk simulator
+ * @param parameters simulator configuration, for the copies
+ * @param csv        output file, may be null
+ * @param skew_stats running leg skew statistics, of the tuned balance run
+ * 
+ * @return if the chord left the desk still, every leg was tuned, its gains
+ *         were restored and the tuned legs skewed no further than untuned
+ */
+static bool run_autotune(DeskSimulator& simulator, DeskParameters const& parameters, FILE* csv, SkewStats& skew_stats) {
+  unsigned long long const TUNE_TIMEOUT_US = 120000000;
+  double const MAXIMUM_CHORD_TRAVEL = 0.5e-3;
+  SkewStats tune_stats;
+  run(simulator, 1000000, csv, tune_stats);
+  std::vector<double> start_heights(simulator.get_number_of_legs());
+  for (int i = 0; i < simulator.get_number_of_legs(); i++) start_heights[i] = simulator.get_leg(i).get_height();
+  double chord_travel = 0.0;
+  for (int i = 0; i < 2; i++) {
+    simulator.press_up(true);
+    simulator.press_down(true);
+    run(simulator, 200000, csv, tune_stats);
+    simulator.press_up(false);
+    simulator.press_down(false);
+    run(simulator, 300000, csv, tune_stats);
+    // The first tap alone must leave the desk where it was
+    for (int j = 0; i == 0 && j < simulator.get_number_of_legs(); j++) {
+      chord_travel = std::max(chord_travel, fabs(simulator.get_leg(j).get_height() - start_heights[j]));
+    }
+  }
+  printf("autotune chord: legs moved %.2f mm before it completed\n", chord_travel * 1e3);
+  Autotuner const& autotuner = simulator.get_system().get_autotuner();
+  unsigned long long start_us = simulator.get_time_us();
+  while (autotuner.is_running() && simulator.get_time_us() - start_us < TUNE_TIMEOUT_US) {
+    run(simulator, 100000, csv, tune_stats);
+  }
+  printf("autotune: %d of %d legs tuned in %.1f s\n",
+    autotuner.get_tuned_modules(),
+    simulator.get_number_of_legs(),
+    (simulator.get_time_us() - start_us) * 1e-6
+  );
+
+  DeskSimulator power_cycled(parameters);
+  power_cycled.get_storage() = simulator.get_storage();
+  power_cycled.setup();
+  bool is_restored = true;
+  for (int i = 0; i < simulator.get_number_of_legs(); i++) {
+    PIDTuning const& tuning = simulator.get_module(i).get_pid_tuning();
+    PIDTuning const& restored = power_cycled.get_module(i).get_pid_tuning();
+    is_restored = is_restored && restored.kp == tuning.kp && restored.ki == tuning.ki && restored.kd == tuning.kd;
+    printf(
+      "leg %d: Ku %.3f Tu %.3f s -> kp %.3f ki %.3f kd %.4f\n",
+      i,
+      autotuner.get_ultimate_gain(i),
+      autotuner.get_ultimate_period(i),
+      tuning.kp,
+      tuning.ki,
+      tuning.kd
+    );
+  }
+  printf("gains after power cycle: %s\n", is_restored ? "restored" : "lost");
+  bool is_tuned = autotuner.get_tuned_modules() == simulator.get_number_of_legs();
+
+  DeskSimulator untuned(parameters);
+  untuned.setup();
+  SkewStats untuned_stats;
+  run_balance(untuned, 0, untuned_stats);
+  run_balance(simulator, csv, skew_stats);
+  printf(
+    "untuned: max skew %.2f mm, rms skew while travelling %.3f mm\n",
+    untuned_stats.maximum * 1e3,
+    get_travel_rms(untuned_stats) * 1e3
+  );
+  bool is_improved = skew_stats.maximum <= untuned_stats.maximum;
+  printf("tuned skew: %s\n", is_improved ? "passed" : "failed");
+  return chord_travel <= MAXIMUM_CHORD_TRAVEL && is_tuned && is_restored && is_improved;
+}
+
+/**
+ * Run balance on this simulator and on a copy without clock sync, and print
+ * the skew the copy reached
+ * 
+ * @param simulator  desk simulator, with clock sync
+ * @param parameters simulator configuration, for the copy
+ * @param csv        output file, may be null
+ * @param skew_stats running leg skew statistics
+ * 
+ * @return if sync lowered both the maximum and the RMS skew
+ */
+static bool run_latency(DeskSimulator& simulator, DeskParameters const& parameters, FILE* csv, SkewStats& skew_stats) {
+  DeskParameters unsynced_parameters = parameters;
+  unsynced_parameters.minion_sync_period_us = 0;
+  DeskSimulator unsynced(unsynced_parameters);
+  unsynced.setup();
+  SkewStats unsynced_stats;
+  run_balance(unsynced, 0, unsynced_stats);
+  run_balance(simulator, csv, skew_stats);
+  printf(
+    "without sync: max skew %.2f mm, rms skew while travelling %.3f mm\n",
+    unsynced_stats.maximum * 1e3,
+    get_travel_rms(unsynced_stats) * 1e3
+  );
+  bool is_passed = skew_stats.maximum < unsynced_stats.maximum && get_travel_rms(skew_stats) < get_travel_rms(unsynced_stats);
+  printf("clock sync: %s\n", is_passed ? "passed" : "failed");
+  return is_passed;
+}
+
+/**
+ * Let the desk go idle after a move, measure how much of the idle time every
+ * device spends asleep, then press up and measure how long each device takes
+ * to wake and check the desk rises
+ * 
+ * An idle minion still wakes every poll period to read its encoder, so it is
+ * awake for about one poll's wake-up and read per poll period, never more.
+ * 
+ * @param simulator  desk simulator, with light sleep
+ * @param parameters simulator configuration
+ * @param csv        output file, may be null
+ * @param skew_stats running leg skew statistics
+ * 
+ * @return if the master slept for at least 99% of the idle window, each
+ *         minion stayed within its poll duty cycle, every device woke within
+ *         its latency bound and every leg rose
+ */
+static bool run_sleep(DeskSimulator& simulator, DeskParameters const& parameters, FILE* csv, SkewStats& skew_stats) {
+  unsigned long long const SETTLE_US = 60000000;
+  unsigned long long const WINDOW_US = 60000000;
+  unsigned long long const WAKE_TIMEOUT_US = 2000000;
+  double const MAXIMUM_AWAKE_FRACTION = 0.01;
+  double poll_awake_fraction = (double) parameters.minion_poll_awake_us / parameters.minion_wake_poll_us;
+  int number_of_legs = simulator.get_number_of_legs();
+  LinuxPower const& master_power = simulator.get_master_power();
+
+  run(simulator, 1000000, csv, skew_stats);
+  simulator.press_up(true);
+  run(simulator, 5000000, csv, skew_stats);
+  simulator.press_up(false);
+  run(simulator, SETTLE_US, csv, skew_stats);
+
+  // Device 0 is the master, device i + 1 leg i, each timed on its own clock
+  Clock const& master_clock = *simulator.get_master_hal()->clock;
+  bool is_passed = master_power.is_asleep();
+  std::vector<unsigned long> start_us(number_of_legs + 1);
+  std::vector<unsigned long> asleep_us(number_of_legs + 1);
+  std::vector<unsigned long> sleeps(number_of_legs + 1);
+  for (int i = 0; i <= number_of_legs; i++) {
+    if (i) is_passed = is_passed && !simulator.get_minion_power_manager(i - 1)->is_sampling();
+    LinuxPower const& power = i ? simulator.get_leg_power(i - 1) : master_power;
+    start_us[i] = (i ? simulator.get_leg_clock(i - 1) : master_clock).micros();
+    asleep_us[i] = power.get_asleep_us();
+    sleeps[i] = power.get_sleeps();
+  }
+  run(simulator, WINDOW_US, csv, skew_stats);
+  for (int i = 0; i <= number_of_legs; i++) {
+    LinuxPower const& power = i ? simulator.get_leg_power(i - 1) : master_power;
+    double window_us = (i ? simulator.get_leg_clock(i - 1) : master_clock).micros() - start_us[i];
+    double awake = 1.0 - (power.get_asleep_us() - asleep_us[i]) / window_us;
+    double wakes = (power.get_sleeps() - sleeps[i]) / (window_us * 1e-6);
+    if (i) {
+      is_passed = is_passed && awake > 0.0 && awake <= poll_awake_fraction;
+      printf(
+        "leg %d idle: %.3f%% awake (bound %.3f%%), %.1f wakes/s\n",
+        i - 1,
+        awake * 100.0,
+        poll_awake_fraction * 100.0,
+        wakes
+      );
+    } else {
+      is_passed = is_passed && awake <= MAXIMUM_AWAKE_FRACTION;
+      printf("master idle: %.3f%% awake, %.1f wakes/s\n", awake * 100.0, wakes);
+    }
+  }
+
+  // Latency from the press, and for a minion from the leg first moving past
+  // the wake distance from where it was still, so sampling is not charged
+  // for motor spin up. The leg is still, so its last polled height is where
+  // it is now
+  unsigned long long press_us = simulator.get_time_us();
+  long long unknown = -1;
+  long long master_wake_us = unknown;
+  long long control_us = unknown;
+  std::vector<double> start_rotations(number_of_legs);
+  std::vector<double> start_distances(number_of_legs);
+  std::vector<long long> moved_us(number_of_legs, unknown);
+  std::vector<long long> sampling_us(number_of_legs, unknown);
+  std::vector<double> start_heights(number_of_legs);
+  for (int i = 0; i < number_of_legs; i++) {
+    start_heights[i] = simulator.get_leg(i).get_height();
+    start_rotations[i] = simulator.get_leg(i).get_rotations();
+    start_distances[i] = simulator.get_minion(i).get_height() - simulator.get_minion_power_manager(i)->get_idle_height();
+  }
+  simulator.press_up(true);
+  bool is_waiting = true;
+  while (is_waiting && simulator.get_time_us() - press_us < WAKE_TIMEOUT_US) {
+    simulator.step();
+    long long now = (long long) simulator.get_time_us();
+    if (master_wake_us < 0 && !master_power.is_asleep()) master_wake_us = now;
+    if (control_us < 0 && !simulator.get_system().is_idle()) control_us = now;
+    is_waiting = master_wake_us < 0 || control_us < 0;
+    for (int i = 0; i < number_of_legs; i++) {
+      double distance = start_distances[i] + (simulator.get_leg(i).get_rotations() - start_rotations[i]) * UNITS_PER_ROTATION;
+      if (moved_us[i] < 0 && fabs(distance) > parameters.minion_wake_distance) moved_us[i] = now;
+      if (sampling_us[i] < 0 && simulator.get_minion_power_manager(i)->is_sampling()) sampling_us[i] = now;
+      is_waiting = is_waiting || moved_us[i] < 0 || sampling_us[i] < 0;
+    }
+  }
+  run(simulator, 2000000, csv, skew_stats);
+  simulator.press_up(false);
+  run(simulator, 5000000, csv, skew_stats);
+
+  long long master_bound_us = parameters.master_period_us;
+  long long control_bound_us = USER_INPUT_DELAY_MS * 1000 + 2 * parameters.master_period_us;
+  // A sleeping device is only checked once per step or master period
+  long long minion_bound_us = 2 * (parameters.minion_wake_poll_us + parameters.minion_poll_awake_us + parameters.physics_step_us);
+  is_passed = is_passed && master_wake_us >= 0 && master_wake_us - (long long) press_us <= master_bound_us;
+  is_passed = is_passed && control_us >= 0 && control_us - (long long) press_us <= control_bound_us;
+  printf(
+    "master wake: %.1f ms after press (bound %.1f ms), moving %.1f ms after press (bound %.1f ms)\n",
+    (master_wake_us - (long long) press_us) * 1e-3,
+    master_bound_us * 1e-3,
+    (control_us - (long long) press_us) * 1e-3,
+    control_bound_us * 1e-3
+  );
+  for (int i = 0; i < number_of_legs; i++) {
+    long long latency_us = sampling_us[i] - moved_us[i];
+    is_passed = is_passed && moved_us[i] >= 0 && sampling_us[i] >= 0 && latency_us <= minion_bound_us;
+    is_passed = is_passed && simulator.get_leg(i).get_height() > start_heights[i];
+    printf(
+      "leg %d wake: sampling %.1f ms after moving past %ld units (bound %.1f ms)\n",
+      i,
+      latency_us * 1e-3,
+      parameters.minion_wake_distance,
+      minion_bound_us * 1e-3
+    );
+  }
+  printf("light sleep: %s\n", is_passed ? "passed" : "failed");
+  return is_passed;
+}
+
+/**
+ * Run one scenario, balance unless named
+ * 
+ * --trace writes the master control telemetry frames to path, and --capture
+ * adds the master inputs for elevate_replay. --light-sleep lets the master
+ * and minions sleep while idle; the sleep scenario always does. --max-skew
+ * and --min-speed turn a run into a check that fails if the legs skewed
+ * further than mm or the run was slower than x real time.
+ * 
+ * @return 0 if the scenario passed, 1 if it failed, 2 on bad arguments
+ */
+int main(int argc, char** argv) {
+  std::string scenario = "balance";
+  DeskParameters parameters;
+  std::vector<double> loads;
+  std::vector<double> gains;
+  char const* csv_path = 0;
+  char const* trace_path = 0;
+  int number_of_legs = 4;
+  double max_skew_mm = 0.0;
+  double min_speed = 0.0;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--legs") && i + 1 < argc) {
+      number_of_legs = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--loads") && i + 1 < argc) {
+      loads = parse_list(argv[++i]);
+    } else if (!strcmp(argv[i], "--gains") && i + 1 < argc) {
+      gains = parse_list(argv[++i]);
+    } else if (!strcmp(argv[i], "--csv") && i + 1 < argc) {
+      csv_path = argv[++i];
+    } else if (!strcmp(argv[i], "--control-task")) {
+      parameters.use_control_task = true;
+    } else if (!strcmp(argv[i], "--latency") && i + 1 < argc) {
+      parameters.radio_latency_us = strtoul(argv[++i], 0, 10);
+    } else if (!strcmp(argv[i], "--jitter") && i + 1 < argc) {
+      parameters.radio_jitter_us = strtoul(argv[++i], 0, 10);
+    } else if (!strcmp(argv[i], "--no-sync")) {
+      parameters.minion_sync_period_us = 0;
+    } else if (!strcmp(argv[i], "--no-extrapolation")) {
+      parameters.extrapolate_height = false;
+    } else if (!strcmp(argv[i], "--no-synchronization")) {
+      parameters.synchronize_legs = false;
+    } else if (!strcmp(argv[i], "--cascade")) {
+      parameters.cascaded_control = true;
+    } else if (!strcmp(argv[i], "--trace") && i + 1 < argc) {
+      trace_path = argv[++i];
+      parameters.record_telemetry = true;
+    } else if (!strcmp(argv[i], "--capture")) {
+      parameters.record_inputs = true;
+    } else if (!strcmp(argv[i], "--light-sleep")) {
+      parameters.light_sleep = true;
+    } else if (!strcmp(argv[i], "--max-skew") && i + 1 < argc) {
+      max_skew_mm = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--min-speed") && i + 1 < argc) {
+      min_speed = atof(argv[++i]);
+    } else if (argv[i][0] != '-') {
+      scenario = argv[i];
+    } else {
+      fprintf(stderr, "usage: %s [day|balance|calibrate|load|autotune|sleep|latency] [--legs N] [--loads a,b,..] [--gains a,b,..] [--csv path] [--control-task] [--latency us] [--jitter us] [--no-sync] [--no-extrapolation] [--no-synchronization] [--cascade] [--trace path] [--capture] [--light-sleep] [--max-skew mm] [--min-speed x]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  if (parameters.record_inputs && !trace_path) {
+    fprintf(stderr, "--capture needs --trace\n");
+    return 2;
+  }
+  if (number_of_legs < 1 || number_of_legs > MAXIMUM_NUMBER_OF_MODULES_) {
+    fprintf(stderr, "--legs must be 1 to %d\n", MAXIMUM_NUMBER_OF_MODULES_);
+    return 2;
+  }
+
+  if (scenario == "sleep") parameters.light_sleep = true;
+  if (scenario == "latency" && !parameters.radio_latency_us && !parameters.radio_jitter_us) {
+    parameters.radio_latency_us = 15000;
+    parameters.radio_jitter_us = 10000;
+  }
+  bool is_mismatched = scenario == "balance" || scenario == "autotune" || scenario == "latency";
+  if (is_mismatched && loads.empty()) loads = {10.0, 10.0, 80.0, 10.0};
+  if (is_mismatched && gains.empty()) gains = {1.0, 1.0, 0.8, 1.0};
+  parameters.legs.resize(number_of_legs);
+  for (int i = 0; i < number_of_legs; i++) {
+    if (i < (int) loads.size()) parameters.legs[i].load_kg = loads[i];
+    if (i < (int) gains.size()) parameters.legs[i].motor_gain = gains[i];
+    parameters.legs[i].encoder_offset = (i * 1237) % 4096;
+    parameters.legs[i].clock_offset_us = 1000000LL + i * 7654321LL;
+    parameters.legs[i].clock_drift_ppm = (i % 2 ? -10.0 : 10.0) * (i + 1);
+  }
+
+  FILE* csv = csv_path ? fopen(csv_path, "w") : 0;
+  if (csv_path && !csv) {
+    fprintf(stderr, "cannot open %s\n", csv_path);
+    return 1;
+  }
+  if (csv) {
+    fprintf(csv, "time_s");
+    for (int i = 0; i < number_of_legs; i++) fprintf(csv, ",leg_%d_mm", i);
+    fprintf(csv, "\n");
+  }
+
+  FILE* trace = trace_path ? fopen(trace_path, "wb") : 0;
+  if (trace_path && !trace) {
+    fprintf(stderr, "cannot open %s\n", trace_path);
+    return 1;
+  }
+
+  DeskSimulator simulator(parameters);
+  simulator.get_serial().set_output(trace);
+  simulator.setup();
+  SkewStats skew_stats;
+  bool is_passed = true;
+  auto start = std::chrono::steady_clock::now();
+
+  if (scenario == "day") {
+    run_day(simulator, csv, skew_stats);
+  } else if (scenario == "balance") {
+    run_balance(simulator, csv, skew_stats);
+  } else if (scenario == "autotune") {
+    if (!run_autotune(simulator, parameters, csv, skew_stats)) is_passed = false;
+  } else if (scenario == "latency") {
+    if (!run_latency(simulator, parameters, csv, skew_stats)) is_passed = false;
+  } else if (scenario == "load") {
+    run_load(simulator, parameters.legs.back().load_kg, csv, skew_stats);
+  } else if (scenario == "sleep") {
+    if (!run_sleep(simulator, parameters, csv, skew_stats)) return 1;
+  } else if (scenario == "calibrate") {
+    simulator.press_up(true);
+    simulator.press_down(true);
+    run(simulator, 60000000, csv, skew_stats);
+    simulator.press_up(false);
+    simulator.press_down(false);
+    run(simulator, 1000000, csv, skew_stats);
+  } else {
+    fprintf(stderr, "unknown scenario %s\n", scenario.c_str());
+    return 2;
+  }
+
+  double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  double simulated_s = simulator.get_time_us() * 1e-6;
+  printf("scenario: %s\n", scenario.c_str());
+  printf("simulated: %.1f s in %.3f s wall (%.0fx real time)\n", simulated_s, wall_s, simulated_s / wall_s);
+  printf("max skew: %.2f mm\n", skew_stats.maximum * 1e3);
+  printf(
+    "rms skew while travelling: %.3f mm\n",
+    get_travel_rms(skew_stats) * 1e3
+  );
+  for (int i = 0; i < number_of_legs; i++) {
+    MinionLinkStats const& link = simulator.get_receiver().get_link_stats(i);
+    ClockSync const& clock_sync = simulator.get_clock_sync(i);
+    printf(
+      "leg %d: %.2f mm, %u frames received, %u lost, clock %s offset %ld us round trip %lu us\n",
+      i,
+      simulator.get_leg(i).get_height() * 1e3,
+      link.received,
+      link.lost,
+      clock_sync.is_synced() ? "synced" : "unsynced",
+      (long) clock_sync.get_offset_us(),
+      (unsigned long) clock_sync.get_round_trip_us()
+    );
+  }
+  if (trace) {
+    printf(
+      "telemetry: %llu frames, %u dropped\n",
+      simulator.get_telemetry_frames(),
+      simulator.get_telemetry().get_dropped()
+    );
+    if (parameters.record_inputs) {
+      printf(
+        "inputs: %llu frames, %u dropped\n",
+        simulator.get_input_frames(),
+        simulator.get_input_recorder().get_dropped()
+      );
+    }
+    fclose(trace);
+  }
+  if (csv) fclose(csv);
+
+  if (max_skew_mm > 0.0 && skew_stats.maximum * 1e3 > max_skew_mm) {
+    printf("max skew above %.2f mm\n", max_skew_mm);
+    is_passed = false;
+  }
+  if (min_speed > 0.0 && simulated_s / wall_s < min_speed) {
+    printf("slower than %.0fx real time\n", min_speed);
+    is_passed = false;
+  }
+  return is_passed ? 0 : 1;
+}
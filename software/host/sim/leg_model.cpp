@@ -0,0 +1,130 @@
+/**
+ * @file leg_model.cpp
+ * 
+ * @brief simulated lifting leg physics
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#include "leg_model.h"
+#include <math.h>
+
+static double const TWO_PI = 2.0 * M_PI;
+
+/**
+ * Leg Model constructor
+ * 
+ * @param physics    physical parameters shared by every leg
+ * @param parameters parameters for this leg
+ */
+LegModel::LegModel(LegPhysics const& physics, LegParameters const& parameters) :
+PHYSICS(physics), parameters(parameters) {
+  angle = TWO_PI * parameters.initial_height / PHYSICS.lead;
+  angular_velocity = 0.0;
+}
+
+/**
+ * Advance the leg by one time step. The motor, gearbox and screw are one
+ * inertia at the screw with the load reflected through the screw lead, and
+ * back-emf and viscous terms are integrated implicitly so the model stays
+ * stable at coarse steps.
+ * 
+ * @param duty         motor duty, 0-1
+ * @param direction_up whether the direction pin commands upwards travel
+ * @param dt           time step in s
+ */
+void LegModel::step(double duty, bool direction_up, double dt) {
+  double k = PHYSICS.motor_constant * parameters.motor_gain;
+  double voltage = PHYSICS.supply_voltage * duty * (direction_up ? 1.0 : -1.0);
+  double drive_torque = k * voltage / PHYSICS.resistance;
+  double load_torque = parameters.load_kg * PHYSICS.gravity * PHYSICS.lead / TWO_PI;
+  double friction_torque = parameters.coulomb_friction + PHYSICS.screw_friction_ratio * load_torque;
+  double damping = k * k / PHYSICS.resistance + parameters.viscous_friction;
+
+  double applied_torque = drive_torque - load_torque;
+  if (angular_velocity == 0.0 && fabs(applied_torque) <= friction_torque) return;
+
+  double direction = (angular_velocity != 0.0) ?
+    (angular_velocity > 0.0 ? 1.0 : -1.0) :
+    (applied_torque > 0.0 ? 1.0 : -1.0);
+  double next_velocity = (PHYSICS.inertia * angular_velocity + dt * (applied_torque - direction * friction_torque)) /
+    (PHYSICS.inertia + dt * damping);
+  if (next_velocity * direction < 0.0) next_velocity = 0.0;
+
+  angle += 0.5 * (angular_velocity + next_velocity) * dt;
+  angular_velocity = next_velocity;
+
+  double minimum_angle = 0.0;
+  double maximum_angle = TWO_PI * PHYSICS.travel / PHYSICS.lead;
+  if (angle < minimum_angle) {
+    angle = minimum_angle;
+    angular_velocity = 0.0;
+  } else if (angle > maximum_angle) {
+    angle = maximum_angle;
+    angular_velocity = 0.0;
+  }
+}
+
+/**
+ * Get leg height
+ * 
+ * @return height above the lower hard stop in m
+ */
+double LegModel::get_height() const {
+  return angle / TWO_PI * PHYSICS.lead;
+}
+
+/**
+ * Get leg velocity
+ * 
+ * @return vertical velocity in m / s
+ */
+double LegModel::get_velocity() const {
+  return angular_velocity / TWO_PI * PHYSICS.lead;
+}
+
+/**
+ * Get screw rotations
+ * 
+ * @return screw rotations from the lower hard stop
+ */
+double LegModel::get_rotations() const {
+  return angle / TWO_PI;
+}
+
+/**
+ * Get the raw angle the encoder would report
+ * 
+ * @return raw angle, 0-4095
+ */
+int LegModel::get_raw_angle() const {
+  long long counts = (long long) floor(get_rotations() * UNITS_PER_ROTATION) + parameters.encoder_offset;
+  return (int) (((counts % UNITS_PER_ROTATION) + UNITS_PER_ROTATION) % UNITS_PER_ROTATION);
+}
+
+/**
+ * Determine if lower limit switch is closed
+ * 
+ * @return if lower limit switch is closed
+ */
+bool LegModel::lower_limit_switch_pressed() const {
+  return get_height() <= PHYSICS.switch_zone;
+}
+
+/**
+ * Determine if upper limit switch is closed
+ * 
+ * @return if upper limit switch is closed
+ */
+bool LegModel::upper_limit_switch_pressed() const {
+  return get_height() >= PHYSICS.travel - PHYSICS.switch_zone;
+}
+
+/**
+ * Change the load carried by the leg
+ * 
+ * @param load_kg mass carried by the leg in kg
+ */
+void LegModel::set_load(double load_kg) {
+  parameters.load_kg = load_kg;
+}
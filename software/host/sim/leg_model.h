@@ -0,0 +1,84 @@
+/**
+ * @file leg_model.h
+ * 
+ * @brief header file for simulated lifting leg physics
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#ifndef LEG_MODEL_H_
+#define LEG_MODEL_H_
+
+#include <stdint.h>
+
+/**
+ * Struct for physical parameters shared by every leg
+ * 
+ * supply_voltage:       motor supply voltage in V
+ * resistance:           motor winding resistance in ohm
+ * motor_constant:       torque and back-emf constant at the screw in N m / A
+ * inertia:              rotor, gearbox and screw inertia at the screw in kg m^2
+ * lead:                 screw travel per rotation in m
+ * screw_friction_ratio: screw friction torque per unit of load torque
+ * travel:               distance between the hard stops in m
+ * switch_zone:          distance from a hard stop at which its limit switch closes in m
+ * gravity:              gravitational acceleration in m / s^2
+ */
+struct LegPhysics {
+  double supply_voltage = 12.0;
+  double resistance = 2.0;
+  double motor_constant = 0.76;
+  double inertia = 1e-3;
+  double lead = 0.008;
+  double screw_friction_ratio = 1.5;
+  double travel = 0.5;
+  double switch_zone = 0.002;
+  double gravity = 9.81;
+};
+
+/**
+ * Struct for parameters that vary from leg to leg
+ * 
+ * load_kg:           mass carried by the leg in kg
+ * motor_gain:        scale on the motor constant for unit-to-unit variance
+ * coulomb_friction:  load independent friction torque in N m
+ * viscous_friction:  viscous friction in N m s / rad
+ * initial_height:    starting height in m
+ * encoder_offset:    encoder reading at zero screw angle, 0-4095
+ * clock_offset_us:   minion clock at master boot in us
+ * clock_drift_ppm:   minion clock rate error against the master in ppm
+ */
+struct LegParameters {
+  double load_kg = 10.0;
+  double motor_gain = 1.0;
+  double coulomb_friction = 0.05;
+  double viscous_friction = 0.002;
+  double initial_height = 0.1;
+  int encoder_offset = 0;
+  long long clock_offset_us = 0;
+  double clock_drift_ppm = 0.0;
+};
+
+class LegModel {
+  public:
+    LegModel(LegPhysics const& physics, LegParameters const& parameters);
+    void step(double duty, bool direction_up, double dt);
+    double get_height() const;
+    double get_velocity() const;
+    double get_rotations() const;
+    int get_raw_angle() const;
+    bool lower_limit_switch_pressed() const;
+    bool upper_limit_switch_pressed() const;
+    void set_load(double load_kg);
+
+  private:
+    static int const UNITS_PER_ROTATION = 1 << 12;
+
+    LegPhysics const PHYSICS;
+    LegParameters parameters;
+
+    double angle;
+    double angular_velocity;
+};
+
+#endif
@@ -0,0 +1,146 @@
+/**
+ * @file minion_spin.cpp
+ * 
+ * @brief checks minion encoder unwrapping against a fast-spinning encoder
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#include "as5600_model.h"
+#include "elevate_minion.h"
+#include "leg_model.h"
+#include "linux_hal.h"
+#include "minion_constants.h"
+#include "minion_protocol.h"
+#include "minion_sampler.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static unsigned long const LEGACY_PERIOD_US = 20000;
+
+/**
+ * Get encoder counts turned since time zero
+ * 
+ * @param revolutions_per_second spin speed
+ * @param time_us                time in us
+ * 
+ * @return whole counts turned
+ */
+static long true_counts(double revolutions_per_second, unsigned long long time_us) {
+  return (long) floor(revolutions_per_second * time_us * 1e-6 * UNITS_PER_ROTATION);
+}
+
+/**
+ * Spin the encoder under one sampler configuration
+ * 
+ * @param revolutions_per_second spin speed
+ * @param sample_period_us       encoder read period in us
+ * @param decimation             encoder reads per transmitted sample
+ * @param duration_us            how long to spin in us
+ * 
+ * @return largest count error over every transmitted sample
+ */
+static long spin(
+    double revolutions_per_second,
+    unsigned long sample_period_us,
+    uint8_t decimation,
+    unsigned long long duration_us) {
+  VirtualClock clock;
+  LinuxGpio gpio;
+  LinuxI2c i2c;
+  LinuxPeriodicTimer timer = LinuxPeriodicTimer(true);
+  As5600Model encoder;
+  i2c.attach(ENCODER_ADDRESS_, &encoder);
+  Hal hal = {&clock, &gpio, 0, 0, &i2c, &timer};
+
+  ElevateMinion minion = ElevateMinion(&hal, LOWER_LIMIT_SWITCH_PIN_0, UPPER_LIMIT_SWITCH_PIN_0);
+  MinionSampler sampler = MinionSampler(&hal, &minion, 0, sample_period_us, decimation);
+  encoder.set_raw_angle(0);
+  minion.setup();
+  sampler.start();
+
+  long max_error = 0;
+  uint8_t frame[MINION_MAXIMUM_BATCH_FRAME_SIZE];
+  MinionBatch batch;
+  unsigned long long next_transmit_us = TRANSMIT_PERIOD_US;
+  for (unsigned long long time_us = sample_period_us; time_us <= duration_us; time_us += sample_period_us) {
+    clock.set_micros(time_us);
+    encoder.set_raw_angle((int) (true_counts(revolutions_per_second, time_us) & (UNITS_PER_ROTATION - 1)));
+    timer.tick();
+    if (time_us < next_transmit_us) continue;
+    next_transmit_us += TRANSMIT_PERIOD_US;
+    size_t len;
+    while ((len = sampler.encode_frame(0, frame, sizeof(frame))) > 0) {
+      if (decode_minion_batch(frame, len, batch) != MINION_MESSAGE_OK) return -1;
+      for (uint8_t i = 0; i < batch.count; i++) {
+        long error = labs(batch.samples[i].height - true_counts(revolutions_per_second, batch.samples[i].timestamp_us));
+        if (error > max_error) max_error = error;
+      }
+    }
+  }
+  sampler.stop();
+  return max_error;
+}
+
+/**
+ * Spin a simulated AS5600 at multiples of the leg's maximum travel speed
+ * under the real MinionSampler, once at the old 50 Hz loop rate and once at
+ * the timer rate, comparing every height sent with the true encoder counts
+ * 
+ * @return 0 if no count was lost, 1 if the timer-paced sampler lost a count
+ *         below its Nyquist speed of half a turn per read, 2 on bad arguments
+ */
+int main(int argc, char** argv) {
+  double rate_hz = 1e6 / SAMPLE_PERIOD_US;
+  double seconds = 10.0;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--rate") && i + 1 < argc) {
+      rate_hz = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--seconds") && i + 1 < argc) {
+      seconds = atof(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [--rate HZ] [--seconds S]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (rate_hz <= 0.0 || seconds <= 0.0) {
+    fprintf(stderr, "rate and seconds must be positive\n");
+    return 2;
+  }
+
+  LegPhysics physics;
+  double max_travel_rps = physics.supply_voltage / physics.motor_constant / (2.0 * M_PI);
+  unsigned long sample_period_us = (unsigned long) (1e6 / rate_hz);
+  uint8_t decimation = (uint8_t) (SAMPLE_DECIMATION * SAMPLE_PERIOD_US / sample_period_us);
+  if (decimation == 0) decimation = 1;
+  unsigned long long duration_us = (unsigned long long) (seconds * 1e6);
+
+  printf(
+    "max travel speed %.2f rev/s (%.1f mm/s), timer read every %lu us\n\n",
+    max_travel_rps,
+    max_travel_rps * physics.lead * 1e3,
+    sample_period_us
+  );
+  printf("%10s %10s %16s %16s\n", "rev/s", "x travel", "50 Hz error", "timer error");
+  bool passed = true;
+  double multiples[] = {1.0, 4.0, 16.0, 64.0, 256.0};
+  for (double multiple : multiples) {
+    double revolutions_per_second = max_travel_rps * multiple;
+    long legacy_error = spin(revolutions_per_second, LEGACY_PERIOD_US, 1, duration_us);
+    long timer_error = spin(revolutions_per_second, sample_period_us, decimation, duration_us);
+    bool below_nyquist = revolutions_per_second * sample_period_us * 1e-6 < 0.5;
+    if (below_nyquist && timer_error != 0) passed = false;
+    printf(
+      "%10.2f %10.0f %16ld %16ld%s\n",
+      revolutions_per_second,
+      multiple,
+      legacy_error,
+      timer_error,
+      below_nyquist ? "" : "  (above timer Nyquist)"
+    );
+  }
+  printf("\n%s\n", passed ? "no counts lost by the timer-paced sampler" : "timer-paced sampler lost counts");
+  return passed ? 0 : 1;
+}
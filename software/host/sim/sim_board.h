@@ -0,0 +1,60 @@
+/**
+ * @file sim_board.h
+ * 
+ * @brief simulated master boards of any supported leg count
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#ifndef SIM_BOARD_H_
+#define SIM_BOARD_H_
+
+#include "button_panel.h"
+#include "elevate_board.h"
+#include "elevate_constants.h"
+#include "elevate_system.h"
+#include "hal.h"
+
+uint8_t const SIM_PWM_PIN_ = 150;
+uint8_t const SIM_DIRECTION_PIN_ = 100;
+
+/**
+ * Build the simulated board for a module count, module i driving PWM pin
+ * SIM_PWM_PIN_ + i on channel i and direction pin SIM_DIRECTION_PIN_ + i
+ * 
+ * @return board
+ */
+template <int NUMBER_OF_MODULES>
+constexpr ElevateBoard<NUMBER_OF_MODULES> make_sim_board() {
+  ElevateBoard<NUMBER_OF_MODULES> board = {};
+  for (int i = 0; i < NUMBER_OF_MODULES; i++) {
+    board.modules[i] = {(uint8_t) (SIM_PWM_PIN_ + i), (uint8_t) i, (uint8_t) (SIM_DIRECTION_PIN_ + i)};
+  }
+  board.up_switch_pin = UP_SWITCH_PIN_;
+  board.down_switch_pin = DOWN_SWITCH_PIN_;
+  return board;
+}
+
+/**
+ * Create a system on the simulated board, picking the ElevateSystem
+ * instantiation for the module count asked for at run time
+ * 
+ * @param hal               hardware abstraction layer
+ * @param number_of_modules number of modules, 1 to MAXIMUM_NUMBER_OF_MODULES_
+ * @param button_panel      pointer to button panel
+ * 
+ * @return new system, or null if the count is not supported
+ */
+template <int NUMBER_OF_MODULES = MAXIMUM_NUMBER_OF_MODULES_>
+ElevateSystemBase* create_sim_system(Hal* hal, int number_of_modules, ButtonPanel* button_panel) {
+  if constexpr (NUMBER_OF_MODULES < 1) {
+    return 0;
+  } else {
+    if (number_of_modules == NUMBER_OF_MODULES) {
+      return new ElevateSystem<NUMBER_OF_MODULES>(hal, make_sim_board<NUMBER_OF_MODULES>(), button_panel);
+    }
+    return create_sim_system<NUMBER_OF_MODULES - 1>(hal, number_of_modules, button_panel);
+  }
+}
+
+#endif
@@ -0,0 +1,473 @@
+/**
+ * @file elevate_sweep.cpp
+ * 
+ * @brief offline gain sweep over the desk simulator
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#include "desk_simulator.h"
+#include "elevate_constants.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+static unsigned long long const SETTLE_US = 1000000;
+static unsigned long long const TRAVEL_US = 6000000;
+static unsigned long long const STOP_US = 4000000;
+static size_t const MAXIMUM_ROWS_SHOWN = 20;
+
+/**
+ * Struct for one point of the sweep
+ * 
+ * kp:               proportional gain
+ * ki:               integral gain per s
+ * kd:               derivative gain in s
+ * pid_rate_ms:      PID sample time in ms
+ * rotations_per_ms: travel speed in encoder rotations per ms
+ * error_threshold:  largest error a leg stops at in units
+ */
+struct SweepConfig {
+  double kp;
+  double ki;
+  double kd;
+  unsigned long pid_rate_ms;
+  double rotations_per_ms;
+  long error_threshold;
+};
+
+/**
+ * Struct for the score of one point of the sweep
+ * 
+ * is_evaluated: if the worker finished the simulation
+ * is_settled:   if every leg came to rest within the stop window
+ * settle_s:     longest time from release until every leg is at rest in s
+ * overshoot_mm: furthest any leg went past its final height in mm
+ * max_skew_mm:  largest inter-leg error over the run in mm
+ * travel_mm_s:  mean travel speed while a button is held in mm/s
+ * rank:         non-dominated sorting rank, 0 on the Pareto front
+ */
+struct SweepResult {
+  bool is_evaluated;
+  bool is_settled;
+  double settle_s;
+  double overshoot_mm;
+  double max_skew_mm;
+  double travel_mm_s;
+  int rank;
+};
+
+/**
+ * Parse a comma separated list of numbers
+ * 
+ * @param text list text
+ * 
+ * @return parsed values
+ */
+static std::vector<double> parse_list(char const* text) {
+  std::vector<double> values;
+  char* end = 0;
+  while (*text) {
+    values.push_back(strtod(text, &end));
+    if (*end != ',') break;
+    text = end + 1;
+  }
+  return values;
+}
+
+/**
+ * Run the simulator while tracking the largest inter-leg error
+ * 
+ * @param simulator   desk simulator
+ * @param duration_us duration in us
+ * @param result      score to update
+ */
+static void run(DeskSimulator& simulator, unsigned long long duration_us, SweepResult& result) {
+  unsigned long long end_us = simulator.get_time_us() + duration_us;
+  while (simulator.get_time_us() < end_us) {
+    simulator.step();
+    result.max_skew_mm = std::max(result.max_skew_mm, simulator.get_skew() * 1e3);
+  }
+}
+
+/**
+ * Hold a button, release it and score the stop
+ * 
+ * @param simulator desk simulator
+ * @param is_up     if the up button is held, else the down one
+ * @param result    score to update
+ */
+static void run_travel(DeskSimulator& simulator, bool is_up, SweepResult& result) {
+  int number_of_legs = simulator.get_number_of_legs();
+  double start_height = simulator.get_leg(0).get_height();
+  if (is_up) simulator.press_up(true); else simulator.press_down(true);
+  run(simulator, TRAVEL_US, result);
+  if (is_up) simulator.press_up(false); else simulator.press_down(false);
+  result.travel_mm_s += fabs(simulator.get_leg(0).get_height() - start_height) * 1e3 / (TRAVEL_US * 1e-6) / 2.0;
+
+  unsigned long long release_us = simulator.get_time_us();
+  unsigned long long end_us = release_us + STOP_US;
+  unsigned long long last_moving_us = release_us;
+  std::vector<double> extreme(number_of_legs);
+  for (int i = 0; i < number_of_legs; i++) extreme[i] = simulator.get_leg(i).get_height();
+  while (simulator.get_time_us() < end_us) {
+    simulator.step();
+    result.max_skew_mm = std::max(result.max_skew_mm, simulator.get_skew() * 1e3);
+    for (int i = 0; i < number_of_legs; i++) {
+      double height = simulator.get_leg(i).get_height();
+      extreme[i] = is_up ? std::max(extreme[i], height) : std::min(extreme[i], height);
+      if (simulator.get_leg_duty(i) > 0.0 || fabs(simulator.get_leg(i).get_velocity()) > 1e-4) {
+        last_moving_us = simulator.get_time_us();
+      }
+    }
+  }
+  for (int i = 0; i < number_of_legs; i++) {
+    double overshoot = fabs(extreme[i] - simulator.get_leg(i).get_height()) * 1e3;
+    result.overshoot_mm = std::max(result.overshoot_mm, overshoot);
+  }
+  if (last_moving_us >= end_us - 1000) result.is_settled = false;
+  result.settle_s = std::max(result.settle_s, (last_moving_us - release_us) * 1e-6);
+}
+
+/**
+ * Simulate one point of the sweep: an up and a down travel, each followed by
+ * a release and stop, scored on settling time after release, overshoot past
+ * the final height and maximum inter-leg error, with travel speed kept
+ * alongside so slowing the desk down does not win by itself
+ * 
+ * @param parameters desk configuration
+ * @param config     control configuration
+ * 
+ * @return score
+ */
+static SweepResult evaluate(DeskParameters const& parameters, SweepConfig const& config) {
+  DeskSimulator simulator(parameters);
+  simulator.setup();
+  for (int i = 0; i < simulator.get_number_of_legs(); i++) {
+    ElevateModule& module = simulator.get_module(i);
+    module.set_gains(config.kp, config.ki, config.kd);
+    module.set_pid_rate(config.pid_rate_ms);
+    module.set_error_threshold(config.error_threshold);
+  }
+  simulator.get_system().set_maximum_velocity(UNITS_PER_ROTATION * config.rotations_per_ms * 1e3);
+
+  SweepResult result = SweepResult();
+  result.is_settled = true;
+  run(simulator, SETTLE_US, result);
+  run_travel(simulator, true, result);
+  run_travel(simulator, false, result);
+  result.is_evaluated = true;
+  return result;
+}
+
+/**
+ * Simulate every point of the sweep on a pool of jobs threads, each taking
+ * the next point until none are left. Every simulator owns all of its state,
+ * so the runs are independent.
+ * 
+ * @param parameters desk configuration
+ * @param configs    control configurations
+ * @param jobs       most simulations to run at once
+ * 
+ * @return scores, in the order of configs
+ */
+static std::vector<SweepResult> evaluate_all(
+    DeskParameters const& parameters,
+    std::vector<SweepConfig> const& configs,
+    int jobs) {
+  std::vector<SweepResult> results(configs.size(), SweepResult());
+  std::atomic<size_t> next(0);
+  std::atomic<size_t> done(0);
+  size_t progress_step = std::max<size_t>(configs.size() / 20, 1);
+  auto work = [&]() {
+    for (size_t i = next++; i < configs.size(); i = next++) {
+      results[i] = evaluate(parameters, configs[i]);
+      size_t finished = ++done;
+      if (finished % progress_step == 0) fprintf(stderr, "\r%zu of %zu simulated", finished, configs.size());
+    }
+  };
+
+  std::vector<std::thread> workers;
+  int threads = (int) std::min<size_t>(jobs, configs.size());
+  for (int i = 0; i < threads; i++) workers.emplace_back(work);
+  for (std::thread& worker : workers) worker.join();
+  fprintf(stderr, "\n");
+  return results;
+}
+
+/**
+ * Round a value to a step, so differences too small to matter are ties
+ * 
+ * @param value value
+ * @param step  resolution
+ * 
+ * @return value in whole steps
+ */
+static long quantize(double value, double step) {
+  return lround(value / step);
+}
+
+/**
+ * Check whether one score is at least as good as another on every objective
+ * and better on one, at 10 ms, 0.01 mm and 0.1 mm/s resolution
+ * 
+ * @param a score to check
+ * @param b score to compare to
+ * 
+ * @return if a dominates b
+ */
+static bool dominates(SweepResult const& a, SweepResult const& b) {
+  if (a.is_settled != b.is_settled) return a.is_settled;
+  long const objectives_a[] = {
+    quantize(a.settle_s, 0.01),
+    quantize(a.overshoot_mm, 0.01),
+    quantize(a.max_skew_mm, 0.01),
+    -quantize(a.travel_mm_s, 0.1)
+  };
+  long const objectives_b[] = {
+    quantize(b.settle_s, 0.01),
+    quantize(b.overshoot_mm, 0.01),
+    quantize(b.max_skew_mm, 0.01),
+    -quantize(b.travel_mm_s, 0.1)
+  };
+  bool is_better = false;
+  for (int i = 0; i < 4; i++) {
+    if (objectives_a[i] > objectives_b[i]) return false;
+    if (objectives_a[i] < objectives_b[i]) is_better = true;
+  }
+  return is_better;
+}
+
+/**
+ * Rank scores by non-dominated sorting: rank 0 is dominated by nothing, rank
+ * 1 only by rank 0, and so on. Failed simulations are ranked last.
+ * 
+ * @param results scores to rank
+ */
+static void rank(std::vector<SweepResult>& results) {
+  std::vector<size_t> remaining;
+  for (size_t i = 0; i < results.size(); i++) {
+    results[i].rank = -1;
+    if (results[i].is_evaluated) remaining.push_back(i);
+  }
+  int front = 0;
+  while (!remaining.empty()) {
+    std::vector<size_t> dominated;
+    for (size_t i : remaining) {
+      bool is_dominated = false;
+      for (size_t j : remaining) {
+        if (dominates(results[j], results[i])) {
+          is_dominated = true;
+          break;
+        }
+      }
+      if (is_dominated) dominated.push_back(i); else results[i].rank = front;
+    }
+    remaining.swap(dominated);
+    front++;
+  }
+  for (SweepResult& result : results) {
+    if (result.rank < 0) result.rank = front;
+  }
+}
+
+/**
+ * Write one configuration and its score
+ * 
+ * @param file   output file
+ * @param config control configuration
+ * @param result score
+ */
+static void write_row(FILE* file, SweepConfig const& config, SweepResult const& result) {
+  fprintf(
+    file,
+    "%d,%g,%g,%g,%lu,%g,%ld,%d,%.3f,%.3f,%.3f,%.2f\n",
+    result.rank,
+    config.kp,
+    config.ki,
+    config.kd,
+    config.pid_rate_ms,
+    config.rotations_per_ms,
+    config.error_threshold,
+    result.is_evaluated && result.is_settled,
+    result.settle_s,
+    result.overshoot_mm,
+    result.max_skew_mm,
+    result.travel_mm_s
+  );
+}
+
+/**
+ * Write configurations and scores as csv, best ranked first
+ * 
+ * @param path    output path
+ * @param configs control configurations
+ * @param results scores
+ * @param order   indices to write, in order
+ * 
+ * @return if the file was written
+ */
+static bool write_csv(
+    char const* path,
+    std::vector<SweepConfig> const& configs,
+    std::vector<SweepResult> const& results,
+    std::vector<size_t> const& order) {
+  FILE* file = fopen(path, "w");
+  if (!file) {
+    fprintf(stderr, "cannot open %s\n", path);
+    return false;
+  }
+  fprintf(file, "rank,kp,ki,kd,pid_rate_ms,rotations_per_ms,error_threshold,settled,settle_s,overshoot_mm,max_skew_mm,travel_mm_s\n");
+  for (size_t i : order) write_row(file, configs[i], results[i]);
+  fclose(file);
+  return true;
+}
+
+/**
+ * Check whether a configuration is the one in elevate_constants.h
+ * 
+ * @param config control configuration
+ * 
+ * @return if every swept value matches the shipped constant
+ */
+static bool is_shipped(SweepConfig const& config) {
+  return (float) config.kp == KP_ && (float) config.ki == KI_ && (float) config.kd == KD_ &&
+    config.pid_rate_ms == PID_RATE_MS_ && (float) config.rotations_per_ms == ROTATIONS_PER_MS_ &&
+    config.error_threshold == ERROR_THRESHOLD_;
+}
+
+/**
+ * Sweep every combination of the listed values and rank them, rank 0 being
+ * the Pareto front
+ */
+int main(int argc, char** argv) {
+  std::vector<double> kps = {0.5, 1.0, 2.0};
+  std::vector<double> kis = {0.0, 2.0, 8.0};
+  std::vector<double> kds = {0.0, 0.005, 0.02};
+  std::vector<double> pid_rates_ms = {10, 20, 50};
+  std::vector<double> rotations_per_ms = {0.0005, 0.001, 0.0015};
+  std::vector<double> error_thresholds = {125, 250, 500};
+  std::vector<double> loads = {10.0, 10.0, 80.0, 10.0};
+  std::vector<double> gains = {1.0, 1.0, 0.8, 1.0};
+  int number_of_legs = 4;
+  int jobs = std::max(1u, std::thread::hardware_concurrency());
+  char const* csv_path = "sweep.csv";
+  char const* pareto_path = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--kp") && i + 1 < argc) {
+      kps = parse_list(argv[++i]);
+    } else if (!strcmp(argv[i], "--ki") && i + 1 < argc) {
+      kis = parse_list(argv[++i]);
+    } else if (!strcmp(argv[i], "--kd") && i + 1 < argc) {
+      kds = parse_list(argv[++i]);
+    } else if (!strcmp(argv[i], "--pid-rate-ms") && i + 1 < argc) {
+      pid_rates_ms = parse_list(argv[++i]);
+    } else if (!strcmp(argv[i], "--rotations-per-ms") && i + 1 < argc) {
+      rotations_per_ms = parse_list(argv[++i]);
+    } else if (!strcmp(argv[i], "--error-threshold") && i + 1 < argc) {
+      error_thresholds = parse_list(argv[++i]);
+    } else if (!strcmp(argv[i], "--legs") && i + 1 < argc) {
+      number_of_legs = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--loads") && i + 1 < argc) {
+      loads = parse_list(argv[++i]);
+    } else if (!strcmp(argv[i], "--gains") && i + 1 < argc) {
+      gains = parse_list(argv[++i]);
+    } else if (!strcmp(argv[i], "--jobs") && i + 1 < argc) {
+      jobs = std::max(1, atoi(argv[++i]));
+    } else if (!strcmp(argv[i], "--csv") && i + 1 < argc) {
+      csv_path = argv[++i];
+    } else if (!strcmp(argv[i], "--pareto") && i + 1 < argc) {
+      pareto_path = argv[++i];
+    } else {
+      fprintf(stderr, "usage: %s [--kp a,b,..] [--ki a,b,..] [--kd a,b,..] [--pid-rate-ms a,b,..] [--rotations-per-ms a,b,..] [--error-threshold a,b,..] [--legs N] [--loads a,b,..] [--gains a,b,..] [--jobs N] [--csv path] [--pareto path]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (number_of_legs < 1 || number_of_legs > MAXIMUM_NUMBER_OF_MODULES_) {
+    fprintf(stderr, "--legs must be 1 to %d\n", MAXIMUM_NUMBER_OF_MODULES_);
+    return 2;
+  }
+
+  DeskParameters parameters;
+  parameters.legs.resize(number_of_legs);
+  for (int i = 0; i < number_of_legs; i++) {
+    if (i < (int) loads.size()) parameters.legs[i].load_kg = loads[i];
+    if (i < (int) gains.size()) parameters.legs[i].motor_gain = gains[i];
+    parameters.legs[i].encoder_offset = (i * 1237) % 4096;
+    parameters.legs[i].clock_offset_us = 1000000LL + i * 7654321LL;
+    parameters.legs[i].clock_drift_ppm = (i % 2 ? -10.0 : 10.0) * (i + 1);
+  }
+
+  // The shipped constants go first, so they are scored and ranked alongside
+  // the grid
+  std::vector<SweepConfig> configs;
+  configs.push_back({KP_, KI_, KD_, PID_RATE_MS_, ROTATIONS_PER_MS_, ERROR_THRESHOLD_});
+  for (double kp : kps) {
+    for (double ki : kis) {
+      for (double kd : kds) {
+        for (double pid_rate_ms : pid_rates_ms) {
+          for (double rotations : rotations_per_ms) {
+            for (double error_threshold : error_thresholds) {
+              SweepConfig config = {kp, ki, kd, (unsigned long) pid_rate_ms, rotations, (long) error_threshold};
+              if (!is_shipped(config)) configs.push_back(config);
+            }
+          }
+        }
+      }
+    }
+  }
+
+  printf("sweeping %zu configurations on %d jobs\n", configs.size(), jobs);
+  auto start = std::chrono::steady_clock::now();
+  std::vector<SweepResult> results = evaluate_all(parameters, configs, jobs);
+  double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  rank(results);
+
+  std::vector<size_t> order(configs.size());
+  for (size_t i = 0; i < order.size(); i++) order[i] = i;
+  std::stable_sort(order.begin(), order.end(), [&results](size_t a, size_t b) {
+    if (results[a].rank != results[b].rank) return results[a].rank < results[b].rank;
+    return results[a].max_skew_mm < results[b].max_skew_mm;
+  });
+  std::vector<size_t> front;
+  for (size_t i : order) {
+    if (results[i].rank == 0) front.push_back(i);
+  }
+
+  if (!write_csv(csv_path, configs, results, order)) return 1;
+  if (pareto_path && !write_csv(pareto_path, configs, results, front)) return 1;
+
+  printf("simulated %zu configurations in %.1f s wall, %zu on the Pareto front\n", configs.size(), wall_s, front.size());
+  printf("%4s %6s %6s %7s %4s %8s %6s %8s %10s %8s %9s\n",
+    "rank", "kp", "ki", "kd", "ms", "rot/ms", "thresh", "settle s", "overshoot", "skew mm", "travel mm/s");
+  size_t shown = std::min<size_t>(front.size(), MAXIMUM_ROWS_SHOWN);
+  for (size_t n = 0; n <= shown; n++) {
+    size_t i = (n < shown) ? front[n] : 0;
+    if (n == shown) printf("shipped constants:\n");
+    printf(
+      "%4d %6g %6g %7g %4lu %8g %6ld %8.2f %10.3f %8.3f %9.2f%s\n",
+      results[i].rank,
+      configs[i].kp,
+      configs[i].ki,
+      configs[i].kd,
+      configs[i].pid_rate_ms,
+      configs[i].rotations_per_ms,
+      configs[i].error_threshold,
+      results[i].settle_s,
+      results[i].overshoot_mm,
+      results[i].max_skew_mm,
+      results[i].travel_mm_s,
+      results[i].is_settled ? "" : " (unsettled)"
+    );
+  }
+  if (front.size() > shown) printf("%zu more on the front, see %s\n", front.size() - shown, pareto_path ? pareto_path : csv_path);
+  printf("full ranking in %s\n", csv_path);
+  return 0;
+}
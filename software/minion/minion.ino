@@ -6,51 +6,93 @@
  * @author Jonathan Lee
  * Contact: jonlee27@seas.upenn.edu
  */
-#include <WiFi.h>
-#include <esp_now.h>
 #include "src/minion_constants.h"
+#include "src/esp32_hal.h"
+#include "src/clock_sync.h"
 #include "src/elevate_minion.h"
+#include "src/minion_power_manager.h"
+#include "src/minion_protocol.h"
+#include "src/minion_sampler.h"
 
-/**
- * Struct for messages from encoder minion
- * 
- * id:                         minion ID
- * height:                     module height
- * lower_limit_switch_pressed: whether or not the lower limit switch is pressed
- * upper_limit_switch_pressed: whether or not the upper limit switch is pressed
- */
-struct MinionMessage {
-  unsigned int id;
-  int height;
-  bool lower_limit_switch_pressed;
-  bool upper_limit_switch_pressed;
-};
-MinionMessage message;
+uint8_t const MINION_ID = 3;
+
+// Set to 0 to keep sampling at full rate while the leg is still
+#define LIGHT_SLEEP 1
+
+uint8_t frame[MINION_MAXIMUM_BATCH_FRAME_SIZE];
+unsigned long next_transmit_us;
+unsigned long next_sync_us;
 
 // ESP-NOW parameters
-esp_now_peer_info_t const master = {
-  .peer_addr = {0xF4, 0x12, 0xFA, 0x42, 0x09, 0x54},
-  .channel = 1,
-  .encrypt = false,
-};
+uint8_t const MASTER_ADDRESS[] = {0xF4, 0x12, 0xFA, 0x42, 0x09, 0x54};
+uint8_t const MASTER_CHANNEL = 1;
+
+Hal* const hal = esp32_hal();
+
+ClockSync clock_sync = ClockSync(hal, MINION_ID);
+ElevateMinion minion = ElevateMinion(hal, LOWER_LIMIT_SWITCH_PIN_0, UPPER_LIMIT_SWITCH_PIN_0);
+MinionSampler sampler = MinionSampler(hal, &minion, &clock_sync, SAMPLE_PERIOD_US, SAMPLE_DECIMATION);
 
-ElevateMinion minion = ElevateMinion(LOWER_LIMIT_SWITCH_PIN_0, UPPER_LIMIT_SWITCH_PIN_0);
+#if LIGHT_SLEEP
+MinionPowerManager power_manager = MinionPowerManager(
+  hal,
+  &minion,
+  &sampler,
+  &clock_sync,
+  IDLE_SLEEP_DELAY_MS,
+  WAKE_POLL_PERIOD_US,
+  WAKE_DISTANCE
+);
+bool is_started = false;
+#endif
+
+/**
+ * Callback when data is received from master, only clock sync replies are
+ * expected
+ */
+void receive_callback(const uint8_t* mac_address, const uint8_t* data, int len) {
+  clock_sync.receive(data, len);
+}
 
 void setup() {
   // communication setup
-  WiFi.mode(WIFI_STA);
-  WiFi.setSleep(false);
-  if (esp_now_init() != ESP_OK) return;
-  if (esp_now_add_peer(&master) != ESP_OK) return;
+  if (!hal->radio->begin()) return;
+  if (!hal->radio->add_peer(MASTER_ADDRESS, MASTER_CHANNEL)) return;
+  hal->radio->set_receive_callback(receive_callback);
 
   minion.setup();
-  message.id = 3;
+  sampler.start();
+  next_transmit_us = hal->clock->micros();
+  next_sync_us = next_transmit_us;
+#if LIGHT_SLEEP
+  is_started = true;
+#endif
 }
 
 void loop() {
-  message.height = minion.update_height();
-  message.lower_limit_switch_pressed = minion.lower_limit_switch_pressed();
-  message.upper_limit_switch_pressed = minion.upper_limit_switch_pressed();
-  esp_now_send(master.peer_addr, (uint8_t *) &message, sizeof(message));
-  delay(20);
+#if LIGHT_SLEEP
+  if (is_started && power_manager.update()) {
+    // Polling in light sleep; transmit and sync as soon as sampling resumes
+    next_transmit_us = hal->clock->micros();
+    next_sync_us = next_transmit_us;
+    return;
+  }
+#endif
+  long wait_us = (long) (next_transmit_us - hal->clock->micros());
+  if (wait_us > 0) {
+    delay(wait_us / 1000 + 1);
+    return;
+  }
+  next_transmit_us += TRANSMIT_PERIOD_US;
+
+  if ((long) (next_transmit_us - next_sync_us) > 0) {
+    next_sync_us += SYNC_PERIOD_US;
+    size_t len = clock_sync.encode_request(frame, sizeof(frame));
+    hal->radio->send(MASTER_ADDRESS, frame, len);
+  }
+
+  size_t len;
+  while ((len = sampler.encode_frame(MINION_ID, frame, sizeof(frame))) > 0) {
+    hal->radio->send(MASTER_ADDRESS, frame, len);
+  }
 }
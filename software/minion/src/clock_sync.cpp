@@ -0,0 +1,158 @@
+/**
+ * @file clock_sync.cpp
+ * 
+ * @brief minion to master clock sync
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#include "clock_sync.h"
+
+/**
+ * Clock Sync constructor
+ * 
+ * @param hal hardware abstraction layer
+ * @param id  minion ID, replies for other minions are ignored
+ */
+ClockSync::ClockSync(Hal* hal, uint8_t id) :
+HAL(hal),
+ID(id),
+request_send_us(0),
+is_request_pending(false),
+offset_us(0),
+round_trip_us(0),
+synced(false) {
+  next_exchange = 0;
+  number_of_exchanges = 0;
+}
+
+/**
+ * Clock Sync copy constructor, only valid before the first exchange
+ * 
+ * @param other clock sync to copy
+ */
+ClockSync::ClockSync(ClockSync const& other) :
+HAL(other.HAL),
+ID(other.ID),
+request_send_us(0),
+is_request_pending(false),
+offset_us(0),
+round_trip_us(0),
+synced(false) {
+  next_exchange = 0;
+  number_of_exchanges = 0;
+}
+
+/**
+ * Encode a sync request stamped with the minion clock, replacing any request
+ * still unanswered
+ * 
+ * @param buffer frame buffer
+ * @param size   frame buffer size in bytes
+ * 
+ * @return frame length in bytes, or 0 if the buffer is too small
+ */
+size_t ClockSync::encode_request(uint8_t* buffer, size_t size) {
+  MinionSyncRequest request;
+  request.id = ID;
+  request.minion_send_us = (uint32_t) HAL->clock->micros();
+  size_t len = encode_minion_sync_request(request, buffer, size);
+  if (len > 0) {
+    request_send_us.store(request.minion_send_us, std::memory_order_relaxed);
+    is_request_pending.store(true, std::memory_order_release);
+  }
+  return len;
+}
+
+/**
+ * Take a sync reply from the master, called from the radio callback.
+ * Assuming both legs of the trip take equally long, the master clock is
+ * ahead by ((t2 - t1) + (t3 - t4)) / 2. Radio delay is rarely symmetric when
+ * the air is busy, so the offset comes from the exchange with the shortest
+ * round trip among the last few, which bounds its error by half that round
+ * trip. The sampler timer reads the offset, so it is shared atomically.
+ * 
+ * @param data frame
+ * @param len  frame length in bytes
+ * 
+ * @return if the frame answered the pending request of this minion
+ */
+bool ClockSync::receive(const uint8_t* data, int len) {
+  uint32_t receive_us = (uint32_t) HAL->clock->micros();
+  MinionSyncReply reply;
+  if (len <= 0 || decode_minion_sync_reply(data, (size_t) len, reply) != MINION_MESSAGE_OK) return false;
+  if (reply.id != ID || !is_request_pending.load(std::memory_order_acquire)) return false;
+  if (reply.minion_send_us != request_send_us.load(std::memory_order_relaxed)) return false;
+  is_request_pending.store(false, std::memory_order_relaxed);
+
+  int32_t elapsed_us = (int32_t) (receive_us - reply.minion_send_us);
+  int32_t held_us = (int32_t) (reply.master_send_us - reply.master_receive_us);
+  if (elapsed_us < 0 || held_us < 0 || held_us > elapsed_us) return false;
+
+  offsets_us[next_exchange] =
+    ((int32_t) (reply.master_receive_us - reply.minion_send_us) +
+     (int32_t) (reply.master_send_us - receive_us)) / 2;
+  round_trips_us[next_exchange] = (uint32_t) (elapsed_us - held_us);
+  next_exchange = (next_exchange + 1) % WINDOW;
+  if (number_of_exchanges < WINDOW) number_of_exchanges++;
+
+  int best = 0;
+  for (int i = 1; i < number_of_exchanges; i++) {
+    if (round_trips_us[i] < round_trips_us[best]) best = i;
+  }
+  offset_us.store(offsets_us[best], std::memory_order_relaxed);
+  round_trip_us.store(round_trips_us[best], std::memory_order_relaxed);
+  synced.store(true, std::memory_order_release);
+  return true;
+}
+
+/**
+ * Forget every exchange after going without sync for long enough to drift,
+ * so samples are stamped unsynced until the next exchange alone sets the
+ * offset; call from loop() with the radio idle
+ */
+void ClockSync::restart() {
+  is_request_pending.store(false, std::memory_order_relaxed);
+  synced.store(false, std::memory_order_release);
+  next_exchange = 0;
+  number_of_exchanges = 0;
+}
+
+/**
+ * Get whether at least one exchange has completed
+ * 
+ * @return if the offset is known
+ */
+bool ClockSync::is_synced() const {
+  return synced.load(std::memory_order_acquire);
+}
+
+/**
+ * Convert a minion clock time to the master clock
+ * 
+ * @param minion_us minion clock in us
+ * 
+ * @return master clock in us, unchanged before the first exchange
+ */
+uint32_t ClockSync::to_master_us(uint32_t minion_us) const {
+  return minion_us + (uint32_t) offset_us.load(std::memory_order_relaxed);
+}
+
+/**
+ * Get how far the master clock is ahead of the minion clock
+ * 
+ * @return offset in us
+ */
+int32_t ClockSync::get_offset_us() const {
+  return offset_us.load(std::memory_order_relaxed);
+}
+
+/**
+ * Get the round trip of the exchange the offset was taken from, twice the
+ * bound on the offset error
+ * 
+ * @return round trip in us
+ */
+uint32_t ClockSync::get_round_trip_us() const {
+  return round_trip_us.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,47 @@
+/**
+ * @file clock_sync.h
+ * 
+ * @brief header file for minion to master clock sync
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#ifndef CLOCK_SYNC_H_
+#define CLOCK_SYNC_H_
+
+#include "hal.h"
+#include "minion_protocol.h"
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+class ClockSync {
+  public:
+    ClockSync(Hal* hal, uint8_t id);
+    ClockSync(ClockSync const& other);
+    size_t encode_request(uint8_t* buffer, size_t size);
+    bool receive(const uint8_t* data, int len);
+    void restart();
+    bool is_synced() const;
+    uint32_t to_master_us(uint32_t minion_us) const;
+    int32_t get_offset_us() const;
+    uint32_t get_round_trip_us() const;
+
+  private:
+    static int const WINDOW = 4;
+
+    Hal* const HAL;
+    uint8_t const ID;
+
+    int32_t offsets_us[WINDOW];
+    uint32_t round_trips_us[WINDOW];
+    int next_exchange;
+    int number_of_exchanges;
+    std::atomic<uint32_t> request_send_us;
+    std::atomic<bool> is_request_pending;
+    std::atomic<int32_t> offset_us;
+    std::atomic<uint32_t> round_trip_us;
+    std::atomic<bool> synced;
+};
+
+#endif
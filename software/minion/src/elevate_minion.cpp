@@ -8,22 +8,43 @@
  */
 #include "elevate_minion.h"
 #include "minion_constants.h"
-#include "switch_utility.h"
-#include <Arduino.h>
+#include <math.h>
+
+/**
+ * Clamp a value into an int16
+ * 
+ * @param value value to clamp
+ * 
+ * @return clamped value
+ */
+static int16_t saturate_int16(float value) {
+  if (value > INT16_MAX) return INT16_MAX;
+  if (value < INT16_MIN) return INT16_MIN;
+  return (int16_t) lroundf(value);
+}
 
 /**
  * Elevate Minion constructor
  * 
- * @param upper_limit_switch_pin upper limit switch input pin
+ * @param hal                    hardware abstraction layer
  * @param lower_limit_switch_pin lower limit switch input pin
+ * @param upper_limit_switch_pin upper limit switch input pin
  */
-ElevateMinion::ElevateMinion(uint8_t lower_limit_switch_pin, uint8_t upper_limit_switch_pin) :
-encoder(),
+ElevateMinion::ElevateMinion(Hal* hal, uint8_t lower_limit_switch_pin, uint8_t upper_limit_switch_pin) :
+HAL(hal),
+encoder(hal),
+motion(ESTIMATOR_BANDWIDTH_HZ),
 LOWER_LIMIT_SWITCH_PIN(lower_limit_switch_pin),
-UPPER_LIMIT_SWITCH_PIN(upper_limit_switch_pin) {
+UPPER_LIMIT_SWITCH_PIN(upper_limit_switch_pin),
+limit_switches(hal, DEBOUNCE_DELAY_MS) {
+  limit_switches.add_switch(LOWER_LIMIT_SWITCH_PIN);
+  limit_switches.add_switch(UPPER_LIMIT_SWITCH_PIN);
   is_setup = false;
   height = 0;
   previous_angle = 0;
+  reading_timestamp_us = 0;
+  magnet_strength = NONE;
+  is_encoder_stale = true;
 }
 
 /**
@@ -31,29 +52,34 @@ UPPER_LIMIT_SWITCH_PIN(upper_limit_switch_pin) {
  */
 void ElevateMinion::setup() {
   if (!is_setup) {
-    pinMode(UPPER_LIMIT_SWITCH_PIN, INPUT);
-    pinMode(LOWER_LIMIT_SWITCH_PIN, INPUT);
-    previous_angle = encoder.get_raw_angle();
+    limit_switches.setup();
+    encoder.setup();
+    EncoderReading reading;
+    if (encoder.read(reading)) {
+      previous_angle = reading.raw_angle;
+      magnet_strength = reading.magnet_strength;
+    }
+    reading_timestamp_us = reading.timestamp_us;
+    motion.reset(height);
+    encoder.start_read();
     is_setup = true;
   }
 }
 
+/**
+ * Sample and debounce both limit switches, on every sampling tick
+ */
+void ElevateMinion::update_switches() {
+  limit_switches.update();
+}
+
 /**
  * Determine if lower limit switch is pressed
  * 
  * @return if lower limit switch is pressed
  */
 bool ElevateMinion::lower_limit_switch_pressed() const {
-  static uint8_t switch_state = digitalRead(LOWER_LIMIT_SWITCH_PIN);
-  static uint8_t previous_state = digitalRead(LOWER_LIMIT_SWITCH_PIN);
-  static unsigned long previous_time = millis();
-  return switch_pressed(
-    LOWER_LIMIT_SWITCH_PIN,
-    DEBOUNCE_DELAY_MS,
-    switch_state,
-    previous_state,
-    previous_time
-  );
+  return limit_switches.is_pressed(LOWER_LIMIT_SWITCH_PIN);
 }
 
 /**
@@ -62,32 +88,79 @@ bool ElevateMinion::lower_limit_switch_pressed() const {
  * @return if upper limit switch is pressed
  */
 bool ElevateMinion::upper_limit_switch_pressed() const {
-  static uint8_t switch_state = digitalRead(UPPER_LIMIT_SWITCH_PIN);
-  static uint8_t previous_state = digitalRead(UPPER_LIMIT_SWITCH_PIN);
-  static unsigned long previous_time = millis();
-  return switch_pressed(
-    UPPER_LIMIT_SWITCH_PIN,
-    DEBOUNCE_DELAY_MS,
-    switch_state,
-    previous_state,
-    previous_time
-  );
+  return limit_switches.is_pressed(UPPER_LIMIT_SWITCH_PIN);
 }
 
 /**
- * Update the height of the module
+ * Update the height of the module from the last finished encoder read and
+ * start the next one
+ * 
+ * If no read finished or the read failed, the height is left alone and
+ * marked stale rather than repeated.
  * 
- * :return: module height
+ * @return module height
  */
 long ElevateMinion::update_height() {
-  int current_angle = encoder.get_raw_angle();
-  int increase = (current_angle - previous_angle + UNITS_PER_ROTATION) % UNITS_PER_ROTATION;
-  int decrease = (previous_angle - current_angle + UNITS_PER_ROTATION) % UNITS_PER_ROTATION;
-  if (increase > decrease) {
-    height -= decrease;
-  } else {
-    height += increase;
+  EncoderReading reading;
+  is_encoder_stale = true;
+  if (encoder.take_reading(reading) && reading.is_valid) {
+    int increase = (reading.raw_angle - previous_angle) & (UNITS_PER_ROTATION - 1);
+    if (increase > UNITS_PER_ROTATION / 2) {
+      height += increase - UNITS_PER_ROTATION;
+    } else {
+      height += increase;
+    }
+    previous_angle = reading.raw_angle;
+    motion.update(height, (reading.timestamp_us - reading_timestamp_us) * 1e-6f);
+    reading_timestamp_us = reading.timestamp_us;
+    magnet_strength = reading.magnet_strength;
+    is_encoder_stale = false;
   }
-  previous_angle = current_angle;
+  encoder.start_read();
+  return height;
+}
+
+/**
+ * Get the height as of the last height update
+ * 
+ * @return height in encoder units
+ */
+long ElevateMinion::get_height() const {
   return height;
 }
+
+/**
+ * Check if the last height update had no fresh encoder reading
+ * 
+ * @return if the height is stale
+ */
+bool ElevateMinion::encoder_stale() const {
+  return is_encoder_stale;
+}
+
+/**
+ * Get the motion estimate from encoder reads
+ * 
+ * @return motion estimator
+ */
+MotionEstimator const& ElevateMinion::get_motion() const {
+  return motion;
+}
+
+/**
+ * Sample the module as of the last height update, stamped with the time of
+ * the encoder read behind it
+ * 
+ * @param sample sample to fill
+ */
+void ElevateMinion::sample(MinionSample& sample) {
+  sample.height = (int32_t) height;
+  sample.timestamp_us = reading_timestamp_us;
+  sample.velocity = saturate_int16(motion.get_velocity());
+  sample.acceleration = saturate_int16(motion.get_acceleration() / MINION_ACCELERATION_SCALE);
+  sample.status = 0;
+  if (lower_limit_switch_pressed()) sample.status |= MINION_LOWER_LIMIT_BIT;
+  if (upper_limit_switch_pressed()) sample.status |= MINION_UPPER_LIMIT_BIT;
+  if (is_encoder_stale) sample.status |= MINION_ENCODER_STALE_BIT;
+  sample.status |= (magnet_strength << MINION_MAGNET_STRENGTH_SHIFT) & MINION_MAGNET_STRENGTH_MASK;
+}
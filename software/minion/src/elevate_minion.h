@@ -10,23 +10,39 @@
 #define ELEVATE_MINION_H_
 
 #include "encoder.h"
+#include "hal.h"
+#include "minion_protocol.h"
+#include "motion_estimator.h"
+#include "switch_debouncer.h"
+#include <stdint.h>
 
 class ElevateMinion {
   public:
-    ElevateMinion(uint8_t lower_limit_switch_pin, uint8_t upper_limit_switch_pin);
+    ElevateMinion(Hal* hal, uint8_t lower_limit_switch_pin, uint8_t upper_limit_switch_pin);
     void setup();
+    void update_switches();
     bool lower_limit_switch_pressed() const;
     bool upper_limit_switch_pressed() const;
     long update_height();
+    long get_height() const;
+    bool encoder_stale() const;
+    MotionEstimator const& get_motion() const;
+    void sample(MinionSample& sample);
 
   private:
-    Encoder const encoder;
-    uint8_t const UPPER_LIMIT_SWITCH_PIN;
+    Hal* const HAL;
+    Encoder encoder;
+    MotionEstimator motion;
     uint8_t const LOWER_LIMIT_SWITCH_PIN;
+    uint8_t const UPPER_LIMIT_SWITCH_PIN;
 
     bool is_setup;
     long height;
     int previous_angle;
+    uint32_t reading_timestamp_us;
+    MagnetStrength magnet_strength;
+    bool is_encoder_stale;
+    SwitchDebouncer limit_switches;
 };
 
 #endif
@@ -8,8 +8,6 @@
  */
 #include "encoder.h"
 #include "minion_constants.h"
-#include <Arduino.h>
-#include <Wire.h>
 
 uint8_t const Encoder::ENCODER_ADDRESS = ENCODER_ADDRESS_;
 uint8_t const Encoder::RAW_ANGLE_ADDRESS = RAW_ANGLE_ADDRESS_;
@@ -17,90 +15,139 @@ uint8_t const Encoder::STATUS_ADDRESS = STATUS_ADDRESS_;
 
 /**
  * Encoder constructor
+ * 
+ * @param hal hardware abstraction layer
  */
-Encoder::Encoder() {
-  Wire.begin(SDA_PIN, SCL_PIN, I2C_FREQUENCY);
+Encoder::Encoder(Hal* hal) : HAL(hal), state(IDLE) {
+  for (size_t i = 0; i < BURST_SIZE; i++) {
+    burst[i] = 0;
+  }
+  completed_reading.raw_angle = 0;
+  completed_reading.magnet_strength = NONE;
+  completed_reading.timestamp_us = 0;
+  completed_reading.is_valid = false;
+  failures = 0;
 }
 
 /**
- * Get raw angle, 0-4095
+ * Encoder copy constructor, only valid while no read is in flight
  * 
- * @return raw angle
+ * @param other encoder to copy
  */
-int Encoder::get_raw_angle() const {
-  return read_two_bytes(RAW_ANGLE_ADDRESS);
+Encoder::Encoder(Encoder const& other) : HAL(other.HAL), state(IDLE) {
+  for (size_t i = 0; i < BURST_SIZE; i++) {
+    burst[i] = other.burst[i];
+  }
+  completed_reading = other.completed_reading;
+  failures = other.failures;
 }
 
 /**
- * Check if magnet is detected
- * 
- * @return if magnet is detected
+ * Set up encoder bus
  */
-bool Encoder::magnet_detected() const {
-  int status = read_one_byte(STATUS_ADDRESS);
-  return (status & 0x20);
+void Encoder::setup() {
+  HAL->i2c->begin(SDA_PIN, SCL_PIN, I2C_FREQUENCY);
 }
 
 /**
- * Check magnet strength
+ * Read the encoder and wait for the result, for use before sampling starts
  * 
- * @return magnet strength
+ * @param reading reading to fill
+ * 
+ * @return if the read succeeded
  */
-MagnetStrength Encoder::get_magnet_strength() const {
-  MagnetStrength strength = NONE;
-  int status = read_one_byte(STATUS_ADDRESS);
-  if (status & 0x20) {
-    strength = PERFECT;
-    if (status & 0x10) {
-      strength = WEAK;
-    } else if (status & 0x08) {
-      strength = STRONG;
-    }
+bool Encoder::read(EncoderReading& reading) {
+  uint8_t data[BURST_SIZE];
+  reading.timestamp_us = (uint32_t) HAL->clock->micros();
+  reading.is_valid = HAL->i2c->read(ENCODER_ADDRESS, STATUS_ADDRESS, data, BURST_SIZE, WAIT_TIME_MS);
+  if (reading.is_valid) {
+    decode(data, reading);
+  } else {
+    failures++;
   }
+  return reading.is_valid;
+}
 
-  return strength;
+/**
+ * Start an asynchronous read without waiting for the bus. STATUS and
+ * RAW_ANGLE sit next to each other on the AS5600, so one burst returns both.
+ * 
+ * @return if the read started; false if a read is in flight, its result has
+ *         not been taken, or the bus refused it
+ */
+bool Encoder::start_read() {
+  if (state.load(std::memory_order_acquire) != IDLE) return false;
+  completed_reading.timestamp_us = (uint32_t) HAL->clock->micros();
+  state.store(BUSY, std::memory_order_relaxed);
+  if (!HAL->i2c->read_async(
+      ENCODER_ADDRESS,
+      STATUS_ADDRESS,
+      burst,
+      BURST_SIZE,
+      WAIT_TIME_MS,
+      read_complete,
+      this)) {
+    state.store(IDLE, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
 }
 
 /**
- * Read one byte of information from encoder
+ * Take the result of the last asynchronous read if it has finished; a
+ * failed read is never replaced by an older value
  * 
- * @param address address to read from
+ * @param reading reading to fill, check is_valid for bus errors
  * 
- * @return one byte of information
+ * @return if a finished read was taken
  */
-int Encoder::read_one_byte(uint8_t address) {
-  static int reading = 0;
-  Wire.beginTransmission(ENCODER_ADDRESS);
-  Wire.write(address);
-  Wire.endTransmission();
-  Wire.requestFrom(ENCODER_ADDRESS, (uint8_t) 1);
-  unsigned long start = millis();
-  while (Wire.available() == 0) {
-    if (millis() - start > WAIT_TIME_MS) return reading;
-  };
-  reading = (int) Wire.read();
-  return reading;
+bool Encoder::take_reading(EncoderReading& reading) {
+  if (state.load(std::memory_order_acquire) != DONE) return false;
+  reading = completed_reading;
+  if (!reading.is_valid) failures++;
+  state.store(IDLE, std::memory_order_release);
+  return true;
 }
 
 /**
- * Read two bytes of information from encoder
+ * Get number of failed reads
  * 
- * @param address address to read from
+ * @return number of failed reads
+ */
+uint32_t Encoder::get_failures() const {
+  return failures;
+}
+
+/**
+ * Bus callback for a finished asynchronous read
+ * 
+ * @param encoder encoder that started the read
+ * @param success whether every byte was read
+ */
+void Encoder::read_complete(void* encoder, bool success) {
+  Encoder* self = (Encoder*) encoder;
+  self->completed_reading.is_valid = success;
+  if (success) decode(self->burst, self->completed_reading);
+  self->state.store(DONE, std::memory_order_release);
+}
+
+/**
+ * Decode a STATUS and RAW_ANGLE burst
  * 
- * @return two bytes of information
+ * @param burst   registers from STATUS through RAW_ANGLE
+ * @param reading reading to fill
  */
-int Encoder::read_two_bytes(uint8_t address) {
-  static int reading = 0;
-  Wire.beginTransmission(ENCODER_ADDRESS);
-  Wire.write(address);
-  Wire.endTransmission();
-  Wire.requestFrom(ENCODER_ADDRESS, (uint8_t) 2);
-  unsigned long start = millis();
-  while (Wire.available() < 2) {
-    if ((millis() - start) > WAIT_TIME_MS) return reading;
-  };
-  int high_byte = Wire.read();
-  int low_byte = Wire.read();
-  reading = (high_byte << 8) | low_byte;
-  return reading;
+void Encoder::decode(const uint8_t* burst, EncoderReading& reading) {
+  uint8_t status = burst[0];
+  const uint8_t* raw_angle = burst + (RAW_ANGLE_ADDRESS - STATUS_ADDRESS);
+  reading.raw_angle = ((raw_angle[0] & 0x0f) << 8) | raw_angle[1];
+  reading.magnet_strength = NONE;
+  if (status & 0x20) {
+    reading.magnet_strength = PERFECT;
+    if (status & 0x10) {
+      reading.magnet_strength = WEAK;
+    } else if (status & 0x08) {
+      reading.magnet_strength = STRONG;
+    }
+  }
 }
@@ -9,6 +9,9 @@
 #ifndef ENCODER_H_
 #define ENCODER_H_
 
+#include "hal.h"
+#include <atomic>
+#include <stddef.h>
 #include <stdint.h>
 
 /**
@@ -26,20 +29,59 @@ enum MagnetStrength {
   STRONG
 };
 
+/**
+ * Struct for one encoder reading
+ * 
+ * raw_angle:       raw angle, 0-4095
+ * magnet_strength: magnet strength
+ * timestamp_us:    minion clock when the read started in us
+ * is_valid:        false if the bus read failed, other fields are then unset
+ */
+struct EncoderReading {
+  int raw_angle;
+  MagnetStrength magnet_strength;
+  uint32_t timestamp_us;
+  bool is_valid;
+};
+
 class Encoder {
   public:
-    Encoder();
-    int get_raw_angle() const;
-    bool magnet_detected() const;
-    MagnetStrength get_magnet_strength() const;
+    Encoder(Hal* hal);
+    Encoder(Encoder const& other);
+    void setup();
+    bool read(EncoderReading& reading);
+    bool start_read();
+    bool take_reading(EncoderReading& reading);
+    uint32_t get_failures() const;
 
   private:
     static uint8_t const ENCODER_ADDRESS;
     static uint8_t const RAW_ANGLE_ADDRESS;
     static uint8_t const STATUS_ADDRESS;
+    static size_t const BURST_SIZE = 3;
+
+    /**
+     * Read State
+     * 
+     * IDLE: no read in flight
+     * BUSY: read in flight
+     * DONE: read finished, waiting for take_reading()
+     */
+    enum ReadState {
+      IDLE,
+      BUSY,
+      DONE
+    };
+
+    Hal* const HAL;
+
+    uint8_t burst[BURST_SIZE];
+    EncoderReading completed_reading;
+    std::atomic<int> state;
+    uint32_t failures;
 
-    static int read_one_byte(uint8_t address);
-    static int read_two_bytes(uint8_t address);
+    static void read_complete(void* encoder, bool success);
+    static void decode(const uint8_t* burst, EncoderReading& reading);
 };
 
 #endif
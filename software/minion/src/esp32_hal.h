@@ -0,0 +1,147 @@
+/**
+ * @file esp32_hal.h
+ * 
+ * @brief header file for ESP32 hardware abstraction layer backend
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#ifndef ESP32_HAL_H_
+#define ESP32_HAL_H_
+
+#include "hal.h"
+
+#ifdef ARDUINO
+
+class Esp32Clock : public Clock {
+  public:
+    unsigned long millis() const;
+    unsigned long micros() const;
+};
+
+class Esp32Gpio : public Gpio {
+  public:
+    void pin_mode(uint8_t pin, HalPinMode mode);
+    uint8_t digital_read(uint8_t pin) const;
+    void digital_write(uint8_t pin, uint8_t value);
+    uint32_t read_bank(uint8_t bank) const;
+};
+
+class Esp32Pwm : public Pwm {
+  public:
+    void setup(uint8_t channel, uint32_t frequency, uint8_t resolution_bits);
+    void attach_pin(uint8_t pin, uint8_t channel);
+    void write(uint8_t channel, uint32_t duty);
+};
+
+class Esp32Radio : public Radio {
+  public:
+    bool begin();
+    bool add_peer(const uint8_t* mac_address, uint8_t channel);
+    void set_receive_callback(ReceiveCallback callback);
+    bool send(const uint8_t* mac_address, const uint8_t* data, size_t len);
+};
+
+class Esp32I2c : public I2c {
+  public:
+    Esp32I2c(int core, int priority);
+    bool begin(int sda_pin, int scl_pin, uint32_t frequency);
+    bool read(
+      uint8_t device_address,
+      uint8_t register_address,
+      uint8_t* data,
+      size_t len,
+      unsigned long timeout_ms
+    );
+    bool read_async(
+      uint8_t device_address,
+      uint8_t register_address,
+      uint8_t* data,
+      size_t len,
+      unsigned long timeout_ms,
+      I2cCallback callback,
+      void* context
+    );
+
+  private:
+    static int const QUEUE_LENGTH = 4;
+
+    /**
+     * Struct for one queued read
+     */
+    struct Request {
+      uint8_t device_address;
+      uint8_t register_address;
+      uint8_t* data;
+      size_t len;
+      unsigned long timeout_ms;
+      I2cCallback callback;
+      void* context;
+    };
+
+    int const CORE;
+    int const PRIORITY;
+
+    void* queue;
+    void* task;
+
+    static void task_main(void* i2c);
+};
+
+class Esp32PeriodicTimer : public PeriodicTimer {
+  public:
+    Esp32PeriodicTimer(int core, int priority);
+    bool start(unsigned long period_us, TickCallback callback, void* context);
+    void stop();
+
+  private:
+    int const CORE;
+    int const PRIORITY;
+
+    TickCallback callback;
+    void* context;
+    void* task;
+    void* timer;
+
+    static void task_main(void* periodic_timer);
+    static void timer_callback(void* periodic_timer);
+};
+
+class Esp32Storage : public Storage {
+  public:
+    bool read(const char* key, void* data, size_t len);
+    bool write(const char* key, const void* data, size_t len);
+
+  private:
+    static char const* const NAMESPACE;
+};
+
+class Esp32SerialPort : public SerialPort {
+  public:
+    bool begin(unsigned long baud_rate);
+    size_t available_for_write();
+    size_t write(const uint8_t* data, size_t len);
+
+  private:
+    static size_t const TX_BUFFER_SIZE;
+};
+
+class Esp32Power : public Power {
+  public:
+    Esp32Power();
+    void enable_pin_wake(uint8_t pin, uint8_t level);
+    void enable_timer_wake(unsigned long sleep_us);
+    void light_sleep();
+
+  private:
+    static int const MAXIMUM_WAKE_PINS = 8;
+
+    uint8_t wake_pins[MAXIMUM_WAKE_PINS];
+    int number_of_wake_pins;
+};
+
+Hal* esp32_hal();
+
+#endif
+
+#endif
@@ -0,0 +1,232 @@
+/**
+ * @file linux_hal.h
+ * 
+ * @brief header file for Linux hardware abstraction layer backend
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#ifndef LINUX_HAL_H_
+#define LINUX_HAL_H_
+
+#include "hal.h"
+
+#ifndef ARDUINO
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+class LinuxClock : public Clock {
+  public:
+    LinuxClock();
+    unsigned long millis() const;
+    unsigned long micros() const;
+
+  private:
+    unsigned long long start_us;
+};
+
+class VirtualClock : public Clock {
+  public:
+    VirtualClock();
+    unsigned long millis() const;
+    unsigned long micros() const;
+    void set_micros(unsigned long long time_us);
+    void advance_micros(unsigned long long time_us);
+
+  private:
+    unsigned long long time_us;
+};
+
+class LinuxGpio : public Gpio {
+  public:
+    LinuxGpio();
+    void pin_mode(uint8_t pin, HalPinMode mode);
+    uint8_t digital_read(uint8_t pin) const;
+    void digital_write(uint8_t pin, uint8_t value);
+    uint32_t read_bank(uint8_t bank) const;
+    void set_input(uint8_t pin, uint8_t value);
+    HalPinMode get_mode(uint8_t pin) const;
+
+  private:
+    static int const NUMBER_OF_PINS = 256;
+    static int const NUMBER_OF_BANKS = NUMBER_OF_PINS / HAL_PINS_PER_BANK;
+
+    uint8_t levels[NUMBER_OF_PINS];
+    uint32_t bank_levels[NUMBER_OF_BANKS];
+    HalPinMode modes[NUMBER_OF_PINS];
+
+    void set_level(uint8_t pin, uint8_t value);
+};
+
+class LinuxPwm : public Pwm {
+  public:
+    LinuxPwm();
+    void setup(uint8_t channel, uint32_t frequency, uint8_t resolution_bits);
+    void attach_pin(uint8_t pin, uint8_t channel);
+    void write(uint8_t channel, uint32_t duty);
+    uint32_t get_duty(uint8_t channel) const;
+    uint8_t get_resolution_bits(uint8_t channel) const;
+
+  private:
+    static int const NUMBER_OF_CHANNELS = 16;
+
+    uint32_t frequencies[NUMBER_OF_CHANNELS];
+    uint8_t resolution_bits[NUMBER_OF_CHANNELS];
+    uint32_t duties[NUMBER_OF_CHANNELS];
+};
+
+class LinuxRadio : public Radio {
+  public:
+    LinuxRadio();
+    bool begin();
+    bool add_peer(const uint8_t* mac_address, uint8_t channel);
+    void set_receive_callback(ReceiveCallback callback);
+    bool send(const uint8_t* mac_address, const uint8_t* data, size_t len);
+    void receive(const uint8_t* mac_address, const uint8_t* data, int len);
+    std::vector<std::vector<uint8_t> > const& get_sent() const;
+    void clear_sent();
+
+  private:
+    bool is_started;
+    ReceiveCallback callback;
+    std::vector<std::vector<uint8_t> > sent;
+};
+
+class I2cDevice {
+  public:
+    virtual ~I2cDevice() {}
+    virtual bool read(uint8_t register_address, uint8_t* data, size_t len) = 0;
+};
+
+class LinuxI2c : public I2c {
+  public:
+    LinuxI2c();
+    bool begin(int sda_pin, int scl_pin, uint32_t frequency);
+    bool read(
+      uint8_t device_address,
+      uint8_t register_address,
+      uint8_t* data,
+      size_t len,
+      unsigned long timeout_ms
+    );
+    bool read_async(
+      uint8_t device_address,
+      uint8_t register_address,
+      uint8_t* data,
+      size_t len,
+      unsigned long timeout_ms,
+      I2cCallback callback,
+      void* context
+    );
+    void attach(uint8_t device_address, I2cDevice* device);
+    uint32_t get_frequency() const;
+    void set_deferred(bool deferred);
+    bool complete_transfer();
+    bool is_transfer_pending() const;
+    void fail_transfers(int count);
+
+  private:
+    static int const NUMBER_OF_ADDRESSES = 128;
+
+    bool is_started;
+    uint32_t frequency;
+    I2cDevice* devices[NUMBER_OF_ADDRESSES];
+    bool deferred;
+    int failures_remaining;
+    bool is_pending;
+    uint8_t pending_device_address;
+    uint8_t pending_register_address;
+    uint8_t* pending_data;
+    size_t pending_len;
+    I2cCallback pending_callback;
+    void* pending_context;
+};
+
+class LinuxPeriodicTimer : public PeriodicTimer {
+  public:
+    LinuxPeriodicTimer(bool simulated_tick);
+    ~LinuxPeriodicTimer();
+    bool start(unsigned long period_us, TickCallback callback, void* context);
+    void stop();
+    void tick();
+
+  private:
+    bool const SIMULATED_TICK;
+
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool is_running;
+    unsigned long period_us;
+    TickCallback callback;
+    void* context;
+    unsigned long long requested_ticks;
+    unsigned long long completed_ticks;
+
+    void thread_main();
+};
+
+class LinuxStorage : public Storage {
+  public:
+    bool read(const char* key, void* data, size_t len);
+    bool write(const char* key, const void* data, size_t len);
+    void clear();
+
+  private:
+    std::map<std::string, std::vector<uint8_t> > values;
+};
+
+class LinuxSerialPort : public SerialPort {
+  public:
+    LinuxSerialPort();
+    bool begin(unsigned long baud_rate);
+    size_t available_for_write();
+    size_t write(const uint8_t* data, size_t len);
+    void set_output(FILE* output);
+    std::vector<uint8_t> const& get_written() const;
+    void clear();
+
+  private:
+    FILE* output;
+    std::vector<uint8_t> written;
+};
+
+class LinuxPower : public Power {
+  public:
+    LinuxPower(Clock const* clock, Gpio const* gpio);
+    void enable_pin_wake(uint8_t pin, uint8_t level);
+    void enable_timer_wake(unsigned long sleep_us);
+    void light_sleep();
+    bool update();
+    void set_awake_per_wake(unsigned long awake_us);
+    bool is_asleep() const;
+    unsigned long get_asleep_us() const;
+    unsigned long get_sleeps() const;
+
+  private:
+    static int const MAXIMUM_WAKE_PINS = 8;
+
+    Clock const* const CLOCK;
+    Gpio const* const GPIO;
+
+    uint8_t wake_pins[MAXIMUM_WAKE_PINS];
+    uint8_t wake_levels[MAXIMUM_WAKE_PINS];
+    int number_of_wake_pins;
+    bool is_timer_wake;
+    unsigned long wake_after_us;
+    unsigned long awake_per_wake_us;
+    bool is_sleeping;
+    unsigned long sleep_start_us;
+    unsigned long asleep_us;
+    unsigned long sleeps;
+};
+
+#endif
+
+#endif
@@ -18,8 +18,8 @@
 // Encoder constants
 int const SDA_PIN = 18;
 int const SCL_PIN = 19;
-uint32_t const I2C_FREQUENCY = 100000;
-unsigned long const WAIT_TIME_MS = 10;
+uint32_t const I2C_FREQUENCY = 400000;
+unsigned long const WAIT_TIME_MS = 1;
 uint8_t const ENCODER_ADDRESS_ = 0x36;
 uint8_t const RAW_ANGLE_ADDRESS_ = 0x0c;
 uint8_t const STATUS_ADDRESS_ = 0x0b;
@@ -27,4 +27,16 @@ uint8_t const STATUS_ADDRESS_ = 0x0b;
 int const UNITS_PER_ROTATION = 1 << 12;
 unsigned long const DEBOUNCE_DELAY_MS = 25;
 
+// Sampling constants
+unsigned long const SAMPLE_PERIOD_US = 500;
+uint8_t const SAMPLE_DECIMATION = 4;
+unsigned long const TRANSMIT_PERIOD_US = 20000;
+float const ESTIMATOR_BANDWIDTH_HZ = 20.0;
+unsigned long const SYNC_PERIOD_US = 500000;
+
+// Power constants
+unsigned long const IDLE_SLEEP_DELAY_MS = 5000;
+unsigned long const WAKE_POLL_PERIOD_US = 25000;
+long const WAKE_DISTANCE = 16;
+
 #endif
@@ -0,0 +1,135 @@
+/**
+ * @file minion_power_manager.cpp
+ * 
+ * @brief minion light sleep while the leg is still
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#include "minion_power_manager.h"
+
+/**
+ * Minion Power Manager constructor
+ * 
+ * @param hal            hardware abstraction layer
+ * @param minion         minion whose encoder is watched
+ * @param sampler        sampler to stop while asleep
+ * @param clock_sync     clock sync to restart on waking, may be null
+ * @param idle_delay_ms  how long the leg has to be still before sleeping in
+ *                       ms
+ * @param poll_period_us light sleep between encoder polls in us
+ * @param wake_distance  motion that counts as moving in encoder units
+ */
+MinionPowerManager::MinionPowerManager(
+    Hal* hal,
+    ElevateMinion* minion,
+    MinionSampler* sampler,
+    ClockSync* clock_sync,
+    unsigned long idle_delay_ms,
+    unsigned long poll_period_us,
+    long wake_distance) :
+HAL(hal),
+MINION(minion),
+SAMPLER(sampler),
+CLOCK_SYNC(clock_sync),
+IDLE_DELAY_MS(idle_delay_ms),
+POLL_PERIOD_US(poll_period_us),
+WAKE_DISTANCE(wake_distance) {
+  is_sampler_running = true;
+  idle_height = 0;
+  idle_start_time = HAL->clock->millis();
+  sleeps = 0;
+}
+
+/**
+ * Poll the encoder after a light sleep, or go to sleep if the leg has been
+ * still for long enough; call at the top of loop(), with the sampler started
+ * 
+ * The AS5600 has no motion interrupt, so motion is found by polling. Once
+ * the leg has stayed within WAKE_DISTANCE of one height for IDLE_DELAY_MS,
+ * the sampler is stopped and the minion light sleeps for POLL_PERIOD_US at a
+ * time, waking only to read the encoder once. A poll sees the angle read at
+ * the poll before, so sampling resumes at full rate within two poll periods
+ * of the leg moving WAKE_DISTANCE. A poll period is far too short for the
+ * leg to turn half a rotation, so unwrapping survives the gaps. The limit
+ * switches only change with motion and are left to the sampler. Clock sync
+ * restarts with sampling, since the clocks drift apart during the sleep.
+ * 
+ * @return if the sampler is stopped and there is nothing to transmit
+ */
+bool MinionPowerManager::update() {
+  unsigned long current_time = HAL->clock->millis();
+  if (!is_sampler_running) {
+    long height = MINION->update_height();
+    if (!has_moved(height)) {
+      sleep();
+      return true;
+    }
+    idle_height = height;
+    idle_start_time = current_time;
+    if (CLOCK_SYNC) CLOCK_SYNC->restart();
+    is_sampler_running = SAMPLER->start();
+    return !is_sampler_running;
+  }
+
+  long height = MINION->get_height();
+  if (has_moved(height)) {
+    idle_height = height;
+    idle_start_time = current_time;
+    return false;
+  }
+  if (current_time - idle_start_time < IDLE_DELAY_MS) return false;
+
+  SAMPLER->stop();
+  is_sampler_running = false;
+  sleep();
+  return true;
+}
+
+/**
+ * Determine if the sampler is running at full rate
+ * 
+ * @return if the sampler is running
+ */
+bool MinionPowerManager::is_sampling() const {
+  return is_sampler_running;
+}
+
+/**
+ * Get number of light sleeps, one per poll
+ * 
+ * @return number of sleeps
+ */
+unsigned long MinionPowerManager::get_sleeps() const {
+  return sleeps;
+}
+
+/**
+ * Get the height the leg has been still at, that motion is measured from
+ * 
+ * @return height in encoder units
+ */
+long MinionPowerManager::get_idle_height() const {
+  return idle_height;
+}
+
+/**
+ * Determine if the leg has left the height it was still at
+ * 
+ * @param height current height in encoder units
+ * 
+ * @return if the leg moved more than WAKE_DISTANCE
+ */
+bool MinionPowerManager::has_moved(long height) const {
+  long distance = height - idle_height;
+  return distance > WAKE_DISTANCE || distance < -WAKE_DISTANCE;
+}
+
+/**
+ * Light sleep until the next poll
+ */
+void MinionPowerManager::sleep() {
+  sleeps++;
+  HAL->power->enable_timer_wake(POLL_PERIOD_US);
+  HAL->power->light_sleep();
+}
@@ -0,0 +1,51 @@
+/**
+ * @file minion_power_manager.h
+ * 
+ * @brief header file for minion light sleep while the leg is still
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#ifndef MINION_POWER_MANAGER_H_
+#define MINION_POWER_MANAGER_H_
+
+#include "clock_sync.h"
+#include "elevate_minion.h"
+#include "hal.h"
+#include "minion_sampler.h"
+
+class MinionPowerManager {
+  public:
+    MinionPowerManager(
+      Hal* hal,
+      ElevateMinion* minion,
+      MinionSampler* sampler,
+      ClockSync* clock_sync,
+      unsigned long idle_delay_ms,
+      unsigned long poll_period_us,
+      long wake_distance
+    );
+    bool update();
+    bool is_sampling() const;
+    unsigned long get_sleeps() const;
+    long get_idle_height() const;
+
+  private:
+    Hal* const HAL;
+    ElevateMinion* const MINION;
+    MinionSampler* const SAMPLER;
+    ClockSync* const CLOCK_SYNC;
+    unsigned long const IDLE_DELAY_MS;
+    unsigned long const POLL_PERIOD_US;
+    long const WAKE_DISTANCE;
+
+    bool is_sampler_running;
+    long idle_height;
+    unsigned long idle_start_time;
+    unsigned long sleeps;
+
+    bool has_moved(long height) const;
+    void sleep();
+};
+
+#endif
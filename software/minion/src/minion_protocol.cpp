@@ -0,0 +1,452 @@
+/**
+ * @file minion_protocol.cpp
+ * 
+ * @brief minion to master wire protocol
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#include "minion_protocol.h"
+
+static size_t const HEADER_SIZE = 2;
+static size_t const CHECKSUM_SIZE = 2;
+static size_t const BATCH_HEADER_SIZE = 19;
+static size_t const BATCH_DELTA_SIZE = 9;
+
+/**
+ * Get the length of a batch frame
+ * 
+ * @param count number of samples in the batch
+ * 
+ * @return frame length in bytes
+ */
+static size_t batch_frame_size(uint8_t count) {
+  return BATCH_HEADER_SIZE + BATCH_DELTA_SIZE * (count - 1) + CHECKSUM_SIZE;
+}
+
+/**
+ * Write a little-endian 16 bit value; frames are written field by field so
+ * the layout does not depend on struct padding or compiler
+ * 
+ * @param buffer destination
+ * @param value  value to write
+ */
+static void write_u16(uint8_t* buffer, uint16_t value) {
+  buffer[0] = (uint8_t) value;
+  buffer[1] = (uint8_t) (value >> 8);
+}
+
+/**
+ * Write a little-endian 32 bit value
+ * 
+ * @param buffer destination
+ * @param value  value to write
+ */
+static void write_u32(uint8_t* buffer, uint32_t value) {
+  buffer[0] = (uint8_t) value;
+  buffer[1] = (uint8_t) (value >> 8);
+  buffer[2] = (uint8_t) (value >> 16);
+  buffer[3] = (uint8_t) (value >> 24);
+}
+
+/**
+ * Read a little-endian 16 bit value
+ * 
+ * @param buffer source
+ * 
+ * @return value read
+ */
+static uint16_t read_u16(const uint8_t* buffer) {
+  return (uint16_t) (buffer[0] | (buffer[1] << 8));
+}
+
+/**
+ * Read a little-endian 32 bit value
+ * 
+ * @param buffer source
+ * 
+ * @return value read
+ */
+static uint32_t read_u32(const uint8_t* buffer) {
+  return (uint32_t) buffer[0] |
+    ((uint32_t) buffer[1] << 8) |
+    ((uint32_t) buffer[2] << 16) |
+    ((uint32_t) buffer[3] << 24);
+}
+
+/**
+ * Compute CRC-16/CCITT-FALSE, a byte at a time from a 256 entry table
+ * 
+ * @param data bytes to check
+ * @param len  number of bytes
+ * 
+ * @return checksum
+ */
+uint16_t minion_crc16(const uint8_t* data, size_t len) {
+  static uint16_t const BYTE_TABLE[256] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+    0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
+    0x1231, 0x0210, 0x3273, 0x2252, 0x52b5, 0x4294, 0x72f7, 0x62d6,
+    0x9339, 0x8318, 0xb37b, 0xa35a, 0xd3bd, 0xc39c, 0xf3ff, 0xe3de,
+    0x2462, 0x3443, 0x0420, 0x1401, 0x64e6, 0x74c7, 0x44a4, 0x5485,
+    0xa56a, 0xb54b, 0x8528, 0x9509, 0xe5ee, 0xf5cf, 0xc5ac, 0xd58d,
+    0x3653, 0x2672, 0x1611, 0x0630, 0x76d7, 0x66f6, 0x5695, 0x46b4,
+    0xb75b, 0xa77a, 0x9719, 0x8738, 0xf7df, 0xe7fe, 0xd79d, 0xc7bc,
+    0x48c4, 0x58e5, 0x6886, 0x78a7, 0x0840, 0x1861, 0x2802, 0x3823,
+    0xc9cc, 0xd9ed, 0xe98e, 0xf9af, 0x8948, 0x9969, 0xa90a, 0xb92b,
+    0x5af5, 0x4ad4, 0x7ab7, 0x6a96, 0x1a71, 0x0a50, 0x3a33, 0x2a12,
+    0xdbfd, 0xcbdc, 0xfbbf, 0xeb9e, 0x9b79, 0x8b58, 0xbb3b, 0xab1a,
+    0x6ca6, 0x7c87, 0x4ce4, 0x5cc5, 0x2c22, 0x3c03, 0x0c60, 0x1c41,
+    0xedae, 0xfd8f, 0xcdec, 0xddcd, 0xad2a, 0xbd0b, 0x8d68, 0x9d49,
+    0x7e97, 0x6eb6, 0x5ed5, 0x4ef4, 0x3e13, 0x2e32, 0x1e51, 0x0e70,
+    0xff9f, 0xefbe, 0xdfdd, 0xcffc, 0xbf1b, 0xaf3a, 0x9f59, 0x8f78,
+    0x9188, 0x81a9, 0xb1ca, 0xa1eb, 0xd10c, 0xc12d, 0xf14e, 0xe16f,
+    0x1080, 0x00a1, 0x30c2, 0x20e3, 0x5004, 0x4025, 0x7046, 0x6067,
+    0x83b9, 0x9398, 0xa3fb, 0xb3da, 0xc33d, 0xd31c, 0xe37f, 0xf35e,
+    0x02b1, 0x1290, 0x22f3, 0x32d2, 0x4235, 0x5214, 0x6277, 0x7256,
+    0xb5ea, 0xa5cb, 0x95a8, 0x8589, 0xf56e, 0xe54f, 0xd52c, 0xc50d,
+    0x34e2, 0x24c3, 0x14a0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+    0xa7db, 0xb7fa, 0x8799, 0x97b8, 0xe75f, 0xf77e, 0xc71d, 0xd73c,
+    0x26d3, 0x36f2, 0x0691, 0x16b0, 0x6657, 0x7676, 0x4615, 0x5634,
+    0xd94c, 0xc96d, 0xf90e, 0xe92f, 0x99c8, 0x89e9, 0xb98a, 0xa9ab,
+    0x5844, 0x4865, 0x7806, 0x6827, 0x18c0, 0x08e1, 0x3882, 0x28a3,
+    0xcb7d, 0xdb5c, 0xeb3f, 0xfb1e, 0x8bf9, 0x9bd8, 0xabbb, 0xbb9a,
+    0x4a75, 0x5a54, 0x6a37, 0x7a16, 0x0af1, 0x1ad0, 0x2ab3, 0x3a92,
+    0xfd2e, 0xed0f, 0xdd6c, 0xcd4d, 0xbdaa, 0xad8b, 0x9de8, 0x8dc9,
+    0x7c26, 0x6c07, 0x5c64, 0x4c45, 0x3ca2, 0x2c83, 0x1ce0, 0x0cc1,
+    0xef1f, 0xff3e, 0xcf5d, 0xdf7c, 0xaf9b, 0xbfba, 0x8fd9, 0x9ff8,
+    0x6e17, 0x7e36, 0x4e55, 0x5e74, 0x2e93, 0x3eb2, 0x0ed1, 0x1ef0
+  };
+  uint16_t crc = 0xffff;
+  for (size_t i = 0; i < len; i++) {
+    crc = (uint16_t) ((crc << 8) ^ BYTE_TABLE[(crc >> 8) ^ data[i]]);
+  }
+  return crc;
+}
+
+/**
+ * Encode a sample message into a frame, little-endian, 16 bytes, with no
+ * motion estimate:
+ * 
+ *   0  uint8   version
+ *   1  uint8   message type
+ *   2  uint8   minion ID
+ *   3  uint16  sequence number
+ *   5  uint32  minion timestamp in us
+ *   9  int32   module height
+ *   13 uint8   status bits
+ *   14 uint16  CRC-16/CCITT-FALSE over bytes 0-13
+ * 
+ * @param message message to encode
+ * @param buffer  frame buffer
+ * @param size    frame buffer size in bytes
+ * 
+ * @return frame length in bytes, or 0 if the buffer is too small
+ */
+size_t encode_minion_message(MinionMessage const& message, uint8_t* buffer, size_t size) {
+  size_t len = MINION_SAMPLE_FRAME_SIZE;
+  if (size < len) return 0;
+  buffer[0] = MINION_PROTOCOL_VERSION;
+  buffer[1] = MINION_SAMPLE;
+  buffer[2] = message.id;
+  write_u16(buffer + 3, message.sequence);
+  write_u32(buffer + 5, message.timestamp_us);
+  write_u32(buffer + 9, (uint32_t) message.height);
+  buffer[13] = message.status;
+  write_u16(buffer + 14, minion_crc16(buffer, len - CHECKSUM_SIZE));
+  return len;
+}
+
+/**
+ * Decode a sample message from a frame
+ * 
+ * @param data    frame
+ * @param len     frame length in bytes
+ * @param message decoded message, only valid if the frame is accepted
+ * 
+ * @return decode status
+ */
+MinionMessageStatus decode_minion_message(const uint8_t* data, size_t len, MinionMessage& message) {
+  if (len < HEADER_SIZE) return MINION_MESSAGE_TOO_SHORT;
+  if (data[0] != MINION_PROTOCOL_VERSION) return MINION_MESSAGE_BAD_VERSION;
+  if (data[1] != MINION_SAMPLE) return MINION_MESSAGE_BAD_TYPE;
+  size_t expected = MINION_SAMPLE_FRAME_SIZE;
+  if (len < expected) return MINION_MESSAGE_TOO_SHORT;
+  if (read_u16(data + expected - CHECKSUM_SIZE) != minion_crc16(data, expected - CHECKSUM_SIZE)) {
+    return MINION_MESSAGE_BAD_CHECKSUM;
+  }
+  message.id = data[2];
+  message.sequence = read_u16(data + 3);
+  message.timestamp_us = read_u32(data + 5);
+  message.height = (int32_t) read_u32(data + 9);
+  message.status = data[13];
+  return MINION_MESSAGE_OK;
+}
+
+/**
+ * Append a sample to a batch if it fits the delta encoding
+ * 
+ * @param batch  batch to append to
+ * @param sample sample to append, newer than every sample in the batch
+ * 
+ * @return if the sample was appended; false if the batch is full or the
+ *         sample is too far from the previous one to delta encode
+ */
+bool add_minion_sample(MinionBatch& batch, MinionSample const& sample) {
+  if (batch.count >= MINION_MAXIMUM_BATCH_SIZE) return false;
+  if (batch.count > 0) {
+    MinionSample const& previous = batch.samples[batch.count - 1];
+    uint32_t time_difference = sample.timestamp_us - previous.timestamp_us;
+    int32_t height_difference = sample.height - previous.height;
+    if (time_difference > 0xffff) return false;
+    if (height_difference < INT16_MIN || height_difference > INT16_MAX) return false;
+  }
+  batch.samples[batch.count++] = sample;
+  return true;
+}
+
+/**
+ * Encode a batch of samples into a frame, little-endian,
+ * 21 + 9 * (count - 1) bytes:
+ * 
+ *   0  uint8   version
+ *   1  uint8   message type
+ *   2  uint8   minion ID
+ *   3  uint16  sequence number
+ *   5  uint8   sample count
+ *   6  uint32  minion timestamp of the first sample in us
+ *   10 int32   module height of the first sample
+ *   14 int16   velocity of the first sample
+ *   16 int16   acceleration of the first sample
+ *   18 uint8   status bits of the first sample
+ *   19         per later sample: uint16 us since the previous sample,
+ *              int16 height change since the previous sample, int16
+ *              velocity, int16 acceleration, uint8 status
+ *   ...uint16  CRC-16/CCITT-FALSE over every byte before it
+ * 
+ * @param batch  batch built with add_minion_sample
+ * @param buffer frame buffer
+ * @param size   frame buffer size in bytes
+ * 
+ * @return frame length in bytes, or 0 if the batch is empty or the buffer is
+ *         too small
+ */
+size_t encode_minion_batch(MinionBatch const& batch, uint8_t* buffer, size_t size) {
+  if (batch.count == 0 || batch.count > MINION_MAXIMUM_BATCH_SIZE) return 0;
+  size_t len = batch_frame_size(batch.count);
+  if (size < len) return 0;
+  buffer[0] = MINION_PROTOCOL_VERSION;
+  buffer[1] = MINION_SAMPLE_BATCH;
+  buffer[2] = batch.id;
+  write_u16(buffer + 3, batch.sequence);
+  buffer[5] = batch.count;
+  write_u32(buffer + 6, batch.samples[0].timestamp_us);
+  write_u32(buffer + 10, (uint32_t) batch.samples[0].height);
+  write_u16(buffer + 14, (uint16_t) batch.samples[0].velocity);
+  write_u16(buffer + 16, (uint16_t) batch.samples[0].acceleration);
+  buffer[18] = batch.samples[0].status;
+  uint8_t* delta = buffer + BATCH_HEADER_SIZE;
+  for (uint8_t i = 1; i < batch.count; i++) {
+    MinionSample const& previous = batch.samples[i - 1];
+    MinionSample const& sample = batch.samples[i];
+    write_u16(delta, (uint16_t) (sample.timestamp_us - previous.timestamp_us));
+    write_u16(delta + 2, (uint16_t) (sample.height - previous.height));
+    write_u16(delta + 4, (uint16_t) sample.velocity);
+    write_u16(delta + 6, (uint16_t) sample.acceleration);
+    delta[8] = sample.status;
+    delta += BATCH_DELTA_SIZE;
+  }
+  write_u16(buffer + len - CHECKSUM_SIZE, minion_crc16(buffer, len - CHECKSUM_SIZE));
+  return len;
+}
+
+/**
+ * Decode a frame of either sample type into a batch
+ * 
+ * @param data  frame
+ * @param len   frame length in bytes
+ * @param batch decoded batch, only valid if the frame is accepted
+ * 
+ * @return decode status
+ */
+MinionMessageStatus decode_minion_batch(const uint8_t* data, size_t len, MinionBatch& batch) {
+  if (len < HEADER_SIZE) return MINION_MESSAGE_TOO_SHORT;
+  if (data[0] != MINION_PROTOCOL_VERSION) return MINION_MESSAGE_BAD_VERSION;
+  if (data[1] == MINION_SAMPLE) {
+    MinionMessage message;
+    MinionMessageStatus status = decode_minion_message(data, len, message);
+    if (status != MINION_MESSAGE_OK) return status;
+    batch.id = message.id;
+    batch.sequence = message.sequence;
+    batch.count = 1;
+    batch.samples[0].timestamp_us = message.timestamp_us;
+    batch.samples[0].height = message.height;
+    batch.samples[0].velocity = 0;
+    batch.samples[0].acceleration = 0;
+    batch.samples[0].status = message.status;
+    return MINION_MESSAGE_OK;
+  }
+  if (data[1] != MINION_SAMPLE_BATCH) return MINION_MESSAGE_BAD_TYPE;
+  if (len < BATCH_HEADER_SIZE) return MINION_MESSAGE_TOO_SHORT;
+  uint8_t count = data[5];
+  if (count == 0 || count > MINION_MAXIMUM_BATCH_SIZE) return MINION_MESSAGE_BAD_COUNT;
+  size_t expected = batch_frame_size(count);
+  if (len < expected) return MINION_MESSAGE_TOO_SHORT;
+  if (read_u16(data + expected - CHECKSUM_SIZE) != minion_crc16(data, expected - CHECKSUM_SIZE)) {
+    return MINION_MESSAGE_BAD_CHECKSUM;
+  }
+  batch.id = data[2];
+  batch.sequence = read_u16(data + 3);
+  batch.count = count;
+  batch.samples[0].timestamp_us = read_u32(data + 6);
+  batch.samples[0].height = (int32_t) read_u32(data + 10);
+  batch.samples[0].velocity = (int16_t) read_u16(data + 14);
+  batch.samples[0].acceleration = (int16_t) read_u16(data + 16);
+  batch.samples[0].status = data[18];
+  const uint8_t* delta = data + BATCH_HEADER_SIZE;
+  for (uint8_t i = 1; i < count; i++) {
+    MinionSample const& previous = batch.samples[i - 1];
+    MinionSample& sample = batch.samples[i];
+    sample.timestamp_us = previous.timestamp_us + read_u16(delta);
+    sample.height = previous.height + (int16_t) read_u16(delta + 2);
+    sample.velocity = (int16_t) read_u16(delta + 4);
+    sample.acceleration = (int16_t) read_u16(delta + 6);
+    sample.status = delta[8];
+    delta += BATCH_DELTA_SIZE;
+  }
+  return MINION_MESSAGE_OK;
+}
+
+/**
+ * Check the header of a frame and get its message type
+ * 
+ * @param data frame
+ * @param len  frame length in bytes
+ * @param type message type, only valid if the header is accepted
+ * 
+ * @return header status
+ */
+MinionMessageStatus peek_minion_message_type(const uint8_t* data, size_t len, MinionMessageType& type) {
+  if (len < HEADER_SIZE) return MINION_MESSAGE_TOO_SHORT;
+  if (data[0] != MINION_PROTOCOL_VERSION) return MINION_MESSAGE_BAD_VERSION;
+  if (data[1] < MINION_SAMPLE || data[1] > MINION_SYNC_REPLY) return MINION_MESSAGE_BAD_TYPE;
+  type = (MinionMessageType) data[1];
+  return MINION_MESSAGE_OK;
+}
+
+/**
+ * Check the header, length and checksum of a fixed size frame
+ * 
+ * @param data     frame
+ * @param len      frame length in bytes
+ * @param type     expected message type
+ * @param expected expected frame length in bytes
+ * 
+ * @return frame status
+ */
+static MinionMessageStatus check_fixed_frame(
+    const uint8_t* data,
+    size_t len,
+    MinionMessageType type,
+    size_t expected) {
+  if (len < HEADER_SIZE) return MINION_MESSAGE_TOO_SHORT;
+  if (data[0] != MINION_PROTOCOL_VERSION) return MINION_MESSAGE_BAD_VERSION;
+  if (data[1] != type) return MINION_MESSAGE_BAD_TYPE;
+  if (len < expected) return MINION_MESSAGE_TOO_SHORT;
+  if (read_u16(data + expected - CHECKSUM_SIZE) != minion_crc16(data, expected - CHECKSUM_SIZE)) {
+    return MINION_MESSAGE_BAD_CHECKSUM;
+  }
+  return MINION_MESSAGE_OK;
+}
+
+/**
+ * Encode a clock sync request into a frame, little-endian, 9 bytes:
+ * 
+ *   0  uint8   version
+ *   1  uint8   message type
+ *   2  uint8   minion ID
+ *   3  uint32  minion clock when the request was sent in us
+ *   7  uint16  CRC-16/CCITT-FALSE over bytes 0-6
+ * 
+ * @param request request to encode
+ * @param buffer  frame buffer
+ * @param size    frame buffer size in bytes
+ * 
+ * @return frame length in bytes, or 0 if the buffer is too small
+ */
+size_t encode_minion_sync_request(MinionSyncRequest const& request, uint8_t* buffer, size_t size) {
+  size_t len = MINION_SYNC_REQUEST_FRAME_SIZE;
+  if (size < len) return 0;
+  buffer[0] = MINION_PROTOCOL_VERSION;
+  buffer[1] = MINION_SYNC_REQUEST;
+  buffer[2] = request.id;
+  write_u32(buffer + 3, request.minion_send_us);
+  write_u16(buffer + 7, minion_crc16(buffer, len - CHECKSUM_SIZE));
+  return len;
+}
+
+/**
+ * Decode a clock sync request from a frame
+ * 
+ * @param data    frame
+ * @param len     frame length in bytes
+ * @param request decoded request, only valid if the frame is accepted
+ * 
+ * @return decode status
+ */
+MinionMessageStatus decode_minion_sync_request(const uint8_t* data, size_t len, MinionSyncRequest& request) {
+  MinionMessageStatus status = check_fixed_frame(data, len, MINION_SYNC_REQUEST, MINION_SYNC_REQUEST_FRAME_SIZE);
+  if (status != MINION_MESSAGE_OK) return status;
+  request.id = data[2];
+  request.minion_send_us = read_u32(data + 3);
+  return MINION_MESSAGE_OK;
+}
+
+/**
+ * Encode a clock sync reply into a frame, little-endian, 17 bytes:
+ * 
+ *   0  uint8   version
+ *   1  uint8   message type
+ *   2  uint8   minion ID the reply is for
+ *   3  uint32  minion send time copied from the request in us
+ *   7  uint32  master clock when the request arrived in us
+ *   11 uint32  master clock when the reply was sent in us
+ *   15 uint16  CRC-16/CCITT-FALSE over bytes 0-14
+ * 
+ * @param reply  reply to encode
+ * @param buffer frame buffer
+ * @param size   frame buffer size in bytes
+ * 
+ * @return frame length in bytes, or 0 if the buffer is too small
+ */
+size_t encode_minion_sync_reply(MinionSyncReply const& reply, uint8_t* buffer, size_t size) {
+  size_t len = MINION_SYNC_REPLY_FRAME_SIZE;
+  if (size < len) return 0;
+  buffer[0] = MINION_PROTOCOL_VERSION;
+  buffer[1] = MINION_SYNC_REPLY;
+  buffer[2] = reply.id;
+  write_u32(buffer + 3, reply.minion_send_us);
+  write_u32(buffer + 7, reply.master_receive_us);
+  write_u32(buffer + 11, reply.master_send_us);
+  write_u16(buffer + 15, minion_crc16(buffer, len - CHECKSUM_SIZE));
+  return len;
+}
+
+/**
+ * Decode a clock sync reply from a frame
+ * 
+ * @param data  frame
+ * @param len   frame length in bytes
+ * @param reply decoded reply, only valid if the frame is accepted
+ * 
+ * @return decode status
+ */
+MinionMessageStatus decode_minion_sync_reply(const uint8_t* data, size_t len, MinionSyncReply& reply) {
+  MinionMessageStatus status = check_fixed_frame(data, len, MINION_SYNC_REPLY, MINION_SYNC_REPLY_FRAME_SIZE);
+  if (status != MINION_MESSAGE_OK) return status;
+  reply.id = data[2];
+  reply.minion_send_us = read_u32(data + 3);
+  reply.master_receive_us = read_u32(data + 7);
+  reply.master_send_us = read_u32(data + 11);
+  return MINION_MESSAGE_OK;
+}
@@ -0,0 +1,160 @@
+/**
+ * @file minion_protocol.h
+ * 
+ * @brief header file for the minion to master wire protocol
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#ifndef MINION_PROTOCOL_H_
+#define MINION_PROTOCOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+uint8_t const MINION_PROTOCOL_VERSION = 2;
+
+// Status bits
+uint8_t const MINION_LOWER_LIMIT_BIT = 0x01;
+uint8_t const MINION_UPPER_LIMIT_BIT = 0x02;
+uint8_t const MINION_MAGNET_STRENGTH_SHIFT = 2;
+uint8_t const MINION_MAGNET_STRENGTH_MASK = 0x0c;
+uint8_t const MINION_ENCODER_STALE_BIT = 0x10;
+uint8_t const MINION_CLOCK_SYNCED_BIT = 0x20;
+
+uint8_t const MINION_BROADCAST_ADDRESS[] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+
+size_t const MINION_SAMPLE_FRAME_SIZE = 16;
+uint8_t const MINION_MAXIMUM_BATCH_SIZE = 16;
+size_t const MINION_MAXIMUM_BATCH_FRAME_SIZE = 21 + 9 * (MINION_MAXIMUM_BATCH_SIZE - 1);
+float const MINION_ACCELERATION_SCALE = 16.0f;
+size_t const MINION_SYNC_REQUEST_FRAME_SIZE = 9;
+size_t const MINION_SYNC_REPLY_FRAME_SIZE = 17;
+
+/**
+ * Minion Message Type
+ * 
+ * MINION_SAMPLE:       single module sample
+ * MINION_SAMPLE_BATCH: delta-encoded run of module samples
+ * MINION_SYNC_REQUEST: minion asks for the master clock
+ * MINION_SYNC_REPLY:   master answers a sync request
+ */
+enum MinionMessageType {
+  MINION_SAMPLE = 1,
+  MINION_SAMPLE_BATCH = 2,
+  MINION_SYNC_REQUEST = 3,
+  MINION_SYNC_REPLY = 4
+};
+
+/**
+ * Minion Message Status
+ * 
+ * MINION_MESSAGE_OK:           message accepted
+ * MINION_MESSAGE_TOO_SHORT:    frame shorter than its message
+ * MINION_MESSAGE_BAD_VERSION:  unknown protocol version
+ * MINION_MESSAGE_BAD_TYPE:     unknown message type
+ * MINION_MESSAGE_BAD_CHECKSUM: CRC mismatch
+ * MINION_MESSAGE_BAD_COUNT:    batch sample count is 0 or too large
+ * MINION_MESSAGE_BAD_ID:       minion ID has no module
+ * MINION_MESSAGE_STALE:        repeated or out-of-order sequence number
+ */
+enum MinionMessageStatus {
+  MINION_MESSAGE_OK,
+  MINION_MESSAGE_TOO_SHORT,
+  MINION_MESSAGE_BAD_VERSION,
+  MINION_MESSAGE_BAD_TYPE,
+  MINION_MESSAGE_BAD_CHECKSUM,
+  MINION_MESSAGE_BAD_COUNT,
+  MINION_MESSAGE_BAD_ID,
+  MINION_MESSAGE_STALE
+};
+
+/**
+ * Struct for messages from encoder minion
+ * 
+ * id:           minion ID
+ * sequence:     sequence number, increments by one per message
+ * timestamp_us: minion clock when the sample was taken in us
+ * height:       module height
+ * status:       limit switch and magnet strength bits
+ */
+struct MinionMessage {
+  uint8_t id;
+  uint16_t sequence;
+  uint32_t timestamp_us;
+  int32_t height;
+  uint8_t status;
+};
+
+/**
+ * Struct for one sample in a batch
+ * 
+ * timestamp_us: minion clock when the sample was taken in us
+ * height:       module height
+ * velocity:     estimated velocity in encoder units per second
+ * acceleration: estimated acceleration in MINION_ACCELERATION_SCALE encoder
+ *               units per second squared
+ * status:       limit switch, encoder, clock and magnet strength bits
+ */
+struct MinionSample {
+  uint32_t timestamp_us;
+  int32_t height;
+  int16_t velocity;
+  int16_t acceleration;
+  uint8_t status;
+};
+
+/**
+ * Struct for a batch of samples from encoder minion
+ * 
+ * id:       minion ID
+ * sequence: sequence number, increments by one per frame
+ * count:    number of samples in the batch
+ * samples:  samples, oldest first
+ */
+struct MinionBatch {
+  uint8_t id;
+  uint16_t sequence;
+  uint8_t count;
+  MinionSample samples[MINION_MAXIMUM_BATCH_SIZE];
+};
+
+/**
+ * Struct for a clock sync request from encoder minion
+ * 
+ * id:             minion ID
+ * minion_send_us: minion clock when the request was sent in us
+ */
+struct MinionSyncRequest {
+  uint8_t id;
+  uint32_t minion_send_us;
+};
+
+/**
+ * Struct for the master reply to a clock sync request
+ * 
+ * id:                minion ID the reply is for
+ * minion_send_us:    minion send time copied from the request in us
+ * master_receive_us: master clock when the request arrived in us
+ * master_send_us:    master clock when the reply was sent in us
+ */
+struct MinionSyncReply {
+  uint8_t id;
+  uint32_t minion_send_us;
+  uint32_t master_receive_us;
+  uint32_t master_send_us;
+};
+
+uint16_t minion_crc16(const uint8_t* data, size_t len);
+size_t encode_minion_message(MinionMessage const& message, uint8_t* buffer, size_t size);
+MinionMessageStatus decode_minion_message(const uint8_t* data, size_t len, MinionMessage& message);
+bool add_minion_sample(MinionBatch& batch, MinionSample const& sample);
+size_t encode_minion_batch(MinionBatch const& batch, uint8_t* buffer, size_t size);
+MinionMessageStatus decode_minion_batch(const uint8_t* data, size_t len, MinionBatch& batch);
+MinionMessageStatus peek_minion_message_type(const uint8_t* data, size_t len, MinionMessageType& type);
+size_t encode_minion_sync_request(MinionSyncRequest const& request, uint8_t* buffer, size_t size);
+MinionMessageStatus decode_minion_sync_request(const uint8_t* data, size_t len, MinionSyncRequest& request);
+size_t encode_minion_sync_reply(MinionSyncReply const& reply, uint8_t* buffer, size_t size);
+MinionMessageStatus decode_minion_sync_reply(const uint8_t* data, size_t len, MinionSyncReply& reply);
+
+#endif
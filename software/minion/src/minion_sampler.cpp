@@ -0,0 +1,175 @@
+/**
+ * @file minion_sampler.cpp
+ * 
+ * @brief timer-paced minion sampler
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#include "minion_sampler.h"
+
+/**
+ * Minion Sampler constructor
+ * 
+ * @param hal              hardware abstraction layer
+ * @param minion           minion to sample
+ * @param clock_sync       clock sync to stamp samples with, or 0 to keep the
+ *                         minion clock
+ * @param sample_period_us encoder read period in us
+ * @param decimation       encoder reads per queued sample
+ */
+MinionSampler::MinionSampler(
+    Hal* hal,
+    ElevateMinion* minion,
+    ClockSync* clock_sync,
+    unsigned long sample_period_us,
+    uint8_t decimation) :
+HAL(hal),
+MINION(minion),
+CLOCK_SYNC(clock_sync),
+SAMPLE_PERIOD_US(sample_period_us),
+DECIMATION(decimation > 0 ? decimation : 1),
+head(0),
+tail(0),
+dropped(0) {
+  ticks_since_sample = 0;
+  has_synced_timestamp = false;
+  synced_timestamp_us = 0;
+  batch.id = 0;
+  batch.sequence = 0;
+  batch.count = 0;
+  has_held_sample = false;
+}
+
+/**
+ * Minion Sampler copy constructor, only valid before the sampler is started
+ * 
+ * @param other sampler to copy
+ */
+MinionSampler::MinionSampler(MinionSampler const& other) :
+HAL(other.HAL),
+MINION(other.MINION),
+CLOCK_SYNC(other.CLOCK_SYNC),
+SAMPLE_PERIOD_US(other.SAMPLE_PERIOD_US),
+DECIMATION(other.DECIMATION),
+head(0),
+tail(0),
+dropped(0) {
+  ticks_since_sample = 0;
+  has_synced_timestamp = false;
+  synced_timestamp_us = 0;
+  batch = other.batch;
+  has_held_sample = false;
+}
+
+/**
+ * Start sampling on the periodic timer, fast enough that the angle never
+ * moves half a turn between reads so unwrapping holds at full travel speed
+ * 
+ * @return if the timer started
+ */
+bool MinionSampler::start() {
+  return HAL->timer->start(SAMPLE_PERIOD_US, tick, this);
+}
+
+/**
+ * Stop sampling
+ */
+void MinionSampler::stop() {
+  HAL->timer->stop();
+}
+
+/**
+ * Read the encoder and limit switches once and queue a sample every
+ * DECIMATION reads, called only from the timer side, which never waits on
+ * the radio. Once the clock is synced, timestamps are converted to the
+ * master clock, and a correction that steps the offset back is held flat
+ * rather than sending time backwards.
+ */
+void MinionSampler::sample() {
+  MINION->update_height();
+  MINION->update_switches();
+  if (++ticks_since_sample < DECIMATION) return;
+  ticks_since_sample = 0;
+
+  uint32_t current = head.load(std::memory_order_relaxed);
+  if (current - tail.load(std::memory_order_acquire) >= QUEUE_CAPACITY) {
+    dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    return;
+  }
+  MinionSample& slot = queue[current % QUEUE_CAPACITY];
+  MINION->sample(slot);
+  if (CLOCK_SYNC && CLOCK_SYNC->is_synced()) {
+    slot.timestamp_us = CLOCK_SYNC->to_master_us(slot.timestamp_us);
+    if (has_synced_timestamp && (int32_t) (slot.timestamp_us - synced_timestamp_us) < 0) {
+      slot.timestamp_us = synced_timestamp_us;
+    }
+    slot.status |= MINION_CLOCK_SYNCED_BIT;
+    synced_timestamp_us = slot.timestamp_us;
+    has_synced_timestamp = true;
+  }
+  head.store(current + 1, std::memory_order_release);
+}
+
+/**
+ * Encode queued samples into one batch frame, called only from the transmit
+ * side; call again until it returns 0 to send everything queued
+ * 
+ * @param id     minion ID
+ * @param buffer frame buffer, MINION_MAXIMUM_BATCH_FRAME_SIZE bytes fits
+ *               any batch
+ * @param size   frame buffer size in bytes
+ * 
+ * @return frame length in bytes, or 0 if nothing is queued
+ */
+size_t MinionSampler::encode_frame(uint8_t id, uint8_t* buffer, size_t size) {
+  batch.id = id;
+  batch.count = 0;
+  if (has_held_sample) {
+    add_minion_sample(batch, held_sample);
+    has_held_sample = false;
+  }
+  uint32_t current = tail.load(std::memory_order_relaxed);
+  uint32_t end = head.load(std::memory_order_acquire);
+  while (current != end && batch.count < MINION_MAXIMUM_BATCH_SIZE) {
+    MinionSample const& next = queue[current % QUEUE_CAPACITY];
+    current++;
+    if (!add_minion_sample(batch, next)) {
+      held_sample = next;
+      has_held_sample = true;
+      break;
+    }
+  }
+  tail.store(current, std::memory_order_release);
+
+  size_t len = encode_minion_batch(batch, buffer, size);
+  if (len > 0) batch.sequence++;
+  return len;
+}
+
+/**
+ * Get encoder read period
+ * 
+ * @return read period in us
+ */
+unsigned long MinionSampler::get_sample_period_us() const {
+  return SAMPLE_PERIOD_US;
+}
+
+/**
+ * Get number of samples dropped because transmission fell behind
+ * 
+ * @return number of dropped samples
+ */
+uint32_t MinionSampler::get_dropped() const {
+  return dropped.load(std::memory_order_relaxed);
+}
+
+/**
+ * Timer callback
+ * 
+ * @param sampler sampler that started the timer
+ */
+void MinionSampler::tick(void* sampler) {
+  ((MinionSampler*) sampler)->sample();
+}
@@ -0,0 +1,61 @@
+/**
+ * @file minion_sampler.h
+ * 
+ * @brief header file for timer-paced minion sampler
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#ifndef MINION_SAMPLER_H_
+#define MINION_SAMPLER_H_
+
+#include "clock_sync.h"
+#include "elevate_minion.h"
+#include "hal.h"
+#include "minion_protocol.h"
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+class MinionSampler {
+  public:
+    MinionSampler(
+      Hal* hal,
+      ElevateMinion* minion,
+      ClockSync* clock_sync,
+      unsigned long sample_period_us,
+      uint8_t decimation
+    );
+    MinionSampler(MinionSampler const& other);
+    bool start();
+    void stop();
+    void sample();
+    size_t encode_frame(uint8_t id, uint8_t* buffer, size_t size);
+    unsigned long get_sample_period_us() const;
+    uint32_t get_dropped() const;
+
+  private:
+    static uint32_t const QUEUE_CAPACITY = 64;
+
+    Hal* const HAL;
+    ElevateMinion* const MINION;
+    ClockSync* const CLOCK_SYNC;
+    unsigned long const SAMPLE_PERIOD_US;
+    uint8_t const DECIMATION;
+
+    uint8_t ticks_since_sample;
+    bool has_synced_timestamp;
+    uint32_t synced_timestamp_us;
+    MinionSample queue[QUEUE_CAPACITY];
+    std::atomic<uint32_t> head;
+    std::atomic<uint32_t> tail;
+    std::atomic<uint32_t> dropped;
+
+    MinionBatch batch;
+    MinionSample held_sample;
+    bool has_held_sample;
+
+    static void tick(void* sampler);
+};
+
+#endif
@@ -0,0 +1,106 @@
+/**
+ * @file motion_estimator.cpp
+ * 
+ * @brief tracking-loop motion estimator
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#include "motion_estimator.h"
+#include <math.h>
+
+/**
+ * Flush a decaying estimate to zero before it turns subnormal, where float
+ * arithmetic runs many times slower
+ * 
+ * @param value estimate
+ * 
+ * @return value, or 0 once it is negligibly small
+ */
+static float flush_to_zero(float value) {
+  return (fabsf(value) < 1e-12f) ? 0.0f : value;
+}
+
+/**
+ * Motion Estimator constructor, a third-order tracking loop with all three
+ * observer poles at the bandwidth, so the estimate follows a constant
+ * acceleration with no steady-state error and smooths count quantization
+ * above the bandwidth
+ * 
+ * @param bandwidth_hz observer bandwidth in Hz
+ */
+MotionEstimator::MotionEstimator(float bandwidth_hz) :
+POSITION_GAIN(3.0f * 2.0f * (float) M_PI * bandwidth_hz),
+VELOCITY_GAIN(3.0f * powf(2.0f * (float) M_PI * bandwidth_hz, 2.0f)),
+ACCELERATION_GAIN(powf(2.0f * (float) M_PI * bandwidth_hz, 3.0f)) {
+  reset(0);
+}
+
+/**
+ * Restart the estimate at rest
+ * 
+ * @param position position in encoder units
+ */
+void MotionEstimator::reset(long position) {
+  position_base = position;
+  position_offset = 0.0f;
+  velocity = 0.0f;
+  acceleration = 0.0f;
+}
+
+/**
+ * Update the estimate with a new position reading, a gap too long for the
+ * loop to stay stable restarts it at the reading. The position is kept as a
+ * whole count base plus a small float offset so single precision keeps
+ * sub-count resolution over the full travel.
+ * 
+ * @param position position in encoder units
+ * @param dt       time since the previous reading in s
+ */
+void MotionEstimator::update(long position, float dt) {
+  if (dt <= 0.0f) return;
+  if (POSITION_GAIN * dt > 1.0f) {
+    reset(position);
+    return;
+  }
+  position_offset += (velocity + 0.5f * acceleration * dt) * dt;
+  velocity += acceleration * dt;
+
+  float error = (float) (position - position_base) - position_offset;
+  position_offset += POSITION_GAIN * dt * error;
+  velocity += VELOCITY_GAIN * dt * error;
+  acceleration += ACCELERATION_GAIN * dt * error;
+
+  long whole = lroundf(position_offset);
+  position_base += whole;
+  position_offset = flush_to_zero(position_offset - (float) whole);
+  velocity = flush_to_zero(velocity);
+  acceleration = flush_to_zero(acceleration);
+}
+
+/**
+ * Get estimated position
+ * 
+ * @return position in encoder units, rounded
+ */
+long MotionEstimator::get_position() const {
+  return position_base + lroundf(position_offset);
+}
+
+/**
+ * Get estimated velocity
+ * 
+ * @return velocity in encoder units per second
+ */
+float MotionEstimator::get_velocity() const {
+  return velocity;
+}
+
+/**
+ * Get estimated acceleration
+ * 
+ * @return acceleration in encoder units per second squared
+ */
+float MotionEstimator::get_acceleration() const {
+  return acceleration;
+}
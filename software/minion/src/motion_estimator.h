@@ -0,0 +1,32 @@
+/**
+ * @file motion_estimator.h
+ * 
+ * @brief header file for tracking-loop motion estimator
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#ifndef MOTION_ESTIMATOR_H_
+#define MOTION_ESTIMATOR_H_
+
+class MotionEstimator {
+  public:
+    MotionEstimator(float bandwidth_hz);
+    void reset(long position);
+    void update(long position, float dt);
+    long get_position() const;
+    float get_velocity() const;
+    float get_acceleration() const;
+
+  private:
+    float const POSITION_GAIN;
+    float const VELOCITY_GAIN;
+    float const ACCELERATION_GAIN;
+
+    long position_base;
+    float position_offset;
+    float velocity;
+    float acceleration;
+};
+
+#endif
@@ -0,0 +1,46 @@
+/**
+ * @file switch_debouncer.h
+ * 
+ * @brief header file for debouncing a bank of switches in parallel
+ * 
+ * @author Jonathan Lee
+ * Contact: jonlee27@seas.upenn.edu
+ */
+#ifndef SWITCH_DEBOUNCER_H_
+#define SWITCH_DEBOUNCER_H_
+
+#include "hal.h"
+#include <stdint.h>
+
+class SwitchDebouncer {
+  public:
+    static int const STABLE_SAMPLES = 4;
+
+    SwitchDebouncer(Hal* hal, unsigned long delay_ms);
+    bool add_switch(uint8_t pin);
+    void setup();
+    void update();
+    bool is_pressed(uint8_t pin) const;
+    bool was_pressed(uint8_t pin) const;
+    bool was_released(uint8_t pin) const;
+    uint32_t get_pressed() const;
+    uint32_t get_presses() const;
+    uint32_t get_releases() const;
+
+  private:
+    Hal* const HAL;
+    unsigned long const TICK_US;
+
+    int bank;
+    uint32_t mask;
+    unsigned long previous_tick_us;
+    uint32_t pressed;
+    uint32_t count_low;
+    uint32_t count_high;
+    uint32_t presses;
+    uint32_t releases;
+
+    static uint32_t pin_bit(uint8_t pin);
+};
+
+#endif